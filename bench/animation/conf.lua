@@ -0,0 +1,9 @@
+function lovr.conf(t)
+  t.identity = 'lovr-bench'
+  t.modules.audio = false
+  t.modules.headset = false
+  t.modules.physics = false
+  t.window.width = 320
+  t.window.height = 240
+  t.window.title = 'bench'
+end
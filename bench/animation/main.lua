@@ -0,0 +1,146 @@
+-- Long animation benchmark.  Writes a glTF with a chain of joints animated by long rotation and
+-- translation tracks to the save directory, then times keyframe sampling for monotonic playback,
+-- random seeks, batched playback, and playback after ModelData:compressAnimations.
+--
+-- Usage: lovr bench/animation [joints] [seconds] [models]
+
+local ffi = require 'ffi'
+
+local JOINTS = tonumber(arg[1]) or 64
+local SECONDS = tonumber(arg[2]) or 600
+local MODELS = tonumber(arg[3]) or 32
+local RATE = 30
+local FRAMES = 600
+local KEYS = SECONDS * RATE + 1
+
+local function generate(filename)
+  local timesSize = KEYS * 4
+  local rotationSize = KEYS * 16
+  local translationSize = KEYS * 12
+  local size = timesSize + JOINTS * (rotationSize + translationSize)
+  local data = ffi.new('float[?]', size / 4)
+
+  for k = 0, KEYS - 1 do
+    data[k] = k / RATE
+  end
+
+  local views, accessors, samplers, channels, nodes = {}, {}, {}, {}, {}
+  views[1] = ('{"buffer":0,"byteOffset":0,"byteLength":%d}'):format(timesSize)
+  accessors[1] = ('{"bufferView":0,"componentType":5126,"count":%d,"type":"SCALAR","min":[0],"max":[%f]}'):format(KEYS, (KEYS - 1) / RATE)
+
+  local offset = timesSize
+  for j = 0, JOINTS - 1 do
+    local f = offset / 4
+    for k = 0, KEYS - 1 do
+      local t = k / RATE
+      local angle = math.sin(t * (1 + j * .01)) * .5 + math.sin(t * 3.7 + j) * .1
+      local s, c = math.sin(angle / 2), math.cos(angle / 2)
+      data[f + k * 4 + 0] = s * .6
+      data[f + k * 4 + 1] = s * .8
+      data[f + k * 4 + 2] = 0
+      data[f + k * 4 + 3] = c
+    end
+    views[#views + 1] = ('{"buffer":0,"byteOffset":%d,"byteLength":%d}'):format(offset, rotationSize)
+    accessors[#accessors + 1] = ('{"bufferView":%d,"componentType":5126,"count":%d,"type":"VEC4"}'):format(#views - 1, KEYS)
+    offset = offset + rotationSize
+
+    f = offset / 4
+    for k = 0, KEYS - 1 do
+      local t = k / RATE
+      data[f + k * 3 + 0] = math.sin(t * 2 + j) * .05
+      data[f + k * 3 + 1] = .25
+      data[f + k * 3 + 2] = math.cos(t * 1.3 + j) * .05
+    end
+    views[#views + 1] = ('{"buffer":0,"byteOffset":%d,"byteLength":%d}'):format(offset, translationSize)
+    accessors[#accessors + 1] = ('{"bufferView":%d,"componentType":5126,"count":%d,"type":"VEC3"}'):format(#views - 1, KEYS)
+    offset = offset + translationSize
+
+    samplers[#samplers + 1] = ('{"input":0,"output":%d,"interpolation":"LINEAR"}'):format(#accessors - 2)
+    samplers[#samplers + 1] = ('{"input":0,"output":%d,"interpolation":"LINEAR"}'):format(#accessors - 1)
+    channels[#channels + 1] = ('{"sampler":%d,"target":{"node":%d,"path":"rotation"}}'):format(#samplers - 2, j)
+    channels[#channels + 1] = ('{"sampler":%d,"target":{"node":%d,"path":"translation"}}'):format(#samplers - 1, j)
+    nodes[#nodes + 1] = j < JOINTS - 1 and ('{"children":[%d]}'):format(j + 1) or '{}'
+  end
+
+  local binary = (filename:gsub('%.gltf$', '.bin'))
+  local json = table.concat({
+    '{"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],',
+    '"nodes":[', table.concat(nodes, ','), '],',
+    '"buffers":[{"uri":"', binary, '","byteLength":', size, '}],',
+    '"bufferViews":[', table.concat(views, ','), '],',
+    '"accessors":[', table.concat(accessors, ','), '],',
+    '"animations":[{"name":"long","samplers":[', table.concat(samplers, ','), '],',
+    '"channels":[', table.concat(channels, ','), ']}]}'
+  })
+
+  lovr.filesystem.write(binary, ffi.string(data, size))
+  lovr.filesystem.write(filename, json)
+  return size
+end
+
+local function measure(label, fn, frames)
+  local start = lovr.timer.getTime()
+  fn()
+  local elapsed = (lovr.timer.getTime() - start) * 1000
+  if frames then
+    print(('%-24s %9.3f ms total %9.4f ms/frame'):format(label, elapsed, elapsed / frames))
+  else
+    print(('%-24s %9.3f ms'):format(label, elapsed))
+  end
+end
+
+local function run(label, modelData)
+  local models = {}
+  for i = 1, MODELS do
+    models[i] = lovr.graphics.newModel(modelData)
+  end
+
+  measure(label .. ' playback', function()
+    for frame = 1, FRAMES do
+      for i = 1, MODELS do
+        models[i]:animate(1, (frame / 90 + i * 7.3) % SECONDS)
+      end
+    end
+  end, FRAMES)
+
+  measure(label .. ' seek', function()
+    for frame = 1, FRAMES do
+      for i = 1, MODELS do
+        models[i]:animate(1, lovr.math.random() * SECONDS)
+      end
+    end
+  end, FRAMES)
+
+  local requests = {}
+  for i = 1, MODELS do
+    requests[i] = { models[i], 1, 0 }
+  end
+
+  measure(label .. ' batch', function()
+    for frame = 1, FRAMES do
+      for i = 1, MODELS do
+        requests[i][3] = (frame / 90 + i * 7.3) % SECONDS
+      end
+      lovr.graphics.animate(requests)
+    end
+  end, FRAMES)
+end
+
+function lovr.load()
+  lovr.math.setRandomSeed(0)
+
+  local filename = 'bench-animation.gltf'
+  local size = generate(filename)
+  print(('%d joints, %d keyframes per track, %d models, %d frames, %.1f MB of keyframes'):format(JOINTS, KEYS, MODELS, FRAMES, size / 2 ^ 20))
+
+  local modelData
+  measure('load', function() modelData = lovr.data.newModelData(filename) end)
+  run('raw', modelData)
+
+  measure('compress', function() modelData:compressAnimations(RATE, .0001) end)
+  run('compressed', modelData)
+
+  lovr.filesystem.remove(filename)
+  lovr.filesystem.remove((filename:gsub('%.gltf$', '.bin')))
+  lovr.event.quit()
+end
@@ -0,0 +1,8 @@
+function lovr.conf(t)
+  t.identity = 'lovr-bench'
+  t.modules.audio = false
+  t.modules.graphics = false
+  t.modules.headset = false
+  t.modules.physics = false
+  t.window = nil
+end
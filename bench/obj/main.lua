@@ -0,0 +1,75 @@
+-- OBJ loading benchmark.  Writes a large tessellated OBJ to the save directory, then times
+-- lovr.data.newModelData on it a few times and reports the best and average load times.
+--
+-- Usage: lovr bench/obj [segments] [runs]
+
+local SEGMENTS = tonumber(arg[1]) or 1024
+local RUNS = tonumber(arg[2]) or 5
+
+-- A torus with positions, normals, and texture coordinates, written in chunks to keep the string
+-- table small.  Values are printed with the precision exporters usually use.
+local function generate(filename)
+  local rings, sides = SEGMENTS, SEGMENTS / 2
+  local chunks, lines = {}, {}
+
+  local function flush()
+    chunks[#chunks + 1] = table.concat(lines, '\n', 1, #lines) .. '\n'
+    lines = {}
+  end
+
+  local function emit(line)
+    lines[#lines + 1] = line
+    if #lines >= 4096 then flush() end
+  end
+
+  emit('# generated by bench/obj')
+  emit('o torus')
+
+  for i = 0, rings do
+    local u = i / rings * 2 * math.pi
+    for j = 0, sides do
+      local v = j / sides * 2 * math.pi
+      local nx, ny, nz = math.cos(u) * math.cos(v), math.sin(v), math.sin(u) * math.cos(v)
+      local x, y, z = math.cos(u) + .25 * nx, .25 * ny, math.sin(u) + .25 * nz
+      emit(('v %.6f %.6f %.6f'):format(x, y, z))
+      emit(('vn %.6f %.6f %.6f'):format(nx, ny, nz))
+      emit(('vt %.6f %.6f'):format(i / rings, j / sides))
+    end
+  end
+
+  local stride = sides + 1
+  for i = 0, rings - 1 do
+    for j = 0, sides - 1 do
+      local a = i * stride + j + 1
+      local b = a + stride
+      emit(('f %d/%d/%d %d/%d/%d %d/%d/%d'):format(a, a, a, b, b, b, b + 1, b + 1, b + 1))
+      emit(('f %d/%d/%d %d/%d/%d %d/%d/%d'):format(a, a, a, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1))
+    end
+  end
+
+  flush()
+  local contents = table.concat(chunks)
+  lovr.filesystem.write(filename, contents)
+  return (rings + 1) * (sides + 1), rings * sides * 2, #contents
+end
+
+function lovr.load()
+  local filename = 'bench-obj.obj'
+  local vertices, triangles, size = generate(filename)
+  print(('%d vertices, %d triangles, %.1f MB'):format(vertices, triangles, size / 2 ^ 20))
+
+  local best, total = math.huge, 0
+  for run = 1, RUNS do
+    collectgarbage()
+    local start = lovr.timer.getTime()
+    local modelData = lovr.data.newModelData(filename)
+    local elapsed = (lovr.timer.getTime() - start) * 1000
+    modelData:release()
+    best, total = math.min(best, elapsed), total + elapsed
+    print(('run %d %9.3f ms'):format(run, elapsed))
+  end
+
+  print(('best %9.3f ms average %9.3f ms'):format(best, total / RUNS))
+  lovr.filesystem.remove(filename)
+  lovr.event.quit()
+end
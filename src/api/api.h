@@ -1,6 +1,7 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include "core/hash.h"
@@ -51,6 +52,7 @@ extern const luaL_Reg lovrSliderJoint[];
 extern const luaL_Reg lovrSoundData[];
 extern const luaL_Reg lovrSource[];
 extern const luaL_Reg lovrSphereShape[];
+extern const luaL_Reg lovrTask[];
 extern const luaL_Reg lovrTexture[];
 extern const luaL_Reg lovrTextureData[];
 extern const luaL_Reg lovrThread[];
@@ -144,6 +146,15 @@ void luax_readcolor(lua_State* L, int index, struct Color* color);
 #ifdef LOVR_ENABLE_DATA
 struct Blob;
 struct Blob* luax_readblob(lua_State* L, int index, const char* debug);
+struct Blob* luax_mapfile(const char* path);
+struct Blob* luax_loadmodelblob(const char* path);
+struct ModelData;
+struct ModelDataFlags;
+struct TextureData;
+void luax_readmodeldataflags(lua_State* L, int index, struct ModelDataFlags* flags);
+uint64_t luax_cachesource(const char* path, struct Blob* blob);
+struct ModelData* luax_loadmodeldata(const char* path, struct Blob* blob, struct ModelDataFlags flags);
+struct TextureData* luax_loadtexturedata(const char* path, struct Blob* blob, bool flip);
 #endif
 
 #ifdef LOVR_ENABLE_EVENT
@@ -5,6 +5,10 @@
 #include "data/rasterizer.h"
 #include "data/soundData.h"
 #include "data/textureData.h"
+#include "filesystem/filesystem.h"
+#include "thread/task.h"
+#include "core/cache.h"
+#include "core/hash.h"
 #include "core/ref.h"
 #include <stdlib.h>
 #include <string.h>
@@ -58,11 +62,128 @@ static int l_lovrDataNewAudioStream(lua_State* L) {
   return 1;
 }
 
+// Cooked models are mapped instead of read, so their vertex and texture data is used in place.  Only
+// the magic is read to tell them apart, other files are read normally.
+Blob* luax_loadmodelblob(const char* path) {
+  size_t size = 0;
+  void* magic = lovrFilesystemRead(path, 8, &size);
+  bool cooked = magic && lovrModelDataIsCooked(magic, size);
+  free(magic);
+
+  if (cooked) {
+    Blob* blob = luax_mapfile(path);
+    if (blob) {
+      return blob;
+    }
+  }
+
+  void* data = luax_readfile(path, &size);
+  lovrAssert(data, "Could not read Model from '%s'", path);
+  return lovrBlobCreate(data, size, path);
+}
+
+// Loads from a path or a Blob go through the cache.  Paths are keyed by name (writing to the path
+// invalidates them), Blobs by contents.
+uint64_t luax_cachesource(const char* path, Blob* blob) {
+  return path ? lovrCacheHashPath(path) : hash64(blob->data, blob->size);
+}
+
+static Blob* readSource(const char* path, Blob* blob, const char* debug) {
+  if (blob) {
+    lovrRetain(blob);
+    return blob;
+  }
+
+  size_t size;
+  void* data = luax_readfile(path, &size);
+  lovrAssert(data, "Could not read %s from '%s'", debug, path);
+  return lovrBlobCreate(data, size, path);
+}
+
+ModelData* luax_loadmodeldata(const char* path, Blob* blob, ModelDataFlags flags) {
+  uint64_t options = flags.optimize | flags.deferImages << 1 | (uint64_t) flags.lods << 2;
+  uint64_t source = luax_cachesource(path, blob);
+  uint64_t key = lovrCacheKey("ModelData", source, options);
+  ModelData* modelData = lovrCacheGet(key);
+  if (modelData) {
+    return modelData;
+  }
+
+  Blob* contents = blob;
+  if (contents) {
+    lovrRetain(contents);
+  } else {
+    contents = luax_loadmodelblob(path);
+  }
+
+  modelData = lovrModelDataCreate(contents, luax_readfile, flags);
+  lovrRelease(Blob, contents);
+
+  // Images are cached separately
+  size_t size = 0;
+  for (uint32_t i = 0; i < modelData->blobCount; i++) {
+    size += modelData->blobs[i]->size;
+  }
+
+  lovrCachePut(key, source, modelData, size);
+  return modelData;
+}
+
+TextureData* luax_loadtexturedata(const char* path, Blob* blob, bool flip) {
+  uint64_t source = luax_cachesource(path, blob);
+  uint64_t key = lovrCacheKey("TextureData", source, flip);
+  TextureData* textureData = lovrCacheGet(key);
+  if (textureData) {
+    return textureData;
+  }
+
+  Blob* contents = readSource(path, blob, "Texture");
+  textureData = lovrTextureDataCreateFromBlob(contents, flip);
+  lovrRelease(Blob, contents);
+  lovrCachePut(key, source, textureData, textureData->blob ? textureData->blob->size : textureData->source->size);
+  return textureData;
+}
+
+static SoundData* loadSoundData(const char* path, Blob* blob) {
+  uint64_t source = luax_cachesource(path, blob);
+  uint64_t key = lovrCacheKey("SoundData", source, 0);
+  SoundData* soundData = lovrCacheGet(key);
+  if (soundData) {
+    return soundData;
+  }
+
+  Blob* contents = readSource(path, blob, "SoundData");
+  soundData = lovrSoundDataCreateFromBlob(contents);
+  lovrRelease(Blob, contents);
+  lovrCachePut(key, source, soundData, soundData->blob->size);
+  return soundData;
+}
+
+void luax_readmodeldataflags(lua_State* L, int index, ModelDataFlags* flags) {
+  *flags = (ModelDataFlags) { .optimize = false, .lods = 0, .deferImages = false };
+
+  if (lua_istable(L, index)) {
+    lua_getfield(L, index, "optimize");
+    flags->optimize = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "lods");
+    flags->lods = luaL_optinteger(L, -1, 0);
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "deferImages");
+    flags->deferImages = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+}
+
 static int l_lovrDataNewModelData(lua_State* L) {
-  Blob* blob = luax_readblob(L, 1, "Model");
-  ModelData* modelData = lovrModelDataCreate(blob, luax_readfile);
+  Blob* blob = luax_totype(L, 1, Blob);
+  const char* path = blob ? NULL : luaL_checkstring(L, 1);
+  ModelDataFlags flags;
+  luax_readmodeldataflags(L, 2, &flags);
+  ModelData* modelData = luax_loadmodeldata(path, blob, flags);
   luax_pushtype(L, ModelData, modelData);
-  lovrRelease(Blob, blob);
   lovrRelease(ModelData, modelData);
   return 1;
 }
@@ -105,10 +226,10 @@ static int l_lovrDataNewSoundData(lua_State* L) {
     return 1;
   }
 
-  Blob* blob = luax_readblob(L, 1, "SoundData");
-  SoundData* soundData = lovrSoundDataCreateFromBlob(blob);
+  Blob* blob = luax_totype(L, 1, Blob);
+  const char* path = blob ? NULL : luaL_checkstring(L, 1);
+  SoundData* soundData = loadSoundData(path, blob);
   luax_pushtype(L, SoundData, soundData);
-  lovrRelease(Blob, blob);
   lovrRelease(SoundData, soundData);
   return 1;
 }
@@ -126,10 +247,10 @@ static int l_lovrDataNewTextureData(lua_State* L) {
     if (source) {
       textureData = lovrTextureDataCreate(source->width, source->height, source->blob, 0x0, source->format);
     } else {
-      Blob* blob = luax_readblob(L, 1, "Texture");
+      Blob* blob = luax_totype(L, 1, Blob);
+      const char* path = blob ? NULL : luaL_checkstring(L, 1);
       bool flip = lua_isnoneornil(L, 2) ? true : lua_toboolean(L, 2);
-      textureData = lovrTextureDataCreateFromBlob(blob, flip);
-      lovrRelease(Blob, blob);
+      textureData = luax_loadtexturedata(path, blob, flip);
     }
   }
 
@@ -138,6 +259,121 @@ static int l_lovrDataNewTextureData(lua_State* L) {
   return 1;
 }
 
+static int l_lovrDataIsCacheEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrCacheIsEnabled());
+  return 1;
+}
+
+static int l_lovrDataSetCacheEnabled(lua_State* L) {
+  lovrCacheSetEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
+static int l_lovrDataGetCacheStats(lua_State* L) {
+  if (lua_gettop(L) > 0) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 1);
+  } else {
+    lua_createtable(L, 0, 4);
+  }
+
+  CacheStats stats;
+  lovrCacheGetStats(&stats);
+  lua_pushnumber(L, stats.hits);
+  lua_setfield(L, 1, "hits");
+  lua_pushnumber(L, stats.misses);
+  lua_setfield(L, 1, "misses");
+  lua_pushinteger(L, stats.objects);
+  lua_setfield(L, 1, "objects");
+  lua_pushnumber(L, stats.memory);
+  lua_setfield(L, 1, "memory");
+  return 1;
+}
+
+#ifdef LOVR_ENABLE_THREAD
+// Async loads copy the path (or retain the Blob) so the file is read on a worker thread too
+typedef struct {
+  char* path;
+  Blob* blob;
+  ModelDataFlags flags;
+  bool flip;
+} DataTask;
+
+static DataTask* luax_newdatatask(lua_State* L, int index) {
+  Blob* blob = luax_totype(L, index, Blob);
+  size_t length = 0;
+  const char* path = blob ? NULL : luaL_checklstring(L, index, &length);
+  DataTask* context = calloc(1, sizeof(DataTask));
+  lovrAssert(context, "Out of memory");
+  if (blob) {
+    context->blob = blob;
+    lovrRetain(blob);
+  } else {
+    context->path = malloc(length + 1);
+    lovrAssert(context->path, "Out of memory");
+    memcpy(context->path, path, length + 1);
+  }
+  return context;
+}
+
+static void freeDataTask(void* ref) {
+  DataTask* context = ref;
+  lovrRelease(Blob, context->blob);
+  free(context->path);
+  free(context);
+}
+
+static bool loadModelDataTask(Task* task) {
+  DataTask* context = task->context;
+  ModelData* modelData = luax_loadmodeldata(context->path, context->blob, context->flags);
+  task->result = (Variant) { .type = TYPE_OBJECT, .value.object = { modelData, "ModelData", lovrModelDataDestroy } };
+  return true;
+}
+
+static bool loadSoundDataTask(Task* task) {
+  DataTask* context = task->context;
+  SoundData* soundData = loadSoundData(context->path, context->blob);
+  task->result = (Variant) { .type = TYPE_OBJECT, .value.object = { soundData, "SoundData", lovrSoundDataDestroy } };
+  return true;
+}
+
+static bool loadTextureDataTask(Task* task) {
+  DataTask* context = task->context;
+  TextureData* textureData = luax_loadtexturedata(context->path, context->blob, context->flip);
+  task->result = (Variant) { .type = TYPE_OBJECT, .value.object = { textureData, "TextureData", lovrTextureDataDestroy } };
+  return true;
+}
+
+static int luax_startdatatask(lua_State* L, TaskFn* run, DataTask* context) {
+  Task* task = lovrTaskCreate(run, NULL, context, freeDataTask);
+  task->notify = true;
+  lovrTaskStart(task);
+  luax_pushtype(L, Task, task);
+  lovrRelease(Task, task);
+  return 1;
+}
+
+static int l_lovrDataNewModelDataAsync(lua_State* L) {
+  ModelDataFlags flags;
+  luax_readmodeldataflags(L, 2, &flags);
+  DataTask* context = luax_newdatatask(L, 1);
+  context->flags = flags;
+  return luax_startdatatask(L, loadModelDataTask, context);
+}
+
+static int l_lovrDataNewSoundDataAsync(lua_State* L) {
+  DataTask* context = luax_newdatatask(L, 1);
+  return luax_startdatatask(L, loadSoundDataTask, context);
+}
+
+static int l_lovrDataNewTextureDataAsync(lua_State* L) {
+  bool flip = lua_isnoneornil(L, 2) ? true : lua_toboolean(L, 2);
+  DataTask* context = luax_newdatatask(L, 1);
+  context->flip = flip;
+  return luax_startdatatask(L, loadTextureDataTask, context);
+}
+#endif
+
 static const luaL_Reg lovrData[] = {
   { "newBlob", l_lovrDataNewBlob },
   { "newAudioStream", l_lovrDataNewAudioStream },
@@ -145,6 +381,14 @@ static const luaL_Reg lovrData[] = {
   { "newRasterizer", l_lovrDataNewRasterizer },
   { "newSoundData", l_lovrDataNewSoundData },
   { "newTextureData", l_lovrDataNewTextureData },
+  { "isCacheEnabled", l_lovrDataIsCacheEnabled },
+  { "setCacheEnabled", l_lovrDataSetCacheEnabled },
+  { "getCacheStats", l_lovrDataGetCacheStats },
+#ifdef LOVR_ENABLE_THREAD
+  { "newModelDataAsync", l_lovrDataNewModelDataAsync },
+  { "newSoundDataAsync", l_lovrDataNewSoundDataAsync },
+  { "newTextureDataAsync", l_lovrDataNewTextureDataAsync },
+#endif
   { NULL, NULL }
 };
 
@@ -1,6 +1,33 @@
 #include "api.h"
 #include "data/modelData.h"
 
+static int l_lovrModelDataCompressAnimations(lua_State* L) {
+  ModelData* modelData = luax_checktype(L, 1, ModelData);
+  float rate = luax_optfloat(L, 2, 30.f);
+  float tolerance = luax_optfloat(L, 3, .0001f);
+  lovrModelDataCompressAnimations(modelData, rate, tolerance);
+  return 0;
+}
+
+static int l_lovrModelDataEncode(lua_State* L) {
+  ModelData* modelData = luax_checktype(L, 1, ModelData);
+  const char* filename = luaL_checkstring(L, 2);
+  bool success = lovrModelDataEncode(modelData, filename);
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+static int l_lovrModelDataGetOptimizationStats(lua_State* L) {
+  ModelData* modelData = luax_checktype(L, 1, ModelData);
+  lua_pushinteger(L, modelData->removedVertices);
+  lua_pushnumber(L, modelData->acmrBefore);
+  lua_pushnumber(L, modelData->acmrAfter);
+  return 3;
+}
+
 const luaL_Reg lovrModelData[] = {
+  { "compressAnimations", l_lovrModelDataCompressAnimations },
+  { "encode", l_lovrModelDataEncode },
+  { "getOptimizationStats", l_lovrModelDataGetOptimizationStats },
   { NULL, NULL }
 };
@@ -1,5 +1,8 @@
 #include "api.h"
+#include "data/blob.h"
 #include "data/textureData.h"
+#include "core/ref.h"
+#include <stdlib.h>
 
 static int l_lovrTextureDataEncode(lua_State* L) {
   TextureData* textureData = luax_checktype(L, 1, TextureData);
@@ -47,6 +50,19 @@ static int l_lovrTextureDataPaste(lua_State* L) {
   return 0;
 }
 
+static int l_lovrTextureDataGenerateMipmaps(lua_State* L) {
+  TextureData* textureData = luax_checktype(L, 1, TextureData);
+  bool linear = lua_toboolean(L, 2);
+  lovrTextureDataGenerateMipmaps(textureData, !linear);
+  return 0;
+}
+
+static int l_lovrTextureDataGetMipmapCount(lua_State* L) {
+  TextureData* textureData = luax_checktype(L, 1, TextureData);
+  lua_pushinteger(L, MAX(textureData->mipmapCount, 1));
+  return 1;
+}
+
 static int l_lovrTextureDataGetPixel(lua_State* L) {
   TextureData* textureData = luax_checktype(L, 1, TextureData);
   int x = luaL_checkinteger(L, 2);
@@ -73,6 +89,80 @@ static int l_lovrTextureDataSetPixel(lua_State* L) {
   return 0;
 }
 
+static int l_lovrTextureDataGetPixels(lua_State* L) {
+  TextureData* textureData = luax_checktype(L, 1, TextureData);
+  uint32_t x = luaL_optinteger(L, 2, 0);
+  uint32_t y = luaL_optinteger(L, 3, 0);
+  lovrAssert(x <= textureData->width && y <= textureData->height, "getPixels region must be within TextureData bounds");
+  uint32_t w = luaL_optinteger(L, 4, textureData->width - x);
+  uint32_t h = luaL_optinteger(L, 5, textureData->height - y);
+  TextureFormat format = lua_isnoneornil(L, 6) ? textureData->format : (TextureFormat) luax_checkenum(L, 6, TextureFormats, NULL, "TextureFormat");
+  bool srgb = lua_toboolean(L, 7);
+  lovrAssert(w <= textureData->width - x && h <= textureData->height - y, "getPixels region must be within TextureData bounds");
+  lovrAssert(format < FORMAT_DXT1, "Compressed formats can not be used with getPixels");
+  size_t size = (size_t) w * h * lovrTextureFormatGetPixelSize(format);
+  void* data = malloc(size);
+  lovrAssert(data, "Out of memory");
+  lovrTextureDataGetPixels(textureData, x, y, w, h, format, srgb, data);
+  Blob* blob = lovrBlobCreate(data, size, "TextureData pixels");
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(Blob, blob);
+  return 1;
+}
+
+static int l_lovrTextureDataSetPixels(lua_State* L) {
+  TextureData* textureData = luax_checktype(L, 1, TextureData);
+  Blob* blob = luax_checktype(L, 2, Blob);
+  uint32_t x = luaL_optinteger(L, 3, 0);
+  uint32_t y = luaL_optinteger(L, 4, 0);
+  lovrAssert(x <= textureData->width && y <= textureData->height, "setPixels region must be within TextureData bounds");
+  uint32_t w = luaL_optinteger(L, 5, textureData->width - x);
+  uint32_t h = luaL_optinteger(L, 6, textureData->height - y);
+  TextureFormat format = lua_isnoneornil(L, 7) ? textureData->format : (TextureFormat) luax_checkenum(L, 7, TextureFormats, NULL, "TextureFormat");
+  bool srgb = lua_toboolean(L, 8);
+  lovrAssert(w <= textureData->width - x && h <= textureData->height - y, "setPixels region must be within TextureData bounds");
+  lovrAssert(format < FORMAT_DXT1, "Compressed formats can not be used with setPixels");
+  size_t size = (size_t) w * h * lovrTextureFormatGetPixelSize(format);
+  lovrAssert(blob->size >= size, "Blob is too small for setPixels (%d bytes needed, got %d)", size, blob->size);
+  lovrTextureDataSetPixels(textureData, x, y, w, h, format, srgb, blob->data);
+  return 0;
+}
+
+// Converts one row at a time to floats so the callback only deals with Lua numbers
+static int l_lovrTextureDataMapPixel(lua_State* L) {
+  TextureData* textureData = luax_checktype(L, 1, TextureData);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  uint32_t x = luaL_optinteger(L, 3, 0);
+  uint32_t y = luaL_optinteger(L, 4, 0);
+  lovrAssert(x <= textureData->width && y <= textureData->height, "mapPixel region must be within TextureData bounds");
+  uint32_t w = luaL_optinteger(L, 5, textureData->width - x);
+  uint32_t h = luaL_optinteger(L, 6, textureData->height - y);
+  lovrAssert(w <= textureData->width - x && h <= textureData->height - y, "mapPixel region must be within TextureData bounds");
+
+  // The row is a userdata so it gets collected if the callback errors
+  float* row = lua_newuserdata(L, (size_t) w * 4 * sizeof(float));
+  for (uint32_t j = 0; j < h; j++) {
+    lovrTextureDataGetPixels(textureData, x, y + j, w, 1, FORMAT_RGBA32F, false, row);
+    for (uint32_t i = 0; i < w; i++) {
+      float* pixel = row + 4 * i;
+      lua_pushvalue(L, 2);
+      lua_pushinteger(L, x + i);
+      lua_pushinteger(L, y + j);
+      lua_pushnumber(L, pixel[0]);
+      lua_pushnumber(L, pixel[1]);
+      lua_pushnumber(L, pixel[2]);
+      lua_pushnumber(L, pixel[3]);
+      lua_call(L, 6, 4);
+      for (int c = 0; c < 4; c++) {
+        pixel[c] = luax_optfloat(L, -4 + c, pixel[c]);
+      }
+      lua_pop(L, 4);
+    }
+    lovrTextureDataSetPixels(textureData, x, y + j, w, 1, FORMAT_RGBA32F, false, row);
+  }
+  return 0;
+}
+
 static int l_lovrTextureDataGetBlob(lua_State* L) {
   TextureData* textureData = luax_checktype(L, 1, TextureData);
   Blob* blob = textureData->blob;
@@ -87,8 +177,13 @@ const luaL_Reg lovrTextureData[] = {
   { "getDimensions", l_lovrTextureDataGetDimensions },
   { "getFormat", l_lovrTextureDataGetFormat },
   { "paste", l_lovrTextureDataPaste },
+  { "generateMipmaps", l_lovrTextureDataGenerateMipmaps },
+  { "getMipmapCount", l_lovrTextureDataGetMipmapCount },
   { "getPixel", l_lovrTextureDataGetPixel },
   { "setPixel", l_lovrTextureDataSetPixel },
+  { "getPixels", l_lovrTextureDataGetPixels },
+  { "setPixels", l_lovrTextureDataSetPixels },
+  { "mapPixel", l_lovrTextureDataMapPixel },
   { "getBlob", l_lovrTextureDataGetBlob },
   { NULL, NULL }
 };
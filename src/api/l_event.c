@@ -1,6 +1,7 @@
 #include "api.h"
 #include "event/event.h"
 #include "thread/thread.h"
+#include "thread/task.h"
 #include "core/os.h"
 #include "core/ref.h"
 #include "core/util.h"
@@ -13,6 +14,7 @@ StringEntry EventTypes[] = {
   [EVENT_FOCUS] = ENTRY("focus"),
 #ifdef LOVR_ENABLE_THREAD
   [EVENT_THREAD_ERROR] = ENTRY("threaderror"),
+  [EVENT_TASK_DONE] = ENTRY("taskdone"),
 #endif
   { 0 }
 };
@@ -112,6 +114,15 @@ static int nextEvent(lua_State* L) {
       lua_pushstring(L, event.data.thread.error);
       lovrRelease(Thread, event.data.thread.thread);
       return 3;
+
+    case EVENT_TASK_DONE: {
+      Task* task = event.data.task.task;
+      luax_pushtype(L, Task, task);
+      luax_pushvariant(L, &task->result);
+      lua_pushstring(L, task->error);
+      lovrRelease(Task, task);
+      return 4;
+    }
 #endif
 
     case EVENT_CUSTOM:
@@ -151,6 +162,9 @@ static int l_lovrEventPoll(lua_State* L) {
 
 static int l_lovrEventPump(lua_State* L) {
   lovrEventPump();
+#ifdef LOVR_ENABLE_THREAD
+  lovrTaskUpdate();
+#endif
   return 0;
 }
 
@@ -30,6 +30,20 @@ Blob* luax_readblob(lua_State* L, int index, const char* debug) {
   }
 }
 
+// Returns a Blob of a mapped file, or NULL if the file can't be mapped.  Doesn't touch Lua, so it can
+// be used on other threads.
+Blob* luax_mapfile(const char* path) {
+  size_t size;
+  void* data = lovrFilesystemMap(path, &size);
+  if (!data) {
+    return NULL;
+  }
+
+  Blob* blob = lovrBlobCreate(data, size, path);
+  blob->mapped = true;
+  return blob;
+}
+
 static void pushDirectoryItem(void* context, const char* path) {
   lua_State* L = context;
 
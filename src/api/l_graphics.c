@@ -10,7 +10,9 @@
 #include "data/modelData.h"
 #include "data/rasterizer.h"
 #include "data/textureData.h"
+#include "thread/task.h"
 #include "core/arr.h"
+#include "core/cache.h"
 #include "core/ref.h"
 #include <math.h>
 #include <stdbool.h>
@@ -305,9 +307,9 @@ static TextureData* luax_checktexturedata(lua_State* L, int index, bool flip) {
   if (textureData) {
     lovrRetain(textureData);
   } else {
-    Blob* blob = luax_readblob(L, index, "Texture");
-    textureData = lovrTextureDataCreateFromBlob(blob, flip);
-    lovrRelease(Blob, blob);
+    Blob* blob = luax_totype(L, index, Blob);
+    const char* path = blob ? NULL : luaL_checkstring(L, index);
+    textureData = luax_loadtexturedata(path, blob, flip);
   }
 
   return textureData;
@@ -476,6 +478,30 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
   return 1;
 }
 
+static int l_lovrGraphicsGetTextureBudget(lua_State* L) {
+  uint64_t budget;
+  uint32_t idleFrames;
+  lovrGraphicsGetTextureBudget(&budget, &idleFrames);
+  if (budget > 0) {
+    lua_pushnumber(L, (lua_Number) budget);
+  } else {
+    lua_pushnil(L);
+  }
+  lua_pushinteger(L, idleFrames);
+  return 2;
+}
+
+static int l_lovrGraphicsSetTextureBudget(lua_State* L) {
+  uint64_t budget;
+  uint32_t idleFrames;
+  lovrGraphicsGetTextureBudget(&budget, &idleFrames);
+  lua_Number bytes = luaL_optnumber(L, 1, 0.);
+  lovrAssert(bytes >= 0., "Texture budget can not be negative");
+  idleFrames = luaL_optinteger(L, 2, idleFrames);
+  lovrGraphicsSetTextureBudget((uint64_t) bytes, idleFrames);
+  return 0;
+}
+
 // State
 
 static int l_lovrGraphicsReset(lua_State* L) {
@@ -635,6 +661,16 @@ static int l_lovrGraphicsSetLineWidth(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsGetLodBias(lua_State* L) {
+  lua_pushnumber(L, lovrGraphicsGetLodBias());
+  return 1;
+}
+
+static int l_lovrGraphicsSetLodBias(lua_State* L) {
+  lovrGraphicsSetLodBias(luax_optfloat(L, 1, 0.f));
+  return 0;
+}
+
 static int l_lovrGraphicsGetPointSize(lua_State* L) {
   lua_pushnumber(L, lovrGraphicsGetPointSize());
   return 1;
@@ -1003,6 +1039,50 @@ static int l_lovrGraphicsCompute(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsAnimate(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  uint32_t count = luax_len(L, 1);
+  ModelAnimationRequest* requests = lua_newuserdata(L, count * sizeof(ModelAnimationRequest));
+
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    lovrAssert(lua_istable(L, -1), "Expected a table of { Model, animation, time, [alpha], [instance] } tables");
+    lua_rawgeti(L, -1, 1);
+    lua_rawgeti(L, -2, 2);
+    lua_rawgeti(L, -3, 3);
+    lua_rawgeti(L, -4, 4);
+    lua_rawgeti(L, -5, 5);
+    Model* model = luax_checktype(L, -5, Model);
+    uint32_t animation;
+    if (lua_type(L, -4) == LUA_TSTRING) {
+      size_t length;
+      const char* name = lua_tolstring(L, -4, &length);
+      uint64_t index = map_get(&lovrModelGetModelData(model)->animationMap, hash64(name, length));
+      lovrAssert(index != MAP_NIL, "Model has no animation named '%s'", name);
+      animation = (uint32_t) index;
+    } else {
+      animation = luaL_checkinteger(L, -4) - 1;
+    }
+    uint32_t instance = ~0u;
+    if (!lua_isnoneornil(L, -1)) {
+      instance = luaL_checkinteger(L, -1);
+      lovrAssert(instance > 0, "Instance index must be positive");
+      instance--;
+    }
+    requests[i] = (ModelAnimationRequest) {
+      .model = model,
+      .animation = animation,
+      .time = luax_checkfloat(L, -3),
+      .alpha = luax_optfloat(L, -2, 1.f),
+      .instance = instance
+    };
+    lua_pop(L, 6);
+  }
+
+  lovrModelAnimateBatch(requests, count);
+  return 0;
+}
+
 // Types
 
 static void luax_checkuniformtype(lua_State* L, int index, UniformType* baseType, int* components) {
@@ -1335,22 +1415,128 @@ static int l_lovrGraphicsNewMesh(lua_State* L) {
 
 static int l_lovrGraphicsNewModel(lua_State* L) {
   ModelData* modelData = luax_totype(L, 1, ModelData);
+  ModelDataFlags flags;
+  luax_readmodeldataflags(L, 2, &flags);
+  bool batch = false;
+
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "batch");
+    batch = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
 
   if (!modelData) {
-    Blob* blob = luax_readblob(L, 1, "Model");
-    modelData = lovrModelDataCreate(blob, luax_readfile);
-    lovrRelease(Blob, blob);
+    Blob* blob = luax_totype(L, 1, Blob);
+    const char* path = blob ? NULL : luaL_checkstring(L, 1);
+    modelData = luax_loadmodeldata(path, blob, flags);
   } else {
     lovrRetain(modelData);
   }
 
-  Model* model = lovrModelCreate(modelData);
+  Model* model = lovrModelCreate(modelData, batch, NULL);
   luax_pushtype(L, Model, model);
   lovrRelease(ModelData, modelData);
   lovrRelease(Model, model);
   return 1;
 }
 
+#ifdef LOVR_ENABLE_THREAD
+// The file is read and decoded (images included) on a worker thread.  Then the main thread uploads
+// one texture per step, and the geometry in the last step, so a big Model is spread over frames.
+typedef struct {
+  char* path;
+  Blob* blob;
+  ModelData* modelData;
+  ModelDataFlags flags;
+  bool batch;
+  Texture** textures;
+  uint32_t textureIndex;
+} ModelTask;
+
+static void freeModelTask(void* ref) {
+  ModelTask* context = ref;
+  if (context->textures) {
+    for (uint32_t i = 0; i < context->modelData->textureCount; i++) {
+      lovrRelease(Texture, context->textures[i]);
+    }
+    free(context->textures);
+  }
+  lovrRelease(ModelData, context->modelData);
+  lovrRelease(Blob, context->blob);
+  free(context->path);
+  free(context);
+}
+
+static bool loadModel(Task* task) {
+  ModelTask* context = task->context;
+
+  if (!context->modelData) {
+    context->modelData = luax_loadmodeldata(context->path, context->blob, context->flags);
+  }
+
+  for (uint32_t i = 0; i < context->modelData->textureCount; i++) {
+    lovrModelDataGetTexture(context->modelData, i);
+  }
+
+  return true;
+}
+
+static bool uploadModel(Task* task) {
+  ModelTask* context = task->context;
+  ModelData* modelData = context->modelData;
+
+  if (context->textureIndex < modelData->textureCount) {
+    if (!context->textures) {
+      context->textures = calloc(modelData->textureCount, sizeof(Texture*));
+      lovrAssert(context->textures, "Out of memory");
+    }
+
+    uint32_t index = context->textureIndex++;
+    context->textures[index] = lovrModelCreateTexture(modelData, index);
+    return false;
+  }
+
+  Model* model = lovrModelCreate(modelData, context->batch, context->textures);
+  task->result = (Variant) { .type = TYPE_OBJECT, .value.object = { model, "Model", lovrModelDestroy } };
+  return true;
+}
+
+static int l_lovrGraphicsNewModelAsync(lua_State* L) {
+  ModelData* modelData = luax_totype(L, 1, ModelData);
+  Blob* blob = modelData ? NULL : luax_totype(L, 1, Blob);
+  size_t length = 0;
+  const char* path = (modelData || blob) ? NULL : luaL_checklstring(L, 1, &length);
+  ModelTask* context = calloc(1, sizeof(ModelTask));
+  lovrAssert(context, "Out of memory");
+  luax_readmodeldataflags(L, 2, &context->flags);
+
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "batch");
+    context->batch = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  if (modelData) {
+    context->modelData = modelData;
+    lovrRetain(modelData);
+  } else if (blob) {
+    context->blob = blob;
+    lovrRetain(blob);
+  } else {
+    context->path = malloc(length + 1);
+    lovrAssert(context->path, "Out of memory");
+    memcpy(context->path, path, length + 1);
+  }
+
+  Task* task = lovrTaskCreate(loadModel, uploadModel, context, freeModelTask);
+  task->notify = true;
+  lovrTaskStart(task);
+  luax_pushtype(L, Task, task);
+  lovrRelease(Task, task);
+  return 1;
+}
+#endif
+
 static const char* luax_checkshadersource(lua_State* L, int index, int *outLength) {
   if (lua_isnoneornil(L, index)) {
     return NULL;
@@ -1552,6 +1738,10 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
   bool blank = argType == LUA_TNUMBER;
   TextureType type = TEXTURE_2D;
 
+  // Textures made from a single path or Blob are cached
+  Blob* sourceBlob = argType == LUA_TUSERDATA ? luax_totype(L, index, Blob) : NULL;
+  const char* sourcePath = argType == LUA_TSTRING ? lua_tostring(L, index) : NULL;
+
   if (blank) {
     width = lua_tointeger(L, index++);
     height = luaL_checkinteger(L, index++);
@@ -1597,8 +1787,23 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
     lua_pop(L, 1);
   }
 
+  uint64_t key = 0;
+  uint64_t source = 0;
+  TextureFilter filter = lovrGraphicsGetDefaultFilter();
+  if (sourceBlob || sourcePath) {
+    uint64_t options = srgb | mipmaps << 1 | type << 2 | (uint64_t) msaa << 4 | (uint64_t) filter.mode << 12 | (uint64_t) filter.anisotropy << 16;
+    source = luax_cachesource(sourcePath, sourceBlob);
+    key = lovrCacheKey("Texture", source, options);
+    Texture* texture = lovrCacheGet(key);
+    if (texture) {
+      luax_pushtype(L, Texture, texture);
+      lovrRelease(Texture, texture);
+      return 1;
+    }
+  }
+
   Texture* texture = lovrTextureCreate(type, NULL, 0, srgb, mipmaps, msaa);
-  lovrTextureSetFilter(texture, lovrGraphicsGetDefaultFilter());
+  lovrTextureSetFilter(texture, filter);
 
   if (blank) {
     depth = depth ? depth : (type == TEXTURE_CUBE ? 6 : 1);
@@ -1622,11 +1827,20 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
         lovrTextureAllocate(texture, textureData->width, textureData->height, depth, textureData->format);
       }
       lovrTextureReplacePixels(texture, textureData, 0, 0, i, 0);
+      if (sourcePath) {
+        lovrTextureSetSourceFile(texture, sourcePath, type != TEXTURE_CUBE, luax_readfile);
+      } else if (sourceBlob) {
+        lovrTextureSetSource(texture, textureData);
+      }
       lovrRelease(TextureData, textureData);
       lua_pop(L, 1);
     }
   }
 
+  if (key) {
+    lovrCachePut(key, source, texture, lovrTextureGetMemorySize(texture));
+  }
+
   luax_pushtype(L, Texture, texture);
   lovrRelease(Texture, texture);
   return 1;
@@ -1647,6 +1861,8 @@ static const luaL_Reg lovrGraphics[] = {
   { "getFeatures", l_lovrGraphicsGetFeatures },
   { "getLimits", l_lovrGraphicsGetLimits },
   { "getStats", l_lovrGraphicsGetStats },
+  { "getTextureBudget", l_lovrGraphicsGetTextureBudget },
+  { "setTextureBudget", l_lovrGraphicsSetTextureBudget },
 
   // State
   { "reset", l_lovrGraphicsReset },
@@ -1672,6 +1888,8 @@ static const luaL_Reg lovrGraphics[] = {
   { "setFont", l_lovrGraphicsSetFont },
   { "getLineWidth", l_lovrGraphicsGetLineWidth },
   { "setLineWidth", l_lovrGraphicsSetLineWidth },
+  { "getLodBias", l_lovrGraphicsGetLodBias },
+  { "setLodBias", l_lovrGraphicsSetLodBias },
   { "getPointSize", l_lovrGraphicsGetPointSize },
   { "setPointSize", l_lovrGraphicsSetPointSize },
   { "getShader", l_lovrGraphicsGetShader },
@@ -1712,6 +1930,7 @@ static const luaL_Reg lovrGraphics[] = {
   { "stencil", l_lovrGraphicsStencil },
   { "fill", l_lovrGraphicsFill },
   { "compute", l_lovrGraphicsCompute },
+  { "animate", l_lovrGraphicsAnimate },
 
   // Types
   { "newCanvas", l_lovrGraphicsNewCanvas },
@@ -1719,6 +1938,9 @@ static const luaL_Reg lovrGraphics[] = {
   { "newMaterial", l_lovrGraphicsNewMaterial },
   { "newMesh", l_lovrGraphicsNewMesh },
   { "newModel", l_lovrGraphicsNewModel },
+#ifdef LOVR_ENABLE_THREAD
+  { "newModelAsync", l_lovrGraphicsNewModelAsync },
+#endif
   { "newShader", l_lovrGraphicsNewShader },
   { "newComputeShader", l_lovrGraphicsNewComputeShader },
   { "newShaderBlock", l_lovrGraphicsNewShaderBlock },
@@ -104,6 +104,38 @@ static int l_lovrFontHasGlyphs(lua_State* L) {
   return 1;
 }
 
+static int l_lovrFontPrebake(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  size_t length;
+  const char* string = luaL_checklstring(L, 2, &length);
+  lovrFontPrebake(font, string, length);
+  return 0;
+}
+
+static int l_lovrFontIsAsyncEnabled(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  lua_pushboolean(L, lovrFontIsAsyncEnabled(font));
+  return 1;
+}
+
+static int l_lovrFontSetAsyncEnabled(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  lovrFontSetAsyncEnabled(font, lua_toboolean(L, 2));
+  return 0;
+}
+
+static int l_lovrFontIsCacheEnabled(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  lua_pushboolean(L, lovrFontIsCacheEnabled(font));
+  return 1;
+}
+
+static int l_lovrFontSetCacheEnabled(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  lovrFontSetCacheEnabled(font, lua_toboolean(L, 2));
+  return 0;
+}
+
 const luaL_Reg lovrFont[] = {
   { "getWidth", l_lovrFontGetWidth },
   { "getHeight", l_lovrFontGetHeight },
@@ -118,5 +150,10 @@ const luaL_Reg lovrFont[] = {
   { "setPixelDensity", l_lovrFontSetPixelDensity },
   { "getRasterizer", l_lovrFontGetRasterizer},
   { "hasGlyphs", l_lovrFontHasGlyphs },
+  { "prebake", l_lovrFontPrebake },
+  { "isAsyncEnabled", l_lovrFontIsAsyncEnabled },
+  { "setAsyncEnabled", l_lovrFontSetAsyncEnabled },
+  { "isCacheEnabled", l_lovrFontIsCacheEnabled },
+  { "setCacheEnabled", l_lovrFontSetCacheEnabled },
   { NULL, NULL }
 };
@@ -71,6 +71,18 @@ static int l_lovrModelPose(lua_State* L) {
   return 0;
 }
 
+static int l_lovrModelSetInstancePose(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  if (lua_isnoneornil(L, 2)) {
+    lovrModelClearInstancePoses(model);
+  } else {
+    uint32_t instance = luaL_checkinteger(L, 2);
+    lovrAssert(instance > 0, "Instance index must be positive");
+    lovrModelSetInstancePose(model, instance - 1);
+  }
+  return 0;
+}
+
 static int l_lovrModelGetMaterial(lua_State* L) {
   Model* model = luax_checktype(L, 1, Model);
 
@@ -196,6 +208,7 @@ const luaL_Reg lovrModel[] = {
   { "draw", l_lovrModelDraw },
   { "animate", l_lovrModelAnimate },
   { "pose", l_lovrModelPose },
+  { "setInstancePose", l_lovrModelSetInstancePose },
   { "getMaterial", l_lovrModelGetMaterial },
   { "getAABB", l_lovrModelGetAABB },
   { "getNodePose", l_lovrModelGetNodePose },
@@ -172,38 +172,42 @@ static int l_lovrMathSetRandomSeed(lua_State* L) {
   return l_lovrRandomGeneratorSetSeed(L);
 }
 
-static int l_lovrMathGammaToLinear(lua_State* L) {
+// Colors are a table or up to 3 numbers, and they get converted together
+static int readGammaColor(lua_State* L, float* color) {
   if (lua_istable(L, 1)) {
     for (int i = 0; i < 3; i++) {
       lua_rawgeti(L, 1, i + 1);
-      lua_pushnumber(L, lovrMathGammaToLinear(luax_checkfloat(L, -1)));
+      color[i] = luax_checkfloat(L, -1);
+      lua_pop(L, 1);
     }
-    lua_pop(L, 3);
     return 3;
   } else {
     int n = CLAMP(lua_gettop(L), 1, 3);
     for (int i = 0; i < n; i++) {
-      lua_pushnumber(L, lovrMathGammaToLinear(luax_checkfloat(L, i + 1)));
+      color[i] = luax_checkfloat(L, i + 1);
     }
     return n;
   }
 }
 
+static int l_lovrMathGammaToLinear(lua_State* L) {
+  float color[3];
+  int n = readGammaColor(L, color);
+  lovrMathGammaToLinearBatch(color, n);
+  for (int i = 0; i < n; i++) {
+    lua_pushnumber(L, color[i]);
+  }
+  return n;
+}
+
 static int l_lovrMathLinearToGamma(lua_State* L) {
-  if (lua_istable(L, 1)) {
-    for (int i = 0; i < 3; i++) {
-      lua_rawgeti(L, 1, i + 1);
-      lua_pushnumber(L, lovrMathLinearToGamma(luax_checkfloat(L, -1)));
-    }
-    lua_pop(L, 3);
-    return 3;
-  } else {
-    int n = CLAMP(lua_gettop(L), 1, 3);
-    for (int i = 0; i < n; i++) {
-      lua_pushnumber(L, lovrMathLinearToGamma(luax_checkfloat(L, i + 1)));
-    }
-    return n;
+  float color[3];
+  int n = readGammaColor(L, color);
+  lovrMathLinearToGammaBatch(color, n);
+  for (int i = 0; i < n; i++) {
+    lua_pushnumber(L, color[i]);
   }
+  return n;
 }
 
 static int l_lovrMathNewVec2(lua_State* L) {
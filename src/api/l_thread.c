@@ -2,6 +2,7 @@
 #include "event/event.h"
 #include "thread/thread.h"
 #include "thread/channel.h"
+#include "thread/task.h"
 #include "core/ref.h"
 #include <stdlib.h>
 #include <string.h>
@@ -90,9 +91,23 @@ static int l_lovrThreadGetChannel(lua_State* L) {
   return 1;
 }
 
+static int l_lovrThreadGetTaskBudget(lua_State* L) {
+  lua_pushnumber(L, lovrTaskGetBudget());
+  return 1;
+}
+
+static int l_lovrThreadSetTaskBudget(lua_State* L) {
+  double budget = luaL_checknumber(L, 1);
+  lovrAssert(budget >= 0., "Task budget must be non-negative");
+  lovrTaskSetBudget(budget);
+  return 0;
+}
+
 static const luaL_Reg lovrThreadModule[] = {
   { "newThread", l_lovrThreadNewThread },
   { "getChannel", l_lovrThreadGetChannel },
+  { "getTaskBudget", l_lovrThreadGetTaskBudget },
+  { "setTaskBudget", l_lovrThreadSetTaskBudget },
   { NULL, NULL }
 };
 
@@ -101,6 +116,7 @@ int luaopen_lovr_thread(lua_State* L) {
   luaL_register(L, NULL, lovrThreadModule);
   luax_registertype(L, Thread);
   luax_registertype(L, Channel);
+  luax_registertype(L, Task);
   if (lovrThreadModuleInit()) {
     luax_atexit(L, lovrThreadModuleDestroy);
   }
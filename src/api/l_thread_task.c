@@ -0,0 +1,46 @@
+#include "api.h"
+#include "thread/task.h"
+
+static int l_lovrTaskIsDone(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  lua_pushboolean(L, lovrTaskIsDone(task));
+  return 1;
+}
+
+static int l_lovrTaskWait(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  lovrTaskWait(task);
+  const char* error = lovrTaskGetError(task);
+  if (error) {
+    return luaL_error(L, "%s", error);
+  }
+  return luax_pushvariant(L, &task->result);
+}
+
+static int l_lovrTaskGetResult(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  if (lovrTaskIsDone(task)) {
+    return luax_pushvariant(L, &task->result);
+  }
+  lua_pushnil(L);
+  return 1;
+}
+
+static int l_lovrTaskGetError(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  const char* error = lovrTaskGetError(task);
+  if (error && lovrTaskIsDone(task)) {
+    lua_pushstring(L, error);
+  } else {
+    lua_pushnil(L);
+  }
+  return 1;
+}
+
+const luaL_Reg lovrTask[] = {
+  { "isDone", l_lovrTaskIsDone },
+  { "wait", l_lovrTaskWait },
+  { "getResult", l_lovrTaskGetResult },
+  { "getError", l_lovrTaskGetError },
+  { NULL, NULL }
+};
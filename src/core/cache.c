@@ -0,0 +1,189 @@
+#include "cache.h"
+#include "arr.h"
+#include "hash.h"
+#include "map.h"
+#include "ref.h"
+#include <stdbool.h>
+#include <string.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
+
+typedef struct {
+  uint64_t key;
+  uint64_t source;
+  void* object;
+  size_t size;
+} CacheEntry;
+
+static struct {
+  arr_t(CacheEntry) entries;
+  map_t keys;
+  map_t objects;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t memory;
+  bool enabled;
+#ifdef LOVR_ENABLE_THREAD
+  mtx_t lock;
+#endif
+} state;
+
+#ifdef LOVR_ENABLE_THREAD
+static once_flag initialized = ONCE_FLAG_INIT;
+#define lock() mtx_lock(&state.lock)
+#define unlock() mtx_unlock(&state.lock)
+#else
+static bool initialized;
+#define call_once(flag, fn) if (!*(flag)) { fn(); *(flag) = true; }
+#define lock()
+#define unlock()
+#endif
+
+static void init(void) {
+  arr_init(&state.entries);
+  map_init(&state.keys, 0);
+  map_init(&state.objects, 0);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_init(&state.lock, mtx_plain);
+#endif
+}
+
+static uint64_t hashObject(void* object) {
+  return hash64(&object, sizeof(object));
+}
+
+// Must hold the lock.  The last entry is moved into the hole, so its indices are updated.
+static void removeEntry(uint64_t index) {
+  CacheEntry* entry = &state.entries.data[index];
+  map_remove(&state.keys, entry->key);
+  map_remove(&state.objects, hashObject(entry->object));
+  state.memory -= entry->size;
+
+  CacheEntry* last = &state.entries.data[--state.entries.length];
+  if (entry != last) {
+    *entry = *last;
+    map_set(&state.keys, entry->key, index);
+    map_set(&state.objects, hashObject(entry->object), index);
+  }
+}
+
+bool lovrCacheIsEnabled() {
+  call_once(&initialized, init);
+  lock();
+  bool enabled = state.enabled;
+  unlock();
+  return enabled;
+}
+
+// Disabling the cache forgets everything in it, objects that were already shared stay shared
+void lovrCacheSetEnabled(bool enabled) {
+  call_once(&initialized, init);
+  lock();
+  state.enabled = enabled;
+  if (!enabled) {
+    while (state.entries.length > 0) {
+      removeEntry(state.entries.length - 1);
+    }
+  }
+  unlock();
+}
+
+// The source of anything loaded from a path, see lovrCacheInvalidate
+uint64_t lovrCacheHashPath(const char* path) {
+  return hash64(path, strlen(path));
+}
+
+uint64_t lovrCacheKey(const char* type, uint64_t source, uint64_t flags) {
+  uint64_t words[3] = { hash64(type, strlen(type)), source, flags };
+  return hash64(words, sizeof(words));
+}
+
+// Returns a retained object, or NULL on a miss
+void* lovrCacheGet(uint64_t key) {
+  call_once(&initialized, init);
+  lock();
+  if (!state.enabled) {
+    unlock();
+    return NULL;
+  }
+
+  void* object = NULL;
+  uint64_t index = map_get(&state.keys, key);
+  if (index != MAP_NIL) {
+    object = state.entries.data[index].object;
+
+    // A count of 1 means the last reference was already released and the destructor is waiting for
+    // the lock to remove it, so it can't be revived
+    if (ref_inc(toRef(object)) == 1) {
+      ref_dec(toRef(object));
+      object = NULL;
+    }
+  }
+  object ? state.hits++ : state.misses++;
+  unlock();
+  return object;
+}
+
+// An object already cached under the key (from a racing load, or one being destroyed) is replaced
+void lovrCachePut(uint64_t key, uint64_t source, void* object, size_t size) {
+  call_once(&initialized, init);
+  lock();
+  if (!state.enabled) {
+    unlock();
+    return;
+  }
+
+  uint64_t index = map_get(&state.keys, key);
+  if (index != MAP_NIL) {
+    removeEntry(index);
+  }
+  index = state.entries.length;
+  arr_push(&state.entries, ((CacheEntry) { key, source, object, size }));
+  map_set(&state.keys, key, index);
+  map_set(&state.objects, hashObject(object), index);
+  state.memory += size;
+  unlock();
+}
+
+// Also called before an object is modified, so later loads don't see the changes
+void lovrCacheRemove(void* object) {
+  call_once(&initialized, init);
+  lock();
+  uint64_t index = map_get(&state.objects, hashObject(object));
+  if (index != MAP_NIL) {
+    removeEntry(index);
+  }
+  unlock();
+}
+
+void lovrCacheInvalidate(uint64_t source) {
+  call_once(&initialized, init);
+  lock();
+  for (size_t i = state.entries.length; i-- > 0;) {
+    if (state.entries.data[i].source == source) {
+      removeEntry(i);
+    }
+  }
+  unlock();
+}
+
+// Returns the key an object is cached under, or 0 if it isn't cached
+uint64_t lovrCacheGetKey(void* object) {
+  call_once(&initialized, init);
+  lock();
+  uint64_t index = map_get(&state.objects, hashObject(object));
+  uint64_t key = index == MAP_NIL ? 0 : state.entries.data[index].key;
+  unlock();
+  return key;
+}
+
+void lovrCacheGetStats(CacheStats* stats) {
+  call_once(&initialized, init);
+  lock();
+  stats->hits = state.hits;
+  stats->misses = state.misses;
+  stats->objects = (uint32_t) state.entries.length;
+  stats->memory = state.memory;
+  unlock();
+}
@@ -0,0 +1,29 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma once
+
+// A cache of loaded objects, keyed by where they came from (a path or a hash of their contents) and
+// how they were loaded.  References are weak: the cache never keeps an object alive, objects that
+// might be cached call lovrCacheRemove from their destructor instead.  Cached objects are shared, so
+// caching is off until it's enabled, and objects evict themselves before they're modified.  Writing
+// to a path invalidates everything loaded from it.  Thread safe.
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint32_t objects;
+  uint64_t memory;
+} CacheStats;
+
+bool lovrCacheIsEnabled(void);
+void lovrCacheSetEnabled(bool enabled);
+uint64_t lovrCacheHashPath(const char* path);
+uint64_t lovrCacheKey(const char* type, uint64_t source, uint64_t flags);
+void* lovrCacheGet(uint64_t key);
+void lovrCachePut(uint64_t key, uint64_t source, void* object, size_t size);
+void lovrCacheRemove(void* object);
+void lovrCacheInvalidate(uint64_t source);
+uint64_t lovrCacheGetKey(void* object);
+void lovrCacheGetStats(CacheStats* stats);
@@ -83,8 +83,12 @@ void map_remove(map_t* map, uint64_t hash) {
   uint64_t mask = map->size - 1;
   uint64_t i = h;
 
-  do {
+  for (;;) {
     i = (i + 1) & mask;
+    if (map->hashes[i] == MAP_NIL) {
+      break;
+    }
+
     uint64_t x = map->hashes[i] & mask;
     // Removing a key from an open-addressed hash table is complicated
     if ((i > h && (x <= h || x > i)) || (i < h && (x <= h && x > i))) {
@@ -92,9 +96,10 @@ void map_remove(map_t* map, uint64_t hash) {
       map->values[h] = map->values[i];
       h = i;
     }
-  } while (map->hashes[i] != MAP_NIL);
+  }
 
-  map->hashes[i] = MAP_NIL;
-  map->values[i] = MAP_NIL;
+  // The last slot that was moved out of (or the removed key's, if nothing moved) is the hole
+  map->hashes[h] = MAP_NIL;
+  map->values[h] = MAP_NIL;
   map->used--;
 }
@@ -1,4 +1,7 @@
 #include "data/blob.h"
+#include "core/fs.h"
+#include "core/ref.h"
+#include "core/util.h"
 #include <stdlib.h>
 
 Blob* lovrBlobInit(Blob* blob, void* data, size_t size, const char* name) {
@@ -8,7 +11,22 @@ Blob* lovrBlobInit(Blob* blob, void* data, size_t size, const char* name) {
   return blob;
 }
 
+Blob* lovrBlobInitView(Blob* blob, Blob* parent, void* data, size_t size) {
+  blob->data = data;
+  blob->size = size;
+  blob->name = parent->name;
+  blob->parent = parent;
+  lovrRetain(parent);
+  return blob;
+}
+
 void lovrBlobDestroy(void* ref) {
   Blob* blob = ref;
-  free(blob->data);
+  if (blob->parent) {
+    lovrRelease(Blob, blob->parent);
+  } else if (blob->mapped) {
+    fs_unmap(blob->data, blob->size);
+  } else {
+    free(blob->data);
+  }
 }
@@ -1,13 +1,20 @@
+#include <stdbool.h>
 #include <stddef.h>
 
 #pragma once
 
+// Blobs normally own their data.  A Blob with a parent points into the parent's data and keeps it
+// alive instead, and a mapped Blob's data is a read only file mapping.
 typedef struct Blob {
   void* data;
   size_t size;
   const char* name;
+  struct Blob* parent;
+  bool mapped;
 } Blob;
 
 Blob* lovrBlobInit(Blob* blob, void* data, size_t size, const char* name);
 #define lovrBlobCreate(...) lovrBlobInit(lovrAlloc(Blob), __VA_ARGS__)
+Blob* lovrBlobInitView(Blob* blob, Blob* parent, void* data, size_t size);
+#define lovrBlobCreateView(...) lovrBlobInitView(lovrAlloc(Blob), __VA_ARGS__)
 void lovrBlobDestroy(void* ref);
@@ -1,13 +1,124 @@
 #include "data/modelData.h"
 #include "data/blob.h"
 #include "data/textureData.h"
+#include "core/maf.h"
+#include "core/cache.h"
+#include "core/hash.h"
 #include "core/ref.h"
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
 
-ModelData* lovrModelDataInit(ModelData* model, Blob* source, ModelDataIO* io) {
-  if (lovrModelDataInitGltf(model, source, io)) {
+typedef struct {
+  ModelData* model;
+  Blob* source;
+  ModelDataFlags flags;
+} ModelJob;
+
+// Optimization rewrites vertex and index data in place, so a glb that keeps its binary chunk in
+// the source Blob gets a private copy instead, and everything pointing into it is moved over.
+static void detachSource(ModelData* model, Blob* source) {
+  for (uint32_t i = 0; i < model->blobCount; i++) {
+    if (model->blobs[i] != source) {
+      continue;
+    }
+
+    void* data = malloc(source->size);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, source->data, source->size);
+    model->blobs[i] = lovrBlobCreate(data, source->size, source->name);
+    lovrRelease(Blob, source);
+
+    char* start = source->data;
+    char* end = start + source->size;
+    ptrdiff_t delta = (char*) data - start;
+#define REBASE(p) if ((char*) (p) >= start && (char*) (p) < end) (p) = (void*) ((char*) (p) + delta)
+    for (uint32_t j = 0; j < model->bufferCount; j++) {
+      REBASE(model->buffers[j].data);
+    }
+    for (uint32_t j = 0; j < model->channelCount; j++) {
+      REBASE(model->channels[j].times);
+      REBASE(model->channels[j].data);
+    }
+    for (uint32_t j = 0; j < model->skinCount; j++) {
+      REBASE(model->skins[j].inverseBindMatrices);
+    }
+#undef REBASE
+  }
+}
+
+// Images are cached by their contents, so one shared by several models is only decoded once
+static TextureData* decodeImage(ModelImage* image) {
+  uint64_t source = hash64(image->data, image->size);
+  uint64_t key = lovrCacheKey("TextureData", source, image->flip);
+  TextureData* texture = lovrCacheGet(key);
+  if (texture) {
+    return texture;
+  }
+
+  if (image->data == image->blob->data && image->size == image->blob->size) {
+    texture = lovrTextureDataCreateFromBlob(image->blob, image->flip);
+  } else {
+    // Embedded images get a view of their buffer
+    Blob* blob = lovrBlobCreateView(image->blob, image->data, image->size);
+    texture = lovrTextureDataCreateFromBlob(blob, image->flip);
+    lovrRelease(Blob, blob);
+  }
+
+  lovrCachePut(key, source, texture, texture->blob ? texture->blob->size : texture->source->size);
+  return texture;
+}
+
+// Index 0 processes the geometry and the rest decode one image each, so on worker threads the
+// images are decoded while the geometry is being processed
+static void processModel(void* context, uint32_t index) {
+  ModelJob* job = context;
+  ModelData* model = job->model;
+  if (index == 0) {
+    if (job->flags.optimize) {
+      detachSource(model, job->source);
+      lovrModelDataOptimize(model);
+    }
+
+    if (job->flags.lods > 0) {
+      lovrModelDataGenerateLods(model, job->flags.lods);
+    }
+  } else if (model->images[index - 1].blob) {
+    model->textures[index - 1] = decodeImage(&model->images[index - 1]);
+  }
+}
+
+ModelData* lovrModelDataInit(ModelData* model, Blob* source, ModelDataIO* io, ModelDataFlags flags) {
+
+  // Cooked models were optimized and decoded before they were encoded, so the flags don't apply
+  if (lovrModelDataInitCooked(model, source)) {
     return model;
-  } else if (lovrModelDataInitObj(model, source, io)) {
+  }
+
+  if (lovrModelDataInitGltf(model, source, io) || lovrModelDataInitObj(model, source, io)) {
+
+    // The loop only returns (or rethrows an error) once every worker is done with the model
+    ModelJob job = { .model = model, .source = source, .flags = flags };
+    uint32_t count = flags.deferImages ? 1 : 1 + model->textureCount;
+#ifdef LOVR_ENABLE_THREAD
+    lovrTaskParallel(processModel, &job, count);
+#else
+    for (uint32_t i = 0; i < count; i++) {
+      processModel(&job, i);
+    }
+#endif
+
+    // Releases the encoded images
+    if (!flags.deferImages) {
+      for (uint32_t i = 0; i < model->textureCount; i++) {
+        lovrModelDataGetTexture(model, i);
+      }
+    }
+
     return model;
   }
 
@@ -17,35 +128,41 @@ ModelData* lovrModelDataInit(ModelData* model, Blob* source, ModelDataIO* io) {
 
 void lovrModelDataDestroy(void* ref) {
   ModelData* model = ref;
+  lovrCacheRemove(ref);
   for (uint32_t i = 0; i < model->blobCount; i++) {
     lovrRelease(Blob, model->blobs[i]);
   }
   for (uint32_t i = 0; i < model->textureCount; i++) {
     lovrRelease(TextureData, model->textures[i]);
+    lovrRelease(Blob, model->images[i].blob);
   }
   map_free(&model->animationMap);
   map_free(&model->materialMap);
   map_free(&model->nodeMap);
+  free(model->samples);
+  free(model->sampleTimes);
+  free(model->lodIndices);
   free(model->data);
 }
 
 // Note: this code is a scary optimization
 void lovrModelDataAllocate(ModelData* model) {
   size_t totalSize = 0;
-  size_t sizes[13];
+  size_t sizes[14];
   totalSize += sizes[0] = model->blobCount * sizeof(Blob*);
   totalSize += sizes[1] = model->bufferCount * sizeof(ModelBuffer);
   totalSize += sizes[2] = model->textureCount * sizeof(TextureData*);
-  totalSize += sizes[3] = model->materialCount * sizeof(ModelMaterial);
-  totalSize += sizes[4] = model->attributeCount * sizeof(ModelAttribute);
-  totalSize += sizes[5] = model->primitiveCount * sizeof(ModelPrimitive);
-  totalSize += sizes[6] = model->animationCount * sizeof(ModelAnimation);
-  totalSize += sizes[7] = model->skinCount * sizeof(ModelSkin);
-  totalSize += sizes[8] = model->nodeCount * sizeof(ModelNode);
-  totalSize += sizes[9] = model->channelCount * sizeof(ModelAnimationChannel);
-  totalSize += sizes[10] = model->childCount * sizeof(uint32_t);
-  totalSize += sizes[11] = model->jointCount * sizeof(uint32_t);
-  totalSize += sizes[12] = model->charCount * sizeof(char);
+  totalSize += sizes[3] = model->textureCount * sizeof(ModelImage);
+  totalSize += sizes[4] = model->materialCount * sizeof(ModelMaterial);
+  totalSize += sizes[5] = model->attributeCount * sizeof(ModelAttribute);
+  totalSize += sizes[6] = model->primitiveCount * sizeof(ModelPrimitive);
+  totalSize += sizes[7] = model->animationCount * sizeof(ModelAnimation);
+  totalSize += sizes[8] = model->skinCount * sizeof(ModelSkin);
+  totalSize += sizes[9] = model->nodeCount * sizeof(ModelNode);
+  totalSize += sizes[10] = model->channelCount * sizeof(ModelAnimationChannel);
+  totalSize += sizes[11] = model->childCount * sizeof(uint32_t);
+  totalSize += sizes[12] = model->jointCount * sizeof(uint32_t);
+  totalSize += sizes[13] = model->charCount * sizeof(char);
 
   size_t offset = 0;
   char* p = model->data = calloc(1, totalSize);
@@ -53,18 +170,469 @@ void lovrModelDataAllocate(ModelData* model) {
   model->blobs = (Blob**) (p + offset), offset += sizes[0];
   model->buffers = (ModelBuffer*) (p + offset), offset += sizes[1];
   model->textures = (TextureData**) (p + offset), offset += sizes[2];
-  model->materials = (ModelMaterial*) (p + offset), offset += sizes[3];
-  model->attributes = (ModelAttribute*) (p + offset), offset += sizes[4];
-  model->primitives = (ModelPrimitive*) (p + offset), offset += sizes[5];
-  model->animations = (ModelAnimation*) (p + offset), offset += sizes[6];
-  model->skins = (ModelSkin*) (p + offset), offset += sizes[7];
-  model->nodes = (ModelNode*) (p + offset), offset += sizes[8];
-  model->channels = (ModelAnimationChannel*) (p + offset), offset += sizes[9];
-  model->children = (uint32_t*) (p + offset), offset += sizes[10];
-  model->joints = (uint32_t*) (p + offset), offset += sizes[11];
-  model->chars = (char*) (p + offset), offset += sizes[12];
+  model->images = (ModelImage*) (p + offset), offset += sizes[3];
+  model->materials = (ModelMaterial*) (p + offset), offset += sizes[4];
+  model->attributes = (ModelAttribute*) (p + offset), offset += sizes[5];
+  model->primitives = (ModelPrimitive*) (p + offset), offset += sizes[6];
+  model->animations = (ModelAnimation*) (p + offset), offset += sizes[7];
+  model->skins = (ModelSkin*) (p + offset), offset += sizes[8];
+  model->nodes = (ModelNode*) (p + offset), offset += sizes[9];
+  model->channels = (ModelAnimationChannel*) (p + offset), offset += sizes[10];
+  model->children = (uint32_t*) (p + offset), offset += sizes[11];
+  model->joints = (uint32_t*) (p + offset), offset += sizes[12];
+  model->chars = (char*) (p + offset), offset += sizes[13];
 
   map_init(&model->animationMap, model->animationCount);
   map_init(&model->materialMap, model->materialCount);
   map_init(&model->nodeMap, model->nodeCount);
 }
+
+// Images that haven't been decoded yet (see ModelDataFlags.deferImages) are decoded on first use
+TextureData* lovrModelDataGetTexture(ModelData* model, uint32_t index) {
+  ModelImage* image = &model->images[index];
+  if (image->blob) {
+    if (!model->textures[index]) {
+      model->textures[index] = decodeImage(image);
+    }
+    lovrRelease(Blob, image->blob);
+    image->blob = NULL;
+  }
+  return model->textures[index];
+}
+
+// Returns the first keyframe at or after the time. Playback is usually monotonic, so the keyframe
+// found last time and the one after it are checked before falling back to a binary search.
+static uint32_t findKeyframe(ModelAnimationChannel* channel, float time, uint32_t cursor) {
+  float* times = channel->times;
+  uint32_t count = channel->keyframeCount;
+
+  for (uint32_t k = cursor; k <= cursor + 1 && k <= count; k++) {
+    if ((k == 0 || times[k - 1] < time) && (k == count || times[k] >= time)) {
+      return k;
+    }
+  }
+
+  uint32_t lo = 0;
+  uint32_t hi = count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (times[mid] < time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+static void sampleKeyframes(ModelAnimationChannel* channel, float time, uint32_t* cursor, float* property) {
+  uint32_t keyframe = *cursor = findKeyframe(channel, time, *cursor);
+  bool rotate = channel->property == PROP_ROTATION;
+  size_t n = 3 + rotate;
+  float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
+
+  if (keyframe == 0 || keyframe >= channel->keyframeCount) {
+    size_t index = MIN(keyframe, channel->keyframeCount - 1);
+
+    // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
+    if (channel->smoothing == SMOOTH_CUBIC) {
+      index = 3 * index + 1;
+    }
+
+    memcpy(property, channel->data + index * n, n * sizeof(float));
+  } else {
+    float t1 = channel->times[keyframe - 1];
+    float t2 = channel->times[keyframe];
+    float z = (time - t1) / (t2 - t1);
+
+    switch (channel->smoothing) {
+      case SMOOTH_STEP:
+        memcpy(property, channel->data + (z >= .5f ? keyframe : keyframe - 1) * n, n * sizeof(float));
+        break;
+      case SMOOTH_LINEAR:
+        memcpy(property, channel->data + (keyframe - 1) * n, n * sizeof(float));
+        lerp(property, channel->data + keyframe * n, z);
+        break;
+      case SMOOTH_CUBIC: {
+        size_t stride = 3 * n;
+        float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
+        float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
+        float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
+        float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
+        float dt = t2 - t1;
+        float z2 = z * z;
+        float z3 = z2 * z;
+        float a = 2.f * z3 - 3.f * z2 + 1.f;
+        float b = 2.f * z3 - 3.f * z2 + 1.f;
+        float c = (-2.f * z3 + 3.f * z2);
+        float d = (z3 * -z2) * dt;
+        for (size_t j = 0; j < n; j++) {
+          property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+// Rotations use the "smallest three" encoding: the largest component is dropped (and made positive
+// by negating the quaternion), the other three fit in [-1/sqrt(2), 1/sqrt(2)] and get 15 bits each,
+// and the index of the dropped component is stored in the spare high bits of the first two words.
+static void packQuaternion(float* q, uint16_t* out) {
+  uint32_t largest = 0;
+  for (uint32_t i = 1; i < 4; i++) {
+    if (fabsf(q[i]) > fabsf(q[largest])) {
+      largest = i;
+    }
+  }
+
+  float sign = q[largest] < 0.f ? -1.f : 1.f;
+  for (uint32_t i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      float x = CLAMP(q[i] * sign * 1.41421356f, -1.f, 1.f);
+      out[j++] = (uint16_t) lroundf((x * .5f + .5f) * 32767.f);
+    }
+  }
+
+  out[0] |= (largest >> 1) << 15;
+  out[1] |= (largest & 1) << 15;
+}
+
+static void unpackQuaternion(uint16_t* in, float* q) {
+  uint32_t largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+  float sum = 0.f;
+  for (uint32_t i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      float x = ((in[j++] & 0x7fff) / 32767.f * 2.f - 1.f) * .70710678f;
+      sum += x * x;
+      q[i] = x;
+    }
+  }
+  q[largest] = sqrtf(MAX(1.f - sum, 0.f));
+}
+
+static void decodeSample(ModelAnimationChannel* channel, uint32_t index, float* property) {
+  uint16_t* sample = channel->samples + 3 * index;
+  if (channel->property == PROP_ROTATION) {
+    unpackQuaternion(sample, property);
+  } else {
+    for (uint32_t i = 0; i < 3; i++) {
+      property[i] = channel->sampleMin[i] + channel->sampleRange[i] * (sample[i] / 65535.f);
+    }
+  }
+}
+
+static bool withinTolerance(float* value, float* target, size_t n, float tolerance) {
+  if (n == 4) {
+    float dot = value[0] * target[0] + value[1] * target[1] + value[2] * target[2] + value[3] * target[3];
+    return 1.f - fabsf(dot) <= tolerance;
+  }
+
+  for (uint32_t c = 0; c < 3; c++) {
+    if (fabsf(value[c] - target[c]) > tolerance) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Whether interpolating between samples a and b reproduces every sample between them
+static bool fitsSegment(float* values, float* times, size_t n, uint32_t a, uint32_t b, float tolerance) {
+  float value[4];
+  for (uint32_t i = a + 1; i < b; i++) {
+    float z = (times[i] - times[a]) / (times[b] - times[a]);
+    memcpy(value, values + a * n, n * sizeof(float));
+    if (n == 4) {
+      quat_slerp(value, values + b * n, z);
+    } else {
+      vec3_lerp(value, values + b * n, z);
+    }
+
+    if (!withinTolerance(value, values + i * n, n, tolerance)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Blobs that aren't referenced by any buffer or skin only held keyframes, which are gone now
+static void releaseUnusedBlobs(ModelData* model) {
+  for (uint32_t i = 0; i < model->blobCount; i++) {
+    Blob* blob = model->blobs[i];
+    if (!blob) {
+      continue;
+    }
+
+    char* start = blob->data;
+    char* end = start + blob->size;
+    bool used = false;
+#define USES(p) ((char*) (p) >= start && (char*) (p) < end)
+    for (uint32_t j = 0; j < model->bufferCount && !used; j++) {
+      used = USES(model->buffers[j].data);
+    }
+    for (uint32_t j = 0; j < model->skinCount && !used; j++) {
+      used = USES(model->skins[j].inverseBindMatrices);
+    }
+#undef USES
+
+    if (!used) {
+      lovrRelease(Blob, blob);
+      model->blobs[i] = NULL;
+    }
+  }
+}
+
+// Channels are sampled densely at the rate and then reduced to the keyframes that linear (or
+// spherical) interpolation needs to reproduce every sample within the tolerance.  Keyframes are
+// picked greedily, stretching each segment until a sample in it would leave the tolerance.  Step
+// channels keep their keyframe times.  Values are quantized to 3 16-bit words each and the
+// original keyframes are dropped.  Compressing again resamples the compressed clips.
+void lovrModelDataCompressAnimations(ModelData* model, float rate, float tolerance) {
+  lovrAssert(rate > 0.f, "Animation sample rate must be positive");
+  lovrCacheRemove(model);
+
+  uint32_t frameTotal = 0;
+  uint32_t frameMax = 1;
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    ModelAnimation* animation = &model->animations[i];
+    uint32_t frames = (uint32_t) ceilf(animation->duration * rate) + 1;
+    for (uint32_t j = 0; j < animation->channelCount; j++) {
+      ModelAnimationChannel* channel = &animation->channels[j];
+      uint32_t count = channel->smoothing == SMOOTH_STEP ? channel->keyframeCount : frames;
+      frameTotal += count;
+      frameMax = MAX(frameMax, count);
+    }
+  }
+
+  uint16_t* samples = malloc(MAX(3 * frameTotal, 1) * sizeof(uint16_t));
+  float* sampleTimes = malloc(MAX(frameTotal, 1) * sizeof(float));
+  uint32_t* offsets = malloc(MAX(model->channelCount, 1) * sizeof(uint32_t));
+  uint32_t* counts = malloc(MAX(model->channelCount, 1) * sizeof(uint32_t));
+  float* ranges = malloc(MAX(model->channelCount, 1) * 6 * sizeof(float));
+  float* values = malloc(4 * frameMax * sizeof(float));
+  float* times = malloc(frameMax * sizeof(float));
+  uint32_t* keys = malloc(frameMax * sizeof(uint32_t));
+  lovrAssert(samples && sampleTimes && offsets && counts && ranges && values && times && keys, "Out of memory");
+
+  // Channels are only pointed at the new samples at the end, since recompressing reads the old ones
+  uint32_t sampleOffset = 0;
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    ModelAnimation* animation = &model->animations[i];
+    uint32_t frames = (uint32_t) ceilf(animation->duration * rate) + 1;
+
+    for (uint32_t j = 0; j < animation->channelCount; j++) {
+      ModelAnimationChannel* channel = &animation->channels[j];
+      uint32_t index = channel - model->channels;
+      bool step = channel->smoothing == SMOOTH_STEP;
+      bool rotate = channel->property == PROP_ROTATION;
+      size_t n = 3 + rotate;
+      uint32_t count = step ? channel->keyframeCount : frames;
+      uint32_t cursor = 0;
+      bool constant = true;
+
+      for (uint32_t k = 0; k < count; k++) {
+        float* value = values + k * n;
+        times[k] = step ? channel->times[k] : MIN(k / rate, animation->duration);
+        lovrModelDataSampleChannel(channel, times[k], &cursor, value);
+        if (rotate) {
+          quat_normalize(value);
+        }
+        constant &= withinTolerance(value, values, n, tolerance);
+      }
+
+      // A channel that stays within the tolerance of its first value only needs one keyframe
+      uint32_t keyCount = 0;
+      keys[keyCount++] = 0;
+      if (step && !constant) {
+        for (uint32_t k = 1; k < count; k++) {
+          keys[keyCount++] = k;
+        }
+      } else if (!constant) {
+        for (uint32_t a = 0, b = 2; b < count; b++) {
+          if (!fitsSegment(values, times, n, a, b, tolerance)) {
+            keys[keyCount++] = a = b - 1;
+          }
+        }
+        keys[keyCount++] = count - 1;
+      }
+
+      offsets[index] = sampleOffset;
+      counts[index] = keyCount;
+      uint16_t* sample = samples + 3 * sampleOffset;
+      for (uint32_t k = 0; k < keyCount; k++) {
+        sampleTimes[sampleOffset + k] = times[keys[k]];
+      }
+      sampleOffset += keyCount;
+
+      if (rotate) {
+        for (uint32_t k = 0; k < keyCount; k++) {
+          packQuaternion(values + 4 * keys[k], sample + 3 * k);
+        }
+        continue;
+      }
+
+      for (uint32_t c = 0; c < 3; c++) {
+        float min = values[c];
+        float max = values[c];
+        for (uint32_t k = 1; k < keyCount; k++) {
+          min = MIN(min, values[3 * keys[k] + c]);
+          max = MAX(max, values[3 * keys[k] + c]);
+        }
+
+        ranges[6 * index + c] = min;
+        ranges[6 * index + 3 + c] = max - min;
+
+        for (uint32_t k = 0; k < keyCount; k++) {
+          float x = max > min ? (values[3 * keys[k] + c] - min) / (max - min) : 0.f;
+          sample[3 * k + c] = (uint16_t) lroundf(x * 65535.f);
+        }
+      }
+    }
+  }
+
+  free(values);
+  free(times);
+  free(keys);
+  free(model->samples);
+  free(model->sampleTimes);
+  model->samples = realloc(samples, MAX(3 * sampleOffset, 1) * sizeof(uint16_t));
+  model->sampleTimes = realloc(sampleTimes, MAX(sampleOffset, 1) * sizeof(float));
+  lovrAssert(model->samples && model->sampleTimes, "Out of memory");
+
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    ModelAnimation* animation = &model->animations[i];
+    for (uint32_t j = 0; j < animation->channelCount; j++) {
+      ModelAnimationChannel* channel = &animation->channels[j];
+      uint32_t index = channel - model->channels;
+      channel->smoothing = channel->smoothing == SMOOTH_STEP ? SMOOTH_STEP : SMOOTH_LINEAR;
+      channel->keyframeCount = counts[index];
+      channel->times = model->sampleTimes + offsets[index];
+      channel->data = NULL;
+      channel->samples = model->samples + 3 * offsets[index];
+      memcpy(channel->sampleMin, ranges + 6 * index, 3 * sizeof(float));
+      memcpy(channel->sampleRange, ranges + 6 * index + 3, 3 * sizeof(float));
+    }
+  }
+
+  free(offsets);
+  free(counts);
+  free(ranges);
+  releaseUnusedBlobs(model);
+}
+
+// Evaluates a channel at a time (in seconds).  The keyframe search uses the cursor to remember
+// where the last search ended, compressed channels just decode their keyframes first.
+void lovrModelDataSampleChannel(ModelAnimationChannel* channel, float time, uint32_t* cursor, float* property) {
+  if (!channel->samples) {
+    sampleKeyframes(channel, time, cursor, property);
+    return;
+  }
+
+  uint32_t keyframe = *cursor = findKeyframe(channel, time, *cursor);
+
+  if (keyframe == 0 || keyframe >= channel->keyframeCount) {
+    decodeSample(channel, MIN(keyframe, channel->keyframeCount - 1), property);
+    return;
+  }
+
+  float t1 = channel->times[keyframe - 1];
+  float t2 = channel->times[keyframe];
+  float z = (time - t1) / (t2 - t1);
+
+  if (channel->smoothing == SMOOTH_STEP) {
+    decodeSample(channel, z >= .5f ? keyframe : keyframe - 1, property);
+  } else {
+    float next[4];
+    decodeSample(channel, keyframe - 1, property);
+    decodeSample(channel, keyframe, next);
+    if (channel->property == PROP_ROTATION) {
+      quat_slerp(property, next, z);
+    } else {
+      vec3_lerp(property, next, z);
+    }
+  }
+}
+
+static const float powersOf10[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// Used by the OBJ and glTF loaders.  Exporters write short decimals, and when the digits fit in a
+// float's 24 bit mantissa and the power of 10 is exactly representable as a float (up to 1e10),
+// a single float multiply or divide gives the correctly rounded result.  Going through double
+// first would round twice.  Anything else uses strtof.
+const char* lovrModelDataParseFloat(const char* s, const char* end, float* value) {
+  const char* p = s;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool truncated = false;
+  bool valid = false;
+
+  for (; p < end && *p >= '0' && *p <= '9'; p++, valid = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa > 0;
+    } else {
+      exponent++;
+      truncated = true;
+    }
+  }
+
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++, valid = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa > 0;
+        exponent--;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+
+  if (!valid) {
+    return NULL;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negativeExponent = *q++ == '-';
+    }
+
+    if (q < end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      for (; q < end && *q >= '0' && *q <= '9'; q++) {
+        e = MIN(e * 10 + (*q - '0'), 100000);
+      }
+      exponent += negativeExponent ? -e : e;
+      p = q;
+    }
+  }
+
+  if (!truncated && mantissa <= (1ull << 24) && exponent >= -10 && exponent <= 10) {
+    float f = (float) mantissa;
+    f = exponent < 0 ? f / powersOf10[-exponent] : f * powersOf10[exponent];
+    *value = negative ? -f : f;
+  } else {
+    char buffer[128];
+    size_t length = MIN((size_t) (p - s), sizeof(buffer) - 1);
+    memcpy(buffer, s, length);
+    buffer[length] = '\0';
+    *value = strtof(buffer, NULL);
+  }
+
+  return p;
+}
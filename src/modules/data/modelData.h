@@ -6,7 +6,11 @@
 
 #pragma once
 
-#define MAX_BONES 48
+#define MAX_BONES 256
+#define MAX_LODS 4
+
+// Screen coverage below which a node switches to its first LOD, each following level halves it
+#define DEFAULT_LOD_COVERAGE .3f
 
 struct TextureData;
 struct Blob;
@@ -129,6 +133,9 @@ typedef struct {
   uint32_t keyframeCount;
   float* times;
   float* data;
+  uint16_t* samples;
+  float sampleMin[3];
+  float sampleRange[3];
 } ModelAnimationChannel;
 
 typedef struct {
@@ -147,11 +154,18 @@ typedef struct {
   TextureWrap wraps[MAX_MATERIAL_TEXTURES];
 } ModelMaterial;
 
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+} ModelLod;
+
 typedef struct {
   ModelAttribute* attributes[MAX_DEFAULT_ATTRIBUTES];
   ModelAttribute* indices;
   DrawMode mode;
   uint32_t material;
+  ModelLod lods[MAX_LODS - 1];
+  uint32_t lodCount;
 } ModelPrimitive;
 
 typedef struct {
@@ -169,6 +183,11 @@ typedef struct {
   uint32_t primitiveIndex;
   uint32_t primitiveCount;
   uint32_t skin;
+  uint32_t lodNodes[MAX_LODS - 1];
+  float lodCoverage[MAX_LODS];
+  uint32_t lodCount;
+  float* instances;
+  uint32_t instanceCount;
   bool matrix;
 } ModelNode;
 
@@ -178,11 +197,21 @@ typedef struct {
   float* inverseBindMatrices;
 } ModelSkin;
 
+// Encoded image data, kept until it's decoded into the matching entry of ModelData's textures.  The
+// Blob is retained to keep the data alive, it may be a larger buffer the image is embedded in.
+typedef struct {
+  struct Blob* blob;
+  void* data;
+  size_t size;
+  bool flip;
+} ModelImage;
+
 typedef struct ModelData {
   void* data;
   struct Blob** blobs;
   ModelBuffer* buffers;
   struct TextureData** textures;
+  ModelImage* images;
   ModelMaterial* materials;
   ModelAttribute* attributes;
   ModelPrimitive* primitives;
@@ -205,21 +234,44 @@ typedef struct ModelData {
   uint32_t* children;
   uint32_t* joints;
   char* chars;
+  uint16_t* samples;
+  float* sampleTimes;
+  uint32_t* lodIndices;
   uint32_t channelCount;
   uint32_t childCount;
   uint32_t jointCount;
   uint32_t charCount;
+  uint32_t lodIndexCount;
 
   map_t animationMap;
   map_t materialMap;
   map_t nodeMap;
+
+  uint32_t removedVertices;
+  float acmrBefore;
+  float acmrAfter;
 } ModelData;
 
+typedef struct ModelDataFlags {
+  bool optimize;
+  uint32_t lods;
+  bool deferImages;
+} ModelDataFlags;
+
 typedef void* ModelDataIO(const char* filename, size_t* bytesRead);
 
-ModelData* lovrModelDataInit(ModelData* model, struct Blob* blob, ModelDataIO* io);
+ModelData* lovrModelDataInit(ModelData* model, struct Blob* blob, ModelDataIO* io, ModelDataFlags flags);
 #define lovrModelDataCreate(...) lovrModelDataInit(lovrAlloc(ModelData), __VA_ARGS__)
 ModelData* lovrModelDataInitGltf(ModelData* model, struct Blob* blob, ModelDataIO* io);
 ModelData* lovrModelDataInitObj(ModelData* model, struct Blob* blob, ModelDataIO* io);
+ModelData* lovrModelDataInitCooked(ModelData* model, struct Blob* blob);
+bool lovrModelDataIsCooked(const void* data, size_t size);
+bool lovrModelDataEncode(ModelData* model, const char* filename);
+const char* lovrModelDataParseFloat(const char* s, const char* end, float* value);
 void lovrModelDataDestroy(void* ref);
 void lovrModelDataAllocate(ModelData* model);
+struct TextureData* lovrModelDataGetTexture(ModelData* model, uint32_t index);
+void lovrModelDataOptimize(ModelData* model);
+void lovrModelDataGenerateLods(ModelData* model, uint32_t levels);
+void lovrModelDataCompressAnimations(ModelData* model, float rate, float tolerance);
+void lovrModelDataSampleChannel(ModelAnimationChannel* channel, float time, uint32_t* cursor, float* property);
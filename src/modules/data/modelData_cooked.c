@@ -0,0 +1,628 @@
+#include "data/modelData.h"
+#include "data/blob.h"
+#include "data/textureData.h"
+#include "filesystem/filesystem.h"
+#include "core/arr.h"
+#include "core/ref.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A cooked model is a header, the ModelData arrays as laid out by lovrModelDataAllocate, tables for
+// textures and name lookups, and a data section with vertex, animation, and texture data.  Pointers
+// in the arrays are stored as offsets (plus one, so NULL stays NULL).  Loading copies the arrays and
+// patches the pointers, everything in the data section is used in place.  The arrays are stored with
+// this platform's struct layout, so a cooked model only loads on a build with the same layout.
+
+#define COOKED_VERSION 2
+
+static const char cookedMagic[8] = "LOVRMDL";
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint16_t layout[10];
+  uint32_t bufferCount;
+  uint32_t textureCount;
+  uint32_t materialCount;
+  uint32_t attributeCount;
+  uint32_t primitiveCount;
+  uint32_t animationCount;
+  uint32_t skinCount;
+  uint32_t nodeCount;
+  uint32_t channelCount;
+  uint32_t childCount;
+  uint32_t jointCount;
+  uint32_t charCount;
+  uint32_t mipmapCount;
+  uint32_t mapCounts[3];
+  uint32_t rootNode;
+  uint32_t lodIndexCount;
+  uint32_t removedVertices;
+  float acmrBefore;
+  float acmrAfter;
+  uint64_t arrayOffset;
+  uint64_t arraySize;
+  uint64_t textureOffset;
+  uint64_t mipmapOffset;
+  uint64_t mapOffset;
+  uint64_t lodIndexOffset;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+} CookedHeader;
+
+typedef struct {
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipmapCount;
+  uint32_t firstMipmap;
+} CookedTexture;
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+} CookedMipmap;
+
+typedef struct {
+  uint64_t hash;
+  uint64_t value;
+} CookedMapEntry;
+
+typedef arr_t(CookedMipmap) arr_mipmap_t;
+typedef arr_t(CookedMapEntry) arr_entry_t;
+
+typedef struct {
+  char* start;
+  size_t size;
+  uint64_t offset;
+} CookedRange;
+
+typedef struct {
+  arr_t(char) data;
+  arr_t(CookedRange) ranges;
+} Cooker;
+
+#define ENCODE(p, base) ((p) ? (void*) (uintptr_t) ((char*) (p) - (char*) (base) + 1) : NULL)
+#define DECODE(p, base) ((p) ? (void*) ((char*) (base) + (uintptr_t) (p) - 1) : NULL)
+
+static void getLayout(uint16_t layout[10]) {
+  layout[0] = sizeof(void*);
+  layout[1] = sizeof(ModelBuffer);
+  layout[2] = sizeof(ModelMaterial);
+  layout[3] = sizeof(ModelAttribute);
+  layout[4] = sizeof(ModelPrimitive);
+  layout[5] = sizeof(ModelAnimation);
+  layout[6] = sizeof(ModelAnimationChannel);
+  layout[7] = sizeof(ModelSkin);
+  layout[8] = sizeof(ModelNode);
+  layout[9] = sizeof(ModelImage);
+}
+
+static uint64_t appendData(Cooker* cooker, const void* data, size_t size) {
+  size_t offset = ALIGN(cooker->data.length + 15, 16);
+  arr_reserve(&cooker->data, offset + size);
+  memset(cooker->data.data + cooker->data.length, 0, offset - cooker->data.length);
+  memcpy(cooker->data.data + offset, data, size);
+  cooker->data.length = offset + size;
+  return offset;
+}
+
+// Data that's already in the data section (e.g. an accessor inside a buffer) is shared
+static void* encodeData(Cooker* cooker, const void* p, size_t size) {
+  if (!p) {
+    return NULL;
+  }
+
+  const char* c = p;
+  for (size_t i = 0; i < cooker->ranges.length; i++) {
+    CookedRange* range = &cooker->ranges.data[i];
+    if (c >= range->start && c + size <= range->start + range->size) {
+      return (void*) (uintptr_t) (range->offset + (c - range->start) + 1);
+    }
+  }
+
+  uint64_t offset = appendData(cooker, p, size);
+  arr_push(&cooker->ranges, ((CookedRange) { (char*) p, size, offset }));
+  return (void*) (uintptr_t) (offset + 1);
+}
+
+static char* encodeName(ModelData* cooked, const char* name, char** cursor) {
+  if (!name) {
+    return NULL;
+  }
+
+  size_t length = strlen(name);
+  char* copy = *cursor;
+  memcpy(copy, name, length + 1);
+  *cursor += length + 1;
+  return ENCODE(copy, cooked->chars);
+}
+
+static uint32_t encodeMap(map_t* map, arr_entry_t* entries) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < map->size; i++) {
+    if (map->hashes[i] != MAP_NIL) {
+      arr_push(entries, ((CookedMapEntry) { map->hashes[i], map->values[i] }));
+      count++;
+    }
+  }
+  return count;
+}
+
+bool lovrModelDataIsCooked(const void* data, size_t size) {
+  return size >= sizeof(cookedMagic) && !memcmp(data, cookedMagic, sizeof(cookedMagic));
+}
+
+// Nothing in a cooked file is trusted, every table and pointer is checked against the region it's in
+static bool inBounds(uint64_t offset, uint64_t size, uint64_t capacity) {
+  return offset <= capacity && size <= capacity - offset;
+}
+
+static bool validPointer(const void* p, uint64_t size, uint64_t stride, uint64_t capacity) {
+  uint64_t offset = (uintptr_t) p - 1;
+  return !p || (offset % stride == 0 && inBounds(offset, size, capacity));
+}
+
+static const uint8_t attributeTypeSizes[] = {
+  [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4
+};
+
+// Smallest valid size of a mipmap, compressed formats are measured in whole blocks
+static uint64_t getMipmapSize(TextureFormat format, uint32_t width, uint32_t height) {
+  uint32_t bw = 4, bh = 4;
+  switch (format) {
+    case FORMAT_DXT1: return (uint64_t) ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    case FORMAT_DXT3:
+    case FORMAT_DXT5: break;
+    case FORMAT_ASTC_4x4: break;
+    case FORMAT_ASTC_5x4: bw = 5; break;
+    case FORMAT_ASTC_5x5: bw = 5, bh = 5; break;
+    case FORMAT_ASTC_6x5: bw = 6, bh = 5; break;
+    case FORMAT_ASTC_6x6: bw = 6, bh = 6; break;
+    case FORMAT_ASTC_8x5: bw = 8, bh = 5; break;
+    case FORMAT_ASTC_8x6: bw = 8, bh = 6; break;
+    case FORMAT_ASTC_8x8: bw = 8, bh = 8; break;
+    case FORMAT_ASTC_10x5: bw = 10, bh = 5; break;
+    case FORMAT_ASTC_10x6: bw = 10, bh = 6; break;
+    case FORMAT_ASTC_10x8: bw = 10, bh = 8; break;
+    case FORMAT_ASTC_10x10: bw = 10, bh = 10; break;
+    case FORMAT_ASTC_12x10: bw = 12, bh = 10; break;
+    case FORMAT_ASTC_12x12: bw = 12, bh = 12; break;
+    default: return (uint64_t) width * height * lovrTextureFormatGetPixelSize(format);
+  }
+  return (uint64_t) ((width + bw - 1) / bw) * ((height + bh - 1) / bh) * 16;
+}
+
+#define CHECK(x) lovrAssert(x, "Cooked model '%s' is corrupt", source->name)
+#define CHECK_NAME(p) CHECK(validPointer(p, 1, 1, model->charCount))
+#define CHECK_ARRAY(p, count, type, total) CHECK(validPointer(p, (uint64_t) (count) * sizeof(type), sizeof(type), (uint64_t) (total) * sizeof(type)))
+#define CHECK_DATA(p, count, type) CHECK(validPointer(p, (uint64_t) (count) * sizeof(type), sizeof(type), header->dataSize))
+
+ModelData* lovrModelDataInitCooked(ModelData* model, Blob* source) {
+  if (!lovrModelDataIsCooked(source->data, source->size)) {
+    return NULL;
+  }
+
+  lovrAssert(source->size >= sizeof(CookedHeader), "Cooked model '%s' is truncated", source->name);
+  uint16_t layout[10];
+  getLayout(layout);
+  CookedHeader* header = source->data;
+  lovrAssert(header->version == COOKED_VERSION, "Cooked model '%s' has an unsupported version", source->name);
+  lovrAssert(!memcmp(header->layout, layout, sizeof(layout)), "Cooked model '%s' was built for a different platform", source->name);
+  lovrAssert(inBounds(header->dataOffset, header->dataSize, source->size), "Cooked model '%s' is truncated", source->name);
+
+  uint64_t mapCount = (uint64_t) header->mapCounts[0] + header->mapCounts[1] + header->mapCounts[2];
+  CHECK(inBounds(header->arrayOffset, header->arraySize, source->size));
+  CHECK(inBounds(header->textureOffset, (uint64_t) header->textureCount * sizeof(CookedTexture), source->size));
+  CHECK(inBounds(header->mipmapOffset, (uint64_t) header->mipmapCount * sizeof(CookedMipmap), source->size));
+  CHECK(inBounds(header->mapOffset, mapCount * sizeof(CookedMapEntry), source->size));
+  CHECK(inBounds(header->lodIndexOffset, (uint64_t) header->lodIndexCount * sizeof(uint32_t), header->dataSize));
+  CHECK(header->nodeCount == 0 || header->rootNode < header->nodeCount);
+
+  // Every element takes at least a byte of the arrays, which bounds the allocation before it happens
+  uint64_t elements = (uint64_t) header->bufferCount + header->textureCount + header->materialCount +
+    header->attributeCount + header->primitiveCount + header->animationCount + header->skinCount +
+    header->nodeCount + header->channelCount + header->childCount + header->jointCount + header->charCount;
+  CHECK(elements <= header->arraySize);
+
+  model->blobCount = 1;
+  model->bufferCount = header->bufferCount;
+  model->textureCount = header->textureCount;
+  model->materialCount = header->materialCount;
+  model->attributeCount = header->attributeCount;
+  model->primitiveCount = header->primitiveCount;
+  model->animationCount = header->animationCount;
+  model->skinCount = header->skinCount;
+  model->nodeCount = header->nodeCount;
+  model->channelCount = header->channelCount;
+  model->childCount = header->childCount;
+  model->jointCount = header->jointCount;
+  model->charCount = header->charCount;
+  lovrModelDataAllocate(model);
+
+  size_t arraySize = (char*) (model->chars + model->charCount) - (char*) model->data;
+  CHECK(header->arraySize == arraySize);
+  memcpy(model->data, (char*) source->data + header->arrayOffset, arraySize);
+  CHECK(model->charCount == 0 || model->chars[model->charCount - 1] == '\0');
+
+  char* data = (char*) source->data + header->dataOffset;
+  model->blobs[0] = source;
+  lovrRetain(source);
+
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    ModelBuffer* buffer = &model->buffers[i];
+    CHECK(validPointer(buffer->data, buffer->size, 1, header->dataSize));
+    buffer->data = DECODE(buffer->data, data);
+  }
+
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    ModelMaterial* material = &model->materials[i];
+    CHECK_NAME(material->name);
+    for (uint32_t j = 0; j < MAX_MATERIAL_TEXTURES; j++) {
+      CHECK(material->textures[j] == ~0u || material->textures[j] < model->textureCount);
+    }
+    material->name = DECODE(material->name, model->chars);
+  }
+
+  for (uint32_t i = 0; i < model->attributeCount; i++) {
+    ModelAttribute* attribute = &model->attributes[i];
+    CHECK(attribute->buffer < model->bufferCount);
+    CHECK((uint32_t) attribute->type <= F32 && attribute->components >= 1 && attribute->components <= 4);
+    if (attribute->count > 0) {
+      ModelBuffer* buffer = &model->buffers[attribute->buffer];
+      uint64_t size = (uint64_t) attributeTypeSizes[attribute->type] * attribute->components * (attribute->matrix ? attribute->components : 1);
+      uint64_t stride = buffer->stride ? buffer->stride : size;
+      CHECK(inBounds(attribute->offset, (attribute->count - 1) * stride + size, buffer->size));
+    }
+  }
+
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+      CHECK_ARRAY(primitive->attributes[j], 1, ModelAttribute, model->attributeCount);
+      primitive->attributes[j] = DECODE(primitive->attributes[j], model->attributes);
+    }
+    CHECK_ARRAY(primitive->indices, 1, ModelAttribute, model->attributeCount);
+    primitive->indices = DECODE(primitive->indices, model->attributes);
+    CHECK(primitive->material == ~0u || primitive->material < model->materialCount);
+    CHECK(primitive->lodCount < MAX_LODS);
+    for (uint32_t j = 0; j < primitive->lodCount; j++) {
+      CHECK(inBounds(primitive->lods[j].start, primitive->lods[j].count, header->lodIndexCount));
+    }
+  }
+
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    ModelAnimation* animation = &model->animations[i];
+    CHECK_NAME(animation->name);
+    CHECK_ARRAY(animation->channels, animation->channelCount, ModelAnimationChannel, model->channelCount);
+    animation->name = DECODE(animation->name, model->chars);
+    animation->channels = DECODE(animation->channels, model->channels);
+  }
+
+  for (uint32_t i = 0; i < model->channelCount; i++) {
+    ModelAnimationChannel* channel = &model->channels[i];
+    uint64_t components = channel->property == PROP_ROTATION ? 4 : 3;
+    uint64_t values = channel->keyframeCount * components * (channel->smoothing == SMOOTH_CUBIC ? 3 : 1);
+    CHECK(channel->nodeIndex < model->nodeCount);
+    CHECK_DATA(channel->times, channel->keyframeCount, float);
+    CHECK_DATA(channel->data, values, float);
+    CHECK_DATA(channel->samples, 3 * (uint64_t) channel->keyframeCount, uint16_t);
+    channel->times = DECODE(channel->times, data);
+    channel->data = DECODE(channel->data, data);
+    channel->samples = DECODE(channel->samples, data);
+  }
+
+  for (uint32_t i = 0; i < model->skinCount; i++) {
+    ModelSkin* skin = &model->skins[i];
+    CHECK_ARRAY(skin->joints, skin->jointCount, uint32_t, model->jointCount);
+    CHECK_DATA(skin->inverseBindMatrices, 16 * (uint64_t) skin->jointCount, float);
+    skin->joints = DECODE(skin->joints, model->joints);
+    skin->inverseBindMatrices = DECODE(skin->inverseBindMatrices, data);
+  }
+
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    ModelNode* node = &model->nodes[i];
+    CHECK_NAME(node->name);
+    CHECK_ARRAY(node->children, node->childCount, uint32_t, model->childCount);
+    CHECK_DATA(node->instances, 16 * (uint64_t) node->instanceCount, float);
+    CHECK((uint64_t) node->primitiveIndex + node->primitiveCount <= model->primitiveCount);
+    CHECK(node->skin == ~0u || node->skin < model->skinCount);
+    CHECK(node->lodCount < MAX_LODS);
+    for (uint32_t j = 0; j < node->lodCount; j++) {
+      CHECK(node->lodNodes[j] == ~0u || node->lodNodes[j] < model->nodeCount);
+    }
+    node->name = DECODE(node->name, model->chars);
+    node->children = DECODE(node->children, model->children);
+    node->instances = DECODE(node->instances, data);
+  }
+
+  for (uint32_t i = 0; i < model->childCount; i++) {
+    CHECK(model->children[i] < model->nodeCount);
+  }
+
+  for (uint32_t i = 0; i < model->jointCount; i++) {
+    CHECK(model->joints[i] < model->nodeCount);
+  }
+
+  // Compressed textures keep the whole file as their source, others get a view of their pixels
+  CookedTexture* textures = (CookedTexture*) ((char*) source->data + header->textureOffset);
+  CookedMipmap* mipmaps = (CookedMipmap*) ((char*) source->data + header->mipmapOffset);
+  for (uint32_t i = 0; i < model->textureCount; i++) {
+    CookedTexture* cooked = &textures[i];
+    if (cooked->mipmapCount == 0) {
+      continue;
+    }
+
+    CHECK(inBounds(cooked->firstMipmap, cooked->mipmapCount, header->mipmapCount));
+    CHECK(cooked->format <= FORMAT_ASTC_12x12 && getMipmapSize(cooked->format, 1, 1) > 0);
+    CHECK(cooked->width > 0 && cooked->height > 0 && cooked->mipmapCount <= 32);
+    for (uint32_t j = 0; j < cooked->mipmapCount; j++) {
+      CookedMipmap* mipmap = &mipmaps[cooked->firstMipmap + j];
+      CHECK(mipmap->width == MAX(cooked->width >> j, 1) && mipmap->height == MAX(cooked->height >> j, 1));
+      CHECK(mipmap->size >= getMipmapSize(cooked->format, mipmap->width, mipmap->height));
+      CHECK(cooked->format >= FORMAT_DXT1 || mipmap->size == getMipmapSize(cooked->format, mipmap->width, mipmap->height));
+    }
+
+    TextureData* texture = model->textures[i] = lovrAlloc(TextureData);
+    texture->format = cooked->format;
+    texture->width = cooked->width;
+    texture->height = cooked->height;
+    texture->mipmapCount = cooked->mipmapCount;
+    texture->mipmaps = malloc(cooked->mipmapCount * sizeof(Mipmap));
+    lovrAssert(texture->mipmaps, "Out of memory");
+
+    size_t size = 0;
+    for (uint32_t j = 0; j < cooked->mipmapCount; j++) {
+      CookedMipmap* mipmap = &mipmaps[cooked->firstMipmap + j];
+      CHECK(inBounds(mipmap->offset, mipmap->size, header->dataSize));
+      texture->mipmaps[j] = (Mipmap) { mipmap->width, mipmap->height, mipmap->size, data + mipmap->offset };
+      size += mipmap->size;
+    }
+
+    if (texture->format >= FORMAT_DXT1) {
+      texture->blob = lovrAlloc(Blob);
+      texture->source = source;
+      lovrRetain(source);
+    } else {
+      texture->blob = lovrBlobCreateView(source, texture->mipmaps[0].data, size);
+    }
+  }
+
+  CookedMapEntry* entries = (CookedMapEntry*) ((char*) source->data + header->mapOffset);
+  map_t* maps[] = { &model->animationMap, &model->materialMap, &model->nodeMap };
+  uint32_t counts[] = { model->animationCount, model->materialCount, model->nodeCount };
+  for (uint32_t i = 0; i < 3; i++) {
+    for (uint32_t j = 0; j < header->mapCounts[i]; j++, entries++) {
+      CHECK(entries->value < counts[i]);
+      map_set(maps[i], entries->hash, entries->value);
+    }
+  }
+
+  if (header->lodIndexCount > 0) {
+    size_t size = header->lodIndexCount * sizeof(uint32_t);
+    model->lodIndices = malloc(size);
+    lovrAssert(model->lodIndices, "Out of memory");
+    memcpy(model->lodIndices, data + header->lodIndexOffset, size);
+    model->lodIndexCount = header->lodIndexCount;
+  }
+
+  model->rootNode = header->rootNode;
+  model->removedVertices = header->removedVertices;
+  model->acmrBefore = header->acmrBefore;
+  model->acmrAfter = header->acmrAfter;
+  return model;
+}
+
+static void encodeTexture(Cooker* cooker, TextureData* texture, bool srgb, CookedTexture* cooked, arr_mipmap_t* mipmaps) {
+  cooked->format = texture->format;
+  cooked->width = texture->width;
+  cooked->height = texture->height;
+  cooked->firstMipmap = (uint32_t) mipmaps->length;
+
+  // Uncompressed textures get a full mipmap chain, so it doesn't have to be generated at load time
+  TextureData* copy = NULL;
+  TextureFormat format = texture->format;
+  bool mipmappable = format == FORMAT_RGB || format == FORMAT_RGBA || format == FORMAT_RGBA32F;
+  if (mipmappable && texture->mipmapCount <= 1) {
+    copy = lovrTextureDataCreate(texture->width, texture->height, texture->blob, 0, format);
+    lovrTextureDataGenerateMipmaps(copy, srgb);
+    texture = copy;
+  }
+
+  if (texture->mipmapCount > 0) {
+    for (uint32_t i = 0; i < texture->mipmapCount; i++) {
+      Mipmap* mipmap = &texture->mipmaps[i];
+      uint64_t offset = appendData(cooker, mipmap->data, mipmap->size);
+      arr_push(mipmaps, ((CookedMipmap) { mipmap->width, mipmap->height, offset, mipmap->size }));
+    }
+    cooked->mipmapCount = texture->mipmapCount;
+  } else {
+    uint64_t offset = appendData(cooker, texture->blob->data, texture->blob->size);
+    arr_push(mipmaps, ((CookedMipmap) { texture->width, texture->height, offset, texture->blob->size }));
+    cooked->mipmapCount = 1;
+  }
+
+  lovrRelease(TextureData, copy);
+}
+
+// Writes the model in the cooked format, all textures are decoded (and mipmapped) in the process
+bool lovrModelDataEncode(ModelData* model, const char* filename) {
+  Cooker cooker;
+  arr_init(&cooker.data);
+  arr_init(&cooker.ranges);
+
+  // The arrays are rebuilt in a second ModelData with a single Blob, and names packed from scratch
+  ModelData cooked;
+  memset(&cooked, 0, sizeof(cooked));
+  cooked.blobCount = 1;
+  cooked.bufferCount = model->bufferCount;
+  cooked.textureCount = model->textureCount;
+  cooked.materialCount = model->materialCount;
+  cooked.attributeCount = model->attributeCount;
+  cooked.primitiveCount = model->primitiveCount;
+  cooked.animationCount = model->animationCount;
+  cooked.skinCount = model->skinCount;
+  cooked.nodeCount = model->nodeCount;
+  cooked.channelCount = model->channelCount;
+  cooked.childCount = model->childCount;
+  cooked.jointCount = model->jointCount;
+
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    cooked.charCount += model->materials[i].name ? (uint32_t) strlen(model->materials[i].name) + 1 : 0;
+  }
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    cooked.charCount += model->animations[i].name ? (uint32_t) strlen(model->animations[i].name) + 1 : 0;
+  }
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    cooked.charCount += model->nodes[i].name ? (uint32_t) strlen(model->nodes[i].name) + 1 : 0;
+  }
+
+  lovrModelDataAllocate(&cooked);
+  char* cursor = cooked.chars;
+
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    ModelBuffer* buffer = &model->buffers[i];
+    cooked.buffers[i] = *buffer;
+    cooked.buffers[i].data = encodeData(&cooker, buffer->data, buffer->size);
+  }
+
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    cooked.materials[i] = model->materials[i];
+    cooked.materials[i].name = encodeName(&cooked, model->materials[i].name, &cursor);
+  }
+
+  memcpy(cooked.attributes, model->attributes, model->attributeCount * sizeof(ModelAttribute));
+
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    cooked.primitives[i] = *primitive;
+    for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+      cooked.primitives[i].attributes[j] = ENCODE(primitive->attributes[j], model->attributes);
+    }
+    cooked.primitives[i].indices = ENCODE(primitive->indices, model->attributes);
+  }
+
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    cooked.animations[i] = model->animations[i];
+    cooked.animations[i].name = encodeName(&cooked, model->animations[i].name, &cursor);
+    cooked.animations[i].channels = ENCODE(model->animations[i].channels, model->channels);
+  }
+
+  for (uint32_t i = 0; i < model->channelCount; i++) {
+    ModelAnimationChannel* channel = &model->channels[i];
+    size_t components = channel->property == PROP_ROTATION ? 4 : 3;
+    size_t values = channel->keyframeCount * components * (channel->smoothing == SMOOTH_CUBIC ? 3 : 1);
+    cooked.channels[i] = *channel;
+    cooked.channels[i].times = encodeData(&cooker, channel->times, channel->keyframeCount * sizeof(float));
+    cooked.channels[i].data = encodeData(&cooker, channel->data, values * sizeof(float));
+    cooked.channels[i].samples = encodeData(&cooker, channel->samples, 3 * channel->keyframeCount * sizeof(uint16_t));
+  }
+
+  for (uint32_t i = 0; i < model->skinCount; i++) {
+    ModelSkin* skin = &model->skins[i];
+    cooked.skins[i] = *skin;
+    cooked.skins[i].joints = ENCODE(skin->joints, model->joints);
+    cooked.skins[i].inverseBindMatrices = encodeData(&cooker, skin->inverseBindMatrices, 16 * skin->jointCount * sizeof(float));
+  }
+
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    cooked.nodes[i] = model->nodes[i];
+    cooked.nodes[i].name = encodeName(&cooked, model->nodes[i].name, &cursor);
+    cooked.nodes[i].children = ENCODE(model->nodes[i].children, model->children);
+    cooked.nodes[i].instances = encodeData(&cooker, model->nodes[i].instances, 16 * model->nodes[i].instanceCount * sizeof(float));
+  }
+
+  memcpy(cooked.children, model->children, model->childCount * sizeof(uint32_t));
+  memcpy(cooked.joints, model->joints, model->jointCount * sizeof(uint32_t));
+
+  // Color textures are mipmapped in linear space
+  bool* srgb = calloc(model->textureCount + 1, sizeof(bool));
+  CookedTexture* textures = calloc(model->textureCount + 1, sizeof(CookedTexture));
+  lovrAssert(srgb && textures, "Out of memory");
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    uint32_t diffuse = model->materials[i].textures[TEXTURE_DIFFUSE];
+    uint32_t emissive = model->materials[i].textures[TEXTURE_EMISSIVE];
+    if (diffuse < model->textureCount) srgb[diffuse] = true;
+    if (emissive < model->textureCount) srgb[emissive] = true;
+  }
+
+  arr_mipmap_t mipmaps;
+  arr_init(&mipmaps);
+  for (uint32_t i = 0; i < model->textureCount; i++) {
+    TextureData* texture = lovrModelDataGetTexture(model, i);
+    if (texture) {
+      encodeTexture(&cooker, texture, srgb[i], &textures[i], &mipmaps);
+    }
+  }
+
+  arr_entry_t entries;
+  arr_init(&entries);
+
+  CookedHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, cookedMagic, sizeof(cookedMagic));
+  header.version = COOKED_VERSION;
+  getLayout(header.layout);
+  header.bufferCount = cooked.bufferCount;
+  header.textureCount = cooked.textureCount;
+  header.materialCount = cooked.materialCount;
+  header.attributeCount = cooked.attributeCount;
+  header.primitiveCount = cooked.primitiveCount;
+  header.animationCount = cooked.animationCount;
+  header.skinCount = cooked.skinCount;
+  header.nodeCount = cooked.nodeCount;
+  header.channelCount = cooked.channelCount;
+  header.childCount = cooked.childCount;
+  header.jointCount = cooked.jointCount;
+  header.charCount = cooked.charCount;
+  header.mipmapCount = (uint32_t) mipmaps.length;
+  header.mapCounts[0] = encodeMap(&model->animationMap, &entries);
+  header.mapCounts[1] = encodeMap(&model->materialMap, &entries);
+  header.mapCounts[2] = encodeMap(&model->nodeMap, &entries);
+  header.rootNode = model->rootNode;
+  header.lodIndexCount = model->lodIndexCount;
+  header.removedVertices = model->removedVertices;
+  header.acmrBefore = model->acmrBefore;
+  header.acmrAfter = model->acmrAfter;
+
+  if (model->lodIndexCount > 0) {
+    header.lodIndexOffset = appendData(&cooker, model->lodIndices, model->lodIndexCount * sizeof(uint32_t));
+  }
+
+  size_t textureSize = model->textureCount * sizeof(CookedTexture);
+  size_t mipmapSize = mipmaps.length * sizeof(CookedMipmap);
+  size_t mapSize = entries.length * sizeof(CookedMapEntry);
+  header.arraySize = (char*) (cooked.chars + cooked.charCount) - (char*) cooked.data;
+  header.arrayOffset = sizeof(CookedHeader);
+  header.textureOffset = ALIGN(header.arrayOffset + header.arraySize + 7, 8);
+  header.mipmapOffset = header.textureOffset + textureSize;
+  header.mapOffset = ALIGN(header.mipmapOffset + mipmapSize + 7, 8);
+  header.dataOffset = ALIGN(header.mapOffset + mapSize + 15, 16);
+  header.dataSize = cooker.data.length;
+
+  size_t size = header.dataOffset + header.dataSize;
+  char* file = calloc(1, size);
+  lovrAssert(file, "Out of memory");
+  memcpy(file, &header, sizeof(header));
+  memcpy(file + header.arrayOffset, cooked.data, header.arraySize);
+  memcpy(file + header.textureOffset, textures, textureSize);
+  if (mipmapSize > 0) memcpy(file + header.mipmapOffset, mipmaps.data, mipmapSize);
+  if (mapSize > 0) memcpy(file + header.mapOffset, entries.data, mapSize);
+  if (header.dataSize > 0) memcpy(file + header.dataOffset, cooker.data.data, header.dataSize);
+  bool success = lovrFilesystemWrite(filename, file, size, false) == size;
+
+  free(file);
+  free(srgb);
+  free(textures);
+  arr_free(&mipmaps);
+  arr_free(&entries);
+  arr_free(&cooker.data);
+  arr_free(&cooker.ranges);
+  map_free(&cooked.animationMap);
+  map_free(&cooked.materialMap);
+  map_free(&cooked.nodeMap);
+  free(cooked.data);
+  return success;
+}
@@ -1,33 +1,31 @@
 #include "data/modelData.h"
 #include "data/blob.h"
-#include "data/textureData.h"
 #include "core/hash.h"
 #include "core/maf.h"
 #include "core/ref.h"
-#include "lib/jsmn/jsmn.h"
+#include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-
-#define MAX_STACK_TOKENS 1024
 
 #define MAGIC_glTF 0x46546c67
 #define MAGIC_JSON 0x4e4f534a
 #define MAGIC_BIN 0x004e4942
 
 #define STR_EQ(k, s) !strncmp(k.data, s, k.length)
-#define NOM_VALUE(j, t) nomValue(j, t, 1, 0)
-#define NOM_INT(j, t) nomInt(j + (t++)->start)
-#define NOM_STR(j, t) (gltfString) { (char* )j + t->start, t->end - t->start }; t++
-#define NOM_BOOL(j, t) (*(j + (t++)->start) == 't')
-#define NOM_FLOAT(j, t) atof(j + (t++)->start)
 
 typedef struct {
   char* data;
   size_t length;
 } gltfString;
 
+// The JSON is read in place by a cursor instead of being tokenized up front, so memory use doesn't
+// depend on the size of the document.  Cursors are copied to remember where a section starts.
+typedef struct {
+  const char* data;
+  const char* end;
+} gltfCursor;
+
 typedef struct {
   uint32_t magic;
   uint32_t version;
@@ -43,6 +41,7 @@ typedef struct {
   uint32_t input;
   uint32_t output;
   SmoothMode smoothing;
+  float* data;
 } gltfAnimationSampler;
 
 typedef struct {
@@ -65,20 +64,118 @@ typedef struct {
   uint32_t nodeCount;
 } gltfScene;
 
-static uint32_t nomInt(const char* s) {
+// Commas and colons are skipped along with whitespace, the structure comes from the brackets
+static char nomPeek(gltfCursor* c) {
+  while (c->data < c->end && (*c->data == ' ' || *c->data == '\t' || *c->data == '\r' || *c->data == '\n' || *c->data == ',' || *c->data == ':')) {
+    c->data++;
+  }
+  return c->data < c->end ? *c->data : '\0';
+}
+
+static void nomOpen(gltfCursor* c) {
+  char bracket = nomPeek(c);
+  lovrAssert(bracket == '{' || bracket == '[', "Bad glTF: Expected an object or array");
+  c->data++;
+}
+
+// Returns false after consuming the closing bracket of the current object or array
+static bool nomNext(gltfCursor* c) {
+  char next = nomPeek(c);
+  lovrAssert(next != '\0', "Bad glTF: Unexpected end of JSON");
+  if (next == '}' || next == ']') {
+    c->data++;
+    return false;
+  }
+  return true;
+}
+
+static gltfString nomString(gltfCursor* c) {
+  lovrAssert(nomPeek(c) == '"', "Bad glTF: Expected a string");
+  const char* start = ++c->data;
+  while (c->data < c->end && *c->data != '"') {
+    c->data += *c->data == '\\' ? 2 : 1;
+  }
+  lovrAssert(c->data < c->end, "Bad glTF: Unterminated string");
+  return (gltfString) { (char*) start, c->data++ - start };
+}
+
+static uint32_t nomInt(gltfCursor* c) {
   uint32_t n = 0;
-  lovrAssert(*s != '-', "Expected a positive number");
-  while (isdigit(*s)) { n = 10 * n + (*s++ - '0'); }
+  lovrAssert(nomPeek(c) != '-', "Expected a positive number");
+  while (c->data < c->end && *c->data >= '0' && *c->data <= '9') {
+    n = 10 * n + (*c->data++ - '0');
+  }
   return n;
 }
 
-static int nomValue(const char* data, jsmntok_t* token, int count, int sum) {
-  if (count == 0) { return sum; }
-  switch (token->type) {
-    case JSMN_OBJECT: return nomValue(data, token + 1, count - 1 + 2 * token->size, sum + 1);
-    case JSMN_ARRAY: return nomValue(data, token + 1, count - 1 + token->size, sum + 1);
-    default: return nomValue(data, token + 1, count - 1, sum + 1);
+static float nomFloat(gltfCursor* c) {
+  float value;
+  nomPeek(c);
+  c->data = lovrModelDataParseFloat(c->data, c->end, &value);
+  lovrAssert(c->data, "Bad glTF: Expected a number");
+  return value;
+}
+
+static bool nomBool(gltfCursor* c) {
+  bool value = nomPeek(c) == 't';
+  lovrAssert(c->end - c->data >= (value ? 4 : 5), "Bad glTF: Expected a boolean");
+  c->data += value ? 4 : 5;
+  return value;
+}
+
+// Reads an array of numbers, storing up to capacity of them, and returns how many there were
+static uint32_t nomFloats(gltfCursor* c, float* values, uint32_t capacity) {
+  uint32_t count = 0;
+  for (nomOpen(c); nomNext(c); count++) {
+    float value = nomFloat(c);
+    if (count < capacity) {
+      values[count] = value;
+    }
+  }
+  return count;
+}
+
+// Skips any value, returning the number of elements (or keys) if it was an array (or object)
+static uint32_t nomValue(gltfCursor* c) {
+  char type = nomPeek(c);
+
+  if (type == '"') {
+    nomString(c);
+    return 0;
+  } else if (type != '{' && type != '[') {
+    while (c->data < c->end && !strchr(" \t\r\n,:]}", *c->data)) {
+      c->data++;
+    }
+    return 0;
+  }
+
+  uint32_t count = 0;
+  uint32_t depth = 0;
+  bool empty = true;
+  while (c->data < c->end) {
+    char x = *c->data;
+    if (x == '"') {
+      if (depth == 1 && empty) count++, empty = false;
+      nomString(c);
+      continue;
+    } else if (x == '{' || x == '[') {
+      if (depth == 1 && empty) count++, empty = false;
+      depth++;
+    } else if (x == '}' || x == ']') {
+      if (--depth == 0) {
+        c->data++;
+        return count;
+      }
+    } else if (depth == 1 && x == ',') {
+      empty = true;
+    } else if (depth == 1 && empty && x != ':' && x != ' ' && x != '\t' && x != '\r' && x != '\n') {
+      count++, empty = false;
+    }
+    c->data++;
   }
+
+  lovrThrow("Bad glTF: Unexpected end of JSON");
+  return 0;
 }
 
 static void* decodeBase64(char* str, size_t length, size_t decodedSize) {
@@ -128,23 +225,396 @@ static void* decodeBase64(char* str, size_t length, size_t decodedSize) {
   return data;
 }
 
-static jsmntok_t* resolveTexture(const char* json, jsmntok_t* token, ModelMaterial* material, MaterialTexture textureType, gltfTexture* textures, gltfSampler* samplers) {
-  for (int k = (token++)->size; k > 0; k--) {
-    gltfString key = NOM_STR(json, token);
+// EXT_meshopt_compression, see meshoptimizer's vertexcodec.cpp and indexcodec.cpp for the formats.
+// Vertex data is split into blocks, each byte of the vertex is delta encoded against the previous
+// vertex and the deltas are bit packed in groups of 16.
+
+#define MESHOPT_BLOCK_BYTES 8192
+#define MESHOPT_BLOCK_VERTICES 256
+#define MESHOPT_GROUP_SIZE 16
+#define MESHOPT_GROUP_LIMIT 24
+#define MESHOPT_TAIL_SIZE 32
+
+static const uint8_t* decodeByteGroup(const uint8_t* data, uint8_t* buffer, uint32_t bitslog2) {
+  if (bitslog2 == 0) {
+    memset(buffer, 0, MESHOPT_GROUP_SIZE);
+    return data;
+  } else if (bitslog2 == 3) {
+    memcpy(buffer, data, MESHOPT_GROUP_SIZE);
+    return data + MESHOPT_GROUP_SIZE;
+  }
+
+  // Values that don't fit in the bit width are all ones, and are followed up by a full byte
+  uint32_t bits = bitslog2 == 1 ? 2 : 4;
+  uint32_t sentinel = (1 << bits) - 1;
+  const uint8_t* extra = data + bits * 2;
+  for (uint32_t i = 0; i < MESHOPT_GROUP_SIZE; i += 8 / bits) {
+    uint8_t byte = *data++;
+    for (uint32_t j = 0; j < 8 / bits; j++) {
+      uint8_t value = byte >> (8 - bits);
+      byte <<= bits;
+      *buffer++ = value == sentinel ? *extra : value;
+      extra += value == sentinel;
+    }
+  }
+  return extra;
+}
+
+static const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* buffer, size_t size) {
+  const uint8_t* header = data;
+  size_t headerSize = (size / MESHOPT_GROUP_SIZE + 3) / 4;
+  if ((size_t) (end - data) < headerSize) {
+    return NULL;
+  }
+
+  data += headerSize;
+  for (size_t i = 0; i < size; i += MESHOPT_GROUP_SIZE) {
+    if (end - data < MESHOPT_GROUP_LIMIT) {
+      return NULL;
+    }
+    size_t group = i / MESHOPT_GROUP_SIZE;
+    uint32_t bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    data = decodeByteGroup(data, buffer + i, bitslog2);
+  }
+  return data;
+}
+
+static bool decodeMeshoptVertices(uint8_t* dst, size_t count, size_t stride, const uint8_t* data, size_t size) {
+  const uint8_t* end = data + size;
+  size_t tailSize = MAX(stride, MESHOPT_TAIL_SIZE);
+  if (stride == 0 || stride > 256 || stride % 4 != 0 || size < 1 + tailSize || *data++ != 0xa0) {
+    return false;
+  }
+
+  // The tail has the first vertex, which is the baseline for the deltas of the first block
+  uint8_t last[256];
+  memcpy(last, end - stride, stride);
+
+  uint8_t buffer[MESHOPT_BLOCK_VERTICES];
+  uint8_t transposed[MESHOPT_BLOCK_BYTES];
+  size_t blockSize = (MESHOPT_BLOCK_BYTES / stride) & ~(size_t) (MESHOPT_GROUP_SIZE - 1);
+  blockSize = MIN(blockSize, MESHOPT_BLOCK_VERTICES);
+  for (size_t base = 0; base < count; base += blockSize) {
+    size_t n = MIN(blockSize, count - base);
+    size_t aligned = (n + MESHOPT_GROUP_SIZE - 1) & ~(size_t) (MESHOPT_GROUP_SIZE - 1);
+    for (size_t k = 0; k < stride; k++) {
+      if ((data = decodeBytes(data, end, buffer, aligned)) == NULL) {
+        return false;
+      }
+
+      uint8_t p = last[k];
+      for (size_t i = 0; i < n; i++) {
+        uint8_t delta = buffer[i];
+        p += (uint8_t) (-(delta & 1) ^ (delta >> 1));
+        transposed[i * stride + k] = p;
+      }
+    }
+    memcpy(dst + base * stride, transposed, n * stride);
+    memcpy(last, transposed + (n - 1) * stride, stride);
+  }
+
+  return (size_t) (end - data) == tailSize;
+}
+
+static uint32_t decodeVByte(const uint8_t** data) {
+  uint8_t lead = *(*data)++;
+  if (lead < 128) {
+    return lead;
+  }
+
+  uint32_t result = lead & 127;
+  for (uint32_t i = 0, shift = 7; i < 4; i++, shift += 7) {
+    uint8_t group = *(*data)++;
+    result |= (uint32_t) (group & 127) << shift;
+    if (group < 128) break;
+  }
+  return result;
+}
+
+static uint32_t decodeIndexDelta(const uint8_t** data, uint32_t last) {
+  uint32_t v = decodeVByte(data);
+  return last + ((v >> 1) ^ -(v & 1));
+}
+
+static void writeIndex(void* dst, size_t i, size_t size, uint32_t index) {
+  if (size == 2) {
+    ((uint16_t*) dst)[i] = (uint16_t) index;
+  } else {
+    ((uint32_t*) dst)[i] = index;
+  }
+}
+
+// Triangles reference recently used edges and vertices through small FIFOs, new vertices are
+// implied by a running counter, and anything else is a delta encoded index
+static bool decodeMeshoptTriangles(void* dst, size_t count, size_t indexSize, const uint8_t* data, size_t size) {
+  if (count % 3 != 0 || (indexSize != 2 && indexSize != 4) || size < 1 + count / 3 + 16 || (data[0] & 0xf0) != 0xe0) {
+    return false;
+  }
+
+  uint32_t version = data[0] & 0x0f;
+  if (version > 1) {
+    return false;
+  }
+
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  memset(edges, 0xff, sizeof(edges));
+  memset(vertices, 0xff, sizeof(vertices));
+  uint32_t edgeOffset = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  uint32_t fecMax = version >= 1 ? 13 : 15;
+
+  const uint8_t* codes = data + 1;
+  const uint8_t* cursor = codes + count / 3;
+  const uint8_t* safeEnd = data + size - 16;
+  const uint8_t* auxTable = safeEnd;
+
+#define PUSH_VERTEX(v, cond) vertices[vertexOffset] = (v), vertexOffset = (vertexOffset + (cond)) & 15
+#define PUSH_EDGE(a, b) edges[edgeOffset][0] = (a), edges[edgeOffset][1] = (b), edgeOffset = (edgeOffset + 1) & 15
+
+  for (size_t i = 0; i < count; i += 3) {
+    if (cursor > safeEnd) {
+      return false;
+    }
+
+    uint8_t code = *codes++;
+    uint32_t a, b, c;
+
+    if (code < 0xf0) {
+      uint32_t fe = code >> 4;
+      uint32_t fec = code & 15;
+      a = edges[(edgeOffset - 1 - fe) & 15][0];
+      b = edges[(edgeOffset - 1 - fe) & 15][1];
+
+      if (fec < fecMax) {
+        c = fec == 0 ? next++ : vertices[(vertexOffset - 1 - fec) & 15];
+        PUSH_VERTEX(c, fec == 0);
+      } else {
+        c = last = fec != 15 ? last + (fec == 13 ? -1 : 1) : decodeIndexDelta(&cursor, last);
+        PUSH_VERTEX(c, 1);
+      }
+
+      PUSH_EDGE(c, b);
+      PUSH_EDGE(a, c);
+    } else {
+      uint32_t fea, feb, fec;
+      if (code < 0xfe) {
+        uint8_t aux = auxTable[code & 15];
+        fea = 0;
+        feb = aux >> 4;
+        fec = aux & 15;
+      } else {
+        uint8_t aux = *cursor++;
+        fea = code == 0xfe ? 0 : 15;
+        feb = aux >> 4;
+        fec = aux & 15;
+        if (aux == 0) {
+          next = 0;
+        }
+      }
+
+      // New vertices take the next counter value before any of the FIFO lookups happen
+      a = fea == 0 ? next++ : 0;
+      b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+      c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+      if (fea == 15) a = last = decodeIndexDelta(&cursor, last);
+      if (feb == 15) b = last = decodeIndexDelta(&cursor, last);
+      if (fec == 15) c = last = decodeIndexDelta(&cursor, last);
+
+      PUSH_VERTEX(a, 1);
+      PUSH_VERTEX(b, feb == 0 || feb == 15);
+      PUSH_VERTEX(c, fec == 0 || fec == 15);
+      PUSH_EDGE(b, a);
+      PUSH_EDGE(c, b);
+      PUSH_EDGE(a, c);
+    }
+
+    writeIndex(dst, i + 0, indexSize, a);
+    writeIndex(dst, i + 1, indexSize, b);
+    writeIndex(dst, i + 2, indexSize, c);
+  }
+
+#undef PUSH_VERTEX
+#undef PUSH_EDGE
+
+  return cursor == safeEnd;
+}
+
+// Each index is delta encoded against one of two previous indices, picked by the lowest bit
+static bool decodeMeshoptIndices(void* dst, size_t count, size_t indexSize, const uint8_t* data, size_t size) {
+  if ((indexSize != 2 && indexSize != 4) || size < 1 + count + 4 || (data[0] & 0xf0) != 0xd0 || (data[0] & 0x0f) > 1) {
+    return false;
+  }
+
+  const uint8_t* cursor = data + 1;
+  const uint8_t* safeEnd = data + size - 4;
+  uint32_t last[2] = { 0, 0 };
+  for (size_t i = 0; i < count; i++) {
+    if (cursor >= safeEnd) {
+      return false;
+    }
+    uint32_t v = decodeVByte(&cursor);
+    uint32_t baseline = v & 1;
+    v >>= 1;
+    last[baseline] += (v >> 1) ^ -(v & 1);
+    writeIndex(dst, i, indexSize, last[baseline]);
+  }
+
+  return cursor == safeEnd;
+}
+
+// Filters are applied after decoding, they undo transforms that make vertex data compress better
+static void filterOctahedral(void* data, size_t count, size_t stride) {
+  for (size_t i = 0; i < count; i++) {
+    float v[3];
+    float max;
+    if (stride == 4) {
+      int8_t* p = (int8_t*) data + 4 * i;
+      v[0] = p[0], v[1] = p[1], v[2] = p[2], max = 127.f;
+    } else {
+      int16_t* p = (int16_t*) data + 4 * i;
+      v[0] = p[0], v[1] = p[1], v[2] = p[2], max = 32767.f;
+    }
+
+    // z is stored as the value of 1.0, the actual z and the fold for the lower hemisphere follow
+    v[2] -= fabsf(v[0]) + fabsf(v[1]);
+    float t = MIN(v[2], 0.f);
+    v[0] += v[0] >= 0.f ? t : -t;
+    v[1] += v[1] >= 0.f ? t : -t;
+
+    float scale = max / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (uint32_t j = 0; j < 3; j++) {
+      int32_t x = (int32_t) (v[j] * scale + (v[j] >= 0.f ? .5f : -.5f));
+      if (stride == 4) {
+        ((int8_t*) data)[4 * i + j] = (int8_t) x;
+      } else {
+        ((int16_t*) data)[4 * i + j] = (int16_t) x;
+      }
+    }
+  }
+}
+
+// Quaternions have their largest component dropped, its index is in the low bits of the 4th value
+// and the other bits store the scale the remaining 3 were quantized with
+static void filterQuaternion(int16_t* data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    int16_t* q = data + 4 * i;
+    float scale = .70710678f / (float) (q[3] | 3);
+    float x = q[0] * scale;
+    float y = q[1] * scale;
+    float z = q[2] * scale;
+    float w = sqrtf(MAX(1.f - x * x - y * y - z * z, 0.f));
+    uint32_t largest = q[3] & 3;
+    q[(largest + 1) & 3] = (int16_t) (x * 32767.f + (x >= 0.f ? .5f : -.5f));
+    q[(largest + 2) & 3] = (int16_t) (y * 32767.f + (y >= 0.f ? .5f : -.5f));
+    q[(largest + 3) & 3] = (int16_t) (z * 32767.f + (z >= 0.f ? .5f : -.5f));
+    q[(largest + 0) & 3] = (int16_t) (w * 32767.f + .5f);
+  }
+}
+
+// Floats stored as a 24 bit signed mantissa and an 8 bit signed exponent
+static void filterExponential(uint32_t* data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    int32_t mantissa = (int32_t) (data[i] << 8) >> 8;
+    int32_t exponent = (int32_t) data[i] >> 24;
+    union { float f; uint32_t u; } x;
+    x.u = (uint32_t) (exponent + 127) << 23;
+    x.f *= (float) mantissa;
+    data[i] = x.u;
+  }
+}
+
+static void decodeBufferView(ModelData* model, ModelBuffer* buffer, gltfCursor* token, Blob* source, ptrdiff_t binOffset) {
+  const uint8_t* data = NULL;
+  size_t offset = 0;
+  size_t size = 0;
+  size_t stride = 0;
+  size_t count = 0;
+  gltfString mode = { NULL, 0 };
+  gltfString filter = { "NONE", 4 };
+
+  for (nomOpen(token); nomNext(token);) {
+    gltfString key = nomString(token);
+    if (STR_EQ(key, "buffer")) { data = model->blobs[nomInt(token)]->data; }
+    else if (STR_EQ(key, "byteOffset")) { offset = nomInt(token); }
+    else if (STR_EQ(key, "byteLength")) { size = nomInt(token); }
+    else if (STR_EQ(key, "byteStride")) { stride = nomInt(token); }
+    else if (STR_EQ(key, "count")) { count = nomInt(token); }
+    else if (STR_EQ(key, "mode")) { mode = nomString(token); }
+    else if (STR_EQ(key, "filter")) { filter = nomString(token); }
+    else { nomValue(token); }
+  }
+
+  if (data == source->data) {
+    offset += binOffset;
+  }
+
+  lovrAssert(data && mode.data, "Bad glTF: Compressed buffer view is missing its buffer or mode");
+  lovrAssert(count * stride <= buffer->size, "Bad glTF: Compressed buffer view is larger than its fallback");
+  data += offset;
+
+  bool success = false;
+  if (STR_EQ(mode, "ATTRIBUTES")) {
+    success = decodeMeshoptVertices((uint8_t*) buffer->data, count, stride, data, size);
+  } else if (STR_EQ(mode, "TRIANGLES")) {
+    success = decodeMeshoptTriangles(buffer->data, count, stride, data, size);
+  } else if (STR_EQ(mode, "INDICES")) {
+    success = decodeMeshoptIndices(buffer->data, count, stride, data, size);
+  }
+  lovrAssert(success, "Bad glTF: Could not decode compressed buffer view");
+
+  if (STR_EQ(filter, "OCTAHEDRAL")) {
+    lovrAssert(stride == 4 || stride == 8, "Bad glTF: Octahedral filter needs a stride of 4 or 8");
+    filterOctahedral(buffer->data, count, stride);
+  } else if (STR_EQ(filter, "QUATERNION")) {
+    lovrAssert(stride == 8, "Bad glTF: Quaternion filter needs a stride of 8");
+    filterQuaternion((int16_t*) buffer->data, count);
+  } else if (STR_EQ(filter, "EXPONENTIAL")) {
+    lovrAssert(stride % 4 == 0, "Bad glTF: Exponential filter needs a stride that's a multiple of 4");
+    filterExponential((uint32_t*) buffer->data, count * stride / 4);
+  }
+}
+
+// Reads up to 4 components of an element of an accessor as floats, for data the loader bakes
+static void readAttribute(ModelData* model, ModelAttribute* attribute, uint32_t index, float* value) {
+  static const size_t sizes[] = { [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4 };
+  ModelBuffer* buffer = &model->buffers[attribute->buffer];
+  size_t size = sizes[attribute->type] * attribute->components;
+  char* p = buffer->data + attribute->offset + index * (buffer->stride ? buffer->stride : size);
+  bool normalized = attribute->normalized;
+
+  for (uint32_t i = 0; i < attribute->components && i < 4; i++) {
+    switch (attribute->type) {
+      case I8: value[i] = normalized ? MAX(((int8_t*) p)[i] / 127.f, -1.f) : ((int8_t*) p)[i]; break;
+      case U8: value[i] = normalized ? ((uint8_t*) p)[i] / 255.f : ((uint8_t*) p)[i]; break;
+      case I16: value[i] = normalized ? MAX(((int16_t*) p)[i] / 32767.f, -1.f) : ((int16_t*) p)[i]; break;
+      case U16: value[i] = normalized ? ((uint16_t*) p)[i] / 65535.f : ((uint16_t*) p)[i]; break;
+      case I32: value[i] = (float) ((int32_t*) p)[i]; break;
+      case U32: value[i] = (float) ((uint32_t*) p)[i]; break;
+      case F32: value[i] = ((float*) p)[i]; break;
+      default: break;
+    }
+  }
+}
+
+static void resolveTexture(gltfCursor* token, ModelMaterial* material, MaterialTexture textureType, gltfTexture* textures, gltfSampler* samplers) {
+  for (nomOpen(token); nomNext(token);) {
+    gltfString key = nomString(token);
     if (STR_EQ(key, "index")) {
-      uint32_t index = NOM_INT(json, token);
+      uint32_t index = nomInt(token);
       gltfTexture* texture = &textures[index];
       gltfSampler* sampler = texture->sampler == ~0u ? NULL : &samplers[texture->sampler];
       material->textures[textureType] = texture->image;
       material->filters[textureType] = sampler ? sampler->filter : (TextureFilter) { .mode = FILTER_BILINEAR };
       material->wraps[textureType] = sampler ? sampler->wrap : (TextureWrap) { .s = WRAP_REPEAT, .t = WRAP_REPEAT, .r = WRAP_REPEAT };
     } else if (STR_EQ(key, "texCoord")) {
-      lovrAssert(NOM_INT(json, token) == 0, "Only one set of texture coordinates is supported");
+      lovrAssert(nomInt(token) == 0, "Only one set of texture coordinates is supported");
     } else {
-      token += NOM_VALUE(json, token);
+      nomValue(token);
     }
   }
-  return token;
 }
 
 ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io) {
@@ -182,162 +652,138 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     binOffset = 0;
   }
 
-  // Parse JSON
-  jsmn_parser parser;
-  jsmn_init(&parser);
-
-  jsmntok_t stackTokens[MAX_STACK_TOKENS];
-  jsmntok_t* heapTokens = NULL;
-  jsmntok_t* tokens = &stackTokens[0];
-  int tokenCount = 0;
-
-  if ((tokenCount = jsmn_parse(&parser, json, jsonLength, stackTokens, MAX_STACK_TOKENS)) == JSMN_ERROR_NOMEM) {
-    int capacity = MAX_STACK_TOKENS;
-    jsmn_init(&parser); // This shouldn't be necessary but not doing it caused an infinite loop?
-
-    do {
-      capacity *= 2;
-      heapTokens = realloc(heapTokens, capacity * sizeof(jsmntok_t));
-      lovrAssert(heapTokens, "Out of memory");
-      tokenCount = jsmn_parse(&parser, json, jsonLength, heapTokens, capacity);
-    } while (tokenCount == JSMN_ERROR_NOMEM);
-
-    tokens = heapTokens;
-  }
-
-  if (tokenCount <= 0 || tokens[0].type != JSMN_OBJECT) {
-    free(heapTokens);
+  gltfCursor document = { json, json + jsonLength };
+  if (nomPeek(&document) != '{') {
     return NULL;
   }
 
-  // Prepass: Basically we iterate over the tokens once and figure out how much memory we need and
-  // record the locations of tokens that we'll use later to fill in the memory once it's allocated.
+  // Prepass: Basically we iterate over the JSON once and figure out how much memory we need and
+  // record the locations of sections that we'll use later to fill in the memory once it's allocated.
 
   struct {
-    jsmntok_t* animations;
-    jsmntok_t* attributes;
-    jsmntok_t* buffers;
-    jsmntok_t* bufferViews;
-    jsmntok_t* images;
-    jsmntok_t* materials;
-    jsmntok_t* meshes;
-    jsmntok_t* nodes;
-    jsmntok_t* scenes;
-    jsmntok_t* skins;
+    gltfCursor animations;
+    gltfCursor attributes;
+    gltfCursor buffers;
+    gltfCursor bufferViews;
+    gltfCursor images;
+    gltfCursor materials;
+    gltfCursor meshes;
+    gltfCursor nodes;
+    gltfCursor scenes;
+    gltfCursor skins;
     int sceneCount;
+    uint32_t instancedNodeCount;
   } info;
 
   memset(&info, 0, sizeof(info));
 
   gltfAnimationSampler* animationSamplers = NULL;
+  uint32_t animationSamplerCount = 0;
   gltfMesh* meshes = NULL;
   gltfSampler* samplers = NULL;
   gltfTexture* textures = NULL;
   gltfScene* scenes = NULL;
   int rootScene = 0;
 
-  for (jsmntok_t* token = tokens + 1; token < tokens + tokenCount;) {
-    gltfString key = NOM_STR(json, token);
+  for (nomOpen(&document); nomNext(&document);) {
+    gltfCursor* token = &document;
+    gltfString key = nomString(token);
 
     if (STR_EQ(key, "accessors")) {
-      info.attributes = token;
-      model->attributeCount = token->size;
-      token += NOM_VALUE(json, token);
+      info.attributes = *token;
+      model->attributeCount = nomValue(token);
 
     } else if (STR_EQ(key, "animations")){
-      info.animations = token;
-      model->animationCount = token->size;
-      size_t samplerCount = 0;
-      jsmntok_t* t = token;
-      for (int i = (t++)->size; i > 0; i--) {
-        if (t->size > 0) {
-          for (int k = (t++)->size; k > 0; k--) {
-            gltfString key = NOM_STR(json, t);
-            if (STR_EQ(key, "channels")) { model->channelCount += t->size; }
-            else if (STR_EQ(key, "samplers")) { samplerCount += t->size; }
-            else if (STR_EQ(key, "name")) { model->charCount += t->end - t->start + 1; }
-            t += NOM_VALUE(json, t);
-          }
+      info.animations = *token;
+      uint32_t samplerCount = 0;
+      gltfCursor t = *token;
+      for (nomOpen(&t); nomNext(&t); model->animationCount++) {
+        for (nomOpen(&t); nomNext(&t);) {
+          gltfString key = nomString(&t);
+          if (STR_EQ(key, "channels")) { model->channelCount += nomValue(&t); }
+          else if (STR_EQ(key, "samplers")) { samplerCount += nomValue(&t); }
+          else if (STR_EQ(key, "name")) { model->charCount += nomString(&t).length + 1; }
+          else { nomValue(&t); }
         }
       }
 
       animationSamplers = malloc(samplerCount * sizeof(gltfAnimationSampler));
       lovrAssert(animationSamplers, "Out of memory");
+      animationSamplerCount = samplerCount;
       gltfAnimationSampler* sampler = animationSamplers;
-      for (int i = (token++)->size; i > 0; i--) {
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
+      for (nomOpen(token); nomNext(token);) {
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
           if (STR_EQ(key, "samplers")) {
-            for (int j = (token++)->size; j > 0; j--, sampler++) {
+            for (nomOpen(token); nomNext(token); sampler++) {
               sampler->input = ~0u;
               sampler->output = ~0u;
               sampler->smoothing = SMOOTH_LINEAR;
-              for (int kk = (token++)->size; kk > 0; kk--) {
-                gltfString key = NOM_STR(json, token);
-                if (STR_EQ(key, "input")) { sampler->input = NOM_INT(json, token); }
-                else if (STR_EQ(key, "output")) { sampler->output = NOM_INT(json, token); }
+              sampler->data = NULL;
+              for (nomOpen(token); nomNext(token);) {
+                gltfString key = nomString(token);
+                if (STR_EQ(key, "input")) { sampler->input = nomInt(token); }
+                else if (STR_EQ(key, "output")) { sampler->output = nomInt(token); }
                 else if (STR_EQ(key, "interpolation")) {
-                  gltfString smoothing = NOM_STR(json, token);
+                  gltfString smoothing = nomString(token);
                   if (STR_EQ(smoothing, "LINEAR")) { sampler->smoothing = SMOOTH_LINEAR; }
                   else if (STR_EQ(smoothing, "STEP")) { sampler->smoothing = SMOOTH_STEP; }
                   else if (STR_EQ(smoothing, "CUBICSPLINE")) { sampler->smoothing = SMOOTH_CUBIC; }
                   else { lovrThrow("Unknown animation sampler interpolation"); }
                 } else {
-                  token += NOM_VALUE(json, token);
+                  nomValue(token);
                 }
               }
             }
           } else {
-            token += NOM_VALUE(json, token);
+            nomValue(token);
           }
         }
       }
 
     } else if (STR_EQ(key, "buffers")) {
-      info.buffers = token;
-      model->blobCount = token->size;
-      token += NOM_VALUE(json, token);
+      info.buffers = *token;
+      model->blobCount = nomValue(token);
 
     } else if (STR_EQ(key, "bufferViews")) {
-      info.bufferViews = token;
-      model->bufferCount = token->size;
-      token += NOM_VALUE(json, token);
+      info.bufferViews = *token;
+      model->bufferCount = nomValue(token);
 
     } else if (STR_EQ(key, "images")) {
-      info.images = token;
-      model->textureCount = token->size;
-      token += NOM_VALUE(json, token);
+      info.images = *token;
+      model->textureCount = nomValue(token);
 
     } else if (STR_EQ(key, "samplers")) {
-      samplers = malloc(token->size * sizeof(gltfSampler));
+      gltfCursor t = *token;
+      samplers = malloc(nomValue(&t) * sizeof(gltfSampler));
       lovrAssert(samplers, "Out of memory");
       gltfSampler* sampler = samplers;
-      for (int i = (token++)->size; i > 0; i--, sampler++) {
+      for (nomOpen(token); nomNext(token); sampler++) {
         sampler->filter.mode = FILTER_BILINEAR;
         sampler->wrap.s = sampler->wrap.t = sampler->wrap.r = WRAP_REPEAT;
         int min = -1;
         int mag = -1;
 
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
-          if (STR_EQ(key, "minFilter")) { min = NOM_INT(json, token); }
-          else if (STR_EQ(key, "magFilter")) { mag = NOM_INT(json, token); }
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
+          if (STR_EQ(key, "minFilter")) { min = nomInt(token); }
+          else if (STR_EQ(key, "magFilter")) { mag = nomInt(token); }
           else if (STR_EQ(key, "wrapS")) {
-            switch (NOM_INT(json, token)) {
+            switch (nomInt(token)) {
               case 33071: sampler->wrap.s = WRAP_CLAMP; break;
               case 33648: sampler->wrap.s = WRAP_MIRRORED_REPEAT; break;
               case 10497: sampler->wrap.s = WRAP_REPEAT; break;
-              default: lovrThrow("Unknown sampler wrapS mode for sampler %d", i);
+              default: lovrThrow("Unknown sampler wrapS mode for sampler %d", (int) (sampler - samplers));
             }
           } else if (STR_EQ(key, "wrapT")) {
-            switch (NOM_INT(json, token)) {
+            switch (nomInt(token)) {
               case 33071: sampler->wrap.t = WRAP_CLAMP; break;
               case 33648: sampler->wrap.t = WRAP_MIRRORED_REPEAT; break;
               case 10497: sampler->wrap.t = WRAP_REPEAT; break;
-              default: lovrThrow("Unknown sampler wrapT mode for sampler %d", i);
+              default: lovrThrow("Unknown sampler wrapT mode for sampler %d", (int) (sampler - samplers));
             }
           } else {
-            token += NOM_VALUE(json, token);
+            nomValue(token);
           }
         }
 
@@ -353,103 +799,113 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
       }
 
     } else if (STR_EQ(key, "textures")) {
-      textures = malloc(token->size * sizeof(gltfTexture));
+      gltfCursor t = *token;
+      textures = malloc(nomValue(&t) * sizeof(gltfTexture));
       lovrAssert(textures, "Out of memory");
       gltfTexture* texture = textures;
-      for (int i = (token++)->size; i > 0; i--, texture++) {
+      for (nomOpen(token); nomNext(token); texture++) {
         texture->image = ~0u;
         texture->sampler = ~0u;
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
           if (STR_EQ(key, "source")) {
-            texture->image = NOM_INT(json, token);
+            texture->image = nomInt(token);
           } else if (STR_EQ(key, "sampler")) {
-            texture->sampler = NOM_INT(json, token);
+            texture->sampler = nomInt(token);
           } else {
-            token += NOM_VALUE(json, token);
+            nomValue(token);
           }
         }
         lovrAssert(texture->image != ~0u, "Texture is missing an image (maybe an unsupported extension is used?)");
       }
 
     } else if (STR_EQ(key, "materials")) {
-      info.materials = token;
-      model->materialCount = token->size;
-      for (int i = (token++)->size; i > 0; i--) {
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
-          if (STR_EQ(key, "name")) { model->charCount += token->end - token->start + 1; }
-          token += NOM_VALUE(json, token);
+      info.materials = *token;
+      for (nomOpen(token); nomNext(token); model->materialCount++) {
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
+          if (STR_EQ(key, "name")) { model->charCount += nomString(token).length + 1; }
+          else { nomValue(token); }
         }
       }
 
     } else if (STR_EQ(key, "meshes")) {
-      info.meshes = token;
-      meshes = malloc(token->size * sizeof(gltfMesh));
+      info.meshes = *token;
+      gltfCursor t = *token;
+      meshes = malloc(nomValue(&t) * sizeof(gltfMesh));
       lovrAssert(meshes, "Out of memory");
       gltfMesh* mesh = meshes;
       model->primitiveCount = 0;
-      for (int i = (token++)->size; i > 0; i--, mesh++) {
+      for (nomOpen(token); nomNext(token); mesh++) {
         mesh->primitiveCount = 0;
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
           if (STR_EQ(key, "primitives")) {
+            uint32_t count = nomValue(token);
             mesh->primitiveIndex = model->primitiveCount;
-            mesh->primitiveCount += token->size;
-            model->primitiveCount += token->size;
+            mesh->primitiveCount += count;
+            model->primitiveCount += count;
+          } else {
+            nomValue(token);
           }
-          token += NOM_VALUE(json, token);
         }
       }
 
     } else if (STR_EQ(key, "nodes")) {
-      info.nodes = token;
-      model->nodeCount = token->size;
-      for (int i = (token++)->size; i > 0; i--) {
-        if (token->size > 0) {
-          for (int k = (token++)->size; k > 0; k--) {
-            gltfString key = NOM_STR(json, token);
-            if (STR_EQ(key, "children")) { model->childCount += token->size; }
-            else if (STR_EQ(key, "name")) { model->charCount += token->end - token->start + 1; }
-            token += NOM_VALUE(json, token);
-          }
+      info.nodes = *token;
+      for (nomOpen(token); nomNext(token); model->nodeCount++) {
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
+          if (STR_EQ(key, "children")) { model->childCount += nomValue(token); }
+          else if (STR_EQ(key, "name")) { model->charCount += nomString(token).length + 1; }
+          else if (STR_EQ(key, "extensions")) {
+            for (nomOpen(token); nomNext(token);) {
+              gltfString extension = nomString(token);
+              info.instancedNodeCount += STR_EQ(extension, "EXT_mesh_gpu_instancing");
+              nomValue(token);
+            }
+          } else { nomValue(token); }
         }
       }
 
     } else if (STR_EQ(key, "scene")) {
-      rootScene = NOM_INT(json, token);
+      rootScene = nomInt(token);
 
     } else if (STR_EQ(key, "scenes")) {
-      info.scenes = token;
-      info.sceneCount = token->size;
-      scenes = malloc(info.sceneCount * sizeof(gltfScene));
+      info.scenes = *token;
+      gltfCursor t = *token;
+      info.sceneCount = nomValue(&t);
+      scenes = calloc(info.sceneCount, sizeof(gltfScene));
       lovrAssert(scenes, "Out of memory");
       gltfScene* scene = scenes;
-      for (int i = (token++)->size; i > 0; i--, scene++) {
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
+      for (nomOpen(token); nomNext(token); scene++) {
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
           if (STR_EQ(key, "nodes")) {
-            scene->nodeCount = token->size;
-            jsmntok_t* t = token + 1;
-            scene->node = NOM_INT(json, t);
+            for (nomOpen(token); nomNext(token); scene->nodeCount++) {
+              uint32_t node = nomInt(token);
+              if (scene->nodeCount == 0) {
+                scene->node = node;
+              }
+            }
+          } else {
+            nomValue(token);
           }
-          token += NOM_VALUE(json, token);
         }
       }
 
     } else if (STR_EQ(key, "skins")) {
-      info.skins = token;
-      model->skinCount = token->size;
-      for (int i = (token++)->size; i > 0; i--) {
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
-          if (STR_EQ(key, "joints")) { model->jointCount += token->size; }
-          token += NOM_VALUE(json, token);
+      info.skins = *token;
+      for (nomOpen(token); nomNext(token); model->skinCount++) {
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
+          if (STR_EQ(key, "joints")) { model->jointCount += nomValue(token); }
+          else { nomValue(token); }
         }
       }
 
     } else {
-      token += NOM_VALUE(json, token);
+      nomValue(token);
     }
   }
 
@@ -460,27 +916,59 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     model->nodeCount++;
   }
 
-  // Allocate memory, then revisit all of the tokens that were recorded during the prepass and write
-  // their data into this memory.
+  // Keyframes stored as normalized integers are converted to floats, and instance transforms are
+  // baked to matrices, each into an extra Blob after the ones for the buffers
+  uint32_t keyframeBlob = ~0u;
+  uint32_t instanceBlob = ~0u;
+  if (model->animationCount > 0) {
+    keyframeBlob = model->blobCount++;
+  }
+  if (info.instancedNodeCount > 0) {
+    instanceBlob = model->blobCount++;
+  }
+
+  // Allocate memory, then revisit all of the sections that were recorded during the prepass and
+  // write their data into this memory.
   lovrModelDataAllocate(model);
 
   // Blobs
-  if (model->blobCount > 0) {
-    jsmntok_t* token = info.buffers;
+  if (info.buffers.data) {
+    gltfCursor* token = &info.buffers;
     Blob** blob = model->blobs;
-    for (int i = (token++)->size; i > 0; i--, blob++) {
+    for (nomOpen(token); nomNext(token); blob++) {
       gltfString uri;
       memset(&uri, 0, sizeof(uri));
       size_t size = 0;
-
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
-        if (STR_EQ(key, "byteLength")) { size = NOM_INT(json, token); }
-        else if (STR_EQ(key, "uri")) { uri = NOM_STR(json, token); }
-        else { token += NOM_VALUE(json, token); }
+      bool fallback = false;
+
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
+        if (STR_EQ(key, "byteLength")) { size = nomInt(token); }
+        else if (STR_EQ(key, "uri")) { uri = nomString(token); }
+        else if (STR_EQ(key, "extensions")) {
+          for (nomOpen(token); nomNext(token);) {
+            gltfString extension = nomString(token);
+            if (STR_EQ(extension, "EXT_meshopt_compression") && nomPeek(token) == '{') {
+              for (nomOpen(token); nomNext(token);) {
+                gltfString field = nomString(token);
+                if (STR_EQ(field, "fallback")) { fallback = nomBool(token); }
+                else { nomValue(token); }
+              }
+            } else {
+              nomValue(token);
+            }
+          }
+        } else {
+          nomValue(token);
+        }
       }
 
-      if (uri.data) {
+      // Fallback buffers are never read, compressed buffer views are decoded into them instead
+      if (fallback) {
+        void* bufferData = calloc(1, size);
+        lovrAssert(bufferData, "Out of memory");
+        *blob = lovrBlobCreate(bufferData, size, NULL);
+      } else if (uri.data) {
         size_t bytesRead;
         if (uri.length >= 5 && !strncmp("data:", uri.data, 5)) {
           void* bufferData = decodeBase64(uri.data, uri.length, size);
@@ -503,17 +991,28 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
   // Buffers
   if (model->bufferCount > 0) {
-    jsmntok_t* token = info.bufferViews;
+    gltfCursor* token = &info.bufferViews;
     ModelBuffer* buffer = model->buffers;
-    for (int i = (token++)->size; i > 0; i--, buffer++) {
+    for (nomOpen(token); nomNext(token); buffer++) {
       size_t offset = 0;
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
-        if (STR_EQ(key, "buffer")) { buffer->data = model->blobs[NOM_INT(json, token)]->data; }
-        else if (STR_EQ(key, "byteOffset")) { offset = NOM_INT(json, token); }
-        else if (STR_EQ(key, "byteLength")) { buffer->size = NOM_INT(json, token); }
-        else if (STR_EQ(key, "byteStride")) { buffer->stride = NOM_INT(json, token); }
-        else { token += NOM_VALUE(json, token); }
+      gltfCursor compression = { NULL, NULL };
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
+        if (STR_EQ(key, "buffer")) { buffer->data = model->blobs[nomInt(token)]->data; }
+        else if (STR_EQ(key, "byteOffset")) { offset = nomInt(token); }
+        else if (STR_EQ(key, "byteLength")) { buffer->size = nomInt(token); }
+        else if (STR_EQ(key, "byteStride")) { buffer->stride = nomInt(token); }
+        else if (STR_EQ(key, "extensions")) {
+          for (nomOpen(token); nomNext(token);) {
+            gltfString extension = nomString(token);
+            if (STR_EQ(extension, "EXT_meshopt_compression")) {
+              compression = *token;
+            }
+            nomValue(token);
+          }
+        } else {
+          nomValue(token);
+        }
       }
 
       // If this is the glb binary data, increment the offset to account for the file header
@@ -522,22 +1021,26 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
       }
 
       buffer->data = (char*) buffer->data + offset;
+
+      if (compression.data) {
+        decodeBufferView(model, buffer, &compression, source, glb ? binOffset : 0);
+      }
     }
   }
 
   // Attributes
   if (model->attributeCount > 0) {
-    jsmntok_t* token = info.attributes;
+    gltfCursor* token = &info.attributes;
     ModelAttribute* attribute = model->attributes;
-    for (int i = (token++)->size; i > 0; i--, attribute++) {
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
-        if (STR_EQ(key, "bufferView")) { attribute->buffer = NOM_INT(json, token); }
-        else if (STR_EQ(key, "count")) { attribute->count = NOM_INT(json, token); }
-        else if (STR_EQ(key, "byteOffset")) { attribute->offset = NOM_INT(json, token); }
-        else if (STR_EQ(key, "normalized")) { attribute->normalized = NOM_BOOL(json, token); }
+    for (nomOpen(token); nomNext(token); attribute++) {
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
+        if (STR_EQ(key, "bufferView")) { attribute->buffer = nomInt(token); }
+        else if (STR_EQ(key, "count")) { attribute->count = nomInt(token); }
+        else if (STR_EQ(key, "byteOffset")) { attribute->offset = nomInt(token); }
+        else if (STR_EQ(key, "normalized")) { attribute->normalized = nomBool(token); }
         else if (STR_EQ(key, "componentType")) {
-          switch (NOM_INT(json, token)) {
+          switch (nomInt(token)) {
             case 5120: attribute->type = I8; break;
             case 5121: attribute->type = U8; break;
             case 5122: attribute->type = I16; break;
@@ -547,27 +1050,35 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
             default: break;
           }
         } else if (STR_EQ(key, "type")) {
-          gltfString type = NOM_STR(json, token);
+          gltfString type = nomString(token);
           if (STR_EQ(type, "SCALAR")) {
             attribute->components = 1;
           } else if (type.length == 4) {
             attribute->components = type.data[3] - '0';
             attribute->matrix = type.data[0] == 'M';
           }
-        } else if (STR_EQ(key, "min") && token->size <= 4) {
-          int count = (token++)->size;
-          attribute->hasMin = true;
-          for (int j = 0; j < count; j++) {
-            attribute->min[j] = NOM_FLOAT(json, token);
-          }
-        } else if (STR_EQ(key, "max") && token->size <= 4) {
-          int count = (token++)->size;
-          attribute->hasMax = true;
-          for (int j = 0; j < count; j++) {
-            attribute->max[j] = NOM_FLOAT(json, token);
-          }
+        } else if (STR_EQ(key, "min")) {
+          attribute->hasMin = nomFloats(token, attribute->min, 4) <= 4;
+        } else if (STR_EQ(key, "max")) {
+          attribute->hasMax = nomFloats(token, attribute->max, 4) <= 4;
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
+        }
+      }
+
+      // Bounds of normalized (e.g. KHR_mesh_quantization) accessors are stored unnormalized
+      if (attribute->normalized && attribute->type != F32) {
+        float scale = 1.f;
+        switch (attribute->type) {
+          case I8: scale = 1.f / 127.f; break;
+          case U8: scale = 1.f / 255.f; break;
+          case I16: scale = 1.f / 32767.f; break;
+          case U16: scale = 1.f / 65535.f; break;
+          default: break;
+        }
+        for (uint32_t i = 0; i < 4; i++) {
+          attribute->min[i] = MAX(attribute->min[i] * scale, -1.f);
+          attribute->max[i] = MAX(attribute->max[i] * scale, -1.f);
         }
       }
     }
@@ -575,47 +1086,67 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
   // Animations
   if (model->animationCount > 0) {
+    size_t keyframeCount = 0;
+    for (uint32_t i = 0; i < animationSamplerCount; i++) {
+      ModelAttribute* output = &model->attributes[animationSamplers[i].output];
+      keyframeCount += output->type == F32 ? 0 : output->count * output->components;
+    }
+
+    float* keyframes = malloc(keyframeCount * sizeof(float));
+    lovrAssert(keyframes || keyframeCount == 0, "Out of memory");
+    model->blobs[keyframeBlob] = lovrBlobCreate(keyframes, keyframeCount * sizeof(float), "glTF keyframes");
+
+    for (uint32_t i = 0; i < animationSamplerCount; i++) {
+      ModelAttribute* output = &model->attributes[animationSamplers[i].output];
+      if (output->type != F32) {
+        lovrAssert(output->normalized && output->type != I32 && output->type != U32, "Keyframe data must be floats or normalized integers");
+        animationSamplers[i].data = keyframes;
+        for (uint32_t j = 0; j < output->count; j++, keyframes += output->components) {
+          readAttribute(model, output, j, keyframes);
+        }
+      }
+    }
+
     int channelIndex = 0;
     int baseSampler = 0;
-    jsmntok_t* token = info.animations;
+    gltfCursor* token = &info.animations;
     ModelAnimation* animation = model->animations;
-    for (int i = (token++)->size; i > 0; i--, animation++) {
+    for (nomOpen(token); nomNext(token); animation++) {
       int samplerCount = 0;
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "channels")) {
-          animation->channelCount = (token++)->size;
           animation->channels = model->channels + channelIndex;
-          channelIndex += animation->channelCount;
-          for (uint32_t j = 0; j < animation->channelCount; j++) {
-            ModelAnimationChannel* channel = &animation->channels[j];
+          for (nomOpen(token); nomNext(token); animation->channelCount++) {
+            ModelAnimationChannel* channel = &animation->channels[animation->channelCount];
+            gltfAnimationSampler* sampler = NULL;
             ModelAttribute* times = NULL;
             ModelAttribute* data = NULL;
 
-            for (int kk = (token++)->size; kk > 0; kk--) {
-              gltfString key = NOM_STR(json, token);
+            for (nomOpen(token); nomNext(token);) {
+              gltfString key = nomString(token);
               if (STR_EQ(key, "sampler")) {
-                gltfAnimationSampler* sampler = animationSamplers + baseSampler + NOM_INT(json, token);
+                sampler = animationSamplers + baseSampler + nomInt(token);
                 times = &model->attributes[sampler->input];
                 data = &model->attributes[sampler->output];
                 channel->smoothing = sampler->smoothing;
                 channel->keyframeCount = times->count;
               } else if (STR_EQ(key, "target")) {
-                for (int kkk = (token++)->size; kkk > 0; kkk--) {
-                  gltfString key = NOM_STR(json, token);
-                  if (STR_EQ(key, "node")) { channel->nodeIndex = NOM_INT(json, token); }
+                for (nomOpen(token); nomNext(token);) {
+                  gltfString key = nomString(token);
+                  if (STR_EQ(key, "node")) { channel->nodeIndex = nomInt(token); }
                   else if (STR_EQ(key, "path")) {
-                    gltfString property = NOM_STR(json, token);
+                    gltfString property = nomString(token);
                     if (STR_EQ(property, "translation")) { channel->property = PROP_TRANSLATION; }
                     else if (STR_EQ(property, "rotation")) { channel->property = PROP_ROTATION; }
                     else if (STR_EQ(property, "scale")) { channel->property = PROP_SCALE; }
                     else { lovrThrow("Unknown animation channel property"); }
                   } else {
-                    token += NOM_VALUE(json, token);
+                    nomValue(token);
                   }
                 }
               } else {
-                token += NOM_VALUE(json, token);
+                nomValue(token);
               }
             }
 
@@ -629,55 +1160,66 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
             buffer = &model->buffers[data->buffer];
             uint8_t components = data->components;
-            lovrAssert(data->type == F32 && (buffer->stride == 0 || buffer->stride == sizeof(float) * components), "Keyframe data must be tightly-packed floats");
-            channel->data = (float*) (buffer->data + data->offset);
+            if (sampler->data) {
+              channel->data = sampler->data;
+            } else {
+              lovrAssert(buffer->stride == 0 || buffer->stride == sizeof(float) * components, "Keyframe data must be tightly-packed floats");
+              channel->data = (float*) (buffer->data + data->offset);
+            }
 
             animation->duration = MAX(animation->duration, channel->times[channel->keyframeCount - 1]);
           }
+          channelIndex += animation->channelCount;
         } else if (STR_EQ(key, "samplers")) {
-          samplerCount = token->size;
-          token += NOM_VALUE(json, token);
+          samplerCount = nomValue(token);
         } else if (STR_EQ(key, "name")) {
-          gltfString name = NOM_STR(json, token);
-          map_set(&model->animationMap, hash64(name.data, name.length), model->animationCount - i);
+          gltfString name = nomString(token);
+          map_set(&model->animationMap, hash64(name.data, name.length), animation - model->animations);
           memcpy(model->chars, name.data, name.length);
           animation->name = model->chars;
           model->chars += name.length + 1;
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
         }
       }
       baseSampler += samplerCount;
     }
   }
 
-  // Textures (glTF images)
+  // Images are only read here, lovrModelDataInit decodes them
   if (model->textureCount > 0) {
-    jsmntok_t* token = info.images;
-    TextureData** texture = model->textures;
-    for (int i = (token++)->size; i > 0; i--, texture++) {
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+    gltfCursor* token = &info.images;
+    ModelImage* image = model->images;
+    for (nomOpen(token); nomNext(token); image++) {
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "bufferView")) {
-          ModelBuffer* buffer = &model->buffers[NOM_INT(json, token)];
-          Blob* blob = lovrBlobCreate(buffer->data, buffer->size, NULL);
-          *texture = lovrTextureDataCreateFromBlob(blob, false);
-          blob->data = NULL; // XXX Blob data ownership
-          lovrRelease(Blob, blob);
+          ModelBuffer* buffer = &model->buffers[nomInt(token)];
+          for (uint32_t i = 0; i < model->blobCount; i++) {
+            Blob* blob = model->blobs[i];
+            if ((char*) buffer->data >= (char*) blob->data && (char*) buffer->data < (char*) blob->data + blob->size) {
+              image->blob = blob;
+              break;
+            }
+          }
+          lovrAssert(image->blob, "Image buffer view is not part of a buffer");
+          lovrRetain(image->blob);
+          image->data = buffer->data;
+          image->size = buffer->size;
         } else if (STR_EQ(key, "uri")) {
           size_t size = 0;
-          gltfString uri = NOM_STR(json, token);
+          gltfString uri = nomString(token);
           lovrAssert(uri.length < 5 || strncmp("data:", uri.data, 5), "Base64 images aren't supported yet");
           lovrAssert(uri.length < maxPathLength, "Image filename is too long");
           strncat(filename, uri.data, uri.length);
           void* data = io(filename, &size);
           lovrAssert(data && size > 0, "Unable to read texture from '%s'", filename);
-          Blob* blob = lovrBlobCreate(data, size, NULL);
-          *texture = lovrTextureDataCreateFromBlob(blob, false);
-          lovrRelease(Blob, blob);
+          image->blob = lovrBlobCreate(data, size, NULL);
+          image->data = data;
+          image->size = size;
           *root = '\0';
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
         }
       }
     }
@@ -685,60 +1227,53 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
   // Materials
   if (model->materialCount > 0) {
-    jsmntok_t* token = info.materials;
+    gltfCursor* token = &info.materials;
     ModelMaterial* material = model->materials;
-    for (int i = (token++)->size; i > 0; i--, material++) {
+    for (nomOpen(token); nomNext(token); material++) {
       material->scalars[SCALAR_METALNESS] = 1.f;
       material->scalars[SCALAR_ROUGHNESS] = 1.f;
       material->colors[COLOR_DIFFUSE] = (Color) { 1.f, 1.f, 1.f, 1.f };
       material->colors[COLOR_EMISSIVE] = (Color) { 0.f, 0.f, 0.f, 0.f };
       memset(material->textures, 0xff, MAX_MATERIAL_TEXTURES * sizeof(uint32_t));
 
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "pbrMetallicRoughness")) {
-          for (int j = (token++)->size; j > 0; j--) {
-            gltfString key = NOM_STR(json, token);
+          for (nomOpen(token); nomNext(token);) {
+            gltfString key = nomString(token);
             if (STR_EQ(key, "baseColorFactor")) {
-              token++; // Enter array
-              material->colors[COLOR_DIFFUSE].r = NOM_FLOAT(json, token);
-              material->colors[COLOR_DIFFUSE].g = NOM_FLOAT(json, token);
-              material->colors[COLOR_DIFFUSE].b = NOM_FLOAT(json, token);
-              material->colors[COLOR_DIFFUSE].a = NOM_FLOAT(json, token);
+              nomFloats(token, &material->colors[COLOR_DIFFUSE].r, 4);
             } else if (STR_EQ(key, "baseColorTexture")) {
-              token = resolveTexture(json, token, material, TEXTURE_DIFFUSE, textures, samplers);
+              resolveTexture(token, material, TEXTURE_DIFFUSE, textures, samplers);
             } else if (STR_EQ(key, "metallicFactor")) {
-              material->scalars[SCALAR_METALNESS] = NOM_FLOAT(json, token);
+              material->scalars[SCALAR_METALNESS] = nomFloat(token);
             } else if (STR_EQ(key, "roughnessFactor")) {
-              material->scalars[SCALAR_ROUGHNESS] = NOM_FLOAT(json, token);
+              material->scalars[SCALAR_ROUGHNESS] = nomFloat(token);
             } else if (STR_EQ(key, "metallicRoughnessTexture")) {
-              token = resolveTexture(json, token, material, TEXTURE_METALNESS, textures, samplers);
+              resolveTexture(token, material, TEXTURE_METALNESS, textures, samplers);
               material->textures[TEXTURE_ROUGHNESS] = material->textures[TEXTURE_METALNESS];
               material->filters[TEXTURE_ROUGHNESS] = material->filters[TEXTURE_METALNESS];
               material->wraps[TEXTURE_ROUGHNESS] = material->wraps[TEXTURE_METALNESS];
             } else {
-              token += NOM_VALUE(json, token);
+              nomValue(token);
             }
           }
         } else if (STR_EQ(key, "normalTexture")) {
-          token = resolveTexture(json, token, material, TEXTURE_NORMAL, textures, samplers);
+          resolveTexture(token, material, TEXTURE_NORMAL, textures, samplers);
         } else if (STR_EQ(key, "occlusionTexture")) {
-          token = resolveTexture(json, token, material, TEXTURE_OCCLUSION, textures, samplers);
+          resolveTexture(token, material, TEXTURE_OCCLUSION, textures, samplers);
         } else if (STR_EQ(key, "emissiveTexture")) {
-          token = resolveTexture(json, token, material, TEXTURE_EMISSIVE, textures, samplers);
+          resolveTexture(token, material, TEXTURE_EMISSIVE, textures, samplers);
         } else if (STR_EQ(key, "emissiveFactor")) {
-          token++; // Enter array
-          material->colors[COLOR_EMISSIVE].r = NOM_FLOAT(json, token);
-          material->colors[COLOR_EMISSIVE].g = NOM_FLOAT(json, token);
-          material->colors[COLOR_EMISSIVE].b = NOM_FLOAT(json, token);
+          nomFloats(token, &material->colors[COLOR_EMISSIVE].r, 3);
         } else if (STR_EQ(key, "name")) {
-          gltfString name = NOM_STR(json, token);
-          map_set(&model->materialMap, hash64(name.data, name.length), model->materialCount - i);
+          gltfString name = nomString(token);
+          map_set(&model->materialMap, hash64(name.data, name.length), material - model->materials);
           memcpy(model->chars, name.data, name.length);
           material->name = model->chars;
           model->chars += name.length + 1;
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
         }
       }
     }
@@ -746,25 +1281,25 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
   // Primitives
   if (model->primitiveCount > 0) {
-    jsmntok_t* token = info.meshes;
+    gltfCursor* token = &info.meshes;
     ModelPrimitive* primitive = model->primitives;
-    for (int i = (token++)->size; i > 0; i--) {
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+    for (nomOpen(token); nomNext(token);) {
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "primitives")) {
-          for (uint32_t j = (token++)->size; j > 0; j--, primitive++) {
+          for (nomOpen(token); nomNext(token); primitive++) {
             primitive->mode = DRAW_TRIANGLES;
             primitive->material = ~0u;
 
-            for (int kk = (token++)->size; kk > 0; kk--) {
-              gltfString key = NOM_STR(json, token);
+            for (nomOpen(token); nomNext(token);) {
+              gltfString key = nomString(token);
               if (STR_EQ(key, "material")) {
-                primitive->material = NOM_INT(json, token);
+                primitive->material = nomInt(token);
               } else if (STR_EQ(key, "indices")) {
-                primitive->indices = &model->attributes[NOM_INT(json, token)];
+                primitive->indices = &model->attributes[nomInt(token)];
                 lovrAssert(primitive->indices->type != U8, "Unsigned byte indices are not supported (must be unsigned shorts or unsigned ints)");
               } else if (STR_EQ(key, "mode")) {
-                switch (NOM_INT(json, token)) {
+                switch (nomInt(token)) {
                   case 0: primitive->mode = DRAW_POINTS; break;
                   case 1: primitive->mode = DRAW_LINES; break;
                   case 2: primitive->mode = DRAW_LINE_LOOP; break;
@@ -775,11 +1310,10 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
                   default: lovrThrow("Unknown primitive mode");
                 }
               } else if (STR_EQ(key, "attributes")) {
-                int attributeCount = (token++)->size;
-                for (int a = 0; a < attributeCount; a++) {
+                for (nomOpen(token); nomNext(token);) {
                   DefaultAttribute attributeType = ~0;
-                  gltfString name = NOM_STR(json, token);
-                  uint32_t attributeIndex = NOM_INT(json, token);
+                  gltfString name = nomString(token);
+                  uint32_t attributeIndex = nomInt(token);
                   if (STR_EQ(name, "POSITION")) { attributeType = ATTR_POSITION; }
                   else if (STR_EQ(name, "NORMAL")) { attributeType = ATTR_NORMAL; }
                   else if (STR_EQ(name, "TEXCOORD_0")) { attributeType = ATTR_TEXCOORD; }
@@ -792,12 +1326,12 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
                   }
                 }
               } else {
-                token += NOM_VALUE(json, token);
+                nomValue(token);
               }
             }
           }
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
         }
       }
     }
@@ -805,86 +1339,174 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
 
   // Nodes
   uint32_t childIndex = 0;
+  ModelAttribute* (*instancing)[3] = NULL;
   if (model->nodeCount > 0) {
-    jsmntok_t* token = info.nodes;
+    gltfCursor* token = &info.nodes;
     ModelNode* node = model->nodes;
-    for (int i = (token++)->size; i > 0; i--, node++) {
+    if (info.instancedNodeCount > 0) {
+      instancing = calloc(model->nodeCount, sizeof(*instancing));
+      lovrAssert(instancing, "Out of memory");
+    }
+
+    for (nomOpen(token); nomNext(token); node++) {
       vec3 translation = vec3_set(node->transform.properties.translation, 0.f, 0.f, 0.f);
       quat rotation = quat_set(node->transform.properties.rotation, 0.f, 0.f, 0.f, 1.f);
       vec3 scale = vec3_set(node->transform.properties.scale, 1.f, 1.f, 1.f);
       node->matrix = false;
       node->primitiveCount = 0;
       node->skin = ~0u;
+      bool hasCoverage = false;
 
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "mesh")) {
-          gltfMesh* mesh = &meshes[NOM_INT(json, token)];
+          gltfMesh* mesh = &meshes[nomInt(token)];
           node->primitiveIndex = mesh->primitiveIndex;
           node->primitiveCount = mesh->primitiveCount;
         } else if (STR_EQ(key, "skin")) {
-          node->skin = NOM_INT(json, token);
+          node->skin = nomInt(token);
         } else if (STR_EQ(key, "children")) {
           node->children = &model->children[childIndex];
-          node->childCount = (token++)->size;
-          for (uint32_t j = 0; j < node->childCount; j++) {
-            model->children[childIndex++] = NOM_INT(json, token);
+          for (nomOpen(token); nomNext(token); node->childCount++) {
+            model->children[childIndex++] = nomInt(token);
           }
         } else if (STR_EQ(key, "matrix")) {
-          lovrAssert((token++)->size == 16, "Node matrix needs 16 elements");
+          lovrAssert(nomFloats(token, node->transform.matrix, 16) == 16, "Node matrix needs 16 elements");
           node->matrix = true;
-          for (int j = 0; j < 16; j++) {
-            node->transform.matrix[j] = NOM_FLOAT(json, token);
-          }
         } else if (STR_EQ(key, "translation")) {
-          lovrAssert((token++)->size == 3, "Node translation needs 3 elements");
-          translation[0] = NOM_FLOAT(json, token);
-          translation[1] = NOM_FLOAT(json, token);
-          translation[2] = NOM_FLOAT(json, token);
+          lovrAssert(nomFloats(token, translation, 3) == 3, "Node translation needs 3 elements");
         } else if (STR_EQ(key, "rotation")) {
-          lovrAssert((token++)->size == 4, "Node rotation needs 4 elements");
-          rotation[0] = NOM_FLOAT(json, token);
-          rotation[1] = NOM_FLOAT(json, token);
-          rotation[2] = NOM_FLOAT(json, token);
-          rotation[3] = NOM_FLOAT(json, token);
+          lovrAssert(nomFloats(token, rotation, 4) == 4, "Node rotation needs 4 elements");
         } else if (STR_EQ(key, "scale")) {
-          lovrAssert((token++)->size == 3, "Node scale needs 3 elements");
-          scale[0] = NOM_FLOAT(json, token);
-          scale[1] = NOM_FLOAT(json, token);
-          scale[2] = NOM_FLOAT(json, token);
+          lovrAssert(nomFloats(token, scale, 3) == 3, "Node scale needs 3 elements");
         } else if (STR_EQ(key, "name")) {
-          gltfString name = NOM_STR(json, token);
-          map_set(&model->nodeMap, hash64(name.data, name.length), model->nodeCount - i);
+          gltfString name = nomString(token);
+          map_set(&model->nodeMap, hash64(name.data, name.length), node - model->nodes);
           memcpy(model->chars, name.data, name.length);
           node->name = model->chars;
           model->chars += name.length + 1;
+        } else if (STR_EQ(key, "extensions")) {
+          for (nomOpen(token); nomNext(token);) {
+            gltfString extension = nomString(token);
+            if (STR_EQ(extension, "MSFT_lod") && nomPeek(token) == '{') {
+              for (nomOpen(token); nomNext(token);) {
+                gltfString field = nomString(token);
+                if (STR_EQ(field, "ids")) {
+                  uint32_t count = 0;
+                  for (nomOpen(token); nomNext(token); count++) {
+                    uint32_t id = nomInt(token);
+                    lovrAssert(id < model->nodeCount, "MSFT_lod references a node that doesn't exist");
+                    if (count < MAX_LODS - 1) {
+                      node->lodNodes[count] = id;
+                    }
+                  }
+                  node->lodCount = MIN(count, MAX_LODS - 1);
+                } else {
+                  nomValue(token);
+                }
+              }
+            } else if (STR_EQ(extension, "EXT_mesh_gpu_instancing") && nomPeek(token) == '{') {
+              ModelAttribute** attributes = instancing[node - model->nodes];
+              for (nomOpen(token); nomNext(token);) {
+                gltfString field = nomString(token);
+                if (STR_EQ(field, "attributes")) {
+                  for (nomOpen(token); nomNext(token);) {
+                    gltfString name = nomString(token);
+                    ModelAttribute* attribute = &model->attributes[nomInt(token)];
+                    if (STR_EQ(name, "TRANSLATION")) { attributes[0] = attribute; }
+                    else if (STR_EQ(name, "ROTATION")) { attributes[1] = attribute; }
+                    else if (STR_EQ(name, "SCALE")) { attributes[2] = attribute; }
+                  }
+                } else {
+                  nomValue(token);
+                }
+              }
+            } else {
+              nomValue(token);
+            }
+          }
+        } else if (STR_EQ(key, "extras") && nomPeek(token) == '{') {
+          for (nomOpen(token); nomNext(token);) {
+            gltfString extra = nomString(token);
+            if (STR_EQ(extra, "MSFT_screencoverage") && nomPeek(token) == '[') {
+              hasCoverage = nomFloats(token, node->lodCoverage, MAX_LODS) > 0;
+            } else {
+              nomValue(token);
+            }
+          }
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
+        }
+      }
+
+      // MSFT_screencoverage has a value per level (LOD 0 is used while coverage stays above the
+      // first one), and an optional last value below which the node isn't drawn at all
+      if (node->lodCount > 0 && !hasCoverage) {
+        for (uint32_t j = 0; j < node->lodCount; j++) {
+          node->lodCoverage[j] = DEFAULT_LOD_COVERAGE / (1 << j);
         }
+        node->lodCoverage[node->lodCount] = 0.f;
+      }
+    }
+  }
+
+  // EXT_mesh_gpu_instancing, each instance is drawn with the node's transform times its own
+  if (instancing) {
+    size_t instanceCount = 0;
+    for (uint32_t i = 0; i < model->nodeCount; i++) {
+      ModelAttribute** attributes = instancing[i];
+      ModelAttribute* first = attributes[0] ? attributes[0] : (attributes[1] ? attributes[1] : attributes[2]);
+      for (uint32_t j = 0; j < 3; j++) {
+        lovrAssert(!attributes[j] || attributes[j]->count == first->count, "Instance attributes of a node must have the same count");
+      }
+      model->nodes[i].instanceCount = first ? first->count : 0;
+      instanceCount += model->nodes[i].instanceCount;
+    }
+
+    float* instances = malloc(instanceCount * 16 * sizeof(float));
+    lovrAssert(instances || instanceCount == 0, "Out of memory");
+    model->blobs[instanceBlob] = lovrBlobCreate(instances, instanceCount * 16 * sizeof(float), "glTF instances");
+
+    for (uint32_t i = 0; i < model->nodeCount; i++) {
+      ModelNode* node = &model->nodes[i];
+      ModelAttribute** attributes = instancing[i];
+      node->instances = node->instanceCount > 0 ? instances : NULL;
+      for (uint32_t j = 0; j < node->instanceCount; j++, instances += 16) {
+        float translation[4] = { 0.f, 0.f, 0.f, 0.f };
+        float rotation[4] = { 0.f, 0.f, 0.f, 1.f };
+        float scale[4] = { 1.f, 1.f, 1.f, 1.f };
+        if (attributes[0]) readAttribute(model, attributes[0], j, translation);
+        if (attributes[1]) readAttribute(model, attributes[1], j, rotation);
+        if (attributes[2]) readAttribute(model, attributes[2], j, scale);
+        mat4_identity(instances);
+        mat4_translate(instances, translation[0], translation[1], translation[2]);
+        mat4_rotateQuat(instances, quat_normalize(rotation));
+        mat4_scale(instances, scale[0], scale[1], scale[2]);
       }
     }
+
+    free(instancing);
   }
 
   // Skins
   if (model->skinCount > 0) {
     int jointIndex = 0;
-    jsmntok_t* token = info.skins;
+    gltfCursor* token = &info.skins;
     ModelSkin* skin = model->skins;
-    for (int i = (token++)->size; i > 0; i--, skin++) {
-      for (int k = (token++)->size; k > 0; k--) {
-        gltfString key = NOM_STR(json, token);
+    for (nomOpen(token); nomNext(token); skin++) {
+      for (nomOpen(token); nomNext(token);) {
+        gltfString key = nomString(token);
         if (STR_EQ(key, "inverseBindMatrices")) {
-          ModelAttribute* attribute = &model->attributes[NOM_INT(json, token)];
+          ModelAttribute* attribute = &model->attributes[nomInt(token)];
           ModelBuffer* buffer = &model->buffers[attribute->buffer];
           skin->inverseBindMatrices = (float*) ((uint8_t*) buffer->data + attribute->offset);
         } else if (STR_EQ(key, "joints")) {
           skin->joints = &model->joints[jointIndex];
-          skin->jointCount = (token++)->size;
-          for (uint32_t j = 0; j < skin->jointCount; j++) {
-            model->joints[jointIndex++] = NOM_INT(json, token);
+          for (nomOpen(token); nomNext(token); skin->jointCount++) {
+            model->joints[jointIndex++] = nomInt(token);
           }
         } else {
-          token += NOM_VALUE(json, token);
+          nomValue(token);
         }
       }
     }
@@ -903,22 +1525,23 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     lastNode->primitiveCount = 0;
     lastNode->skin = ~0u;
 
-    jsmntok_t* token = info.scenes;
-    int sceneCount = (token++)->size;
-    for (int i = 0; i < sceneCount; i++) {
+    gltfCursor* token = &info.scenes;
+    int i = 0;
+    for (nomOpen(token); nomNext(token); i++) {
       if (i == rootScene) {
-        for (int k = (token++)->size; k > 0; k--) {
-          gltfString key = NOM_STR(json, token);
+        for (nomOpen(token); nomNext(token);) {
+          gltfString key = nomString(token);
           if (STR_EQ(key, "nodes")) {
-            for (int j = (token++)->size; j > 0; j--) {
-              lastNode->children[lastNode->childCount - j] = NOM_INT(json, token);
+            uint32_t j = 0;
+            for (nomOpen(token); nomNext(token); j++) {
+              lastNode->children[j] = nomInt(token);
             }
           } else {
-            token += NOM_VALUE(json, token);
+            nomValue(token);
           }
         }
       } else {
-        token += NOM_VALUE(json, token);
+        nomValue(token);
       }
     }
   } else {
@@ -930,6 +1553,5 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
   free(samplers);
   free(textures);
   free(scenes);
-  free(heapTokens);
   return model;
 }
@@ -1,6 +1,5 @@
 #include "data/modelData.h"
 #include "data/blob.h"
-#include "data/textureData.h"
 #include "core/arr.h"
 #include "core/hash.h"
 #include "core/maf.h"
@@ -9,6 +8,10 @@
 #include "core/util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
 #include <float.h>
 #include <ctype.h>
 
@@ -19,12 +22,12 @@ typedef struct {
 } objGroup;
 
 typedef arr_t(ModelMaterial) arr_material_t;
-typedef arr_t(TextureData*) arr_texturedata_t;
+typedef arr_t(ModelImage) arr_image_t;
 typedef arr_t(objGroup) arr_group_t;
 
 #define STARTS_WITH(a, b) !strncmp(a, b, strlen(b))
 
-static void parseMtl(char* path, ModelDataIO* io, arr_texturedata_t* textures, arr_material_t* materials, map_t* names, char* base) {
+static void parseMtl(char* path, ModelDataIO* io, arr_image_t* images, arr_material_t* materials, map_t* names, char* base) {
   size_t length = 0;
   char* data = io(path, &length);
   lovrAssert(data && length > 0, "Unable to read mtl from '%s'", path);
@@ -35,9 +38,9 @@ static void parseMtl(char* path, ModelDataIO* io, arr_texturedata_t* textures, a
 
     if (STARTS_WITH(s, "newmtl ")) {
       char name[128];
-      size_t length = sscanf(s + 7, "%s\n%n", name, &lineLength);
-      lovrAssert(length > 0, "Bad OBJ: Expected a material name");
-      map_set(names, hash64(name, length), materials->length);
+      bool hasName = sscanf(s + 7, "%127s\n%n", name, &lineLength);
+      lovrAssert(hasName, "Bad OBJ: Expected a material name");
+      map_set(names, hash64(name, strlen(name)), materials->length);
       arr_push(materials, ((ModelMaterial) {
         .scalars[SCALAR_METALNESS] = 1.f,
         .scalars[SCALAR_ROUGHNESS] = 1.f,
@@ -58,21 +61,20 @@ static void parseMtl(char* path, ModelDataIO* io, arr_texturedata_t* textures, a
       bool hasFilename = sscanf(s + 7, "%s\n%n", filename, &lineLength);
       lovrAssert(hasFilename, "Bad OBJ: Expected a texture filename");
       char path[1024];
-      snprintf(path, sizeof(path), "%s%s", base, filename);
+      int pathLength = snprintf(path, sizeof(path), "%s%s", base, filename);
+      lovrAssert(pathLength >= 0 && (size_t) pathLength < sizeof(path), "OBJ texture path is too long");
       size_t size = 0;
       void* data = io(path, &size);
       lovrAssert(data && size > 0, "Unable to read texture from %s", path);
       Blob* blob = lovrBlobCreate(data, size, NULL);
 
-      // Load texture, assign to material
-      TextureData* texture = lovrTextureDataCreateFromBlob(blob, true);
+      // Assign the texture to the material, the image is decoded later by lovrModelDataInit
       lovrAssert(materials->length > 0, "Tried to set a material property without declaring a material first");
       ModelMaterial* material = &materials->data[materials->length - 1];
-      material->textures[TEXTURE_DIFFUSE] = (uint32_t) textures->length;
+      material->textures[TEXTURE_DIFFUSE] = (uint32_t) images->length;
       material->filters[TEXTURE_DIFFUSE].mode = FILTER_TRILINEAR;
       material->wraps[TEXTURE_DIFFUSE] = (TextureWrap) { .s = WRAP_REPEAT, .t = WRAP_REPEAT };
-      arr_push(textures, texture);
-      lovrRelease(Blob, blob);
+      arr_push(images, ((ModelImage) { .blob = blob, .data = data, .size = size, .flip = true }));
     } else {
       char* newline = memchr(s, '\n', length);
       lineLength = newline - s + 1;
@@ -86,38 +88,308 @@ static void parseMtl(char* path, ModelDataIO* io, arr_texturedata_t* textures, a
   free(data);
 }
 
+#define MAX_OBJ_WORKERS 4
+#define MIN_OBJ_CHUNK_SIZE (1 << 20)
+
+// A face corner as v/vt/vn indices.  Negative OBJ indices are stored relative to the start of the
+// chunk they were parsed in, since the number of elements in earlier chunks isn't known yet.
+typedef struct {
+  int32_t index[3];
+  uint8_t relative;
+  uint8_t missing;
+} objCorner;
+
+// mtllib and usemtl lines, applied during the merge once all of the corners before them are added
+typedef struct {
+  const char* name;
+  size_t length;
+  size_t corner;
+  bool library;
+} objEvent;
+
+typedef struct {
+  const char* start;
+  const char* end;
+  arr_t(float) positions;
+  arr_t(float) normals;
+  arr_t(float) uvs;
+  arr_t(objCorner) corners;
+  arr_t(objEvent) events;
+  const char* error;
+} objChunk;
+
+static const char* skipSpace(const char* s, const char* end) {
+  while (s < end && (*s == ' ' || *s == '\t' || *s == '\r')) s++;
+  return s;
+}
+
+static const char* parseIndex(const char* s, const char* end, int64_t* value) {
+  bool negative = s < end && *s == '-';
+  s += negative;
+
+  if (s >= end || *s < '0' || *s > '9') {
+    return NULL;
+  }
+
+  int64_t n = 0;
+  for (; s < end && *s >= '0' && *s <= '9'; s++) {
+    n = MIN(n * 10 + (*s - '0'), INT32_MAX);
+  }
+
+  *value = negative ? -n : n;
+  return s;
+}
+
+// Parses v, v/vt, v//vn, or v/vt/vn
+static const char* parseCorner(const char* s, const char* end, objChunk* chunk, objCorner* corner) {
+  int64_t counts[3] = { chunk->positions.length / 3, chunk->uvs.length / 2, chunk->normals.length / 3 };
+  corner->relative = 0;
+  corner->missing = 0;
+
+  for (int i = 0; i < 3; i++) {
+    if (i > 0) {
+      if (s < end && *s == '/') {
+        s++;
+      } else {
+        corner->missing |= (7 << i) & 7;
+        break;
+      }
+    }
+
+    int64_t index;
+    const char* next = parseIndex(s, end, &index);
+
+    if (!next) {
+      if (i == 0) {
+        return NULL;
+      }
+
+      corner->missing |= 1 << i;
+      continue;
+    } else if (index == 0) {
+      return NULL;
+    }
+
+    if (index < 0) {
+      corner->index[i] = (int32_t) (counts[i] + index);
+      corner->relative |= 1 << i;
+    } else {
+      corner->index[i] = (int32_t) (index - 1);
+    }
+
+    s = next;
+  }
+
+  return s;
+}
+
+// Runs on worker threads, errors are recorded instead of thrown so the chunks can be cleaned up
+static void parseChunk(void* context, uint32_t index) {
+  objChunk* chunk = (objChunk*) context + index;
+  const char* s = chunk->start;
+  const char* end = chunk->end;
+
+  while (s < end && !chunk->error) {
+    const char* eol = memchr(s, '\n', end - s);
+    eol = eol ? eol : end;
+
+    const char* token = s = skipSpace(s, eol);
+    while (s < eol && *s != ' ' && *s != '\t' && *s != '\r') s++;
+    size_t length = s - token;
+
+    if (length == 1 && token[0] == 'v') {
+      float position[3];
+      for (int i = 0; i < 3 && s; i++) {
+        s = lovrModelDataParseFloat(skipSpace(s, eol), eol, &position[i]);
+      }
+
+      if (!s) {
+        chunk->error = "Bad OBJ: Expected 3 coordinates for vertex position";
+        break;
+      }
+
+      arr_append(&chunk->positions, position, 3);
+    } else if (length == 2 && token[0] == 'v' && token[1] == 'n') {
+      float normal[3];
+      for (int i = 0; i < 3 && s; i++) {
+        s = lovrModelDataParseFloat(skipSpace(s, eol), eol, &normal[i]);
+      }
+
+      if (!s) {
+        chunk->error = "Bad OBJ: Expected 3 coordinates for vertex normal";
+        break;
+      }
+
+      arr_append(&chunk->normals, normal, 3);
+    } else if (length == 2 && token[0] == 'v' && token[1] == 't') {
+      float uv[2] = { 0.f, 0.f };
+      s = lovrModelDataParseFloat(skipSpace(s, eol), eol, &uv[0]);
+
+      if (s && (s = skipSpace(s, eol)) < eol) {
+        s = lovrModelDataParseFloat(s, eol, &uv[1]);
+      }
+
+      if (!s) {
+        chunk->error = "Bad OBJ: Expected 2 coordinates for texture coordinate";
+        break;
+      }
+
+      arr_append(&chunk->uvs, uv, 2);
+    } else if (length == 1 && token[0] == 'f') {
+      objCorner first, previous, corner;
+      int count = 0;
+
+      // Polygons are triangulated as a fan around their first corner
+      for (s = skipSpace(s, eol); s < eol && *s != '#'; s = skipSpace(s, eol), count++) {
+        if ((s = parseCorner(s, eol, chunk, &corner)) == NULL) {
+          chunk->error = "Bad OBJ: Unknown face format";
+          break;
+        }
+
+        if (count == 0) {
+          first = corner;
+        } else if (count >= 2) {
+          arr_push(&chunk->corners, first);
+          arr_push(&chunk->corners, previous);
+          arr_push(&chunk->corners, corner);
+        }
+
+        previous = corner;
+      }
+
+      if (!chunk->error && count < 3) {
+        chunk->error = "Bad OBJ: Expected at least 3 vertices for face";
+      }
+    } else if (length == 6 && (!memcmp(token, "mtllib", 6) || !memcmp(token, "usemtl", 6))) {
+      const char* name = skipSpace(s, eol);
+      const char* nameEnd = eol;
+      while (nameEnd > name && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t' || nameEnd[-1] == '\r')) nameEnd--;
+      bool library = token[0] == 'm';
+
+      if (name == nameEnd) {
+        chunk->error = library ? "Bad OBJ: Expected filename after mtllib" : "Bad OBJ: Expected a valid material name";
+        break;
+      }
+
+      arr_push(&chunk->events, ((objEvent) {
+        .name = name,
+        .length = nameEnd - name,
+        .corner = chunk->corners.length,
+        .library = library
+      }));
+    }
+
+    s = eol < end ? eol + 1 : end;
+  }
+}
+
+static void freeChunks(objChunk* chunks, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    arr_free(&chunks[i].positions);
+    arr_free(&chunks[i].normals);
+    arr_free(&chunks[i].uvs);
+    arr_free(&chunks[i].corners);
+    arr_free(&chunks[i].events);
+  }
+}
+
 ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io) {
-  char* data = (char*) source->data;
+  const char* data = (const char*) source->data;
   size_t length = source->size;
 
   if (!memchr(data, '\n', length)) {
     return NULL;
   }
 
-  float min[4] = { FLT_MAX };
-  float max[4] = { FLT_MIN };
+  // Large files are split into line-aligned chunks that are tokenized in parallel
+  objChunk chunks[MAX_OBJ_WORKERS];
+  uint32_t chunkCount = 1;
+#ifdef LOVR_ENABLE_THREAD
+  chunkCount = (uint32_t) MAX(1, MIN(MAX_OBJ_WORKERS, length / MIN_OBJ_CHUNK_SIZE));
+#endif
+
+  const char* end = data + length;
+  const char* cursor = data;
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    const char* split = end;
+    if (i < chunkCount - 1 && cursor < end) {
+      const char* target = MAX(cursor, data + length * (i + 1) / chunkCount);
+      const char* newline = memchr(target, '\n', end - target);
+      split = newline ? newline + 1 : end;
+    }
+
+    chunks[i] = (objChunk) { .start = cursor, .end = split };
+    arr_init(&chunks[i].positions);
+    arr_init(&chunks[i].normals);
+    arr_init(&chunks[i].uvs);
+    arr_init(&chunks[i].corners);
+    arr_init(&chunks[i].events);
+    cursor = split;
+  }
+
+#ifdef LOVR_ENABLE_THREAD
+  lovrTaskParallel(parseChunk, chunks, chunkCount);
+#else
+  parseChunk(chunks, 0);
+#endif
+
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    if (chunks[i].error) {
+      const char* error = chunks[i].error;
+      freeChunks(chunks, chunkCount);
+      lovrThrow("%s", error);
+    }
+  }
+
+  // Gather the vertex data into the first chunk, remembering where each chunk's elements start so
+  // relative indices can be resolved
+  objChunk* merged = &chunks[0];
+  int64_t bases[MAX_OBJ_WORKERS][3] = { { 0 } };
+  for (uint32_t i = 1; i < chunkCount; i++) {
+    objChunk* chunk = &chunks[i];
+    bases[i][0] = merged->positions.length / 3;
+    bases[i][1] = merged->uvs.length / 2;
+    bases[i][2] = merged->normals.length / 3;
+    if (chunk->positions.length > 0) arr_append(&merged->positions, chunk->positions.data, chunk->positions.length);
+    if (chunk->normals.length > 0) arr_append(&merged->normals, chunk->normals.data, chunk->normals.length);
+    if (chunk->uvs.length > 0) arr_append(&merged->uvs, chunk->uvs.data, chunk->uvs.length);
+    arr_free(&chunk->positions);
+    arr_free(&chunk->normals);
+    arr_free(&chunk->uvs);
+    arr_init(&chunk->positions);
+    arr_init(&chunk->normals);
+    arr_init(&chunk->uvs);
+  }
+
+  float* positions = merged->positions.data;
+  float* normals = merged->normals.data;
+  float* uvs = merged->uvs.data;
+  int64_t counts[3] = { merged->positions.length / 3, merged->uvs.length / 2, merged->normals.length / 3 };
+
+  float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (int64_t i = 0; i < counts[0]; i++) {
+    for (int j = 0; j < 3; j++) {
+      min[j] = MIN(min[j], positions[3 * i + j]);
+      max[j] = MAX(max[j], positions[3 * i + j]);
+    }
+  }
 
   arr_group_t groups;
-  arr_texturedata_t textures;
+  arr_image_t images;
   arr_material_t materials;
   arr_t(float) vertexBlob;
   arr_t(int) indexBlob;
   map_t materialMap;
   map_t vertexMap;
-  arr_t(float) positions;
-  arr_t(float) normals;
-  arr_t(float) uvs;
 
   arr_init(&groups);
-  arr_init(&textures);
+  arr_init(&images);
   arr_init(&materials);
   map_init(&materialMap, 0);
   arr_init(&vertexBlob);
   arr_init(&indexBlob);
   map_init(&vertexMap, 0);
-  arr_init(&positions);
-  arr_init(&normals);
-  arr_init(&uvs);
 
   arr_push(&groups, ((objGroup) { .material = -1 }));
 
@@ -128,109 +400,74 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   char* root = slash ? (slash + 1) : base;
   *root = '\0';
 
-  while (length > 0) {
-    int lineLength = 0;
-
-    if (STARTS_WITH(data, "v ")) {
-      float x, y, z;
-      int count = sscanf(data + 2, "%f %f %f\n%n", &x, &y, &z, &lineLength);
-      lovrAssert(count == 3, "Bad OBJ: Expected 3 coordinates for vertex position");
-      min[0] = MIN(min[0], x);
-      max[0] = MAX(max[0], x);
-      min[1] = MIN(min[1], y);
-      max[1] = MAX(max[1], y);
-      min[2] = MIN(min[2], z);
-      max[2] = MAX(max[2], z);
-      arr_append(&positions, ((float[3]) { x, y, z }), 3);
-    } else if (STARTS_WITH(data, "vn ")) {
-      float x, y, z;
-      int count = sscanf(data + 3, "%f %f %f\n%n", &x, &y, &z, &lineLength);
-      lovrAssert(count == 3, "Bad OBJ: Expected 3 coordinates for vertex normal");
-      arr_append(&normals, ((float[3]) { x, y, z }), 3);
-    } else if (STARTS_WITH(data, "vt ")) {
-      float u, v;
-      int count = sscanf(data + 3, "%f %f\n%n", &u, &v, &lineLength);
-      lovrAssert(count == 2, "Bad OBJ: Expected 2 coordinates for texture coordinate");
-      arr_append(&uvs, ((float[2]) { u, v }), 2);
-    } else if (STARTS_WITH(data, "f ")) {
-      char* s = data + 2;
-      for (int i = 0; i < 3; i++) {
-        char terminator = i == 2 ? '\n' : ' ';
-        char* space = strchr(s, terminator);
-        if (space) {
-          uint64_t hash = hash64(s, space - s);
-          uint64_t index = map_get(&vertexMap, hash);
-          if (index != MAP_NIL) {
-            arr_push(&indexBlob, index);
+  // Resolve the corners in file order, deduplicating identical v/vt/vn combinations
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    objChunk* chunk = &chunks[i];
+    size_t e = 0;
+
+    for (size_t j = 0; j <= chunk->corners.length; j++) {
+      for (; e < chunk->events.length && chunk->events.data[e].corner == j; e++) {
+        objEvent* event = &chunk->events.data[e];
+
+        if (event->library) {
+          char path[1024];
+          size_t baseLength = strlen(base);
+          lovrAssert(baseLength + event->length < sizeof(path), "OBJ material library path is too long");
+          memcpy(path, base, baseLength);
+          memcpy(path + baseLength, event->name, event->length);
+          path[baseLength + event->length] = '\0';
+          parseMtl(path, io, &images, &materials, &materialMap, base);
+        } else {
+          uint64_t material = map_get(&materialMap, hash64(event->name, event->length));
+
+          // If the last group didn't have any faces, just reuse it, otherwise make a new group
+          objGroup* group = &groups.data[groups.length - 1];
+          if (group->count > 0) {
+            int start = group->start + group->count; // Don't put this in the compound literal (realloc)
+            arr_push(&groups, ((objGroup) {
+              .material = material == MAP_NIL ? -1 : material,
+              .start = start,
+              .count = 0
+            }));
           } else {
-            int v, vt, vn;
-            uint64_t newIndex = vertexBlob.length / 8;
-            arr_push(&indexBlob, newIndex);
-            map_set(&vertexMap, hash, newIndex);
-
-            // Can be improved
-            if (sscanf(s, "%d/%d/%d", &v, &vt, &vn) == 3) {
-              arr_append(&vertexBlob, positions.data + 3 * (v - 1), 3);
-              arr_append(&vertexBlob, normals.data + 3 * (vn - 1), 3);
-              arr_append(&vertexBlob, uvs.data + 2 * (vt - 1), 2);
-            } else if (sscanf(s, "%d//%d", &v, &vn) == 2) {
-              arr_append(&vertexBlob, positions.data + 3 * (v - 1), 3);
-              arr_append(&vertexBlob, normals.data + 3 * (vn - 1), 3);
-              arr_append(&vertexBlob, ((float[2]) { 0 }), 2);
-            } else if (sscanf(s, "%d/%d", &v, &vt) == 2) {
-              arr_append(&vertexBlob, positions.data + 3 * (v - 1), 3);
-              arr_append(&vertexBlob, ((float[3]) { 0 }), 3);
-              arr_append(&vertexBlob, uvs.data + 2 * (vt - 1), 2);
-            } else if (sscanf(s, "%d", &v) == 1) {
-              arr_append(&vertexBlob, positions.data + 3 * (v - 1), 3);
-              arr_append(&vertexBlob, ((float[5]) { 0 }), 5);
-            } else {
-              lovrThrow("Bad OBJ: Unknown face format");
-            }
+            group->material = material == MAP_NIL ? -1 : material;
           }
-          s = space + 1;
         }
       }
-      groups.data[groups.length - 1].count += 3;
-      lineLength = s - data;
-    } else if (STARTS_WITH(data, "mtllib ")) {
-      char filename[1024];
-      bool hasName = sscanf(data + 7, "%1024s\n%n", filename, &lineLength);
-      lovrAssert(hasName, "Bad OBJ: Expected filename after mtllib");
-      char path[1024];
-      snprintf(path, sizeof(path), "%s%s", base, filename);
-      parseMtl(path, io, &textures, &materials, &materialMap, base);
-    } else if (STARTS_WITH(data, "usemtl ")) {
-      char name[128];
-      uint64_t length = sscanf(data + 7, "%s\n%n", name, &lineLength);
-      uint64_t material = map_get(&materialMap, hash64(name, length));
-      lovrAssert(length > 0, "Bad OBJ: Expected a valid material name");
-
-      // If the last group didn't have any faces, just reuse it, otherwise make a new group
-      objGroup* group = &groups.data[groups.length - 1];
-      if (group->count > 0) {
-        int start = group->start + group->count; // Don't put this in the compound literal (realloc)
-        arr_push(&groups, ((objGroup) {
-          .material = material == MAP_NIL ? -1 : material,
-          .start = start,
-          .count = 0
-        }));
-      } else {
-        group->material = material == MAP_NIL ? -1 : material;
-      }
-    } else {
-      char* newline = memchr(data, '\n', length);
-      if (!newline) {
+
+      if (j == chunk->corners.length) {
         break;
       }
-      lineLength = newline - data + 1;
-    }
 
-    data += lineLength;
-    length -= lineLength;
-    while (length && (*data == ' ' || *data == '\t')) length--, data++;
+      objCorner* corner = &chunk->corners.data[j];
+      uint32_t key[3];
+      for (int k = 0; k < 3; k++) {
+        if (corner->missing & (1 << k)) {
+          key[k] = ~0u;
+        } else {
+          int64_t index = corner->index[k] + ((corner->relative & (1 << k)) ? bases[i][k] : 0);
+          lovrAssert(index >= 0 && index < counts[k], "Bad OBJ: Face index out of range");
+          key[k] = (uint32_t) index;
+        }
+      }
+
+      uint64_t hash = hash64(key, sizeof(key));
+      uint64_t index = map_get(&vertexMap, hash);
+      if (index == MAP_NIL) {
+        index = vertexBlob.length / 8;
+        map_set(&vertexMap, hash, index);
+        arr_append(&vertexBlob, positions + 3 * key[0], 3);
+        arr_append(&vertexBlob, key[2] == ~0u ? ((float[3]) { 0 }) : normals + 3 * key[2], 3);
+        arr_append(&vertexBlob, key[1] == ~0u ? ((float[2]) { 0 }) : uvs + 2 * key[1], 2);
+      }
+
+      arr_push(&indexBlob, (int) index);
+      groups.data[groups.length - 1].count++;
+    }
   }
 
+  freeChunks(chunks, chunkCount);
+
   if (vertexBlob.length == 0 || indexBlob.length == 0) {
     return NULL;
   }
@@ -240,7 +477,7 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   model->attributeCount = 3 + (uint32_t) groups.length;
   model->primitiveCount = (uint32_t) groups.length;
   model->nodeCount = 1;
-  model->textureCount = (uint32_t) textures.length;
+  model->textureCount = (uint32_t) images.length;
   model->materialCount = (uint32_t) materials.length;
   lovrModelDataAllocate(model);
 
@@ -259,7 +496,7 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
     .stride = sizeof(int)
   };
 
-  memcpy(model->textures, textures.data, model->textureCount * sizeof(TextureData*));
+  memcpy(model->images, images.data, model->textureCount * sizeof(ModelImage));
   memcpy(model->materials, materials.data, model->materialCount * sizeof(ModelMaterial));
   model->materialMap = materialMap; // Copy by value, no need to free original, questionable
 
@@ -329,11 +566,8 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   };
 
   arr_free(&groups);
-  arr_free(&textures);
+  arr_free(&images);
   arr_free(&materials);
   map_free(&vertexMap);
-  arr_free(&positions);
-  arr_free(&normals);
-  arr_free(&uvs);
   return model;
 }
@@ -0,0 +1,860 @@
+#include "data/modelData.h"
+#include "core/arr.h"
+#include "core/hash.h"
+#include "core/map.h"
+#include "core/util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Size of the FIFO cache simulated to measure ACMR and find cluster boundaries
+#define FIFO_CACHE_SIZE 16
+
+// Size of the LRU cache used to score vertices during cache optimization
+#define SCORE_CACHE_SIZE 32
+
+static const size_t typeSizes[] = {
+  [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4
+};
+
+typedef struct {
+  float key;
+  uint32_t start;
+  uint32_t count;
+} Cluster;
+
+static char* getElement(ModelData* model, ModelAttribute* attribute, uint32_t index) {
+  ModelBuffer* buffer = &model->buffers[attribute->buffer];
+  size_t size = typeSizes[attribute->type] * attribute->components;
+  return buffer->data + attribute->offset + index * (buffer->stride ? buffer->stride : size);
+}
+
+// Positions can be quantized (KHR_mesh_quantization), so they're converted to packed float triples
+static float* readPositions(ModelData* model, ModelAttribute* position) {
+  float* positions = malloc(3 * position->count * sizeof(float));
+  lovrAssert(positions, "Out of memory");
+  bool normalized = position->normalized;
+  for (uint32_t i = 0; i < position->count; i++) {
+    char* p = getElement(model, position, i);
+    for (uint32_t j = 0; j < 3; j++) {
+      float* x = &positions[3 * i + j];
+      switch (position->type) {
+        case I8: *x = normalized ? MAX(((int8_t*) p)[j] / 127.f, -1.f) : ((int8_t*) p)[j]; break;
+        case U8: *x = normalized ? ((uint8_t*) p)[j] / 255.f : ((uint8_t*) p)[j]; break;
+        case I16: *x = normalized ? MAX(((int16_t*) p)[j] / 32767.f, -1.f) : ((int16_t*) p)[j]; break;
+        case U16: *x = normalized ? ((uint16_t*) p)[j] / 65535.f : ((uint16_t*) p)[j]; break;
+        case I32: *x = (float) ((int32_t*) p)[j]; break;
+        case U32: *x = (float) ((uint32_t*) p)[j]; break;
+        case F32: *x = ((float*) p)[j]; break;
+        default: break;
+      }
+    }
+  }
+  return positions;
+}
+
+// Counts misses in a FIFO post-transform cache. A vertex is in the cache if fewer than
+// FIFO_CACHE_SIZE misses happened since it was last loaded. The clock carries over between calls
+// and is advanced past the cache size at the start, so every draw starts with a cold cache.
+static uint32_t countCacheMisses(uint32_t* indices, uint32_t count, uint32_t* timestamps, uint32_t* clock) {
+  uint32_t misses = 0;
+  *clock += FIFO_CACHE_SIZE + 1;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t v = indices[i];
+    if (*clock - timestamps[v] > FIFO_CACHE_SIZE) {
+      timestamps[v] = (*clock)++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+static float scoreVertex(int32_t cachePosition, uint32_t valence) {
+  if (valence == 0) {
+    return -1.f;
+  }
+
+  float score = 0.f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      score = .75f;
+    } else {
+      score = powf(1.f - (cachePosition - 3) / (float) (SCORE_CACHE_SIZE - 3), 1.5f);
+    }
+  }
+
+  return score + 2.f / sqrtf((float) valence);
+}
+
+// Reorders triangles for the post-transform cache, using Forsyth's greedy algorithm: vertices are
+// scored by their position in a simulated LRU cache and by how many triangles still need them, and
+// the highest scoring triangle touching the cache is emitted next.
+static void optimizeVertexCache(uint32_t* indices, uint32_t count, uint32_t vertexCount) {
+  uint32_t triangleCount = count / 3;
+  uint32_t* valence = calloc(vertexCount, sizeof(uint32_t));
+  uint32_t* offsets = malloc((vertexCount + 1) * sizeof(uint32_t));
+  uint32_t* adjacency = malloc(count * sizeof(uint32_t));
+  float* vertexScores = malloc(vertexCount * sizeof(float));
+  float* triangleScores = malloc(triangleCount * sizeof(float));
+  bool* emitted = calloc(triangleCount, sizeof(bool));
+  uint32_t* output = malloc(count * sizeof(uint32_t));
+  lovrAssert(valence && offsets && adjacency && vertexScores && triangleScores && emitted && output, "Out of memory");
+
+  for (uint32_t i = 0; i < count; i++) {
+    valence[indices[i]]++;
+  }
+
+  offsets[0] = 0;
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + valence[v];
+    valence[v] = 0;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t v = indices[i];
+    adjacency[offsets[v] + valence[v]++] = i / 3;
+  }
+
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = scoreVertex(-1, valence[v]);
+  }
+
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    uint32_t* tri = indices + 3 * t;
+    triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+  }
+
+  uint32_t cache[SCORE_CACHE_SIZE + 3];
+  uint32_t newCache[SCORE_CACHE_SIZE + 3];
+  uint32_t cacheCount = 0;
+  uint32_t cursor = 0;
+  uint32_t best = ~0u;
+
+  for (uint32_t i = 0; i < triangleCount; i++) {
+
+    // When nothing in the cache has triangles left, continue with the next unemitted triangle
+    if (best == ~0u) {
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+    }
+
+    uint32_t* tri = indices + 3 * best;
+    memcpy(output + 3 * i, tri, 3 * sizeof(uint32_t));
+    emitted[best] = true;
+
+    uint32_t newCacheCount = 0;
+    for (uint32_t j = 0; j < 3; j++) {
+      uint32_t v = tri[j];
+      newCache[newCacheCount++] = v;
+
+      // Remove the triangle from the vertex's list of remaining triangles
+      uint32_t* list = adjacency + offsets[v];
+      for (uint32_t k = 0; k < valence[v]; k++) {
+        if (list[k] == best) {
+          list[k] = list[--valence[v]];
+          break;
+        }
+      }
+    }
+
+    for (uint32_t j = 0; j < cacheCount; j++) {
+      uint32_t v = cache[j];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) {
+        newCache[newCacheCount++] = v;
+      }
+    }
+
+    // Vertices pushed past the end of the cache are rescored once and then forgotten
+    best = ~0u;
+    float bestScore = -1.f;
+    cacheCount = MIN(newCacheCount, SCORE_CACHE_SIZE);
+    for (uint32_t j = 0; j < newCacheCount; j++) {
+      uint32_t v = newCache[j];
+      int32_t position = j < SCORE_CACHE_SIZE ? (int32_t) j : -1;
+      float score = scoreVertex(position, valence[v]);
+      float delta = score - vertexScores[v];
+      vertexScores[v] = score;
+
+      uint32_t* list = adjacency + offsets[v];
+      for (uint32_t k = 0; k < valence[v]; k++) {
+        uint32_t t = list[k];
+        triangleScores[t] += delta;
+        if (position >= 0 && triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+
+    memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+  }
+
+  memcpy(indices, output, count * sizeof(uint32_t));
+  free(valence);
+  free(offsets);
+  free(adjacency);
+  free(vertexScores);
+  free(triangleScores);
+  free(emitted);
+  free(output);
+}
+
+static int compareClusters(const void* a, const void* b) {
+  float x = ((const Cluster*) a)->key;
+  float y = ((const Cluster*) b)->key;
+  return (x < y) - (x > y);
+}
+
+// Splits the cache-optimized triangles into clusters wherever the cache is restarted (a triangle
+// with 3 misses), then draws the clusters that face away from the center of the mesh first. Outer
+// surfaces tend to occlude inner ones, so this reduces overdraw without hurting cache efficiency.
+static void optimizeOverdraw(uint32_t* indices, uint32_t count, float* positions, size_t stride, uint32_t* timestamps, uint32_t* clock) {
+  uint32_t triangleCount = count / 3;
+  Cluster* clusters = malloc(triangleCount * sizeof(Cluster));
+  float* sums = malloc(triangleCount * 6 * sizeof(float));
+  lovrAssert(clusters && sums, "Out of memory");
+
+  uint32_t clusterCount = 0;
+  *clock += FIFO_CACHE_SIZE + 1;
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    uint32_t misses = 0;
+    for (uint32_t j = 0; j < 3; j++) {
+      uint32_t v = indices[3 * t + j];
+      if (*clock - timestamps[v] > FIFO_CACHE_SIZE) {
+        timestamps[v] = (*clock)++;
+        misses++;
+      }
+    }
+
+    if (t == 0 || misses == 3) {
+      clusters[clusterCount++] = (Cluster) { .start = t, .count = 0 };
+    }
+
+    clusters[clusterCount - 1].count++;
+  }
+
+  if (clusterCount < 2) {
+    free(clusters);
+    free(sums);
+    return;
+  }
+
+  // Area weighted centroid and normal of each cluster, and the centroid of the whole mesh
+  float center[3] = { 0.f };
+  float totalArea = 0.f;
+  for (uint32_t c = 0; c < clusterCount; c++) {
+    float* sum = sums + 6 * c;
+    float area = 0.f;
+    memset(sum, 0, 6 * sizeof(float));
+    for (uint32_t t = clusters[c].start; t < clusters[c].start + clusters[c].count; t++) {
+      float* a = (float*) ((char*) positions + indices[3 * t + 0] * stride);
+      float* b = (float*) ((char*) positions + indices[3 * t + 1] * stride);
+      float* d = (float*) ((char*) positions + indices[3 * t + 2] * stride);
+      float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      float w[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+      float n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+      float weight = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (uint32_t j = 0; j < 3; j++) {
+        sum[j] += (a[j] + b[j] + d[j]) / 3.f * weight;
+        sum[3 + j] += n[j];
+      }
+      area += weight;
+    }
+
+    for (uint32_t j = 0; j < 3; j++) {
+      center[j] += sum[j];
+      sum[j] = area > 0.f ? sum[j] / area : 0.f;
+    }
+    totalArea += area;
+  }
+
+  for (uint32_t j = 0; j < 3; j++) {
+    center[j] = totalArea > 0.f ? center[j] / totalArea : 0.f;
+  }
+
+  for (uint32_t c = 0; c < clusterCount; c++) {
+    float* sum = sums + 6 * c;
+    float* n = sum + 3;
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float dot = (sum[0] - center[0]) * n[0] + (sum[1] - center[1]) * n[1] + (sum[2] - center[2]) * n[2];
+    clusters[c].key = length > 0.f ? dot / length : 0.f;
+  }
+
+  qsort(clusters, clusterCount, sizeof(Cluster), compareClusters);
+
+  uint32_t* output = malloc(count * sizeof(uint32_t));
+  lovrAssert(output, "Out of memory");
+  for (uint32_t c = 0, i = 0; c < clusterCount; c++) {
+    memcpy(output + i, indices + 3 * clusters[c].start, 3 * clusters[c].count * sizeof(uint32_t));
+    i += 3 * clusters[c].count;
+  }
+
+  memcpy(indices, output, count * sizeof(uint32_t));
+  free(output);
+  free(clusters);
+  free(sums);
+}
+
+// Optimizes one set of primitives sharing the same vertex attributes. Indices are rewritten in
+// place with the same type, and vertices are compacted in place, so buffer layouts don't change.
+static void optimizeGroup(ModelData* model, ModelPrimitive** primitives, uint32_t primitiveCount, uint64_t* misses, uint64_t* triangles) {
+  ModelAttribute** attributes = primitives[0]->attributes;
+  ModelAttribute* position = attributes[ATTR_POSITION];
+
+  if (!position) {
+    return;
+  }
+
+  uint32_t vertexCount = position->count;
+  size_t vertexSize = 0;
+  for (uint32_t i = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+    if (attributes[i]) {
+      if (attributes[i]->count != vertexCount || attributes[i]->matrix) {
+        return;
+      }
+      vertexSize += typeSizes[attributes[i]->type] * attributes[i]->components;
+    }
+  }
+
+  uint32_t indexCount = 0;
+  for (uint32_t p = 0; p < primitiveCount; p++) {
+    if (memcmp(primitives[p]->attributes, attributes, sizeof(primitives[p]->attributes))) {
+      return;
+    }
+
+    // Primitives sharing an index accessor are only processed once, by the first one
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) {
+      continue;
+    }
+
+    if (index->count % 3 != 0 || (index->type != U16 && index->type != U32)) {
+      return;
+    }
+
+    indexCount += index->count;
+  }
+
+  uint32_t* indices = malloc(indexCount * sizeof(uint32_t));
+  uint32_t* timestamps = calloc(vertexCount, sizeof(uint32_t));
+  uint32_t* remap = malloc(vertexCount * sizeof(uint32_t));
+  char* vertices = malloc(vertexCount * vertexSize);
+  lovrAssert(indices && timestamps && remap && vertices, "Out of memory");
+
+  for (uint32_t p = 0, n = 0; p < primitiveCount; p++) {
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) continue;
+    char* data = getElement(model, index, 0);
+    for (uint32_t i = 0; i < index->count; i++, n++) {
+      indices[n] = index->type == U16 ? ((uint16_t*) data)[i] : ((uint32_t*) data)[i];
+      if (indices[n] >= vertexCount) {
+        free(indices);
+        free(timestamps);
+        free(remap);
+        free(vertices);
+        return;
+      }
+    }
+  }
+
+  uint32_t clock = 0;
+  for (uint32_t p = 0, n = 0; p < primitiveCount; p++) {
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) continue;
+    misses[0] += countCacheMisses(indices + n, index->count, timestamps, &clock);
+    *triangles += index->count / 3;
+    n += index->count;
+  }
+
+  // Deduplicate vertices whose attributes are bitwise identical
+  map_t map;
+  map_init(&map, vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    char* vertex = vertices + v * vertexSize;
+    for (uint32_t i = 0, offset = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+      if (attributes[i]) {
+        size_t size = typeSizes[attributes[i]->type] * attributes[i]->components;
+        memcpy(vertex + offset, getElement(model, attributes[i], v), size);
+        offset += size;
+      }
+    }
+
+    uint64_t hash = hash64(vertex, vertexSize);
+    uint64_t original = map_get(&map, hash);
+    if (original == MAP_NIL) {
+      map_set(&map, hash, v);
+      remap[v] = v;
+    } else if (!memcmp(vertex, vertices + original * vertexSize, vertexSize)) {
+      remap[v] = (uint32_t) original;
+    } else {
+      remap[v] = v;
+    }
+  }
+  map_free(&map);
+
+  for (uint32_t i = 0; i < indexCount; i++) {
+    indices[i] = remap[indices[i]];
+  }
+
+  float* positions = position->components >= 3 ? readPositions(model, position) : NULL;
+
+  for (uint32_t p = 0, n = 0; p < primitiveCount; p++) {
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) continue;
+    optimizeVertexCache(indices + n, index->count, vertexCount);
+    if (positions) {
+      optimizeOverdraw(indices + n, index->count, positions, 3 * sizeof(float), timestamps, &clock);
+    }
+    n += index->count;
+  }
+
+  // Renumber vertices in the order they're first used, dropping duplicates and unused vertices
+  uint32_t newVertexCount = 0;
+  memset(remap, 0xff, vertexCount * sizeof(uint32_t));
+  for (uint32_t i = 0; i < indexCount; i++) {
+    uint32_t* v = &remap[indices[i]];
+    if (*v == ~0u) {
+      *v = newVertexCount++;
+    }
+    indices[i] = *v;
+  }
+
+  // The packed copy of the vertices is in the old order, so scatter it into the new order first
+  char* sorted = malloc(newVertexCount * vertexSize);
+  lovrAssert(sorted, "Out of memory");
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    if (remap[v] != ~0u) {
+      memcpy(sorted + remap[v] * vertexSize, vertices + v * vertexSize, vertexSize);
+    }
+  }
+
+  for (uint32_t i = 0, offset = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+    ModelAttribute* attribute = attributes[i];
+    if (attribute) {
+      size_t size = typeSizes[attribute->type] * attribute->components;
+      for (uint32_t v = 0; v < newVertexCount; v++) {
+        memcpy(getElement(model, attribute, v), sorted + v * vertexSize + offset, size);
+      }
+      attribute->count = newVertexCount;
+      offset += size;
+    }
+  }
+
+  for (uint32_t p = 0, n = 0; p < primitiveCount; p++) {
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) continue;
+    char* data = getElement(model, index, 0);
+    for (uint32_t i = 0; i < index->count; i++, n++) {
+      if (index->type == U16) {
+        ((uint16_t*) data)[i] = (uint16_t) indices[n];
+      } else {
+        ((uint32_t*) data)[i] = indices[n];
+      }
+    }
+  }
+
+  for (uint32_t p = 0, n = 0; p < primitiveCount; p++) {
+    ModelAttribute* index = primitives[p]->indices;
+    if (p > 0 && index == primitives[p - 1]->indices) continue;
+    misses[1] += countCacheMisses(indices + n, index->count, timestamps, &clock);
+    n += index->count;
+  }
+
+  model->removedVertices += vertexCount - newVertexCount;
+  free(indices);
+  free(timestamps);
+  free(remap);
+  free(vertices);
+  free(sorted);
+  free(positions);
+}
+
+static uint32_t findGroup(uint32_t* parents, uint32_t i) {
+  while (parents[i] != i) {
+    i = parents[i] = parents[parents[i]];
+  }
+  return i;
+}
+
+// Optimizes indexed triangle primitives for the GPU: identical vertices are merged, triangles are
+// reordered for the post-transform cache and then to reduce overdraw, and vertices are reordered
+// to match the order the triangles use them. Primitives that share any accessor are optimized
+// together, and groups that can't be rewritten safely (different vertex counts, non-triangle
+// primitives, out of range indices) are left alone. ACMR is measured with a 16 entry FIFO cache.
+void lovrModelDataOptimize(ModelData* model) {
+  uint32_t* parents = malloc(model->primitiveCount * sizeof(uint32_t));
+  uint32_t* order = malloc(model->primitiveCount * sizeof(uint32_t));
+  bool* valid = malloc(model->primitiveCount * sizeof(bool));
+  ModelPrimitive** group = malloc(model->primitiveCount * sizeof(ModelPrimitive*));
+  lovrAssert(!model->primitiveCount || (parents && order && valid && group), "Out of memory");
+
+  map_t owners;
+  map_init(&owners, model->primitiveCount);
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    parents[i] = i;
+    valid[i] = true;
+
+    for (uint32_t j = 0; j <= MAX_DEFAULT_ATTRIBUTES; j++) {
+      ModelAttribute* attribute = j < MAX_DEFAULT_ATTRIBUTES ? primitive->attributes[j] : primitive->indices;
+      if (attribute) {
+        uint64_t hash = hash64(&attribute, sizeof(attribute));
+        uint64_t owner = map_get(&owners, hash);
+        if (owner == MAP_NIL) {
+          map_set(&owners, hash, i);
+        } else {
+          parents[findGroup(parents, i)] = findGroup(parents, (uint32_t) owner);
+        }
+      }
+    }
+  }
+  map_free(&owners);
+
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    if (primitive->mode != DRAW_TRIANGLES || !primitive->indices) {
+      valid[findGroup(parents, i)] = false;
+    }
+  }
+
+  // Sort primitives by group (and by index accessor within a group, so shared ones are adjacent)
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    order[i] = i;
+  }
+
+  for (uint32_t i = 1; i < model->primitiveCount; i++) {
+    uint32_t x = order[i];
+    uint32_t gx = findGroup(parents, x);
+    uintptr_t ix = (uintptr_t) model->primitives[x].indices;
+    uint32_t j = i;
+    while (j > 0) {
+      uint32_t y = order[j - 1];
+      uint32_t gy = findGroup(parents, y);
+      uintptr_t iy = (uintptr_t) model->primitives[y].indices;
+      if (gy < gx || (gy == gx && iy <= ix)) break;
+      order[j] = y;
+      j--;
+    }
+    order[j] = x;
+  }
+
+  uint64_t misses[2] = { 0, 0 };
+  uint64_t triangles = 0;
+  model->removedVertices = 0;
+  for (uint32_t i = 0; i < model->primitiveCount;) {
+    uint32_t root = findGroup(parents, order[i]);
+    uint32_t count = 0;
+    while (i < model->primitiveCount && findGroup(parents, order[i]) == root) {
+      group[count++] = &model->primitives[order[i++]];
+    }
+
+    if (valid[root]) {
+      optimizeGroup(model, group, count, misses, &triangles);
+    }
+  }
+
+  model->acmrBefore = triangles > 0 ? (float) misses[0] / triangles : 0.f;
+  model->acmrAfter = triangles > 0 ? (float) misses[1] / triangles : 0.f;
+
+  free(parents);
+  free(order);
+  free(valid);
+  free(group);
+}
+
+typedef struct {
+  float cost;
+  uint32_t from;
+  uint32_t to;
+} Collapse;
+
+static int compareCollapses(const void* a, const void* b) {
+  float x = ((const Collapse*) a)->cost;
+  float y = ((const Collapse*) b)->cost;
+  return (x > y) - (x < y);
+}
+
+// Quadrics are symmetric 4x4 matrices, stored as the 10 unique values
+static void addPlaneQuadric(float* q, float a, float b, float c, float d, float weight) {
+  q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+  q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+  q[7] += weight * c * c; q[8] += weight * c * d;
+  q[9] += weight * d * d;
+}
+
+static float evaluateQuadric(float* q, float* p) {
+  float x = p[0], y = p[1], z = p[2];
+  return
+    q[0] * x * x + 2.f * q[1] * x * y + 2.f * q[2] * x * z + 2.f * q[3] * x +
+    q[4] * y * y + 2.f * q[5] * y * z + 2.f * q[6] * y +
+    q[7] * z * z + 2.f * q[8] * z +
+    q[9];
+}
+
+static void getTriangleNormal(float* a, float* b, float* c, float* n) {
+  float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  n[0] = u[1] * v[2] - u[2] * v[1];
+  n[1] = u[2] * v[0] - u[0] * v[2];
+  n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+#define POSITION(v) ((float*) ((char*) positions + (v) * stride))
+
+// Simplifies a triangle list with quadric error metrics (Garland and Heckbert). Vertices collapse
+// onto one of their neighbors, so the result indexes the original vertices. Vertices on open
+// borders or attribute seams (several vertices at one position) are locked to keep the outline and
+// UV layout intact. Each pass sorts the candidate edges by error and collapses as many as it can
+// without touching the same area twice, rejecting collapses that would flip a triangle or turn it
+// more than about 75 degrees.
+static uint32_t simplify(uint32_t* indices, uint32_t count, float* positions, size_t stride, uint32_t vertexCount, uint32_t target) {
+  bool* locked = calloc(vertexCount, sizeof(bool));
+  bool* touched = malloc(vertexCount * sizeof(bool));
+  uint32_t* canonical = malloc(vertexCount * sizeof(uint32_t));
+  uint32_t* remap = malloc(vertexCount * sizeof(uint32_t));
+  uint32_t* offsets = malloc((vertexCount + 1) * sizeof(uint32_t));
+  uint32_t* adjacency = malloc(count * sizeof(uint32_t));
+  float* quadrics = calloc(vertexCount, 10 * sizeof(float));
+  Collapse* collapses = malloc(2 * count * sizeof(Collapse));
+  lovrAssert(locked && touched && canonical && remap && offsets && adjacency && quadrics && collapses, "Out of memory");
+
+  // Vertices sharing a position are seams
+  map_t map;
+  map_init(&map, vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    uint64_t hash = hash64(POSITION(v), 3 * sizeof(float));
+    uint64_t first = map_get(&map, hash);
+    if (first == MAP_NIL) {
+      map_set(&map, hash, v);
+      canonical[v] = v;
+    } else {
+      canonical[v] = (uint32_t) first;
+      locked[v] = locked[first] = true;
+    }
+  }
+  map_free(&map);
+
+  // Edges used by only one triangle are borders
+  map_init(&map, count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t a = canonical[indices[i]];
+    uint32_t b = canonical[indices[i - i % 3 + (i % 3 + 1) % 3]];
+    uint64_t edge[2] = { MIN(a, b), MAX(a, b) };
+    uint64_t hash = hash64(edge, sizeof(edge));
+    uint64_t uses = map_get(&map, hash);
+    map_set(&map, hash, uses == MAP_NIL ? 1 : uses + 1);
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t a = indices[i];
+    uint32_t b = indices[i - i % 3 + (i % 3 + 1) % 3];
+    uint64_t edge[2] = { MIN(canonical[a], canonical[b]), MAX(canonical[a], canonical[b]) };
+    if (map_get(&map, hash64(edge, sizeof(edge))) == 1) {
+      locked[a] = locked[b] = true;
+    }
+  }
+  map_free(&map);
+
+  for (uint32_t i = 0; i < count; i += 3) {
+    float* a = POSITION(indices[i + 0]);
+    float n[3];
+    getTriangleNormal(a, POSITION(indices[i + 1]), POSITION(indices[i + 2]), n);
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.f) {
+      n[0] /= length, n[1] /= length, n[2] /= length;
+      float d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+      for (uint32_t j = 0; j < 3; j++) {
+        addPlaneQuadric(quadrics + 10 * indices[i + j], n[0], n[1], n[2], d, length * .5f);
+      }
+    }
+  }
+
+  while (count > target) {
+    memset(offsets, 0, (vertexCount + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+      offsets[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      adjacency[offsets[indices[i]]++] = i / 3;
+    }
+    for (uint32_t v = vertexCount; v > 0; v--) {
+      offsets[v] = offsets[v - 1];
+    }
+    offsets[0] = 0;
+
+    uint32_t collapseCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t a = indices[i];
+      uint32_t b = indices[i - i % 3 + (i % 3 + 1) % 3];
+      float q[10];
+      for (uint32_t j = 0; j < 10; j++) {
+        q[j] = quadrics[10 * a + j] + quadrics[10 * b + j];
+      }
+      if (!locked[a]) collapses[collapseCount++] = (Collapse) { evaluateQuadric(q, POSITION(b)), a, b };
+      if (!locked[b]) collapses[collapseCount++] = (Collapse) { evaluateQuadric(q, POSITION(a)), b, a };
+    }
+
+    qsort(collapses, collapseCount, sizeof(Collapse), compareCollapses);
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      remap[v] = v;
+      touched[v] = false;
+    }
+
+    uint32_t remaining = count;
+    for (uint32_t i = 0; i < collapseCount && remaining > target; i++) {
+      uint32_t from = collapses[i].from;
+      uint32_t to = collapses[i].to;
+      if (touched[from] || touched[to]) {
+        continue;
+      }
+
+      bool valid = true;
+      uint32_t removed = 0;
+      for (uint32_t j = offsets[from]; j < offsets[from + 1] && valid; j++) {
+        uint32_t* tri = indices + 3 * adjacency[j];
+        if (tri[0] == to || tri[1] == to || tri[2] == to) {
+          removed++;
+          continue;
+        }
+
+        float* p[3];
+        float before[3], after[3];
+        for (uint32_t k = 0; k < 3; k++) p[k] = POSITION(tri[k]);
+        getTriangleNormal(p[0], p[1], p[2], before);
+        for (uint32_t k = 0; k < 3; k++) p[k] = tri[k] == from ? POSITION(to) : p[k];
+        getTriangleNormal(p[0], p[1], p[2], after);
+        float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        float lengths = sqrtf(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) * sqrtf(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+        valid = dot > .25f * lengths;
+      }
+
+      if (!valid) {
+        continue;
+      }
+
+      remap[from] = to;
+      for (uint32_t j = 0; j < 10; j++) {
+        quadrics[10 * to + j] += quadrics[10 * from + j];
+      }
+
+      for (uint32_t j = offsets[from]; j < offsets[from + 1]; j++) {
+        uint32_t* tri = indices + 3 * adjacency[j];
+        touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+      }
+
+      remaining -= 3 * removed;
+    }
+
+    if (remaining == count) {
+      break;
+    }
+
+    uint32_t newCount = 0;
+    for (uint32_t i = 0; i < count; i += 3) {
+      uint32_t a = remap[indices[i + 0]];
+      uint32_t b = remap[indices[i + 1]];
+      uint32_t c = remap[indices[i + 2]];
+      if (a != b && b != c && c != a) {
+        indices[newCount++] = a;
+        indices[newCount++] = b;
+        indices[newCount++] = c;
+      }
+    }
+    count = newCount;
+  }
+
+  free(locked);
+  free(touched);
+  free(canonical);
+  free(remap);
+  free(offsets);
+  free(adjacency);
+  free(quadrics);
+  free(collapses);
+  return count;
+}
+
+#undef POSITION
+
+// Each level targets half the triangles of the previous one and is simplified from it, so levels
+// stay consistent with each other. Nodes with LOD nodes from MSFT_lod keep those instead.
+void lovrModelDataGenerateLods(ModelData* model, uint32_t levels) {
+  arr_t(uint32_t) lodIndices;
+  arr_init(&lodIndices);
+  levels = MIN(levels, MAX_LODS - 1);
+
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+    ModelAttribute* index = primitive->indices;
+    primitive->lodCount = 0;
+
+    if (primitive->mode != DRAW_TRIANGLES || !position || position->matrix || position->components < 3) {
+      continue;
+    }
+
+    if (!index || (index->type != U16 && index->type != U32) || index->count < 3) {
+      continue;
+    }
+
+    uint32_t count = index->count - index->count % 3;
+    uint32_t* indices = malloc(count * sizeof(uint32_t));
+    lovrAssert(indices, "Out of memory");
+    char* data = getElement(model, index, 0);
+    bool inRange = true;
+    for (uint32_t j = 0; j < count; j++) {
+      indices[j] = index->type == U16 ? ((uint16_t*) data)[j] : ((uint32_t*) data)[j];
+      inRange &= indices[j] < position->count;
+    }
+
+    if (!inRange) {
+      free(indices);
+      continue;
+    }
+
+    float* positions = readPositions(model, position);
+    uint32_t target = count;
+
+    // Levels that simplify away to nothing are left out, so every level has triangles in lodIndices
+    uint32_t level = 0;
+    while (level < levels) {
+      target = target / 6 * 3;
+      count = simplify(indices, count, positions, 3 * sizeof(float), position->count, MAX(target, 3));
+      if (count == 0) {
+        break;
+      }
+      optimizeVertexCache(indices, count, position->count);
+      primitive->lods[level++] = (ModelLod) { (uint32_t) lodIndices.length, count };
+      arr_append(&lodIndices, indices, count);
+    }
+
+    primitive->lodCount = level;
+    free(positions);
+    free(indices);
+  }
+
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    ModelNode* node = &model->nodes[i];
+    if (node->lodCount > 0 && node->lodNodes[0] != ~0u) {
+      continue;
+    }
+
+    node->lodCount = 0;
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      node->lodCount = MAX(node->lodCount, model->primitives[node->primitiveIndex + j].lodCount);
+    }
+
+    for (uint32_t j = 0; j < node->lodCount; j++) {
+      node->lodNodes[j] = ~0u;
+      node->lodCoverage[j] = DEFAULT_LOD_COVERAGE / (1 << j);
+    }
+    node->lodCoverage[node->lodCount] = 0.f;
+  }
+
+  free(model->lodIndices);
+  model->lodIndices = lodIndices.data;
+  model->lodIndexCount = (uint32_t) lodIndices.length;
+}
@@ -58,10 +58,34 @@ bool lovrRasterizerHasGlyphs(Rasterizer* rasterizer, const char* str) {
   return hasGlyphs;
 }
 
-void lovrRasterizerLoadGlyph(Rasterizer* rasterizer, uint32_t character, Glyph* glyph) {
+void lovrRasterizerGetGlyphMetrics(Rasterizer* rasterizer, uint32_t character, Glyph* glyph) {
   int glyphIndex = stbtt_FindGlyphIndex(&rasterizer->font, character);
   lovrAssert(glyphIndex, "No font glyph found for character code %d, try using Rasterizer:hasGlyphs", character);
 
+  int advance, bearing;
+  stbtt_GetGlyphHMetrics(&rasterizer->font, glyphIndex, &advance, &bearing);
+
+  int x0, y0, x1, y1;
+  stbtt_GetGlyphBox(&rasterizer->font, glyphIndex, &x0, &y0, &x1, &y1);
+
+  bool empty = stbtt_IsGlyphEmpty(&rasterizer->font, glyphIndex);
+
+  glyph->x = 0;
+  glyph->y = 0;
+  glyph->w = empty ? 0 : ceilf((x1 - x0) * rasterizer->scale);
+  glyph->h = empty ? 0 : ceilf((y1 - y0) * rasterizer->scale);
+  glyph->tw = glyph->w + 2 * GLYPH_PADDING;
+  glyph->th = glyph->h + 2 * GLYPH_PADDING;
+  glyph->dx = empty ? 0 : roundf(bearing * rasterizer->scale);
+  glyph->dy = empty ? 0 : roundf(y1 * rasterizer->scale);
+  glyph->advance = roundf(advance * rasterizer->scale);
+  glyph->data = NULL;
+}
+
+void lovrRasterizerLoadGlyph(Rasterizer* rasterizer, uint32_t character, Glyph* glyph) {
+  lovrRasterizerGetGlyphMetrics(rasterizer, character, glyph);
+  int glyphIndex = stbtt_FindGlyphIndex(&rasterizer->font, character);
+
   // Trace glyph outline
   stbtt_vertex* vertices;
   int vertexCount = stbtt_GetGlyphShape(&rasterizer->font, glyphIndex, &vertices);
@@ -107,24 +131,6 @@ void lovrRasterizerLoadGlyph(Rasterizer* rasterizer, uint32_t character, Glyph*
 
   stbtt_FreeShape(&rasterizer->font, vertices);
 
-  int advance, bearing;
-  stbtt_GetGlyphHMetrics(&rasterizer->font, glyphIndex, &advance, &bearing);
-
-  int x0, y0, x1, y1;
-  stbtt_GetGlyphBox(&rasterizer->font, glyphIndex, &x0, &y0, &x1, &y1);
-
-  bool empty = stbtt_IsGlyphEmpty(&rasterizer->font, glyphIndex);
-
-  // Initialize glyph data
-  glyph->x = 0;
-  glyph->y = 0;
-  glyph->w = empty ? 0 : ceilf((x1 - x0) * rasterizer->scale);
-  glyph->h = empty ? 0 : ceilf((y1 - y0) * rasterizer->scale);
-  glyph->tw = glyph->w + 2 * GLYPH_PADDING;
-  glyph->th = glyph->h + 2 * GLYPH_PADDING;
-  glyph->dx = empty ? 0 : roundf(bearing * rasterizer->scale);
-  glyph->dy = empty ? 0 : roundf(y1 * rasterizer->scale);
-  glyph->advance = roundf(advance * rasterizer->scale);
   glyph->data = lovrTextureDataCreate(glyph->tw, glyph->th, NULL, 0, FORMAT_RGB);
 
   // Render SDF
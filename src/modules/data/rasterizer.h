@@ -39,5 +39,6 @@ Rasterizer* lovrRasterizerInit(Rasterizer* rasterizer, struct Blob* blob, float
 void lovrRasterizerDestroy(void* ref);
 bool lovrRasterizerHasGlyph(Rasterizer* fontData, uint32_t character);
 bool lovrRasterizerHasGlyphs(Rasterizer* fontData, const char* str);
+void lovrRasterizerGetGlyphMetrics(Rasterizer* fontData, uint32_t character, Glyph* glyph);
 void lovrRasterizerLoadGlyph(Rasterizer* fontData, uint32_t character, Glyph* glyph);
 int32_t lovrRasterizerGetKerning(Rasterizer* fontData, uint32_t left, uint32_t right);
@@ -1,6 +1,7 @@
 #include "data/soundData.h"
 #include "data/audioStream.h"
 #include "core/util.h"
+#include "core/cache.h"
 #include "core/ref.h"
 #include "lib/stb/stb_vorbis.h"
 #include <limits.h>
@@ -63,6 +64,7 @@ float lovrSoundDataGetSample(SoundData* soundData, size_t index) {
 
 void lovrSoundDataSetSample(SoundData* soundData, size_t index, float value) {
   lovrAssert(index < soundData->blob->size / (soundData->bitDepth / 8), "Sample index out of range");
+  lovrCacheRemove(soundData);
   switch (soundData->bitDepth) {
     case 8: ((int8_t*) soundData->blob->data)[index] = value * CHAR_MAX; break;
     case 16: ((int16_t*) soundData->blob->data)[index] = value * SHRT_MAX; break;
@@ -72,5 +74,6 @@ void lovrSoundDataSetSample(SoundData* soundData, size_t index, float value) {
 
 void lovrSoundDataDestroy(void* ref) {
   SoundData* soundData = (SoundData*) ref;
+  lovrCacheRemove(ref);
   lovrRelease(Blob, soundData->blob);
 }
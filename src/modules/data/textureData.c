@@ -1,15 +1,29 @@
 #include "data/textureData.h"
 #include "filesystem/filesystem.h"
 #include "core/png.h"
+#include "core/cache.h"
 #include "core/ref.h"
 #include "lib/stb/stb_image.h"
+#include "lib/zstd/zstd.h"
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define MIPMAP_BAND_PIXELS 16384
 
 #define FOUR_CC(a, b, c, d) ((uint32_t) (((d)<<24) | ((c)<<16) | ((b)<<8) | (a)))
 
-static size_t getPixelSize(TextureFormat format) {
+size_t lovrTextureFormatGetPixelSize(TextureFormat format) {
   switch (format) {
     case FORMAT_RGB: return 3;
     case FORMAT_RGBA: return 4;
@@ -30,6 +44,24 @@ static size_t getPixelSize(TextureFormat format) {
   }
 }
 
+// Lookup tables for sRGB conversion of 8 bit channels, much cheaper than pow per channel
+typedef struct {
+  float toLinear[256];
+  uint8_t toGamma[4096];
+} GammaTables;
+
+static void initGammaTables(GammaTables* gamma) {
+  for (uint32_t i = 0; i < 256; i++) {
+    float x = i / 255.f;
+    gamma->toLinear[i] = x <= .04045f ? x / 12.92f : powf((x + .055f) / 1.055f, 2.4f);
+  }
+  for (uint32_t i = 0; i < 4096; i++) {
+    float x = i / 4095.f;
+    x = x <= .0031308f ? x * 12.92f : 1.055f * powf(x, 1.f / 2.4f) - .055f;
+    gamma->toGamma[i] = (uint8_t) (x * 255.f + .5f);
+  }
+}
+
 // Modified from ddsparse (https://bitbucket.org/slime73/ddsparse)
 static bool parseDDS(uint8_t* data, size_t size, TextureData* textureData) {
   enum {
@@ -391,6 +423,177 @@ static bool parseKTX(uint8_t* bytes, size_t size, TextureData* textureData) {
   return true;
 }
 
+static bool parseKTX2(uint8_t* bytes, size_t size, TextureData* textureData, bool flip) {
+  typedef struct {
+    uint8_t magic[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+  } KTX2Header;
+
+  typedef struct {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+  } KTX2Level;
+
+  enum { SUPERCOMPRESSION_NONE, SUPERCOMPRESSION_BASISLZ, SUPERCOMPRESSION_ZSTD, SUPERCOMPRESSION_ZLIB };
+
+  uint8_t magic[] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+  if (size < sizeof(KTX2Header) || memcmp(bytes, magic, sizeof(magic))) {
+    return false;
+  }
+
+  KTX2Header* header = (KTX2Header*) bytes;
+  uint32_t levelCount = MAX(header->levelCount, 1);
+
+  if (header->pixelDepth > 1 || header->layerCount > 1 || header->faceCount != 1) {
+    lovrThrow("KTX2 array, cubemap, and volume textures are not supported");
+  }
+
+  if (size < sizeof(KTX2Header) + levelCount * sizeof(KTX2Level)) {
+    return false;
+  }
+
+  switch (header->supercompressionScheme) {
+    case SUPERCOMPRESSION_NONE: case SUPERCOMPRESSION_ZSTD: case SUPERCOMPRESSION_ZLIB: break;
+    case SUPERCOMPRESSION_BASISLZ: lovrThrow("KTX2 BasisLZ (ETC1S) textures are not supported, there is no Basis Universal transcoder");
+    default: lovrThrow("Unknown KTX2 supercompression scheme %d", header->supercompressionScheme);
+  }
+
+  // Vulkan format ids (VkFormat)
+  uint32_t vkFormat = header->vkFormat;
+  switch (vkFormat) {
+    case 0: lovrThrow("KTX2 textures without a GPU format (UASTC) are not supported, there is no Basis Universal transcoder");
+    case 23: case 29: textureData->format = FORMAT_RGB; break;
+    case 37: case 43: textureData->format = FORMAT_RGBA; break;
+    case 64: textureData->format = FORMAT_RGB10A2; break;
+    case 76: textureData->format = FORMAT_R16F; break;
+    case 83: textureData->format = FORMAT_RG16F; break;
+    case 97: textureData->format = FORMAT_RGBA16F; break;
+    case 100: textureData->format = FORMAT_R32F; break;
+    case 103: textureData->format = FORMAT_RG32F; break;
+    case 109: textureData->format = FORMAT_RGBA32F; break;
+    case 122: textureData->format = FORMAT_RG11B10F; break;
+    case 131: case 132: case 133: case 134: textureData->format = FORMAT_DXT1; break;
+    case 135: case 136: textureData->format = FORMAT_DXT3; break;
+    case 137: case 138: textureData->format = FORMAT_DXT5; break;
+    default:
+      if (vkFormat >= 157 && vkFormat <= 184) { // ASTC UNORM/SRGB pairs, in the same order as TextureFormat
+        textureData->format = FORMAT_ASTC_4x4 + (vkFormat - 157) / 2;
+        break;
+      }
+      lovrThrow("Unsupported KTX2 format '%d' (please open an issue)", vkFormat);
+  }
+
+  // Compressed levels without supercompression are uploaded straight out of the source Blob.
+  // Otherwise, levels are decompressed (and flipped) into a single allocation owned by the TextureData.
+  KTX2Level* levels = (KTX2Level*) (bytes + sizeof(KTX2Header));
+  bool compressed = textureData->format >= FORMAT_DXT1;
+  bool copy = !compressed || header->supercompressionScheme != SUPERCOMPRESSION_NONE;
+  size_t pixelSize = lovrTextureFormatGetPixelSize(textureData->format);
+  size_t total = 0;
+
+  for (uint32_t i = 0; i < levelCount; i++) {
+    if (levels[i].byteOffset > size || levels[i].byteLength > size - levels[i].byteOffset) {
+      return false;
+    }
+    total += header->supercompressionScheme == SUPERCOMPRESSION_NONE ? levels[i].byteLength : levels[i].uncompressedByteLength;
+  }
+
+  uint8_t* buffer = NULL;
+  if (copy) {
+    buffer = malloc(total);
+    lovrAssert(buffer, "Out of memory");
+  }
+
+  uint32_t width = textureData->width = header->pixelWidth;
+  uint32_t height = textureData->height = header->pixelHeight;
+  textureData->mipmapCount = levelCount;
+  textureData->mipmaps = malloc(levelCount * sizeof(Mipmap));
+  lovrAssert(textureData->mipmaps, "Out of memory");
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint8_t* data = bytes + levels[i].byteOffset;
+    size_t levelSize = levels[i].byteLength;
+
+    if (header->supercompressionScheme != SUPERCOMPRESSION_NONE) {
+      size_t length;
+      size_t capacity = levels[i].uncompressedByteLength;
+      if (header->supercompressionScheme == SUPERCOMPRESSION_ZSTD) {
+        length = ZSTD_decompress(buffer + offset, capacity, data, levelSize);
+        length = ZSTD_isError(length) ? 0 : length;
+      } else {
+        int inflated = capacity <= INT_MAX && levelSize <= INT_MAX ? stbi_zlib_decode_buffer((char*) buffer + offset, (int) capacity, (const char*) data, (int) levelSize) : -1;
+        length = inflated < 0 ? 0 : (size_t) inflated;
+      }
+      if (length != capacity) {
+        free(buffer);
+        free(textureData->mipmaps);
+        textureData->mipmaps = NULL;
+        lovrThrow("Could not decompress KTX2 mipmap level %d", i);
+      }
+      data = buffer + offset;
+      levelSize = length;
+    }
+
+    if (!compressed && levelSize < width * height * pixelSize) {
+      free(buffer);
+      free(textureData->mipmaps);
+      textureData->mipmaps = NULL;
+      return false;
+    }
+
+    if (copy && data != buffer + offset) {
+      memcpy(buffer + offset, data, levelSize);
+    }
+
+    if (!compressed && flip) {
+      size_t stride = width * pixelSize;
+      uint8_t* row = malloc(stride);
+      lovrAssert(row, "Out of memory");
+      for (uint32_t y = 0; y < height / 2; y++) {
+        uint8_t* a = buffer + offset + y * stride;
+        uint8_t* b = buffer + offset + (height - 1 - y) * stride;
+        memcpy(row, a, stride);
+        memcpy(a, b, stride);
+        memcpy(b, row, stride);
+      }
+      free(row);
+    }
+
+    textureData->mipmaps[i] = (Mipmap) { .width = width, .height = height, .data = copy ? buffer + offset : data, .size = levelSize };
+    offset += levelSize;
+    width = MAX(width >> 1, 1u);
+    height = MAX(height >> 1, 1u);
+  }
+
+  if (copy) {
+    textureData->blob->data = buffer;
+    textureData->blob->size = total;
+  }
+
+  if (!compressed && header->levelCount == 0) {
+    textureData->mipmapCount = 0;
+  }
+
+  return true;
+}
+
 static bool parseASTC(uint8_t* bytes, size_t size, TextureData* textureData) {
   typedef struct {
     uint32_t magic;
@@ -452,8 +655,130 @@ static bool parseASTC(uint8_t* bytes, size_t size, TextureData* textureData) {
   return true;
 }
 
+static void decodeColor565(uint16_t c, uint8_t* rgba) {
+  rgba[0] = ((c >> 11) & 0x1f) * 255 / 31;
+  rgba[1] = ((c >> 5) & 0x3f) * 255 / 63;
+  rgba[2] = (c & 0x1f) * 255 / 31;
+  rgba[3] = 255;
+}
+
+// Writes a 4x4 block of RGBA pixels, the color part is shared by all three DXT formats
+static void decodeDXTColors(const uint8_t* block, bool punchthrough, uint8_t pixels[16][4]) {
+  uint8_t palette[4][4];
+  uint16_t c0 = block[0] | block[1] << 8;
+  uint16_t c1 = block[2] | block[3] << 8;
+  decodeColor565(c0, palette[0]);
+  decodeColor565(c1, palette[1]);
+  for (int i = 0; i < 3; i++) {
+    if (c0 > c1 || !punchthrough) {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i] + 1) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i] + 1) / 3;
+    } else {
+      palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+      palette[3][i] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = (c0 > c1 || !punchthrough) ? 255 : 0;
+
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t) block[7] << 24;
+  for (int i = 0; i < 16; i++) {
+    memcpy(pixels[i], palette[(indices >> (2 * i)) & 3], 4);
+  }
+}
+
+static void decodeDXTAlpha(const uint8_t* block, uint8_t pixels[16][4]) {
+  uint8_t palette[8] = { block[0], block[1] };
+  for (int i = 1; i < 7; i++) {
+    if (palette[0] > palette[1]) {
+      palette[i + 1] = ((7 - i) * palette[0] + i * palette[1] + 3) / 7;
+    } else if (i < 5) {
+      palette[i + 1] = ((5 - i) * palette[0] + i * palette[1] + 2) / 5;
+    }
+  }
+
+  if (palette[0] <= palette[1]) {
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= (uint64_t) block[2 + i] << (8 * i);
+  }
+
+  for (int i = 0; i < 16; i++) {
+    pixels[i][3] = palette[(indices >> (3 * i)) & 7];
+  }
+}
+
+static void decodeDXT(TextureFormat format, const uint8_t* data, uint32_t width, uint32_t height, uint8_t* rgba) {
+  size_t blockSize = format == FORMAT_DXT1 ? 8 : 16;
+  for (uint32_t by = 0; by < height; by += 4) {
+    for (uint32_t bx = 0; bx < width; bx += 4, data += blockSize) {
+      uint8_t pixels[16][4];
+      switch (format) {
+        case FORMAT_DXT1:
+          decodeDXTColors(data, true, pixels);
+          break;
+        case FORMAT_DXT3:
+          decodeDXTColors(data + 8, false, pixels);
+          for (int i = 0; i < 16; i++) {
+            pixels[i][3] = ((data[i / 2] >> (4 * (i & 1))) & 0xf) * 17;
+          }
+          break;
+        case FORMAT_DXT5:
+          decodeDXTColors(data + 8, false, pixels);
+          decodeDXTAlpha(data, pixels);
+          break;
+        default: lovrThrow("Unreachable");
+      }
+
+      for (uint32_t y = 0; y < 4 && by + y < height; y++) {
+        for (uint32_t x = 0; x < 4 && bx + x < width; x++) {
+          memcpy(rgba + 4 * ((by + y) * width + bx + x), pixels[4 * y + x], 4);
+        }
+      }
+    }
+  }
+}
+
+// Replaces the pixel storage.  Views and read only file mappings can't be freed or written to, so
+// those get swapped for a new Blob instead of being changed in place.
+static void setPixelData(TextureData* textureData, void* data, size_t size) {
+  Blob* blob = textureData->blob;
+  if (blob->parent || blob->mapped) {
+    textureData->blob = lovrBlobCreate(data, size, "TextureData plain");
+    lovrRelease(Blob, blob);
+  } else {
+    free(blob->data);
+    blob->data = data;
+    blob->size = size;
+  }
+}
+
+// Called before pixels are written.  Pixels that can't be written to are copied first, and the
+// mipmap chain is dropped (and trimmed off the Blob) since it would be stale.  A cached TextureData
+// is evicted, so later loads get the original pixels.
+static void beginWrite(TextureData* textureData) {
+  lovrCacheRemove(textureData);
+  Blob* blob = textureData->blob;
+  size_t size = textureData->width * textureData->height * lovrTextureFormatGetPixelSize(textureData->format);
+  if (blob->parent || blob->mapped) {
+    void* data = malloc(size);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, blob->data, size);
+    setPixelData(textureData, data, size);
+  } else {
+    blob->size = size;
+  }
+  free(textureData->mipmaps);
+  textureData->mipmaps = NULL;
+  textureData->mipmapCount = 0;
+}
+
 TextureData* lovrTextureDataInit(TextureData* textureData, uint32_t width, uint32_t height, Blob* contents, uint8_t value, TextureFormat format) {
-  size_t pixelSize = getPixelSize(format);
+  size_t pixelSize = lovrTextureFormatGetPixelSize(format);
   size_t size = width * height * pixelSize;
   lovrAssert(width > 0 && height > 0, "TextureData dimensions must be positive");
   lovrAssert(format < FORMAT_DXT1, "Blank TextureData cannot be compressed");
@@ -482,6 +807,10 @@ TextureData* lovrTextureDataInitFromBlob(TextureData* textureData, Blob* blob, b
     textureData->source = blob;
     lovrRetain(blob);
     return textureData;
+  } else if (parseKTX2(blob->data, blob->size, textureData, flip)) {
+    textureData->source = blob;
+    lovrRetain(blob);
+    return textureData;
   } else if (parseASTC(blob->data, blob->size, textureData)) {
     textureData->source = blob;
     lovrRetain(blob);
@@ -514,11 +843,47 @@ TextureData* lovrTextureDataInitFromBlob(TextureData* textureData, Blob* blob, b
   return textureData;
 }
 
+// Decodes every mipmap of DXT compressed TextureData to RGBA, for GPUs that can't sample it
+TextureData* lovrTextureDataInitDecoded(TextureData* textureData, TextureData* source) {
+  lovrAssert(source->format >= FORMAT_DXT1 && source->format <= FORMAT_DXT5, "Only DXT compressed TextureData can be decoded");
+  size_t total = 0;
+  for (uint32_t i = 0; i < source->mipmapCount; i++) {
+    total += 4 * (size_t) source->mipmaps[i].width * source->mipmaps[i].height;
+  }
+
+  size_t blockSize = source->format == FORMAT_DXT1 ? 8 : 16;
+  for (uint32_t i = 0; i < source->mipmapCount; i++) {
+    Mipmap* m = &source->mipmaps[i];
+    size_t blocks = (size_t) ((m->width + 3) / 4) * ((m->height + 3) / 4);
+    lovrAssert(m->size >= blocks * blockSize, "DXT mipmap %d is too small", i);
+  }
+
+  uint8_t* data = malloc(total);
+  textureData->mipmaps = malloc(source->mipmapCount * sizeof(Mipmap));
+  lovrAssert(data && textureData->mipmaps, "Out of memory");
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < source->mipmapCount; i++) {
+    Mipmap* m = &source->mipmaps[i];
+    size_t size = 4 * (size_t) m->width * m->height;
+    decodeDXT(source->format, m->data, m->width, m->height, data + offset);
+    textureData->mipmaps[i] = (Mipmap) { .width = m->width, .height = m->height, .data = data + offset, .size = size };
+    offset += size;
+  }
+
+  textureData->width = source->width;
+  textureData->height = source->height;
+  textureData->format = FORMAT_RGBA;
+  textureData->mipmapCount = source->mipmapCount;
+  textureData->blob = lovrBlobCreate(data, total, "TextureData decoded");
+  return textureData;
+}
+
 Color lovrTextureDataGetPixel(TextureData* textureData, uint32_t x, uint32_t y) {
   lovrAssert(textureData->blob->data, "TextureData does not have any pixel data");
   lovrAssert(x < textureData->width && y < textureData->height, "getPixel coordinates must be within TextureData bounds");
   size_t index = (textureData->height - (y + 1)) * textureData->width + x;
-  size_t pixelSize = getPixelSize(textureData->format);
+  size_t pixelSize = lovrTextureFormatGetPixelSize(textureData->format);
   uint8_t* u8 = (uint8_t*) textureData->blob->data + pixelSize * index;
   float* f32 = (float*) u8;
   switch (textureData->format) {
@@ -534,8 +899,10 @@ Color lovrTextureDataGetPixel(TextureData* textureData, uint32_t x, uint32_t y)
 void lovrTextureDataSetPixel(TextureData* textureData, uint32_t x, uint32_t y, Color color) {
   lovrAssert(textureData->blob->data, "TextureData does not have any pixel data");
   lovrAssert(x < textureData->width && y < textureData->height, "setPixel coordinates must be within TextureData bounds");
+  lovrAssert(textureData->format < FORMAT_DXT1, "Unsupported format for TextureData:setPixel");
+  beginWrite(textureData);
   size_t index = (textureData->height - (y + 1)) * textureData->width + x;
-  size_t pixelSize = getPixelSize(textureData->format);
+  size_t pixelSize = lovrTextureFormatGetPixelSize(textureData->format);
   uint8_t* u8 = (uint8_t*) textureData->blob->data + pixelSize * index;
   float* f32 = (float*) u8;
   switch (textureData->format) {
@@ -572,6 +939,473 @@ void lovrTextureDataSetPixel(TextureData* textureData, uint32_t x, uint32_t y, C
   }
 }
 
+// 2x2 box filter, clamping at the edges of odd-sized levels
+static void downsample8(const uint8_t* src, uint32_t sw, uint32_t sh, uint8_t* dst, uint32_t dw, uint32_t y0, uint32_t y1, uint32_t channels, const GammaTables* gamma) {
+  dst += y0 * dw * channels;
+  for (uint32_t y = y0; y < y1; y++) {
+    const uint8_t* r0 = src + 2 * y * sw * channels;
+    const uint8_t* r1 = src + MIN(2 * y + 1, sh - 1) * sw * channels;
+    uint32_t x = 0;
+
+    // Linear RGBA does two output pixels (a 4x2 block of input pixels) at a time
+    if (channels == 4 && !gamma) {
+      for (; x + 1 < dw && 2 * x + 3 < sw; x += 2, dst += 8) {
+#if defined(__SSE2__)
+        __m128i zero = _mm_setzero_si128();
+        __m128i a = _mm_loadu_si128((const __m128i*) (r0 + 8 * x));
+        __m128i b = _mm_loadu_si128((const __m128i*) (r1 + 8 * x));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_set1_epi16(2)), 2);
+        _mm_storel_epi64((__m128i*) dst, _mm_packus_epi16(sum, sum));
+#elif defined(__ARM_NEON)
+        uint16x8_t lo = vaddl_u8(vld1_u8(r0 + 8 * x), vld1_u8(r1 + 8 * x));
+        uint16x8_t hi = vaddl_u8(vld1_u8(r0 + 8 * x + 8), vld1_u8(r1 + 8 * x + 8));
+        uint16x8_t sum = vcombine_u16(vadd_u16(vget_low_u16(lo), vget_high_u16(lo)), vadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+        vst1_u8(dst, vrshrn_n_u16(sum, 2));
+#else
+        for (uint32_t c = 0; c < 8; c++) {
+          uint32_t x0 = 8 * x + (c & 4) * 2 + (c & 3);
+          dst[c] = (uint8_t) ((r0[x0] + r0[x0 + 4] + r1[x0] + r1[x0 + 4] + 2) >> 2);
+        }
+#endif
+      }
+    }
+
+    for (; x < dw; x++) {
+      uint32_t x0 = 2 * x * channels;
+      uint32_t x1 = MIN(2 * x + 1, sw - 1) * channels;
+      for (uint32_t c = 0; c < channels; c++) {
+        if (gamma && c < 3) {
+          const float* toLinear = gamma->toLinear;
+          float sum = toLinear[r0[x0 + c]] + toLinear[r0[x1 + c]] + toLinear[r1[x0 + c]] + toLinear[r1[x1 + c]];
+          *dst++ = gamma->toGamma[(uint32_t) (sum * (4095.f / 4.f) + .5f)];
+        } else {
+          *dst++ = (uint8_t) ((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+        }
+      }
+    }
+  }
+}
+
+static void downsample32f(const float* src, uint32_t sw, uint32_t sh, float* dst, uint32_t dw, uint32_t y0, uint32_t y1) {
+  dst += y0 * dw * 4;
+  for (uint32_t y = y0; y < y1; y++) {
+    const float* r0 = src + 2 * y * sw * 4;
+    const float* r1 = src + MIN(2 * y + 1, sh - 1) * sw * 4;
+    for (uint32_t x = 0; x < dw; x++, dst += 4) {
+      uint32_t x0 = 2 * x * 4;
+      uint32_t x1 = MIN(2 * x + 1, sw - 1) * 4;
+#if defined(__SSE2__)
+      __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r0 + x0), _mm_loadu_ps(r0 + x1)), _mm_add_ps(_mm_loadu_ps(r1 + x0), _mm_loadu_ps(r1 + x1)));
+      _mm_storeu_ps(dst, _mm_mul_ps(sum, _mm_set1_ps(.25f)));
+#elif defined(__ARM_NEON)
+      float32x4_t sum = vaddq_f32(vaddq_f32(vld1q_f32(r0 + x0), vld1q_f32(r0 + x1)), vaddq_f32(vld1q_f32(r1 + x0), vld1q_f32(r1 + x1)));
+      vst1q_f32(dst, vmulq_n_f32(sum, .25f));
+#else
+      for (uint32_t c = 0; c < 4; c++) {
+        dst[c] = (r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c]) * .25f;
+      }
+#endif
+    }
+  }
+}
+
+typedef struct {
+  Mipmap* parent;
+  Mipmap* mipmap;
+  TextureFormat format;
+  uint32_t pixelSize;
+  uint32_t bandRows;
+  const GammaTables* gamma;
+} MipmapJob;
+
+// Each index downsamples one band of rows, the bands write to disjoint parts of the level
+static void downsampleBand(void* context, uint32_t index) {
+  MipmapJob* job = context;
+  Mipmap* parent = job->parent;
+  Mipmap* mipmap = job->mipmap;
+  uint32_t y0 = index * job->bandRows;
+  uint32_t y1 = MIN(y0 + job->bandRows, mipmap->height);
+  if (job->format == FORMAT_RGBA32F) {
+    downsample32f(parent->data, parent->width, parent->height, mipmap->data, mipmap->width, y0, y1);
+  } else {
+    downsample8(parent->data, parent->width, parent->height, mipmap->data, mipmap->width, y0, y1, job->pixelSize, job->gamma);
+  }
+}
+
+void lovrTextureDataGenerateMipmaps(TextureData* textureData, bool srgb) {
+  TextureFormat format = textureData->format;
+  lovrAssert(textureData->blob->data, "TextureData does not have any pixel data");
+  lovrAssert(format == FORMAT_RGB || format == FORMAT_RGBA || format == FORMAT_RGBA32F, "Unsupported format for TextureData mipmap generation");
+
+  if (textureData->mipmapCount > 1) {
+    return;
+  }
+
+  lovrCacheRemove(textureData);
+  size_t pixelSize = lovrTextureFormatGetPixelSize(format);
+  uint32_t mipmapCount = 1;
+  size_t size = 0;
+  for (uint32_t w = textureData->width, h = textureData->height;; w = MAX(w >> 1, 1u), h = MAX(h >> 1, 1u), mipmapCount++) {
+    size += w * h * pixelSize;
+    if (w == 1 && h == 1) break;
+  }
+
+  uint8_t* data = malloc(size);
+  Mipmap* mipmaps = malloc(mipmapCount * sizeof(Mipmap));
+  lovrAssert(data && mipmaps, "Out of memory");
+  memcpy(data, textureData->blob->data, textureData->width * textureData->height * pixelSize);
+  setPixelData(textureData, data, size);
+  free(textureData->mipmaps);
+  textureData->mipmaps = mipmaps;
+  textureData->mipmapCount = mipmapCount;
+
+  // Averaging happens in linear space
+  GammaTables gamma;
+  if (srgb && format != FORMAT_RGBA32F) {
+    initGammaTables(&gamma);
+  }
+
+  mipmaps[0] = (Mipmap) { .width = textureData->width, .height = textureData->height, .data = data, .size = textureData->width * textureData->height * pixelSize };
+  for (uint32_t i = 1; i < mipmapCount; i++) {
+    Mipmap* parent = &mipmaps[i - 1];
+    uint32_t width = MAX(parent->width >> 1, 1u);
+    uint32_t height = MAX(parent->height >> 1, 1u);
+    mipmaps[i] = (Mipmap) { .width = width, .height = height, .data = (uint8_t*) parent->data + parent->size, .size = width * height * pixelSize };
+
+    // Levels are split into bands of rows, small levels end up as a single band
+    MipmapJob job = {
+      .parent = parent,
+      .mipmap = &mipmaps[i],
+      .format = format,
+      .pixelSize = (uint32_t) pixelSize,
+      .bandRows = MAX(MIPMAP_BAND_PIXELS / width, 1u),
+      .gamma = srgb && format != FORMAT_RGBA32F ? &gamma : NULL
+    };
+
+    uint32_t bandCount = (height + job.bandRows - 1) / job.bandRows;
+#ifdef LOVR_ENABLE_THREAD
+    lovrTaskParallel(downsampleBand, &job, bandCount);
+#else
+    for (uint32_t j = 0; j < bandCount; j++) {
+      downsampleBand(&job, j);
+    }
+#endif
+  }
+}
+
+static float halfToFloat(uint16_t h) {
+  uint32_t sign = (h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0 && mantissa == 0) {
+    bits = sign;
+  } else if (exponent == 0) {
+    exponent = 113;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  } else if (exponent == 31) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Rounds to nearest even, like the GPU and the SIMD conversions below
+static uint16_t floatToHalf(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = (int32_t) ((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (((bits >> 23) & 0xff) == 0xff) {
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  } else if (exponent >= 31) {
+    return sign | 0x7c00;
+  } else if (exponent <= 0) {
+    if (exponent < -10) return sign;
+    mantissa |= 0x800000;
+    uint32_t shift = 14 - exponent;
+    return sign | (uint16_t) ((mantissa + (1u << (shift - 1)) - 1 + ((mantissa >> shift) & 1)) >> shift);
+  } else {
+    uint32_t x = ((uint32_t) exponent << 23) | mantissa;
+    return sign | (uint16_t) ((x + 0xfff + ((x >> 13) & 1)) >> 13);
+  }
+}
+
+#if defined(__SSE2__)
+// 4 halves (zero extended to 32 bits) to floats.  Multiplying by 2^112 rebases the exponent and also
+// normalizes denormals, infinity and NaN get their exponent forced to the maximum.
+static __m128 halfToFloat4(__m128i h) {
+  __m128i expmant = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+  __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+  __m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(0x7f800000));
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infnan)));
+}
+
+// 4 floats to halves, matching floatToHalf.  The halves are sign extended to 32 bits so a signed
+// pack keeps their bits.  Denormals are counted in steps of 2^-24, which rounds them to nearest even.
+static __m128i floatToHalf4(__m128 f) {
+  __m128i bits = _mm_castps_si128(f);
+  __m128i abs = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+  __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+  __m128i x = _mm_sub_epi32(abs, _mm_set1_epi32(112 << 23));
+  __m128i odd = _mm_and_si128(_mm_srli_epi32(x, 13), _mm_set1_epi32(1));
+  __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(x, _mm_set1_epi32(0xfff)), odd), 13);
+  __m128i denormal = _mm_cvtps_epi32(_mm_mul_ps(_mm_castsi128_ps(abs), _mm_set1_ps(16777216.f)));
+  __m128i nan = _mm_and_si128(_mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f800000)), _mm_set1_epi32(0x200));
+  __m128i isDenormal = _mm_cmplt_epi32(abs, _mm_set1_epi32(113 << 23));
+  __m128i isOverflow = _mm_cmpgt_epi32(abs, _mm_set1_epi32((143 << 23) - 1));
+  __m128i h = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+  h = _mm_or_si128(_mm_and_si128(isOverflow, _mm_or_si128(_mm_set1_epi32(0x7c00), nan)), _mm_andnot_si128(isOverflow, h));
+  h = _mm_or_si128(h, sign);
+  return _mm_srai_epi32(_mm_slli_epi32(h, 16), 16);
+}
+#endif
+
+static bool isConvertible(TextureFormat format) {
+  switch (format) {
+    case FORMAT_RGB:
+    case FORMAT_RGBA:
+    case FORMAT_RGBA16F:
+    case FORMAT_RGBA32F:
+    case FORMAT_R16F:
+    case FORMAT_RG16F:
+    case FORMAT_R32F:
+    case FORMAT_RG32F:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Unpacks a row of pixels to RGBA floats, missing channels are filled with 1 like getPixel
+static void decodeRow(const uint8_t* src, TextureFormat format, float* dst, uint32_t count, const GammaTables* gamma) {
+  const uint16_t* f16 = (const uint16_t*) src;
+  const float* f32 = (const float*) src;
+  uint32_t i = 0;
+  switch (format) {
+    case FORMAT_RGB:
+      for (; i < count; i++, src += 3, dst += 4) {
+        for (uint32_t c = 0; c < 3; c++) {
+          dst[c] = gamma ? gamma->toLinear[src[c]] : src[c] / 255.f;
+        }
+        dst[3] = 1.f;
+      }
+      break;
+    case FORMAT_RGBA:
+      if (!gamma) {
+#if defined(__SSE2__)
+        __m128i zero = _mm_setzero_si128();
+        __m128 scale = _mm_set1_ps(1.f / 255.f);
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+          __m128i bytes = _mm_loadu_si128((const __m128i*) src);
+          __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+          __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+          _mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+          _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+          _mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+          _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+        }
+#elif defined(__ARM_NEON)
+        float32x4_t scale = vdupq_n_f32(1.f / 255.f);
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+          uint8x16_t bytes = vld1q_u8(src);
+          uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+          uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+          vst1q_f32(dst + 0, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+          vst1q_f32(dst + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+          vst1q_f32(dst + 8, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+          vst1q_f32(dst + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+        }
+#endif
+      }
+      for (; i < count; i++, src += 4, dst += 4) {
+        for (uint32_t c = 0; c < 3; c++) {
+          dst[c] = gamma ? gamma->toLinear[src[c]] : src[c] / 255.f;
+        }
+        dst[3] = src[3] / 255.f;
+      }
+      break;
+    case FORMAT_RGBA16F:
+#if defined(__SSE2__)
+      for (; i + 8 <= count * 4; i += 8) {
+        __m128i halves = _mm_loadu_si128((const __m128i*) (f16 + i));
+        _mm_storeu_ps(dst + i, halfToFloat4(_mm_unpacklo_epi16(halves, _mm_setzero_si128())));
+        _mm_storeu_ps(dst + i + 4, halfToFloat4(_mm_unpackhi_epi16(halves, _mm_setzero_si128())));
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      for (; i + 4 <= count * 4; i += 4) {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(f16 + i))));
+      }
+#endif
+      for (; i < count * 4; i++) dst[i] = halfToFloat(f16[i]);
+      break;
+    case FORMAT_RGBA32F:
+      memcpy(dst, f32, count * 4 * sizeof(float));
+      break;
+    case FORMAT_R16F:
+      for (; i < count; i++, dst += 4) dst[0] = halfToFloat(f16[i]), dst[1] = dst[2] = dst[3] = 1.f;
+      break;
+    case FORMAT_RG16F:
+      for (; i < count; i++, dst += 4) dst[0] = halfToFloat(f16[2 * i]), dst[1] = halfToFloat(f16[2 * i + 1]), dst[2] = dst[3] = 1.f;
+      break;
+    case FORMAT_R32F:
+      for (; i < count; i++, dst += 4) dst[0] = f32[i], dst[1] = dst[2] = dst[3] = 1.f;
+      break;
+    case FORMAT_RG32F:
+      for (; i < count; i++, dst += 4) dst[0] = f32[2 * i], dst[1] = f32[2 * i + 1], dst[2] = dst[3] = 1.f;
+      break;
+    default: break;
+  }
+}
+
+static void encodeRow(const float* src, TextureFormat format, uint8_t* dst, uint32_t count, const GammaTables* gamma) {
+  uint16_t* f16 = (uint16_t*) dst;
+  float* f32 = (float*) dst;
+  uint32_t i = 0;
+  switch (format) {
+    case FORMAT_RGB:
+      for (; i < count; i++, src += 4, dst += 3) {
+        for (uint32_t c = 0; c < 3; c++) {
+          float x = CLAMP(src[c], 0.f, 1.f);
+          dst[c] = gamma ? gamma->toGamma[(uint32_t) (x * 4095.f + .5f)] : (uint8_t) (x * 255.f + .5f);
+        }
+      }
+      break;
+    case FORMAT_RGBA:
+      if (!gamma) {
+#if defined(__SSE2__)
+        __m128 scale = _mm_set1_ps(255.f);
+        __m128 half = _mm_set1_ps(.5f);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.f);
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+          __m128i p[4];
+          for (uint32_t j = 0; j < 4; j++) {
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 4 * j), zero), one);
+            p[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale), half));
+          }
+          __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(p[0], p[1]), _mm_packs_epi32(p[2], p[3]));
+          _mm_storeu_si128((__m128i*) dst, bytes);
+        }
+#elif defined(__ARM_NEON)
+        for (; i + 4 <= count; i += 4, src += 16, dst += 16) {
+          uint16x4_t p[4];
+          for (uint32_t j = 0; j < 4; j++) {
+            float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(src + 4 * j), vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+            p[j] = vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(.5f), x, 255.f)));
+          }
+          uint8x16_t bytes = vcombine_u8(vmovn_u16(vcombine_u16(p[0], p[1])), vmovn_u16(vcombine_u16(p[2], p[3])));
+          vst1q_u8(dst, bytes);
+        }
+#endif
+      }
+      for (; i < count; i++, src += 4, dst += 4) {
+        for (uint32_t c = 0; c < 4; c++) {
+          float x = CLAMP(src[c], 0.f, 1.f);
+          dst[c] = (gamma && c < 3) ? gamma->toGamma[(uint32_t) (x * 4095.f + .5f)] : (uint8_t) (x * 255.f + .5f);
+        }
+      }
+      break;
+    case FORMAT_RGBA16F:
+#if defined(__SSE2__)
+      for (; i + 8 <= count * 4; i += 8) {
+        __m128i lo = floatToHalf4(_mm_loadu_ps(src + i));
+        __m128i hi = floatToHalf4(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128((__m128i*) (f16 + i), _mm_packs_epi32(lo, hi));
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      for (; i + 4 <= count * 4; i += 4) {
+        vst1_u16(f16 + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+      }
+#endif
+      for (; i < count * 4; i++) f16[i] = floatToHalf(src[i]);
+      break;
+    case FORMAT_RGBA32F:
+      memcpy(f32, src, count * 4 * sizeof(float));
+      break;
+    case FORMAT_R16F:
+      for (; i < count; i++) f16[i] = floatToHalf(src[4 * i]);
+      break;
+    case FORMAT_RG16F:
+      for (; i < count; i++) f16[2 * i] = floatToHalf(src[4 * i]), f16[2 * i + 1] = floatToHalf(src[4 * i + 1]);
+      break;
+    case FORMAT_R32F:
+      for (; i < count; i++) f32[i] = src[4 * i];
+      break;
+    case FORMAT_RG32F:
+      for (; i < count; i++) f32[2 * i] = src[4 * i], f32[2 * i + 1] = src[4 * i + 1];
+      break;
+    default: break;
+  }
+}
+
+// Converts through a small RGBA float buffer, sRGB tables are only used between 8 bit and float formats
+static void convertRow(const uint8_t* src, TextureFormat srcFormat, uint8_t* dst, TextureFormat dstFormat, uint32_t count, const GammaTables* gamma) {
+  if (srcFormat == dstFormat) {
+    memcpy(dst, src, count * lovrTextureFormatGetPixelSize(srcFormat));
+    return;
+  }
+
+  bool src8 = srcFormat == FORMAT_RGB || srcFormat == FORMAT_RGBA;
+  bool dst8 = dstFormat == FORMAT_RGB || dstFormat == FORMAT_RGBA;
+  size_t srcSize = lovrTextureFormatGetPixelSize(srcFormat);
+  size_t dstSize = lovrTextureFormatGetPixelSize(dstFormat);
+  float buffer[64 * 4];
+
+  while (count > 0) {
+    uint32_t n = MIN(count, 64);
+    decodeRow(src, srcFormat, buffer, n, (src8 && !dst8) ? gamma : NULL);
+    encodeRow(buffer, dstFormat, dst, n, (dst8 && !src8) ? gamma : NULL);
+    src += n * srcSize;
+    dst += n * dstSize;
+    count -= n;
+  }
+}
+
+void lovrTextureDataGetPixels(TextureData* textureData, uint32_t x, uint32_t y, uint32_t w, uint32_t h, TextureFormat format, bool srgb, void* pixels) {
+  lovrAssert(textureData->blob->data, "TextureData does not have any pixel data");
+  lovrAssert(x <= textureData->width && w <= textureData->width - x && y <= textureData->height && h <= textureData->height - y, "getPixels region must be within TextureData bounds");
+  lovrAssert(isConvertible(textureData->format) && isConvertible(format), "Unsupported format for TextureData:getPixels");
+  GammaTables gamma;
+  if (srgb && format != textureData->format) initGammaTables(&gamma);
+  size_t srcSize = lovrTextureFormatGetPixelSize(textureData->format);
+  size_t dstStride = (size_t) w * lovrTextureFormatGetPixelSize(format);
+  uint8_t* dst = pixels;
+  for (uint32_t row = 0; row < h; row++, dst += dstStride) {
+    uint8_t* src = (uint8_t*) textureData->blob->data + ((size_t) (textureData->height - (y + row + 1)) * textureData->width + x) * srcSize;
+    convertRow(src, textureData->format, dst, format, w, srgb ? &gamma : NULL);
+  }
+}
+
+void lovrTextureDataSetPixels(TextureData* textureData, uint32_t x, uint32_t y, uint32_t w, uint32_t h, TextureFormat format, bool srgb, const void* pixels) {
+  lovrAssert(textureData->blob->data, "TextureData does not have any pixel data");
+  lovrAssert(x <= textureData->width && w <= textureData->width - x && y <= textureData->height && h <= textureData->height - y, "setPixels region must be within TextureData bounds");
+  lovrAssert(isConvertible(textureData->format) && isConvertible(format), "Unsupported format for TextureData:setPixels");
+  beginWrite(textureData);
+  GammaTables gamma;
+  if (srgb && format != textureData->format) initGammaTables(&gamma);
+  size_t dstSize = lovrTextureFormatGetPixelSize(textureData->format);
+  size_t srcStride = (size_t) w * lovrTextureFormatGetPixelSize(format);
+  const uint8_t* src = pixels;
+  for (uint32_t row = 0; row < h; row++, src += srcStride) {
+    uint8_t* dst = (uint8_t*) textureData->blob->data + ((size_t) (textureData->height - (y + row + 1)) * textureData->width + x) * dstSize;
+    convertRow(src, format, dst, textureData->format, w, srgb ? &gamma : NULL);
+  }
+}
+
 bool lovrTextureDataEncode(TextureData* textureData, const char* filename) {
   lovrAssert(textureData->format == FORMAT_RGBA, "Only RGBA TextureData can be encoded");
   uint8_t* pixels = (uint8_t*) textureData->blob->data + (textureData->height - 1) * textureData->width * 4;
@@ -587,9 +1421,10 @@ bool lovrTextureDataEncode(TextureData* textureData, const char* filename) {
 void lovrTextureDataPaste(TextureData* textureData, TextureData* source, uint32_t dx, uint32_t dy, uint32_t sx, uint32_t sy, uint32_t w, uint32_t h) {
   lovrAssert(textureData->format == source->format, "Currently TextureData must have the same format to paste");
   lovrAssert(textureData->format < FORMAT_DXT1, "Compressed TextureData cannot be pasted");
-  size_t pixelSize = getPixelSize(textureData->format);
-  lovrAssert(dx + w <= textureData->width && dy + h <= textureData->height, "Attempt to paste outside of destination TextureData bounds");
-  lovrAssert(sx + w <= source->width && sy + h <= source->height, "Attempt to paste from outside of source TextureData bounds");
+  size_t pixelSize = lovrTextureFormatGetPixelSize(textureData->format);
+  lovrAssert(dx <= textureData->width && w <= textureData->width - dx && dy <= textureData->height && h <= textureData->height - dy, "Attempt to paste outside of destination TextureData bounds");
+  lovrAssert(sx <= source->width && w <= source->width - sx && sy <= source->height && h <= source->height - sy, "Attempt to paste from outside of source TextureData bounds");
+  beginWrite(textureData);
   uint8_t* src = (uint8_t*) source->blob->data + ((source->height - 1 - sy) * source->width + sx) * pixelSize;
   uint8_t* dst = (uint8_t*) textureData->blob->data + ((textureData->height - 1 - dy) * textureData->width + sx) * pixelSize;
   for (uint32_t y = 0; y < h; y++) {
@@ -601,6 +1436,7 @@ void lovrTextureDataPaste(TextureData* textureData, TextureData* source, uint32_
 
 void lovrTextureDataDestroy(void* ref) {
   TextureData* textureData = ref;
+  lovrCacheRemove(ref);
   lovrRelease(Blob, textureData->source);
   free(textureData->mipmaps);
   lovrRelease(Blob, textureData->blob);
@@ -57,12 +57,18 @@ typedef struct TextureData {
   uint32_t mipmapCount;
 } TextureData;
 
+size_t lovrTextureFormatGetPixelSize(TextureFormat format);
 TextureData* lovrTextureDataInit(TextureData* textureData, uint32_t width, uint32_t height, Blob* contents, uint8_t value, TextureFormat format);
 TextureData* lovrTextureDataInitFromBlob(TextureData* textureData, Blob* blob, bool flip);
+TextureData* lovrTextureDataInitDecoded(TextureData* textureData, TextureData* source);
 #define lovrTextureDataCreate(...) lovrTextureDataInit(lovrAlloc(TextureData), __VA_ARGS__)
 #define lovrTextureDataCreateFromBlob(...) lovrTextureDataInitFromBlob(lovrAlloc(TextureData), __VA_ARGS__)
+#define lovrTextureDataCreateDecoded(...) lovrTextureDataInitDecoded(lovrAlloc(TextureData), __VA_ARGS__)
 Color lovrTextureDataGetPixel(TextureData* textureData, uint32_t x, uint32_t y);
 void lovrTextureDataSetPixel(TextureData* textureData, uint32_t x, uint32_t y, Color color);
+void lovrTextureDataGetPixels(TextureData* textureData, uint32_t x, uint32_t y, uint32_t w, uint32_t h, TextureFormat format, bool srgb, void* pixels);
+void lovrTextureDataSetPixels(TextureData* textureData, uint32_t x, uint32_t y, uint32_t w, uint32_t h, TextureFormat format, bool srgb, const void* pixels);
 bool lovrTextureDataEncode(TextureData* textureData, const char* filename);
+void lovrTextureDataGenerateMipmaps(TextureData* textureData, bool srgb);
 void lovrTextureDataPaste(TextureData* textureData, TextureData* source, uint32_t dx, uint32_t dy, uint32_t sx, uint32_t sy, uint32_t w, uint32_t h);
 void lovrTextureDataDestroy(void* ref);
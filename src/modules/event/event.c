@@ -40,6 +40,8 @@ void lovrEventPush(Event event) {
 #ifdef LOVR_ENABLE_THREAD
   if (event.type == EVENT_THREAD_ERROR) {
     lovrRetain(event.data.thread.thread);
+  } else if (event.type == EVENT_TASK_DONE) {
+    lovrRetain(event.data.task.task);
   }
 #endif
 
@@ -6,6 +6,7 @@
 #define MAX_EVENT_NAME_LENGTH 32
 
 struct Thread;
+struct Task;
 
 typedef enum {
   EVENT_QUIT,
@@ -14,6 +15,7 @@ typedef enum {
   EVENT_CUSTOM,
 #ifdef LOVR_ENABLE_THREAD
   EVENT_THREAD_ERROR,
+  EVENT_TASK_DONE,
 #endif
 } EventType;
 
@@ -54,6 +56,10 @@ typedef struct {
   char* error;
 } ThreadEvent;
 
+typedef struct {
+  struct Task* task;
+} TaskEvent;
+
 typedef struct {
   char name[MAX_EVENT_NAME_LENGTH];
   Variant data[4];
@@ -64,6 +70,7 @@ typedef union {
   QuitEvent quit;
   BoolEvent boolean;
   ThreadEvent thread;
+  TaskEvent task;
   CustomEvent custom;
 } EventData;
 
@@ -1,5 +1,6 @@
 #include "filesystem/filesystem.h"
 #include "core/arr.h"
+#include "core/cache.h"
 #include "core/fs.h"
 #include "core/hash.h"
 #include "core/map.h"
@@ -41,6 +42,7 @@ typedef struct Archive {
   bool (*stat)(struct Archive* archive, const char* path, FileInfo* info);
   void (*list)(struct Archive* archive, const char* path, fs_list_cb callback, void* context);
   bool (*read)(struct Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data);
+  void* (*map)(struct Archive* archive, const char* path, size_t* size);
   void (*close)(struct Archive* archive);
   zip_state zip;
   strpool strings;
@@ -261,6 +263,16 @@ void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead) {
   return NULL;
 }
 
+// Only files in directories can be mapped, zip entries return NULL and have to be read instead
+void* lovrFilesystemMap(const char* path, size_t* size) {
+  FileInfo info;
+  Archive* archive = archiveStat(path, &info);
+  if (!archive || !archive->map || info.type != FILE_REGULAR) {
+    return NULL;
+  }
+  return archive->map(archive, path, size);
+}
+
 void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* context, const char* path), void* context) {
   if (valid(path)) {
     FOREACH_ARCHIVE(archive) {
@@ -346,9 +358,15 @@ bool lovrFilesystemCreateDirectory(const char* path) {
   return fs_mkdir(resolved);
 }
 
+// Anything loaded from a path that's removed or written is stale, so it's dropped from the cache
 bool lovrFilesystemRemove(const char* path) {
   char resolved[LOVR_PATH_MAX];
-  return valid(path) && concat(resolved, state.savePath, state.savePathLength, path, strlen(path)) && fs_remove(resolved);
+  if (!valid(path) || !concat(resolved, state.savePath, state.savePathLength, path, strlen(path))) {
+    return false;
+  }
+
+  lovrCacheInvalidate(lovrCacheHashPath(path));
+  return fs_remove(resolved);
 }
 
 size_t lovrFilesystemWrite(const char* path, const char* content, size_t size, bool append) {
@@ -364,6 +382,7 @@ size_t lovrFilesystemWrite(const char* path, const char* content, size_t size, b
 
   fs_write(file, content, &size);
   fs_close(file);
+  lovrCacheInvalidate(lovrCacheHashPath(path));
   return size;
 }
 
@@ -473,6 +492,11 @@ static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* b
   return true;
 }
 
+static void* dir_map(Archive* archive, const char* path, size_t* size) {
+  char resolved[LOVR_PATH_MAX];
+  return dir_resolve(resolved, archive, path) ? fs_map(resolved, size) : NULL;
+}
+
 static void dir_close(Archive* archive) {
   arr_free(&archive->strings);
 }
@@ -486,6 +510,7 @@ static bool dir_init(Archive* archive, const char* path, const char* mountpoint,
   archive->stat = dir_stat;
   archive->list = dir_list;
   archive->read = dir_read;
+  archive->map = dir_map;
   archive->close = dir_close;
   return true;
 }
@@ -692,6 +717,7 @@ static bool zip_init(Archive* archive, const char* filename, const char* mountpo
   archive->stat = zip_stat;
   archive->list = zip_list;
   archive->read = zip_read;
+  archive->map = NULL;
   archive->close = zip_close;
   return true;
 }
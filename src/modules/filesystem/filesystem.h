@@ -24,6 +24,7 @@ bool lovrFilesystemIsDirectory(const char* path);
 uint64_t lovrFilesystemGetSize(const char* path);
 uint64_t lovrFilesystemGetLastModified(const char* path);
 void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead);
+void* lovrFilesystemMap(const char* path, size_t* size);
 void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* context, const char* path), void* context);
 const char* lovrFilesystemGetIdentity(void);
 bool lovrFilesystemSetIdentity(const char* identity);
@@ -1,26 +1,88 @@
 #include "graphics/font.h"
 #include "graphics/texture.h"
+#include "data/blob.h"
 #include "data/rasterizer.h"
 #include "data/textureData.h"
+#include "filesystem/filesystem.h"
 #include "core/arr.h"
 #include "core/hash.h"
 #include "core/map.h"
 #include "core/ref.h"
 #include "core/utf.h"
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#define GLYPH_PENDING UINT32_MAX
+#define GLYPH_CACHE_VERSION 1
+
 typedef struct {
   uint32_t x;
   uint32_t y;
   uint32_t width;
+} SkylineNode;
+
+typedef struct {
+  uint32_t width;
   uint32_t height;
-  uint32_t rowHeight;
   uint32_t padding;
+  arr_t(SkylineNode) skyline;
   arr_t(Glyph) glyphs;
   map_t glyphMap;
 } FontAtlas;
 
+typedef struct {
+  uint32_t codepoint;
+  Glyph glyph;
+} GlyphResult;
+
+// Cache files start with a header describing how their glyphs were rendered, then the records
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t size;
+  uint32_t padding;
+} GlyphCacheHeader;
+
+// Cache records are a codepoint, the glyph metrics, and then tw * th RGB pixels
+typedef struct {
+  uint32_t codepoint;
+  int32_t w;
+  int32_t h;
+  int32_t tw;
+  int32_t th;
+  int32_t dx;
+  int32_t dy;
+  int32_t advance;
+} GlyphRecord;
+
+// New records are buffered in pending and appended to the file in one write, after a prebake or
+// when the cache is closed, so rendering never touches the disk.  A file that is missing or doesn't
+// match the header is replaced by the first write.
+typedef struct {
+  char path[64];
+  GlyphCacheHeader header;
+  uint8_t* data;
+  size_t size;
+  map_t offsets;
+  arr_t(uint8_t) pending;
+  bool replace;
+} GlyphCache;
+
+#ifdef LOVR_ENABLE_THREAD
+// Async glyphs render on a task worker.  If the Font is destroyed first it clears the job's pointer
+// to it, so the result is thrown away.
+typedef struct GlyphJob {
+  Font* font;
+  Rasterizer* rasterizer;
+  GlyphResult result;
+} GlyphJob;
+#endif
+
 struct Font {
   Rasterizer* rasterizer;
   Texture* texture;
@@ -28,7 +90,14 @@ struct Font {
   map_t kerning;
   float lineHeight;
   float pixelDensity;
+  uint32_t generation;
   bool flip;
+  bool async;
+  GlyphCache* cache;
+#ifdef LOVR_ENABLE_THREAD
+  arr_t(GlyphJob*) glyphJobs;
+  arr_t(GlyphResult) finishedGlyphs;
+#endif
 };
 
 static float* lovrFontAlignLine(float* x, float* lineEnd, float width, HorizontalAlign halign) {
@@ -46,6 +115,12 @@ static float* lovrFontAlignLine(float* x, float* lineEnd, float width, Horizonta
 }
 
 static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint);
+#ifdef LOVR_ENABLE_THREAD
+static void lovrFontStartGlyph(Font* font, uint32_t codepoint);
+#endif
+static bool lovrFontReadCachedGlyph(Font* font, uint32_t codepoint, Glyph* glyph);
+static void lovrFontWriteCachedGlyph(Font* font, uint32_t codepoint, Glyph* glyph);
+static void lovrFontFlushCache(Font* font);
 static void lovrFontAddGlyph(Font* font, Glyph* glyph);
 static void lovrFontExpandTexture(Font* font);
 static void lovrFontCreateTexture(Font* font);
@@ -57,11 +132,13 @@ Font* lovrFontCreate(Rasterizer* rasterizer) {
   font->lineHeight = 1.f;
   font->pixelDensity = (float) font->rasterizer->height;
   map_init(&font->kerning, 0);
+#ifdef LOVR_ENABLE_THREAD
+  arr_init(&font->glyphJobs);
+  arr_init(&font->finishedGlyphs);
+#endif
 
   // Atlas
   uint32_t padding = 1;
-  font->atlas.x = padding;
-  font->atlas.y = padding;
   font->atlas.width = 128;
   font->atlas.height = 128;
   font->atlas.padding = padding;
@@ -70,9 +147,16 @@ Font* lovrFontCreate(Rasterizer* rasterizer) {
 
   // Set initial atlas size
   while (font->atlas.height < 4 * rasterizer->size) {
-    lovrFontExpandTexture(font);
+    if (font->atlas.width == font->atlas.height) {
+      font->atlas.width *= 2;
+    } else {
+      font->atlas.height *= 2;
+    }
   }
 
+  arr_init(&font->atlas.skyline);
+  arr_push(&font->atlas.skyline, ((SkylineNode) { padding, padding, font->atlas.width - 2 * padding }));
+
   // Create the texture
   lovrFontCreateTexture(font);
 
@@ -81,11 +165,21 @@ Font* lovrFontCreate(Rasterizer* rasterizer) {
 
 void lovrFontDestroy(void* ref) {
   Font* font = ref;
+#ifdef LOVR_ENABLE_THREAD
+  for (size_t i = 0; i < font->glyphJobs.length; i++) {
+    font->glyphJobs.data[i]->font = NULL;
+  }
+  for (size_t i = 0; i < font->finishedGlyphs.length; i++) {
+    lovrRelease(TextureData, font->finishedGlyphs.data[i].glyph.data);
+  }
+  arr_free(&font->glyphJobs);
+  arr_free(&font->finishedGlyphs);
+#endif
+  lovrFontSetCacheEnabled(font, false);
   lovrRelease(Rasterizer, font->rasterizer);
   lovrRelease(Texture, font->texture);
-  for (size_t i = 0; i < font->atlas.glyphs.length; i++) {
-    lovrRelease(TextureData, font->atlas.glyphs.data[i].data);
-  }
+  arr_free(&font->atlas.skyline);
+  arr_free(&font->atlas.glyphs);
   map_free(&font->atlas.glyphMap);
   map_free(&font->kerning);
 }
@@ -152,8 +246,16 @@ void lovrFontRender(Font* font, const char* str, size_t length, float wrap, Hori
       return;
     }
 
-    // Triangles
-    if (glyph->w > 0 && glyph->h > 0) {
+    // Glyphs still being generated get a degenerate quad, so the vertex count matches lovrFontMeasure
+    if (glyph->x == GLYPH_PENDING) {
+      memset(vertexCursor, 0, 32 * sizeof(float));
+      vertexCursor[0] = vertexCursor[8] = vertexCursor[16] = vertexCursor[24] = cx;
+      vertexCursor[1] = vertexCursor[9] = vertexCursor[17] = vertexCursor[25] = cy;
+      memcpy(indexCursor, (uint16_t[6]) { I + 0, I + 1, I + 2, I + 2, I + 1, I + 3 }, 6 * sizeof(uint16_t));
+      vertexCursor += 32;
+      indexCursor += 6;
+      I += 4;
+    } else if (glyph->w > 0 && glyph->h > 0) {
       float x1 = cx + glyph->dx - GLYPH_PADDING;
       float y1 = cy + (glyph->dy + GLYPH_PADDING) * (flip ? -1.f : 1.f);
       float x2 = x1 + glyph->tw;
@@ -197,6 +299,9 @@ void lovrFontMeasure(Font* font, const char* str, size_t length, float wrap, flo
   *lineCount = 0;
   *glyphCount = 0;
 
+  // Finished glyphs are only picked up here, the following lovrFontRender sees the same atlas state
+  lovrFontFlushGlyphs(font);
+
   while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
     if (codepoint == '\n' || (wrap && x * scale > wrap && codepoint == ' ')) {
       *width = MAX(*width, x * scale);
@@ -252,6 +357,7 @@ float lovrFontGetLineHeight(Font* font) {
 
 void lovrFontSetLineHeight(Font* font, float lineHeight) {
   font->lineHeight = lineHeight;
+  font->generation++;
 }
 
 bool lovrFontIsFlipEnabled(Font* font) {
@@ -260,6 +366,13 @@ bool lovrFontIsFlipEnabled(Font* font) {
 
 void lovrFontSetFlipEnabled(Font* font, bool flip) {
   font->flip = flip;
+  font->generation++;
+}
+
+// Changes whenever previously laid out text would come out differently.  Glyphs finished by the
+// async worker only count once they've been picked up by lovrFontFlushGlyphs.
+uint32_t lovrFontGetGeneration(Font* font) {
+  return font->generation;
 }
 
 int32_t lovrFontGetKerning(Font* font, uint32_t left, uint32_t right) {
@@ -285,6 +398,7 @@ void lovrFontSetPixelDensity(Font* font, float pixelDensity) {
   }
 
   font->pixelDensity = pixelDensity;
+  font->generation++;
 }
 
 static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint) {
@@ -296,81 +410,448 @@ static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint) {
   if (index == MAP_NIL) {
     index = atlas->glyphs.length;
     arr_reserve(&atlas->glyphs, atlas->glyphs.length + 1);
-    lovrRasterizerLoadGlyph(font->rasterizer, codepoint, &atlas->glyphs.data[atlas->glyphs.length++]);
+    Glyph* glyph = &atlas->glyphs.data[index];
+
+    if (lovrFontReadCachedGlyph(font, codepoint, glyph)) {
+      lovrFontAddGlyph(font, glyph);
+#ifdef LOVR_ENABLE_THREAD
+    } else if (font->async && lovrTaskPoolIsInitialized()) {
+      // Only the metrics are needed for layout, a task worker renders the MSDF
+      lovrRasterizerGetGlyphMetrics(font->rasterizer, codepoint, glyph);
+      if (glyph->w > 0 && glyph->h > 0) {
+        glyph->x = GLYPH_PENDING;
+        lovrFontStartGlyph(font, codepoint);
+      }
+#endif
+    } else {
+      lovrRasterizerLoadGlyph(font->rasterizer, codepoint, glyph);
+      lovrFontWriteCachedGlyph(font, codepoint, glyph);
+      lovrFontAddGlyph(font, glyph);
+    }
+
+    atlas->glyphs.length++;
     map_set(&atlas->glyphMap, hash, index);
-    lovrFontAddGlyph(font, &atlas->glyphs.data[index]);
   }
 
   return &atlas->glyphs.data[index];
 }
 
-static void lovrFontAddGlyph(Font* font, Glyph* glyph) {
+#ifdef LOVR_ENABLE_THREAD
+static bool lovrFontRenderGlyph(Task* task) {
+  GlyphJob* job = task->context;
+  lovrRasterizerLoadGlyph(job->rasterizer, job->result.codepoint, &job->result.glyph);
+  return true;
+}
+
+// Runs on the main thread, the glyph is added to the atlas by the next lovrFontFlushGlyphs
+static bool lovrFontFinishGlyph(Task* task) {
+  GlyphJob* job = task->context;
+  if (job->font) {
+    arr_push(&job->font->finishedGlyphs, job->result);
+    job->result.glyph.data = NULL;
+  }
+  return true;
+}
+
+static void lovrFontFreeGlyphJob(void* context) {
+  GlyphJob* job = context;
+  if (job->font) {
+    for (size_t i = 0; i < job->font->glyphJobs.length; i++) {
+      if (job->font->glyphJobs.data[i] == job) {
+        arr_splice(&job->font->glyphJobs, i, 1);
+        break;
+      }
+    }
+  }
+  lovrRelease(TextureData, job->result.glyph.data);
+  lovrRelease(Rasterizer, job->rasterizer);
+  free(job);
+}
+
+static void lovrFontStartGlyph(Font* font, uint32_t codepoint) {
+  GlyphJob* job = calloc(1, sizeof(GlyphJob));
+  lovrAssert(job, "Out of memory");
+  job->font = font;
+  job->rasterizer = font->rasterizer;
+  job->result.codepoint = codepoint;
+  lovrRetain(job->rasterizer);
+  arr_push(&font->glyphJobs, job);
+  Task* task = lovrTaskCreate(lovrFontRenderGlyph, lovrFontFinishGlyph, job, lovrFontFreeGlyphJob);
+  lovrTaskStart(task);
+  lovrRelease(Task, task);
+}
+#endif
+
+void lovrFontFlushGlyphs(Font* font) {
+#ifdef LOVR_ENABLE_THREAD
+  size_t count = font->finishedGlyphs.length;
+  GlyphResult* results = font->finishedGlyphs.data;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t codepoint = results[i].codepoint;
+    uint64_t index = map_get(&font->atlas.glyphMap, hash64(&codepoint, sizeof(codepoint)));
+    Glyph* glyph = &font->atlas.glyphs.data[index];
+    *glyph = results[i].glyph;
+    lovrFontWriteCachedGlyph(font, codepoint, glyph);
+    lovrFontAddGlyph(font, glyph);
+  }
+
+  if (count > 0) {
+    font->generation++;
+  }
+
+  arr_clear(&font->finishedGlyphs);
+#endif
+}
+
+typedef struct {
+  Rasterizer* rasterizer;
+  uint32_t* codepoints;
+  Glyph* glyphs;
+  uint32_t count;
+} BakeJob;
+
+static void lovrFontBakeGlyph(void* context, uint32_t i) {
+  BakeJob* job = context;
+  lovrRasterizerLoadGlyph(job->rasterizer, job->codepoints[i], &job->glyphs[i]);
+}
+
+// Generates every missing glyph in the string up front, spread across the task workers
+void lovrFontPrebake(Font* font, const char* str, size_t length) {
   FontAtlas* atlas = &font->atlas;
+  const char* end = str + length;
+  uint32_t codepoint;
+  size_t bytes;
 
-  // Don't waste space on empty glyphs
-  if (glyph->w == 0 && glyph->h == 0) {
+  arr_t(uint32_t) codepoints;
+  arr_init(&codepoints);
+
+  while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
+    str += bytes;
+    uint64_t hash = hash64(&codepoint, sizeof(codepoint));
+    if (codepoint == '\n' || codepoint == '\t' || map_get(&atlas->glyphMap, hash) != MAP_NIL) {
+      continue;
+    }
+
+    uint64_t index = atlas->glyphs.length;
+    arr_reserve(&atlas->glyphs, atlas->glyphs.length + 1);
+    Glyph* glyph = &atlas->glyphs.data[index];
+
+    if (lovrFontReadCachedGlyph(font, codepoint, glyph)) {
+      lovrFontAddGlyph(font, glyph);
+    } else {
+      lovrRasterizerGetGlyphMetrics(font->rasterizer, codepoint, glyph);
+      arr_push(&codepoints, codepoint);
+    }
+
+    atlas->glyphs.length++;
+    map_set(&atlas->glyphMap, hash, index);
+  }
+
+  if (codepoints.length == 0) {
+    arr_free(&codepoints);
+    return;
+  }
+
+  BakeJob job = {
+    .rasterizer = font->rasterizer,
+    .codepoints = codepoints.data,
+    .glyphs = calloc(codepoints.length, sizeof(Glyph)),
+    .count = (uint32_t) codepoints.length
+  };
+  lovrAssert(job.glyphs, "Out of memory");
+
+#ifdef LOVR_ENABLE_THREAD
+  lovrTaskParallel(lovrFontBakeGlyph, &job, job.count);
+#else
+  for (uint32_t i = 0; i < job.count; i++) {
+    lovrFontBakeGlyph(&job, i);
+  }
+#endif
+
+  for (uint32_t i = 0; i < job.count; i++) {
+    codepoint = job.codepoints[i];
+    uint64_t index = map_get(&atlas->glyphMap, hash64(&codepoint, sizeof(codepoint)));
+    Glyph* glyph = &atlas->glyphs.data[index];
+    *glyph = job.glyphs[i];
+    lovrFontWriteCachedGlyph(font, codepoint, glyph);
+    lovrFontAddGlyph(font, glyph);
+  }
+
+  lovrFontFlushCache(font);
+  free(job.glyphs);
+  arr_free(&codepoints);
+}
+
+bool lovrFontIsAsyncEnabled(Font* font) {
+  return font->async;
+}
+
+void lovrFontSetAsyncEnabled(Font* font, bool async) {
+#ifdef LOVR_ENABLE_THREAD
+  font->async = async;
+#endif
+}
+
+bool lovrFontIsCacheEnabled(Font* font) {
+  return font->cache != NULL;
+}
+
+// Glyphs are cached in the save directory, keyed by a hash of the font file and the exact bits of
+// the font size
+void lovrFontSetCacheEnabled(Font* font, bool enable) {
+  if (!enable) {
+    if (font->cache) {
+      lovrFontFlushCache(font);
+      free(font->cache->data);
+      map_free(&font->cache->offsets);
+      arr_free(&font->cache->pending);
+      free(font->cache);
+      font->cache = NULL;
+    }
     return;
+  } else if (font->cache) {
+    return;
+  }
+
+  GlyphCache* cache = calloc(1, sizeof(GlyphCache));
+  lovrAssert(cache, "Out of memory");
+  map_init(&cache->offsets, 0);
+  arr_init(&cache->pending);
+
+  Blob* blob = font->rasterizer->blob;
+  uint64_t hash = blob ? hash64(blob->data, blob->size) : hash64("default", strlen("default"));
+  memcpy(cache->header.magic, "LGLY", sizeof(cache->header.magic));
+  cache->header.version = GLYPH_CACHE_VERSION;
+  memcpy(&cache->header.size, &font->rasterizer->size, sizeof(cache->header.size));
+  cache->header.padding = GLYPH_PADDING;
+  snprintf(cache->path, sizeof(cache->path), "glyphcache/%016" PRIx64 "-%08" PRIx32 ".msdf", hash, cache->header.size);
+  lovrFilesystemCreateDirectory("glyphcache");
+
+  // Index the existing records, a truncated trailing record is ignored
+  cache->data = lovrFilesystemRead(cache->path, -1, &cache->size);
+  if (cache->data && (cache->size < sizeof(GlyphCacheHeader) || memcmp(cache->data, &cache->header, sizeof(GlyphCacheHeader)))) {
+    free(cache->data);
+    cache->data = NULL;
+    cache->size = 0;
+  }
+
+  cache->replace = !cache->data;
+  size_t offset = sizeof(GlyphCacheHeader);
+  while (cache->data && offset + sizeof(GlyphRecord) <= cache->size) {
+    GlyphRecord record;
+    memcpy(&record, cache->data + offset, sizeof(record));
+    size_t recordSize = sizeof(GlyphRecord) + (size_t) record.tw * record.th * 3;
+    if (offset + recordSize > cache->size) {
+      break;
+    }
+    map_set(&cache->offsets, hash64(&record.codepoint, sizeof(record.codepoint)), offset);
+    offset += recordSize;
+  }
+
+  font->cache = cache;
+}
+
+static bool lovrFontReadCachedGlyph(Font* font, uint32_t codepoint, Glyph* glyph) {
+  if (!font->cache) {
+    return false;
+  }
+
+  GlyphCache* cache = font->cache;
+  uint64_t offset = map_get(&cache->offsets, hash64(&codepoint, sizeof(codepoint)));
+  if (offset == MAP_NIL) {
+    return false;
   }
 
-  // If the glyph does not fit, you must acquit (new row)
-  if (atlas->x + glyph->tw > atlas->width - 2 * atlas->padding) {
-    atlas->x = atlas->padding;
-    atlas->y += atlas->rowHeight + atlas->padding;
-    atlas->rowHeight = 0;
+  GlyphRecord record;
+  memcpy(&record, cache->data + offset, sizeof(record));
+  *glyph = (Glyph) {
+    .w = record.w,
+    .h = record.h,
+    .tw = record.tw,
+    .th = record.th,
+    .dx = record.dx,
+    .dy = record.dy,
+    .advance = record.advance
+  };
+
+  if (record.w > 0 || record.h > 0) {
+    glyph->data = lovrTextureDataCreate(record.tw, record.th, NULL, 0, FORMAT_RGB);
+    memcpy(glyph->data->blob->data, cache->data + offset + sizeof(record), (size_t) record.tw * record.th * 3);
   }
 
-  // Expand the texture if needed. Expanding the texture re-adds all the glyphs, so we can return.
-  if (atlas->y + glyph->th > atlas->height - 2 * atlas->padding) {
-    lovrFontExpandTexture(font);
+  return true;
+}
+
+static void lovrFontWriteCachedGlyph(Font* font, uint32_t codepoint, Glyph* glyph) {
+  if (!font->cache) {
     return;
   }
 
-  // Keep track of glyph's position in the atlas
-  glyph->x = atlas->x;
-  glyph->y = atlas->y;
+  GlyphRecord record = { codepoint, glyph->w, glyph->h, glyph->tw, glyph->th, glyph->dx, glyph->dy, glyph->advance };
+  size_t pixelSize = glyph->data ? (size_t) glyph->tw * glyph->th * 3 : 0;
+  record.tw = pixelSize ? record.tw : 0;
+  record.th = pixelSize ? record.th : 0;
+
+  GlyphCache* cache = font->cache;
+  arr_append(&cache->pending, (uint8_t*) &record, sizeof(record));
+  if (pixelSize > 0) {
+    arr_append(&cache->pending, (uint8_t*) glyph->data->blob->data, pixelSize);
+  }
+}
+
+static void lovrFontFlushCache(Font* font) {
+  GlyphCache* cache = font->cache;
+  if (!cache || cache->pending.length == 0) {
+    return;
+  }
 
-  // Paste glyph into texture
-  lovrTextureReplacePixels(font->texture, glyph->data, atlas->x, atlas->y, 0, 0);
+  // Fonts can outlive the filesystem module at shutdown, there's nowhere to write to by then
+  const char* saveDirectory = lovrFilesystemGetSaveDirectory();
+  if (saveDirectory && saveDirectory[0]) {
+    if (cache->replace) {
+      lovrFilesystemWrite(cache->path, (const char*) &cache->header, sizeof(GlyphCacheHeader), false);
+      cache->replace = false;
+    }
+    lovrFilesystemWrite(cache->path, (const char*) cache->pending.data, cache->pending.length, true);
+  }
 
-  // Advance atlas cursor
-  atlas->x += glyph->tw + atlas->padding;
-  atlas->rowHeight = MAX(atlas->rowHeight, glyph->th);
+  arr_clear(&cache->pending);
 }
 
+// Skyline bottom-left packing: the glyph goes wherever its top edge ends up lowest
+static bool lovrFontPackGlyph(FontAtlas* atlas, uint32_t w, uint32_t h, uint32_t* x, uint32_t* y) {
+  SkylineNode* nodes = atlas->skyline.data;
+  size_t count = atlas->skyline.length;
+  size_t best = count;
+  uint32_t bestY = UINT32_MAX;
+  uint32_t bestWidth = UINT32_MAX;
+
+  for (size_t i = 0; i < count; i++) {
+    if (nodes[i].x + w > atlas->width - atlas->padding) {
+      break;
+    }
+
+    // The glyph rests on the highest node it spans
+    uint32_t top = 0;
+    uint32_t remaining = w;
+    for (size_t j = i; remaining > 0 && j < count; j++) {
+      top = MAX(top, nodes[j].y);
+      remaining -= MIN(remaining, nodes[j].width);
+    }
+
+    if (top + h > atlas->height - atlas->padding) {
+      continue;
+    }
+
+    if (top < bestY || (top == bestY && nodes[i].width < bestWidth)) {
+      best = i;
+      bestY = top;
+      bestWidth = nodes[i].width;
+    }
+  }
+
+  if (best == count) {
+    return false;
+  }
+
+  *x = nodes[best].x;
+  *y = bestY;
+
+  // Insert the new node, then trim or remove the nodes it covers
+  SkylineNode node = { *x, bestY + h, w };
+  arr_push(&atlas->skyline, node);
+  nodes = atlas->skyline.data;
+  memmove(nodes + best + 1, nodes + best, (atlas->skyline.length - best - 1) * sizeof(SkylineNode));
+  nodes[best] = node;
+
+  size_t i = best + 1;
+  while (i < atlas->skyline.length) {
+    SkylineNode* previous = &nodes[i - 1];
+    uint32_t end = previous->x + previous->width;
+    if (nodes[i].x >= end) {
+      break;
+    } else if (nodes[i].x + nodes[i].width <= end) {
+      arr_splice(&atlas->skyline, i, 1);
+    } else {
+      nodes[i].width -= end - nodes[i].x;
+      nodes[i].x = end;
+      break;
+    }
+  }
+
+  // Merge neighbors at the same height
+  for (i = 0; i + 1 < atlas->skyline.length;) {
+    if (nodes[i].y == nodes[i + 1].y) {
+      nodes[i].width += nodes[i + 1].width;
+      arr_splice(&atlas->skyline, i + 1, 1);
+    } else {
+      i++;
+    }
+  }
+
+  return true;
+}
+
+static void lovrFontAddGlyph(Font* font, Glyph* glyph) {
+  FontAtlas* atlas = &font->atlas;
+
+  // Don't waste space on empty glyphs
+  if (glyph->w > 0 || glyph->h > 0) {
+    uint32_t x, y;
+    while (!lovrFontPackGlyph(atlas, glyph->tw + atlas->padding, glyph->th + atlas->padding, &x, &y)) {
+      lovrFontExpandTexture(font);
+    }
+
+    glyph->x = x;
+    glyph->y = y;
+    lovrTextureReplacePixels(font->texture, glyph->data, x, y, 0, 0);
+  }
+
+  // The pixels live in the atlas texture now
+  lovrRelease(TextureData, glyph->data);
+  glyph->data = NULL;
+}
+
+// Grows the atlas in place, existing glyphs keep their positions
 static void lovrFontExpandTexture(Font* font) {
   FontAtlas* atlas = &font->atlas;
 
   if (atlas->width == atlas->height) {
+    uint32_t x = atlas->width - atlas->padding;
+    arr_push(&atlas->skyline, ((SkylineNode) { x, atlas->padding, atlas->width }));
     atlas->width *= 2;
   } else {
     atlas->height *= 2;
   }
 
-  if (!font->texture) {
-    return;
-  }
-
-  // Recreate the texture
   lovrFontCreateTexture(font);
+}
 
-  // Reset the cursor
-  atlas->x = atlas->padding;
-  atlas->y = atlas->padding;
-  atlas->rowHeight = 0;
-
-  // Re-pack all the glyphs
-  for (size_t i = 0; i < atlas->glyphs.length; i++) {
-    lovrFontAddGlyph(font, &atlas->glyphs.data[i]);
+static void lovrFontClearRegion(Texture* texture, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  if (width > 0 && height > 0) {
+    TextureData* textureData = lovrTextureDataCreate(width, height, NULL, 0x0, FORMAT_RGB);
+    lovrTextureReplacePixels(texture, textureData, x, y, 0, 0);
+    lovrRelease(TextureData, textureData);
   }
 }
 
-// TODO we only need the TextureData here to clear the texture, but it's a big waste of memory.
-// Could look into using glClearTexImage when supported to make this more efficient.
+// Only the area not covered by the old texture is cleared, the rest is copied over on the GPU
 static void lovrFontCreateTexture(Font* font) {
-  lovrRelease(Texture, font->texture);
-  TextureData* textureData = lovrTextureDataCreate(font->atlas.width, font->atlas.height, NULL, 0x0, FORMAT_RGB);
-  font->texture = lovrTextureCreate(TEXTURE_2D, &textureData, 1, false, false, 0);
+  FontAtlas* atlas = &font->atlas;
+  Texture* old = font->texture;
+  font->generation++;
+  uint32_t oldWidth = old ? lovrTextureGetWidth(old, 0) : 0;
+  uint32_t oldHeight = old ? lovrTextureGetHeight(old, 0) : 0;
+
+  font->texture = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, false, 0);
+  lovrTextureAllocate(font->texture, atlas->width, atlas->height, 1, FORMAT_RGB);
   lovrTextureSetFilter(font->texture, (TextureFilter) { .mode = FILTER_BILINEAR });
   lovrTextureSetWrap(font->texture, (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP });
-  lovrRelease(TextureData, textureData);
+  lovrFontClearRegion(font->texture, oldWidth, 0, atlas->width - oldWidth, oldHeight);
+  lovrFontClearRegion(font->texture, 0, oldHeight, atlas->width, atlas->height - oldHeight);
+
+  if (old) {
+    lovrTextureCopy(old, font->texture, oldWidth, oldHeight);
+    lovrRelease(Texture, old);
+  }
 }
@@ -34,6 +34,13 @@ float lovrFontGetLineHeight(Font* font);
 void lovrFontSetLineHeight(Font* font, float lineHeight);
 bool lovrFontIsFlipEnabled(Font* font);
 void lovrFontSetFlipEnabled(Font* font, bool flip);
+uint32_t lovrFontGetGeneration(Font* font);
+void lovrFontFlushGlyphs(Font* font);
 int32_t lovrFontGetKerning(Font* font, unsigned int a, unsigned int b);
 float lovrFontGetPixelDensity(Font* font);
 void lovrFontSetPixelDensity(Font* font, float pixelDensity);
+void lovrFontPrebake(Font* font, const char* str, size_t length);
+bool lovrFontIsAsyncEnabled(Font* font);
+void lovrFontSetAsyncEnabled(Font* font, bool async);
+bool lovrFontIsCacheEnabled(Font* font);
+void lovrFontSetCacheEnabled(Font* font, bool enable);
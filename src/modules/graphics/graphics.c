@@ -3,11 +3,13 @@
 #include "graphics/canvas.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
+#include "graphics/model.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
 #include "data/rasterizer.h"
 #include "event/event.h"
 #include "math/math.h"
+#include "core/hash.h"
 #include "core/maf.h"
 #include "core/ref.h"
 #include "core/util.h"
@@ -18,6 +20,7 @@
 #define MAX_TRANSFORMS 64
 #define MAX_BATCHES 4
 #define MAX_DRAWS 256
+#define MAX_TEXT_LAYOUTS 64
 
 typedef enum {
   STREAM_VERTEX,
@@ -26,6 +29,7 @@ typedef enum {
   STREAM_MODEL,
   STREAM_COLOR,
   STREAM_FRAME,
+  STREAM_POSE,
   MAX_STREAMS
 } StreamType;
 
@@ -52,7 +56,7 @@ typedef union {
   struct { float r1; float r2; bool capped; int segments; } cylinder;
   struct { int segments; } sphere;
   struct { float u; float v; float w; float h; } fill;
-  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; float* pose; } mesh;
+  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; uint32_t pose; Texture* instancePoses; int instancePoseOffset; Texture* instanceTransforms; int instanceTransformOffset; } mesh;
 } BatchParams;
 
 typedef struct {
@@ -82,9 +86,23 @@ typedef struct {
   Color* colors;
   uint32_t drawStart;
   uint32_t drawCount;
+  uint32_t pose;
   bool indexed;
 } Batch;
 
+typedef struct {
+  uint64_t hash;
+  char* text;
+  size_t length;
+  Font* font;
+  uint32_t generation;
+  uint32_t lastUsed;
+  uint32_t glyphCount;
+  float height;
+  float* vertices;
+  uint16_t* indices;
+} TextLayout;
+
 typedef struct {
   float viewMatrix[2][16];
   float projection[2][16];
@@ -99,6 +117,8 @@ static struct {
   bool frameDataDirty;
   Canvas* defaultCanvas;
   Shader* defaultShaders[MAX_DEFAULT_SHADERS][2];
+  Shader* instancePoseShaders[MAX_DEFAULT_SHADERS][2];
+  Shader* instanceTransformShaders[MAX_DEFAULT_SHADERS][2];
   Material* defaultMaterial;
   Font* defaultFont;
   TextureFilter defaultFilter;
@@ -110,6 +130,7 @@ static struct {
   Color color;
   Color linearColor;
   Font* font;
+  float lodBias;
   Pipeline pipeline;
   float pointSize;
   Shader* shader;
@@ -121,6 +142,10 @@ static struct {
   uint32_t tail[MAX_STREAMS];
   Batch batches[MAX_BATCHES];
   uint8_t batchCount;
+  uint32_t identityPose;
+  bool identityPoseValid;
+  TextLayout textLayouts[MAX_TEXT_LAYOUTS];
+  uint32_t textLayoutTick;
 } state;
 
 static const uint32_t bufferCount[] = {
@@ -130,9 +155,11 @@ static const uint32_t bufferCount[] = {
 #if defined(LOVR_WEBGL) // Work around bugs where big UBOs don't work
   [STREAM_MODEL] = MAX_DRAWS,
   [STREAM_COLOR] = MAX_DRAWS,
+  [STREAM_POSE] = MAX_BONES * 16 * sizeof(float),
 #else
   [STREAM_MODEL] = MAX_DRAWS * MAX_BATCHES,
   [STREAM_COLOR] = MAX_DRAWS * MAX_BATCHES,
+  [STREAM_POSE] = 16 * MAX_BONES * 16 * sizeof(float),
 #endif
   [STREAM_FRAME] = 4
 };
@@ -143,7 +170,8 @@ static const size_t bufferStride[] = {
   [STREAM_INDEX] = sizeof(uint16_t),
   [STREAM_MODEL] = 16 * sizeof(float),
   [STREAM_COLOR] = 4 * sizeof(float),
-  [STREAM_FRAME] = sizeof(FrameData)
+  [STREAM_FRAME] = sizeof(FrameData),
+  [STREAM_POSE] = 1 // Skinning palettes are packed by size, so the pose stream is measured in bytes
 };
 
 static const BufferType bufferType[] = {
@@ -152,7 +180,8 @@ static const BufferType bufferType[] = {
   [STREAM_INDEX] = BUFFER_INDEX,
   [STREAM_MODEL] = BUFFER_UNIFORM,
   [STREAM_COLOR] = BUFFER_UNIFORM,
-  [STREAM_FRAME] = BUFFER_UNIFORM
+  [STREAM_FRAME] = BUFFER_UNIFORM,
+  [STREAM_POSE] = BUFFER_UNIFORM
 };
 
 static void gammaCorrect(Color* color) {
@@ -180,6 +209,7 @@ static void* lovrGraphicsMapBuffer(StreamType type, uint32_t count) {
     lovrBufferDiscard(state.buffers[type]);
     state.tail[type] = 0;
     state.head[type] = 0;
+    state.identityPoseValid &= type != STREAM_POSE;
   }
 
   return lovrBufferMap(state.buffers[type], state.head[type] * bufferStride[type]);
@@ -199,6 +229,10 @@ void lovrGraphicsDestroy() {
   for (int i = 0; i < MAX_DEFAULT_SHADERS; i++) {
     lovrRelease(Shader, state.defaultShaders[i][false]);
     lovrRelease(Shader, state.defaultShaders[i][true]);
+    lovrRelease(Shader, state.instancePoseShaders[i][false]);
+    lovrRelease(Shader, state.instancePoseShaders[i][true]);
+    lovrRelease(Shader, state.instanceTransformShaders[i][false]);
+    lovrRelease(Shader, state.instanceTransformShaders[i][true]);
   }
   for (int i = 0; i < MAX_STREAMS; i++) {
     lovrRelease(Buffer, state.buffers[i]);
@@ -209,6 +243,13 @@ void lovrGraphicsDestroy() {
   lovrRelease(Material, state.defaultMaterial);
   lovrRelease(Font, state.defaultFont);
   lovrRelease(Canvas, state.defaultCanvas);
+  for (int i = 0; i < MAX_TEXT_LAYOUTS; i++) {
+    lovrRelease(Font, state.textLayouts[i].font);
+    free(state.textLayouts[i].text);
+    free(state.textLayouts[i].vertices);
+    free(state.textLayouts[i].indices);
+  }
+  lovrModelDestroyShared();
   lovrGpuDestroy();
   memset(&state, 0, sizeof(state));
 }
@@ -341,6 +382,7 @@ void lovrGraphicsReset() {
   lovrGraphicsSetDepthTest(COMPARE_LEQUAL, true);
   lovrGraphicsSetFont(NULL);
   lovrGraphicsSetLineWidth(1.f);
+  lovrGraphicsSetLodBias(0.f);
   lovrGraphicsSetPointSize(1.f);
   lovrGraphicsSetShader(NULL);
   lovrGraphicsSetStencilTest(COMPARE_NONE, 0);
@@ -466,6 +508,14 @@ void lovrGraphicsSetLineWidth(float width) {
   state.pipeline.lineWidth = width;
 }
 
+float lovrGraphicsGetLodBias() {
+  return state.lodBias;
+}
+
+void lovrGraphicsSetLodBias(float bias) {
+  state.lodBias = bias;
+}
+
 float lovrGraphicsGetPointSize() {
   return state.pointSize;
 }
@@ -528,6 +578,10 @@ void lovrGraphicsOrigin() {
   mat4_identity(state.transforms[state.transform]);
 }
 
+void lovrGraphicsGetTransform(mat4 transform) {
+  mat4_init(transform, state.transforms[state.transform]);
+}
+
 void lovrGraphicsTranslate(vec3 translation) {
   mat4_translate(state.transforms[state.transform], translation[0], translation[1], translation[2]);
 }
@@ -561,7 +615,26 @@ static void lovrGraphicsBatch(BatchRequest* req) {
   Mesh* mesh = req->mesh ? req->mesh : (req->instanced ? state.instancedMesh : state.mesh);
   Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
   bool stereo = lovrCanvasIsStereo(canvas);
-  Shader* shader = state.shader ? state.shader : (state.defaultShaders[req->shader][stereo] ? state.defaultShaders[req->shader][stereo] : (state.defaultShaders[req->shader][stereo] = lovrShaderCreateDefault(req->shader, NULL, 0, stereo)));
+  bool instancePoses = req->type == BATCH_MESH && req->params.mesh.instancePoses;
+  bool instanceTransforms = req->type == BATCH_MESH && req->params.mesh.instanceTransforms;
+  Shader* shader = state.shader;
+  if (!shader) {
+    // Draws using instance poses or instance transforms opt in to a variant of the default shader
+    // that reads them
+    Shader** slot = &state.defaultShaders[req->shader][stereo];
+    ShaderFlag flag = { .type = FLAG_BOOL, .value.b32 = true };
+    if (instancePoses) {
+      slot = &state.instancePoseShaders[req->shader][stereo];
+      flag.name = "animatedInstances";
+    } else if (instanceTransforms) {
+      slot = &state.instanceTransformShaders[req->shader][stereo];
+      flag.name = "instanceTransforms";
+    }
+    if (!*slot) {
+      *slot = lovrShaderCreateDefault(req->shader, &flag, flag.name ? 1 : 0, stereo);
+    }
+    shader = *slot;
+  }
   Pipeline* pipeline = req->pipeline ? req->pipeline : &state.pipeline;
   Material* material = req->material ? req->material : (state.defaultMaterial ? state.defaultMaterial : (state.defaultMaterial = lovrMaterialCreate()));
 
@@ -573,18 +646,32 @@ static void lovrGraphicsBatch(BatchRequest* req) {
     }
   }
 
-  if (lovrShaderHasUniform(shader, "lovrPose")) {
-    if (req->type == BATCH_MESH && req->params.mesh.pose) {
-      lovrShaderSetMatrices(shader, "lovrPose", req->params.mesh.pose, 0, MAX_BONES * 16);
-    } else {
-      lovrShaderSetMatrices(shader, "lovrPose", (float[]) MAT4_IDENTITY, 0, 16);
+  // Draws without a skinning palette get a shared identity palette
+  uint32_t pose = ~0u;
+  if (req->type == BATCH_MESH && req->params.mesh.pose != ~0u) {
+    pose = req->params.mesh.pose;
+  } else if (lovrShaderHasBlock(shader, "lovrPoseBlock")) {
+    if (!state.identityPoseValid) {
+      state.identityPose = lovrGraphicsUploadPose((float[]) MAT4_IDENTITY, 1);
+      state.identityPoseValid = true;
     }
+    pose = state.identityPose;
+  }
+
+  if (instancePoses) {
+    lovrShaderSetTextures(shader, "lovrPoseTexture", &req->params.mesh.instancePoses, 0, 1);
+    lovrShaderSetInts(shader, "lovrPoseOffset", &req->params.mesh.instancePoseOffset, 0, 1);
+  }
+
+  if (instanceTransforms) {
+    lovrShaderSetTextures(shader, "lovrInstanceTexture", &req->params.mesh.instanceTransforms, 0, 1);
+    lovrShaderSetInts(shader, "lovrInstanceOffset", &req->params.mesh.instanceTransformOffset, 0, 1);
   }
 
   // Try to find an existing batch to use
   Batch* batch = NULL;
   for (int i = state.batchCount - 1; i >= 0; i--) {
-    if (req->type == BATCH_MESH && req->params.mesh.instances > 1) { break; }
+    if (req->type == BATCH_MESH && (req->params.mesh.instances > 1 || instanceTransforms)) { break; }
 
     Batch* b = &state.batches[i];
     if (b->type != req->type) { goto next; }
@@ -595,6 +682,7 @@ static void lovrGraphicsBatch(BatchRequest* req) {
     if (b->material != material) { goto next; }
     if (memcmp(&b->draw.pipeline, pipeline, sizeof(Pipeline))) { goto next; }
     if (memcmp(&b->params, &req->params, sizeof(BatchParams))) { goto next; }
+    if (b->pose != pose) { goto next; }
     batch = b;
     break;
 
@@ -659,6 +747,7 @@ next:
       .transforms = transforms,
       .colors = colors,
       .drawStart = state.head[STREAM_MODEL],
+      .pose = pose,
       .indexed = req->indexCount > 0
     };
 
@@ -728,6 +817,9 @@ void lovrGraphicsFlush() {
     lovrShaderSetBlock(batch->draw.shader, "lovrModelBlock", state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], MAX_DRAWS * bufferStride[STREAM_MODEL], ACCESS_READ);
     lovrShaderSetBlock(batch->draw.shader, "lovrColorBlock", state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], MAX_DRAWS * bufferStride[STREAM_COLOR], ACCESS_READ);
     lovrShaderSetBlock(batch->draw.shader, "lovrFrameBlock", state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
+    if (batch->pose != ~0u) {
+      lovrShaderSetBlock(batch->draw.shader, "lovrPoseBlock", state.buffers[STREAM_POSE], batch->pose, MAX_BONES * 16 * sizeof(float), ACCESS_READ);
+    }
     if (batch->draw.topology == DRAW_POINTS) {
       lovrShaderSetFloats(batch->draw.shader, "lovrPointSize", &state.pointSize, 0, 1);
     }
@@ -1213,13 +1305,69 @@ void lovrGraphicsSkybox(Texture* texture) {
   }
 }
 
-void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign) {
+static bool lovrGraphicsMatchTextLayout(TextLayout* layout, Font* font, uint64_t hash, const char* str, size_t length) {
+  return layout->font == font && layout->hash == hash && layout->length == length && !memcmp(layout->text, str, length);
+}
+
+// Laid out text is cached by string, font, wrap and alignment, so static labels skip layout entirely
+static TextLayout* lovrGraphicsGetTextLayout(Font* font, const char* str, size_t length, float wrap, HorizontalAlign halign) {
+  uint32_t wrapBits;
+  memcpy(&wrapBits, &wrap, sizeof(wrapBits));
+  uint64_t key[4] = { hash64(str, length), (uint64_t) (uintptr_t) font, wrapBits, halign };
+  uint64_t hash = hash64(key, sizeof(key));
+
+  // Picking up finished async glyphs first means a layout with placeholders for them is redone
+  lovrFontFlushGlyphs(font);
+  uint32_t generation = lovrFontGetGeneration(font);
+
+  TextLayout* layout = NULL;
+  for (int i = 0; i < MAX_TEXT_LAYOUTS; i++) {
+    TextLayout* entry = &state.textLayouts[i];
+    if (lovrGraphicsMatchTextLayout(entry, font, hash, str, length)) {
+      layout = entry;
+      break;
+    } else if (!layout || entry->lastUsed < layout->lastUsed) {
+      layout = entry;
+    }
+  }
+
+  layout->lastUsed = ++state.textLayoutTick;
+
+  if (lovrGraphicsMatchTextLayout(layout, font, hash, str, length) && layout->generation == generation) {
+    return layout;
+  }
+
+  // The generation is recorded before rendering, so anything that changes during or after it
+  // (glyphs finishing, the atlas growing) makes the next lookup lay the text out again
   float width;
-  float height;
   uint32_t lineCount;
-  uint32_t glyphCount;
+  lovrFontMeasure(font, str, length, wrap, &width, &layout->height, &lineCount, &layout->glyphCount);
+  layout->generation = lovrFontGetGeneration(font);
+
+  if (layout->font != font) {
+    lovrRetain(font);
+    lovrRelease(Font, layout->font);
+    layout->font = font;
+  }
+
+  layout->text = realloc(layout->text, length + 1);
+  lovrAssert(layout->text, "Out of memory");
+  memcpy(layout->text, str, length);
+  layout->text[length] = '\0';
+
+  layout->hash = hash;
+  layout->length = length;
+  layout->vertices = realloc(layout->vertices, layout->glyphCount * 32 * sizeof(float));
+  layout->indices = realloc(layout->indices, layout->glyphCount * 6 * sizeof(uint16_t));
+  lovrAssert(layout->glyphCount == 0 || (layout->vertices && layout->indices), "Out of memory");
+  lovrFontRender(font, str, length, wrap, halign, layout->vertices, layout->indices, 0);
+  return layout;
+}
+
+void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign) {
   Font* font = lovrGraphicsGetFont();
-  lovrFontMeasure(font, str, length, wrap, &width, &height, &lineCount, &glyphCount);
+  TextLayout* layout = lovrGraphicsGetTextLayout(font, str, length, wrap, halign);
+  uint32_t glyphCount = layout->glyphCount;
 
   if (glyphCount == 0) {
     return;
@@ -1227,7 +1375,7 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
 
   float scale = 1.f / lovrFontGetPixelDensity(font);
   mat4_scale(transform, scale, scale, scale);
-  mat4_translate(transform, 0.f, height * (valign / 2.f), 0.f);
+  mat4_translate(transform, 0.f, layout->height * (valign / 2.f), 0.f);
 
   Pipeline pipeline = state.pipeline;
   pipeline.blendMode = pipeline.blendMode == BLEND_NONE ? BLEND_ALPHA : pipeline.blendMode;
@@ -1249,7 +1397,10 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
     .baseVertex = &baseVertex
   });
 
-  lovrFontRender(font, str, length, wrap, halign, vertices, indices, baseVertex);
+  memcpy(vertices, layout->vertices, glyphCount * 32 * sizeof(float));
+  for (uint32_t i = 0; i < glyphCount * 6; i++) {
+    indices[i] = layout->indices[i] + baseVertex;
+  }
 }
 
 void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
@@ -1280,26 +1431,56 @@ void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
   }
 }
 
-void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose) {
+// Copies a skinning palette into the pose stream, returning the handle to pass to lovrGraphicsDrawMesh.
+// It stays valid for draws until the next upload, since that upload can recycle the stream.  Each
+// palette only takes up as many bytes as it has joints, but a full block is reserved after it since
+// the pose block is always bound with its declared size.
+uint32_t lovrGraphicsUploadPose(float* pose, uint32_t count) {
+  lovrAssert(count <= MAX_BONES, "Too many bones (%d), the maximum is %d", count, MAX_BONES);
+  uint32_t size = count * 16 * sizeof(float);
+  uint32_t align = (uint32_t) lovrGraphicsGetLimits()->blockAlign;
+  float* data = lovrGraphicsMapBuffer(STREAM_POSE, MAX_BONES * 16 * sizeof(float));
+  memcpy(data, pose, size);
+  uint32_t offset = state.head[STREAM_POSE];
+  state.head[STREAM_POSE] += (uint32_t) ALIGN(size + align - 1, align);
+  return offset;
+}
+
+static void drawMesh(Mesh* mesh, Material* material, mat4 transform, BatchParams* params) {
   uint32_t vertexCount = lovrMeshGetVertexCount(mesh);
   uint32_t indexCount = lovrMeshGetIndexCount(mesh);
   uint32_t defaultCount = indexCount > 0 ? indexCount : vertexCount;
-  uint32_t rangeStart, rangeCount;
-  lovrMeshGetDrawRange(mesh, &rangeStart, &rangeCount);
-  rangeCount = rangeCount > 0 ? rangeCount : defaultCount;
-  DrawMode mode = lovrMeshGetDrawMode(mesh);
-  Material* material = lovrMeshGetMaterial(mesh);
+  lovrMeshGetDrawRange(mesh, &params->mesh.rangeStart, &params->mesh.rangeCount);
+  params->mesh.rangeCount = params->mesh.rangeCount > 0 ? params->mesh.rangeCount : defaultCount;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_MESH,
-    .params.mesh.rangeStart = rangeStart,
-    .params.mesh.rangeCount = rangeCount,
-    .params.mesh.instances = instances,
-    .params.mesh.pose = pose,
+    .params = *params,
     .mesh = mesh,
-    .topology = mode,
+    .topology = lovrMeshGetDrawMode(mesh),
     .transform = transform,
-    .material = material,
-    .instanced = instances <= 1
+    .material = material ? material : lovrMeshGetMaterial(mesh),
+    .instanced = params->mesh.instances <= 1 && !params->mesh.instanceTransforms
+  });
+}
+
+void lovrGraphicsDrawMesh(Mesh* mesh, Material* material, mat4 transform, uint32_t instances, uint32_t pose, Texture* instancePoses, uint32_t instancePoseOffset) {
+  drawMesh(mesh, material, transform, &(BatchParams) {
+    .mesh.instances = instances,
+    .mesh.pose = pose,
+    .mesh.instancePoses = instancePoses,
+    .mesh.instancePoseOffset = instancePoseOffset
+  });
+}
+
+// Draws one instance of the mesh for each of the instance matrices (applied after the transform),
+// in a single draw.  The matrices are read from the instance texture by the default shaders, starting
+// at the offset, 4 texels per matrix (see lovrModel in the vertex prefix).
+void lovrGraphicsDrawMeshInstanced(Mesh* mesh, Material* material, mat4 transform, uint32_t instances, uint32_t pose, Texture* instanceTransforms, uint32_t instanceTransformOffset) {
+  drawMesh(mesh, material, transform, &(BatchParams) {
+    .mesh.instances = instances,
+    .mesh.pose = pose,
+    .mesh.instanceTransforms = instanceTransforms,
+    .mesh.instanceTransformOffset = instanceTransformOffset
   });
 }
@@ -107,6 +107,8 @@ struct Buffer* lovrGraphicsGetIdentityBuffer(void);
 #define lovrGraphicsGetFeatures lovrGpuGetFeatures
 #define lovrGraphicsGetLimits lovrGpuGetLimits
 #define lovrGraphicsGetStats lovrGpuGetStats
+#define lovrGraphicsGetTextureBudget lovrGpuGetTextureBudget
+#define lovrGraphicsSetTextureBudget lovrGpuSetTextureBudget
 
 // State
 void lovrGraphicsReset(void);
@@ -132,6 +134,8 @@ struct Font* lovrGraphicsGetFont(void);
 void lovrGraphicsSetFont(struct Font* font);
 float lovrGraphicsGetLineWidth(void);
 void lovrGraphicsSetLineWidth(float width);
+float lovrGraphicsGetLodBias(void);
+void lovrGraphicsSetLodBias(float bias);
 float lovrGraphicsGetPointSize(void);
 void lovrGraphicsSetPointSize(float size);
 struct Shader* lovrGraphicsGetShader(void);
@@ -147,6 +151,7 @@ void lovrGraphicsSetWireframe(bool wireframe);
 void lovrGraphicsPush(void);
 void lovrGraphicsPop(void);
 void lovrGraphicsOrigin(void);
+void lovrGraphicsGetTransform(mat4 transform);
 void lovrGraphicsTranslate(vec3 translation);
 void lovrGraphicsRotate(quat rotation);
 void lovrGraphicsScale(vec3 scale);
@@ -173,7 +178,9 @@ void lovrGraphicsSphere(struct Material* material, mat4 transform, int segments)
 void lovrGraphicsSkybox(struct Texture* texture);
 void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign);
 void lovrGraphicsFill(struct Texture* texture, float u, float v, float w, float h);
-void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, float* pose);
+uint32_t lovrGraphicsUploadPose(float* pose, uint32_t count);
+void lovrGraphicsDrawMesh(struct Mesh* mesh, struct Material* material, mat4 transform, uint32_t instances, uint32_t pose, struct Texture* instancePoses, uint32_t instancePoseOffset);
+void lovrGraphicsDrawMeshInstanced(struct Mesh* mesh, struct Material* material, mat4 transform, uint32_t instances, uint32_t pose, struct Texture* instanceTransforms, uint32_t instanceTransformOffset);
 #define lovrGraphicsStencil lovrGpuStencil
 #define lovrGraphicsCompute lovrGpuCompute
 
@@ -233,3 +240,5 @@ double lovrGpuTock(const char* label);
 const GpuFeatures* lovrGpuGetFeatures(void);
 const GpuLimits* lovrGpuGetLimits(void);
 const GpuStats* lovrGpuGetStats(void);
+void lovrGpuGetTextureBudget(uint64_t* budget, uint32_t* idleFrames);
+void lovrGpuSetTextureBudget(uint64_t budget, uint32_t idleFrames);
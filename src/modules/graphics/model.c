@@ -3,89 +3,687 @@
 #include "graphics/graphics.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
+#include "graphics/shader.h"
 #include "graphics/texture.h"
+#include "data/textureData.h"
 #include "resources/shaders.h"
+#include "core/cache.h"
+#include "core/hash.h"
 #include "core/maf.h"
+#include "core/map.h"
 #include "core/ref.h"
 #include <stdlib.h>
+#include <string.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
 #include <float.h>
 #include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 typedef struct {
   float properties[3][4];
 } NodeTransform;
 
-struct Model {
+typedef struct {
+  uint32_t node;
+  uint32_t primitive;
+  uint32_t start;
+  uint32_t count;
+  float aabb[6];
+} StaticRange;
+
+typedef struct {
+  struct Mesh* mesh;
+  uint32_t material;
+  uint32_t rangeStart;
+  uint32_t rangeCount;
+} StaticBatch;
+
+typedef struct {
   struct ModelData* data;
+  bool batched;
   struct Buffer** buffers;
   struct Mesh** meshes;
+  struct Mesh** lodMeshes;
+  struct Buffer* lodBuffer;
+  float* nodeBounds;
   struct Texture** textures;
   struct Material** materials;
+  uint32_t* nodeOrder;
+  uint32_t* nodeParents;
+  uint32_t nodeOrderCount;
+  uint32_t* poseOffsets;
+  uint32_t poseCount;
+  uint32_t* instanceOffsets;
+  struct Texture* instanceTransforms;
+  bool* staticNodes;
+  StaticBatch* staticBatches;
+  uint32_t staticBatchCount;
+  StaticRange* staticRanges;
+  uint32_t staticRangeCount;
+} ModelResources;
+
+struct Model {
+  struct ModelData* data;
+  ModelResources* resources;
+  struct Material** materials;
   NodeTransform* localTransforms;
   float* globalTransforms;
+  uint32_t* keyframeCursors;
+  bool* dirtyNodes;
+  float* poses;
+  struct Texture* instancePoses;
+  struct TextureData* instancePoseData;
+  bool instancePosesDirty;
   bool transformsDirty;
 };
 
-static void updateGlobalTransform(Model* model, uint32_t nodeIndex, mat4 parent) {
-  mat4 global = model->globalTransforms + 16 * nodeIndex;
-  NodeTransform* local = &model->localTransforms[nodeIndex];
-  vec3 T = local->properties[PROP_TRANSLATION];
-  quat R = local->properties[PROP_ROTATION];
-  vec3 S = local->properties[PROP_SCALE];
-
+// Not locked: Models are only created and destroyed on the thread that owns the graphics module.
+// Async loads decode on the task workers but create the Model in their finish step, which runs
+// on the main thread too.
+static map_t sharedResources;
+static bool sharedResourcesInitialized;
+
+// Global = parent * T * R * S, with the local matrix built directly from the quaternion
+static void composeTransform(mat4 global, mat4 parent, NodeTransform* local) {
+  float* T = local->properties[PROP_TRANSLATION];
+  float* R = local->properties[PROP_ROTATION];
+  float* S = local->properties[PROP_SCALE];
+  float x = R[0], y = R[1], z = R[2], w = R[3];
+  float m[16] = {
+    (1.f - 2.f * y * y - 2.f * z * z) * S[0], (2.f * x * y + 2.f * w * z) * S[0], (2.f * x * z - 2.f * w * y) * S[0], 0.f,
+    (2.f * x * y - 2.f * w * z) * S[1], (1.f - 2.f * x * x - 2.f * z * z) * S[1], (2.f * y * z + 2.f * w * x) * S[1], 0.f,
+    (2.f * x * z + 2.f * w * y) * S[2], (2.f * y * z - 2.f * w * x) * S[2], (1.f - 2.f * x * x - 2.f * y * y) * S[2], 0.f,
+    T[0], T[1], T[2], 1.f
+  };
+
+#if defined(__SSE2__)
+  __m128 p0 = _mm_loadu_ps(parent + 0);
+  __m128 p1 = _mm_loadu_ps(parent + 4);
+  __m128 p2 = _mm_loadu_ps(parent + 8);
+  __m128 p3 = _mm_loadu_ps(parent + 12);
+  for (int i = 0; i < 16; i += 4) {
+    __m128 c = _mm_mul_ps(p0, _mm_set1_ps(m[i + 0]));
+    c = _mm_add_ps(c, _mm_mul_ps(p1, _mm_set1_ps(m[i + 1])));
+    c = _mm_add_ps(c, _mm_mul_ps(p2, _mm_set1_ps(m[i + 2])));
+    c = _mm_add_ps(c, _mm_mul_ps(p3, _mm_set1_ps(m[i + 3])));
+    _mm_storeu_ps(global + i, c);
+  }
+#elif defined(__ARM_NEON)
+  float32x4_t p0 = vld1q_f32(parent + 0);
+  float32x4_t p1 = vld1q_f32(parent + 4);
+  float32x4_t p2 = vld1q_f32(parent + 8);
+  float32x4_t p3 = vld1q_f32(parent + 12);
+  for (int i = 0; i < 16; i += 4) {
+    float32x4_t c = vmulq_n_f32(p0, m[i + 0]);
+    c = vmlaq_n_f32(c, p1, m[i + 1]);
+    c = vmlaq_n_f32(c, p2, m[i + 2]);
+    c = vmlaq_n_f32(c, p3, m[i + 3]);
+    vst1q_f32(global + i, c);
+  }
+#else
   mat4_init(global, parent);
-  mat4_translate(global, T[0], T[1], T[2]);
-  mat4_rotateQuat(global, R);
-  mat4_scale(global, S[0], S[1], S[2]);
+  mat4_multiply(global, m);
+#endif
+}
+
+// Nodes are stored parent-first, so a single pass recomputes every dirty node and its descendants
+static void updateTransforms(Model* model) {
+  if (!model->transformsDirty) {
+    return;
+  }
+
+  ModelResources* resources = model->resources;
+  bool* dirty = model->dirtyNodes;
+  float identity[16] = MAT4_IDENTITY;
+
+  for (uint32_t i = 0; i < resources->nodeOrderCount; i++) {
+    uint32_t node = resources->nodeOrder[i];
+    uint32_t parent = resources->nodeParents[node];
 
+    if (parent != ~0u && dirty[parent]) {
+      dirty[node] = true;
+    }
+
+    if (dirty[node]) {
+      mat4 parentTransform = parent == ~0u ? identity : model->globalTransforms + 16 * parent;
+      composeTransform(model->globalTransforms + 16 * node, parentTransform, &model->localTransforms[node]);
+    }
+  }
+
+  memset(dirty, 0, model->data->nodeCount * sizeof(bool));
+  model->transformsDirty = false;
+
+  // Skinning palettes, the inverse of the skinned node's transform is shared by all of its joints
+  for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+    if (resources->poseOffsets[i] == ~0u) {
+      continue;
+    }
+
+    ModelSkin* skin = &model->data->skins[model->data->nodes[i].skin];
+    float inverse[16];
+    mat4_invert(mat4_init(inverse, model->globalTransforms + 16 * i));
+
+    for (uint32_t j = 0; j < skin->jointCount; j++) {
+      mat4 jointPose = model->poses + 16 * (resources->poseOffsets[i] + j);
+      mat4_init(jointPose, inverse);
+      mat4_multiply(jointPose, model->globalTransforms + 16 * skin->joints[j]);
+      mat4_multiply(jointPose, skin->inverseBindMatrices + 16 * j);
+    }
+  }
+}
+
+typedef struct {
+  float view[16];
+  float scale;
+  bool orthographic;
+} LodContext;
+
+// Picks a level from the fraction of the screen height covered by the node's bounding sphere, as
+// seen by the first view of the current Camera. The LOD bias is applied like a mipmap bias, each
+// step halving the coverage. Returns ~0u when the node is below its last coverage and is culled.
+static uint32_t selectLod(Model* model, uint32_t nodeIndex, LodContext* context) {
   ModelNode* node = &model->data->nodes[nodeIndex];
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    updateGlobalTransform(model, node->children[i], global);
+  float* sphere = model->resources->nodeBounds + 4 * nodeIndex;
+
+  if (node->lodCount == 0 || sphere[3] < 0.f) {
+    return 0;
+  }
+
+  float m[16];
+  float center[4] = { sphere[0], sphere[1], sphere[2], 1.f };
+  mat4_multiply(mat4_init(m, context->view), model->globalTransforms + 16 * nodeIndex);
+  mat4_transform(m, center);
+
+  float scale = 0.f;
+  for (uint32_t i = 0; i < 3; i++) {
+    scale = MAX(scale, m[4 * i + 0] * m[4 * i + 0] + m[4 * i + 1] * m[4 * i + 1] + m[4 * i + 2] * m[4 * i + 2]);
+  }
+
+  float radius = sphere[3] * sqrtf(scale);
+  float distance = -center[2];
+  float coverage;
+
+  if (context->orthographic) {
+    coverage = radius * context->scale;
+  } else if (distance > radius) {
+    coverage = radius * context->scale / distance;
+  } else {
+    return 0;
   }
+
+  uint32_t level = 0;
+  while (level < node->lodCount && coverage < node->lodCoverage[level]) {
+    level++;
+  }
+
+  return level == node->lodCount && coverage < node->lodCoverage[level] ? ~0u : level;
 }
 
-static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
+static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances, LodContext* context) {
   ModelNode* node = &model->data->nodes[nodeIndex];
   mat4 globalTransform = model->globalTransforms + 16 * nodeIndex;
-  float poseMatrix[16 * MAX_BONES];
-  float* pose = NULL;
 
+  uint32_t pose = ~0u;
+
+  // The palette is uploaded once and shared by all of the node's primitives
   if (node->skin != ~0u) {
     ModelSkin* skin = &model->data->skins[node->skin];
-    pose = poseMatrix;
+    pose = lovrGraphicsUploadPose(model->poses + 16 * model->resources->poseOffsets[nodeIndex], skin->jointCount);
+  }
 
-    for (uint32_t j = 0; j < skin->jointCount; j++) {
-      mat4 globalJointTransform = model->globalTransforms + 16 * skin->joints[j];
-      mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
-      mat4 jointPose = pose + 16 * j;
+  Texture* instancePoses = instances > 1 && pose != ~0u ? model->instancePoses : NULL;
+  uint32_t instancePoseOffset = model->resources->poseOffsets[nodeIndex];
+  bool batched = model->resources->staticNodes && model->resources->staticNodes[nodeIndex];
+  uint32_t level = batched ? ~0u : selectLod(model, nodeIndex, context);
+  uint32_t primitiveIndex = node->primitiveIndex;
+  uint32_t primitiveCount = level == ~0u ? 0 : node->primitiveCount;
+
+  // MSFT_lod levels are whole nodes, drawn with the transform of the node they replace
+  if (level != ~0u && level > 0 && node->lodNodes[level - 1] != ~0u) {
+    ModelNode* lod = &model->data->nodes[node->lodNodes[level - 1]];
+    primitiveIndex = lod->primitiveIndex;
+    primitiveCount = lod->primitiveCount;
+    level = 0;
+  }
 
-      mat4_set(jointPose, globalTransform);
-      mat4_invert(jointPose);
-      mat4_multiply(jointPose, globalJointTransform);
-      mat4_multiply(jointPose, inverseBindMatrix);
-    }
+  // GPU instancing needs a shader that reads lovrInstanceTexture, the default shaders switch to a
+  // variant that does, custom shaders without it get one draw per instance
+  bool instanceTexture = false;
+  if (node->instanceCount > 0 && instances <= 1) {
+    Shader* shader = lovrGraphicsGetShader();
+    instanceTexture = !shader || lovrShaderHasUniform(shader, "lovrInstanceTexture");
   }
 
-  for (uint32_t i = 0; i < node->primitiveCount; i++) {
-    lovrGraphicsDrawMesh(model->meshes[node->primitiveIndex + i], globalTransform, instances, pose);
+  for (uint32_t i = 0; i < primitiveCount; i++) {
+    uint32_t index = primitiveIndex + i;
+    ModelPrimitive* primitive = &model->data->primitives[index];
+    Material* override = model->materials && primitive->material != ~0u ? model->materials[primitive->material] : NULL;
+    Mesh* mesh = model->resources->meshes[index];
+
+    if (level > 0 && primitive->lodCount > 0 && model->resources->lodMeshes) {
+      mesh = model->resources->lodMeshes[index * (MAX_LODS - 1) + MIN(level, primitive->lodCount) - 1];
+    }
+
+    if (node->instanceCount == 0) {
+      lovrGraphicsDrawMesh(mesh, override, globalTransform, instances, pose, instancePoses, instancePoseOffset);
+    } else if (instanceTexture) {
+      Texture* instanceTransforms = model->resources->instanceTransforms;
+      lovrGraphicsDrawMeshInstanced(mesh, override, globalTransform, node->instanceCount, pose, instanceTransforms, model->resources->instanceOffsets[nodeIndex]);
+    } else {
+      for (uint32_t j = 0; j < node->instanceCount; j++) {
+        float transform[16];
+        mat4_multiply(mat4_init(transform, globalTransform), node->instances + 16 * j);
+        lovrGraphicsDrawMesh(mesh, override, transform, instances, pose, instancePoses, instancePoseOffset);
+      }
+    }
   }
 
   for (uint32_t i = 0; i < node->childCount; i++) {
-    renderNode(model, node->children[i], instances);
+    renderNode(model, node->children[i], instances, context);
   }
 }
 
-Model* lovrModelCreate(ModelData* data) {
-  Model* model = lovrAlloc(Model);
-  model->data = data;
+static const size_t attributeTypeSizes[] = {
+  [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4
+};
+
+static void readAttribute(ModelData* data, ModelAttribute* attribute, uint32_t index, float* value) {
+  ModelBuffer* buffer = &data->buffers[attribute->buffer];
+  size_t size = attributeTypeSizes[attribute->type] * attribute->components;
+  char* p = buffer->data + attribute->offset + index * (buffer->stride ? buffer->stride : size);
+  bool normalized = attribute->normalized;
+
+  for (uint32_t i = 0; i < attribute->components && i < 4; i++) {
+    switch (attribute->type) {
+      case I8: value[i] = normalized ? MAX(((int8_t*) p)[i] / 127.f, -1.f) : ((int8_t*) p)[i]; break;
+      case U8: value[i] = normalized ? ((uint8_t*) p)[i] / 255.f : ((uint8_t*) p)[i]; break;
+      case I16: value[i] = normalized ? MAX(((int16_t*) p)[i] / 32767.f, -1.f) : ((int16_t*) p)[i]; break;
+      case U16: value[i] = normalized ? ((uint16_t*) p)[i] / 65535.f : ((uint16_t*) p)[i]; break;
+      case I32: value[i] = (float) ((int32_t*) p)[i]; break;
+      case U32: value[i] = (float) ((uint32_t*) p)[i]; break;
+      case F32: value[i] = ((float*) p)[i]; break;
+      default: break;
+    }
+  }
+}
+
+typedef struct {
+  uint32_t material;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t rangeCount;
+  uint32_t stride;
+  bool attributes[MAX_DEFAULT_ATTRIBUTES];
+  float* vertices;
+  uint32_t* indices;
+} StaticBatchBuilder;
+
+// Nodes that can never move (no animation targets them or an ancestor, and they aren't skinned) are
+// pre-transformed into one mesh per material, so a scene with thousands of small primitives draws a
+// handful of meshes. Each primitive keeps its index range and bounds in the batch, for culling.
+// Posing a batched node won't move its geometry. Nodes with LODs or instances are left out.
+static void createStaticBatches(ModelResources* resources) {
+  ModelData* data = resources->data;
+  bool* animated = calloc(data->nodeCount, sizeof(bool));
+  float* transforms = malloc(data->nodeCount * 16 * sizeof(float));
+  uint32_t* batchIndices = malloc((data->materialCount + 1) * sizeof(uint32_t));
+  StaticBatchBuilder* builders = calloc(data->materialCount + 1, sizeof(StaticBatchBuilder));
+  resources->staticNodes = calloc(data->nodeCount, sizeof(bool));
+  lovrAssert(animated && transforms && batchIndices && builders && resources->staticNodes, "Out of memory");
+  memset(batchIndices, 0xff, (data->materialCount + 1) * sizeof(uint32_t));
+
+  for (uint32_t i = 0; i < data->channelCount; i++) {
+    animated[data->channels[i].nodeIndex] = true;
+  }
+
+  // Default pose, and a first pass to size each material's batch
+  float identity[16] = MAT4_IDENTITY;
+  for (uint32_t i = 0; i < resources->nodeOrderCount; i++) {
+    uint32_t index = resources->nodeOrder[i];
+    uint32_t parent = resources->nodeParents[index];
+    ModelNode* node = &data->nodes[index];
+    mat4 global = transforms + 16 * index;
+    mat4 parentTransform = parent == ~0u ? identity : transforms + 16 * parent;
+
+    if (node->matrix) {
+      mat4_multiply(mat4_init(global, parentTransform), node->transform.matrix);
+    } else {
+      NodeTransform local;
+      memcpy(local.properties[PROP_TRANSLATION], node->transform.properties.translation, 4 * sizeof(float));
+      memcpy(local.properties[PROP_ROTATION], node->transform.properties.rotation, 4 * sizeof(float));
+      memcpy(local.properties[PROP_SCALE], node->transform.properties.scale, 4 * sizeof(float));
+      composeTransform(global, parentTransform, &local);
+    }
+
+    animated[index] |= parent != ~0u && animated[parent];
+    bool batchable = !animated[index] && node->skin == ~0u && node->primitiveCount > 0 && node->lodCount == 0 && node->instanceCount == 0;
+    for (uint32_t j = 0; j < node->primitiveCount && batchable; j++) {
+      ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+      batchable = primitive->mode == DRAW_TRIANGLES && primitive->attributes[ATTR_POSITION];
+    }
+
+    if (!batchable) {
+      continue;
+    }
+
+    resources->staticNodes[index] = true;
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+      uint32_t slot = primitive->material == ~0u ? data->materialCount : primitive->material;
+
+      if (batchIndices[slot] == ~0u) {
+        batchIndices[slot] = resources->staticBatchCount++;
+        builders[batchIndices[slot]].material = primitive->material;
+      }
+
+      StaticBatchBuilder* builder = &builders[batchIndices[slot]];
+      uint32_t vertexCount = primitive->attributes[ATTR_POSITION]->count;
+      builder->vertexCount += vertexCount;
+      builder->indexCount += primitive->indices ? primitive->indices->count : vertexCount;
+      builder->rangeCount++;
+      resources->staticRangeCount++;
+
+      for (uint32_t k = 0; k < MAX_DEFAULT_ATTRIBUTES; k++) {
+        builder->attributes[k] |= primitive->attributes[k] != NULL;
+      }
+    }
+  }
+
+  static const uint32_t components[] = {
+    [ATTR_POSITION] = 3, [ATTR_NORMAL] = 3, [ATTR_TEXCOORD] = 2, [ATTR_COLOR] = 4, [ATTR_TANGENT] = 4
+  };
+
+  resources->staticBatches = calloc(resources->staticBatchCount, sizeof(StaticBatch));
+  resources->staticRanges = malloc(resources->staticRangeCount * sizeof(StaticRange));
+  lovrAssert(resources->staticBatches && resources->staticRanges, "Out of memory");
+
+  uint32_t rangeCount = 0;
+  for (uint32_t i = 0; i < resources->staticBatchCount; i++) {
+    StaticBatchBuilder* builder = &builders[i];
+    builder->attributes[ATTR_BONES] = builder->attributes[ATTR_WEIGHTS] = false;
+    for (uint32_t k = 0; k < MAX_DEFAULT_ATTRIBUTES; k++) {
+      builder->stride += builder->attributes[k] ? components[k] : 0;
+    }
+
+    builder->vertices = malloc(builder->vertexCount * builder->stride * sizeof(float));
+    builder->indices = malloc(builder->indexCount * sizeof(uint32_t));
+    lovrAssert(builder->vertices && builder->indices, "Out of memory");
+    builder->vertexCount = 0;
+    builder->indexCount = 0;
+
+    resources->staticBatches[i].material = builder->material;
+    resources->staticBatches[i].rangeStart = rangeCount;
+    rangeCount += builder->rangeCount;
+  }
+
+  // Second pass, transform the vertices into model space and append them to their batch
+  for (uint32_t i = 0; i < resources->nodeOrderCount; i++) {
+    uint32_t index = resources->nodeOrder[i];
+    if (!resources->staticNodes[index]) {
+      continue;
+    }
+
+    ModelNode* node = &data->nodes[index];
+    mat4 transform = transforms + 16 * index;
+    float normalMatrix[16];
+    mat4_transpose(mat4_invert(mat4_init(normalMatrix, transform)));
+
+    // Mirrored transforms flip the winding of every triangle
+    float* m = transform;
+    float determinant =
+      m[0] * (m[5] * m[10] - m[6] * m[9]) -
+      m[4] * (m[1] * m[10] - m[2] * m[9]) +
+      m[8] * (m[1] * m[6] - m[2] * m[5]);
+    bool flip = determinant < 0.f;
+
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+      uint32_t slot = primitive->material == ~0u ? data->materialCount : primitive->material;
+      StaticBatch* batch = &resources->staticBatches[batchIndices[slot]];
+      StaticBatchBuilder* builder = &builders[batchIndices[slot]];
+      StaticRange* range = &resources->staticRanges[batch->rangeStart + batch->rangeCount++];
+      uint32_t vertexCount = primitive->attributes[ATTR_POSITION]->count;
+      uint32_t base = builder->vertexCount;
+
+      *range = (StaticRange) {
+        .node = index,
+        .primitive = node->primitiveIndex + j,
+        .start = builder->indexCount,
+        .aabb = { FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX }
+      };
+
+      for (uint32_t v = 0; v < vertexCount; v++) {
+        float* vertex = builder->vertices + (base + v) * builder->stride;
+        for (uint32_t k = 0; k < MAX_DEFAULT_ATTRIBUTES; k++) {
+          if (!builder->attributes[k]) {
+            continue;
+          }
+
+          float value[4] = { 0.f, 0.f, 0.f, 1.f };
+          if (k == ATTR_COLOR) {
+            value[0] = value[1] = value[2] = 1.f;
+          }
+
+          if (primitive->attributes[k]) {
+            readAttribute(data, primitive->attributes[k], v, value);
+          }
+
+          if (k == ATTR_POSITION) {
+            mat4_transform(transform, value);
+            range->aabb[0] = MIN(range->aabb[0], value[0]);
+            range->aabb[1] = MAX(range->aabb[1], value[0]);
+            range->aabb[2] = MIN(range->aabb[2], value[1]);
+            range->aabb[3] = MAX(range->aabb[3], value[1]);
+            range->aabb[4] = MIN(range->aabb[4], value[2]);
+            range->aabb[5] = MAX(range->aabb[5], value[2]);
+          } else if (k == ATTR_NORMAL || k == ATTR_TANGENT) {
+            float w = value[3];
+            mat4_transformDirection(k == ATTR_NORMAL ? normalMatrix : transform, value);
+            vec3_normalize(value);
+            value[3] = w;
+          }
+
+          memcpy(vertex, value, components[k] * sizeof(float));
+          vertex += components[k];
+        }
+      }
+
+      if (primitive->indices) {
+        ModelAttribute* indices = primitive->indices;
+        ModelBuffer* buffer = &data->buffers[indices->buffer];
+        char* p = buffer->data + indices->offset;
+        for (uint32_t k = 0; k < indices->count; k++) {
+          builder->indices[builder->indexCount + k] = base + (indices->type == U16 ? ((uint16_t*) p)[k] : ((uint32_t*) p)[k]);
+        }
+        range->count = indices->count;
+      } else {
+        for (uint32_t k = 0; k < vertexCount; k++) {
+          builder->indices[builder->indexCount + k] = base + k;
+        }
+        range->count = vertexCount;
+      }
+
+      if (flip) {
+        uint32_t* triangle = builder->indices + builder->indexCount;
+        for (uint32_t k = 0; k + 2 < range->count; k += 3) {
+          uint32_t temp = triangle[k + 1];
+          triangle[k + 1] = triangle[k + 2];
+          triangle[k + 2] = temp;
+        }
+      }
+
+      builder->vertexCount += vertexCount;
+      builder->indexCount += range->count;
+    }
+  }
+
+  for (uint32_t i = 0; i < resources->staticBatchCount; i++) {
+    StaticBatchBuilder* builder = &builders[i];
+    StaticBatch* batch = &resources->staticBatches[i];
+    batch->mesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
+
+    if (batch->material != ~0u) {
+      lovrMeshSetMaterial(batch->mesh, resources->materials[batch->material]);
+    }
+
+    size_t vertexSize = builder->stride * sizeof(float);
+    Buffer* vertexBuffer = lovrBufferCreate(builder->vertexCount * vertexSize, builder->vertices, BUFFER_VERTEX, USAGE_STATIC, false);
+    for (uint32_t k = 0, offset = 0; k < MAX_DEFAULT_ATTRIBUTES; k++) {
+      if (builder->attributes[k]) {
+        lovrMeshAttachAttribute(batch->mesh, lovrShaderAttributeNames[k], &(MeshAttribute) {
+          .buffer = vertexBuffer,
+          .offset = offset,
+          .stride = vertexSize,
+          .type = F32,
+          .components = components[k]
+        });
+        offset += components[k] * sizeof(float);
+      }
+    }
+
+    lovrMeshAttachAttribute(batch->mesh, "lovrDrawID", &(MeshAttribute) {
+      .buffer = lovrGraphicsGetIdentityBuffer(),
+      .type = U8,
+      .components = 1,
+      .divisor = 1,
+      .integer = true
+    });
+
+    // Indices are narrowed to 16 bits in place when possible
+    size_t indexSize = sizeof(uint32_t);
+    if (builder->vertexCount <= 0xffff) {
+      uint16_t* narrow = (uint16_t*) builder->indices;
+      for (uint32_t k = 0; k < builder->indexCount; k++) {
+        narrow[k] = (uint16_t) builder->indices[k];
+      }
+      indexSize = sizeof(uint16_t);
+    }
+
+    Buffer* indexBuffer = lovrBufferCreate(builder->indexCount * indexSize, builder->indices, BUFFER_INDEX, USAGE_STATIC, false);
+    lovrMeshSetIndexBuffer(batch->mesh, indexBuffer, builder->indexCount, indexSize, 0);
+    lovrMeshSetDrawRange(batch->mesh, 0, builder->indexCount);
+    lovrRelease(Buffer, vertexBuffer);
+    lovrRelease(Buffer, indexBuffer);
+    free(builder->vertices);
+    free(builder->indices);
+  }
+
+  free(animated);
+  free(transforms);
+  free(batchIndices);
+  free(builders);
+}
+
+static Mesh* createPrimitiveMesh(ModelResources* resources, ModelPrimitive* primitive) {
+  ModelData* data = resources->data;
+  Mesh* mesh = lovrMeshCreate(primitive->mode, NULL, 0);
+
+  if (primitive->material != ~0u) {
+    lovrMeshSetMaterial(mesh, resources->materials[primitive->material]);
+  }
+
+  bool setDrawRange = false;
+  for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+    if (primitive->attributes[j]) {
+      ModelAttribute* attribute = primitive->attributes[j];
+
+      if (!resources->buffers[attribute->buffer]) {
+        ModelBuffer* buffer = &data->buffers[attribute->buffer];
+        resources->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_VERTEX, USAGE_STATIC, false);
+      }
+
+      lovrMeshAttachAttribute(mesh, lovrShaderAttributeNames[j], &(MeshAttribute) {
+        .buffer = resources->buffers[attribute->buffer],
+        .offset = attribute->offset,
+        .stride = data->buffers[attribute->buffer].stride,
+        .type = attribute->type,
+        .components = attribute->components,
+        .integer = j == ATTR_BONES,
+        .normalized = attribute->normalized
+      });
+
+      if (!setDrawRange && !primitive->indices) {
+        lovrMeshSetDrawRange(mesh, 0, attribute->count);
+        setDrawRange = true;
+      }
+    }
+  }
+
+  lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) {
+    .buffer = lovrGraphicsGetIdentityBuffer(),
+    .type = U8,
+    .components = 1,
+    .divisor = 1,
+    .integer = true
+  });
+
+  return mesh;
+}
+
+// Uploads a texture with the settings of the first material slot using it, NULL if nothing uses it.
+// Images are cached by their contents, so their uploads are shared between models too.
+Texture* lovrModelCreateTexture(ModelData* data, uint32_t index) {
+  for (uint32_t i = 0; i < data->materialCount; i++) {
+    for (uint32_t j = 0; j < MAX_MATERIAL_TEXTURES; j++) {
+      if (data->materials[i].textures[j] == index) {
+        TextureData* textureData = lovrModelDataGetTexture(data, index);
+        bool srgb = j == TEXTURE_DIFFUSE || j == TEXTURE_EMISSIVE;
+        TextureFilter filter = data->materials[i].filters[j];
+        TextureWrap wrap = data->materials[i].wraps[j];
+
+        uint64_t key = 0;
+        uint64_t source = lovrCacheGetKey(textureData);
+        if (source) {
+          uint64_t options = srgb | filter.mode << 1 | wrap.s << 4 | wrap.t << 8 | wrap.r << 12 | (uint64_t) filter.anisotropy << 16;
+          key = lovrCacheKey("Texture", source, options);
+          Texture* texture = lovrCacheGet(key);
+          if (texture) {
+            return texture;
+          }
+        }
+
+        Texture* texture = lovrTextureCreate(TEXTURE_2D, &textureData, 1, srgb, true, 0);
+        lovrTextureSetFilter(texture, filter);
+        lovrTextureSetWrap(texture, wrap);
+        lovrTextureSetSource(texture, textureData);
+
+        if (key) {
+          lovrCachePut(key, source, texture, lovrTextureGetMemorySize(texture));
+        }
+
+        return texture;
+      }
+    }
+  }
+  return NULL;
+}
+
+static ModelResources* lovrModelResourcesCreate(ModelData* data, bool batch, Texture** textures) {
+  ModelResources* resources = lovrAlloc(ModelResources);
+  resources->data = data;
+  resources->batched = batch;
   lovrRetain(data);
 
   // Materials
   if (data->materialCount > 0) {
-    model->materials = malloc(data->materialCount * sizeof(Material*));
+    resources->materials = malloc(data->materialCount * sizeof(Material*));
 
     if (data->textureCount > 0) {
-      model->textures = calloc(data->textureCount, sizeof(Texture*));
+      resources->textures = calloc(data->textureCount, sizeof(Texture*));
+
+      // Textures that were already uploaded (e.g. by an async load) are used instead of created
+      if (textures) {
+        for (uint32_t i = 0; i < data->textureCount; i++) {
+          resources->textures[i] = textures[i];
+          lovrRetain(textures[i]);
+        }
+      }
     }
 
     for (uint32_t i = 0; i < data->materialCount; i++) {
@@ -103,117 +701,273 @@ Model* lovrModelCreate(ModelData* data) {
         uint32_t index = data->materials[i].textures[j];
 
         if (index != ~0u) {
-          if (!model->textures[index]) {
-            TextureData* textureData = data->textures[index];
-            bool srgb = j == TEXTURE_DIFFUSE || j == TEXTURE_EMISSIVE;
-            model->textures[index] = lovrTextureCreate(TEXTURE_2D, &textureData, 1, srgb, true, 0);
-            lovrTextureSetFilter(model->textures[index], data->materials[i].filters[j]);
-            lovrTextureSetWrap(model->textures[index], data->materials[i].wraps[j]);
+          if (!resources->textures[index]) {
+            resources->textures[index] = lovrModelCreateTexture(data, index);
           }
 
-          lovrMaterialSetTexture(material, j, model->textures[index]);
+          lovrMaterialSetTexture(material, j, resources->textures[index]);
         }
       }
 
-      model->materials[i] = material;
+      resources->materials[i] = material;
     }
   }
 
   // Geometry
   if (data->primitiveCount > 0) {
     if (data->bufferCount > 0) {
-      model->buffers = calloc(data->bufferCount, sizeof(Buffer*));
+      resources->buffers = calloc(data->bufferCount, sizeof(Buffer*));
     }
 
-    model->meshes = calloc(data->primitiveCount, sizeof(Mesh*));
+    resources->meshes = calloc(data->primitiveCount, sizeof(Mesh*));
     for (uint32_t i = 0; i < data->primitiveCount; i++) {
       ModelPrimitive* primitive = &data->primitives[i];
-      model->meshes[i] = lovrMeshCreate(primitive->mode, NULL, 0);
+      resources->meshes[i] = createPrimitiveMesh(resources, primitive);
 
-      if (primitive->material != ~0u) {
-        lovrMeshSetMaterial(model->meshes[i], model->materials[primitive->material]);
-      }
+      if (primitive->indices) {
+        ModelAttribute* attribute = primitive->indices;
 
-      bool setDrawRange = false;
-      for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
-        if (primitive->attributes[j]) {
-          ModelAttribute* attribute = primitive->attributes[j];
+        if (!resources->buffers[attribute->buffer]) {
+          ModelBuffer* buffer = &data->buffers[attribute->buffer];
+          resources->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_INDEX, USAGE_STATIC, false);
+        }
 
-          if (!model->buffers[attribute->buffer]) {
-            ModelBuffer* buffer = &data->buffers[attribute->buffer];
-            model->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_VERTEX, USAGE_STATIC, false);
-          }
+        size_t indexSize = attribute->type == U16 ? 2 : 4;
+        lovrMeshSetIndexBuffer(resources->meshes[i], resources->buffers[attribute->buffer], attribute->count, indexSize, attribute->offset);
+        lovrMeshSetDrawRange(resources->meshes[i], 0, attribute->count);
+      }
+    }
 
-          lovrMeshAttachAttribute(model->meshes[i], lovrShaderAttributeNames[j], &(MeshAttribute) {
-            .buffer = model->buffers[attribute->buffer],
-            .offset = attribute->offset,
-            .stride = data->buffers[attribute->buffer].stride,
-            .type = attribute->type,
-            .components = attribute->components,
-            .integer = j == ATTR_BONES,
-            .normalized = attribute->normalized
-          });
-
-          if (!setDrawRange && !primitive->indices) {
-            lovrMeshSetDrawRange(model->meshes[i], 0, attribute->count);
-            setDrawRange = true;
-          }
+    // Simplified LODs share the vertices of their primitive, with their own range of lodIndices
+    if (data->lodIndexCount > 0) {
+      resources->lodBuffer = lovrBufferCreate(data->lodIndexCount * sizeof(uint32_t), data->lodIndices, BUFFER_INDEX, USAGE_STATIC, false);
+      resources->lodMeshes = calloc(data->primitiveCount * (MAX_LODS - 1), sizeof(Mesh*));
+      lovrAssert(resources->lodMeshes, "Out of memory");
+
+      for (uint32_t i = 0; i < data->primitiveCount; i++) {
+        ModelPrimitive* primitive = &data->primitives[i];
+        for (uint32_t j = 0; j < primitive->lodCount; j++) {
+          Mesh* mesh = createPrimitiveMesh(resources, primitive);
+          lovrMeshSetIndexBuffer(mesh, resources->lodBuffer, primitive->lods[j].count, sizeof(uint32_t), primitive->lods[j].start * sizeof(uint32_t));
+          lovrMeshSetDrawRange(mesh, 0, primitive->lods[j].count);
+          resources->lodMeshes[i * (MAX_LODS - 1) + j] = mesh;
         }
       }
+    }
+  }
 
-      lovrMeshAttachAttribute(model->meshes[i], "lovrDrawID", &(MeshAttribute) {
-        .buffer = lovrGraphicsGetIdentityBuffer(),
-        .type = U8,
-        .components = 1,
-        .divisor = 1,
-        .integer = true
-      });
+  // Flatten the node hierarchy, depth first from the root so parents come before their children
+  resources->nodeOrder = malloc(data->nodeCount * sizeof(uint32_t));
+  resources->nodeParents = malloc(data->nodeCount * sizeof(uint32_t));
+  uint32_t* stack = malloc(data->nodeCount * sizeof(uint32_t));
+  lovrAssert(resources->nodeOrder && resources->nodeParents && stack, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    resources->nodeParents[i] = ~0u;
+  }
 
-      if (primitive->indices) {
-        ModelAttribute* attribute = primitive->indices;
+  uint32_t stackSize = 0;
+  if (data->rootNode < data->nodeCount) {
+    stack[stackSize++] = data->rootNode;
+  }
 
-        if (!model->buffers[attribute->buffer]) {
-          ModelBuffer* buffer = &data->buffers[attribute->buffer];
-          model->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_INDEX, USAGE_STATIC, false);
-        }
+  while (stackSize > 0) {
+    uint32_t index = stack[--stackSize];
+    ModelNode* node = &data->nodes[index];
+    resources->nodeOrder[resources->nodeOrderCount++] = index;
+    for (uint32_t i = node->childCount; i-- > 0;) {
+      if (stackSize < data->nodeCount) {
+        resources->nodeParents[node->children[i]] = index;
+        stack[stackSize++] = node->children[i];
+      }
+    }
+  }
 
-        size_t indexSize = attribute->type == U16 ? 2 : 4;
-        lovrMeshSetIndexBuffer(model->meshes[i], model->buffers[attribute->buffer], attribute->count, indexSize, attribute->offset);
-        lovrMeshSetDrawRange(model->meshes[i], 0, attribute->count);
+  free(stack);
+
+  // Every skinned node gets its own range of skinning matrices
+  resources->poseOffsets = malloc(data->nodeCount * sizeof(uint32_t));
+  lovrAssert(resources->poseOffsets, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    uint32_t skin = data->nodes[i].skin;
+    if (skin == ~0u) {
+      resources->poseOffsets[i] = ~0u;
+    } else {
+      uint32_t jointCount = data->skins[skin].jointCount;
+      lovrAssert(jointCount <= MAX_BONES, "Skin has too many joints (%d), the maximum is %d", jointCount, MAX_BONES);
+      resources->poseOffsets[i] = resources->poseCount;
+      resources->poseCount += jointCount;
+    }
+  }
+
+  // The instance matrices of every instanced node are uploaded once, 4 texels per matrix, wrapping
+  // to new rows when they don't fit in one
+  uint32_t instanceCount = 0;
+  resources->instanceOffsets = malloc(data->nodeCount * sizeof(uint32_t));
+  lovrAssert(resources->instanceOffsets, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    resources->instanceOffsets[i] = instanceCount;
+    instanceCount += data->nodes[i].instanceCount;
+  }
+
+  if (instanceCount > 0) {
+    uint32_t maxSize = (uint32_t) lovrGraphicsGetLimits()->textureSize;
+    uint32_t width = 4 * MIN(instanceCount, maxSize / 4);
+    uint32_t height = (4 * instanceCount + width - 1) / width;
+    lovrAssert(height <= maxSize, "Model has too many node instances (%d)", instanceCount);
+    TextureData* instanceData = lovrTextureDataCreate(width, height, NULL, 0x0, FORMAT_RGBA32F);
+    float* matrices = instanceData->blob->data;
+    for (uint32_t i = 0; i < data->nodeCount; i++) {
+      ModelNode* node = &data->nodes[i];
+      memcpy(matrices + 16 * resources->instanceOffsets[i], node->instances, node->instanceCount * 16 * sizeof(float));
+    }
+    resources->instanceTransforms = lovrTextureCreate(TEXTURE_2D, &instanceData, 1, false, false, 0);
+    lovrTextureSetFilter(resources->instanceTransforms, (TextureFilter) { .mode = FILTER_NEAREST });
+    lovrRelease(TextureData, instanceData);
+  }
+
+  // Bounding spheres of each node's primitives, in the node's space, for LOD selection.  Instanced
+  // nodes are spread out over their instances, so they don't get one and always use LOD 0.
+  resources->nodeBounds = malloc(data->nodeCount * 4 * sizeof(float));
+  lovrAssert(resources->nodeBounds, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    ModelNode* node = &data->nodes[i];
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    float* sphere = resources->nodeBounds + 4 * i;
+    sphere[3] = -1.f;
+
+    for (uint32_t j = 0; j < node->primitiveCount && node->instanceCount == 0; j++) {
+      ModelAttribute* position = data->primitives[node->primitiveIndex + j].attributes[ATTR_POSITION];
+      if (position && position->hasMin && position->hasMax) {
+        for (uint32_t k = 0; k < 3; k++) {
+          min[k] = MIN(min[k], position->min[k]);
+          max[k] = MAX(max[k], position->max[k]);
+        }
+        sphere[3] = 0.f;
       }
     }
+
+    if (sphere[3] == 0.f) {
+      float extent[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+      vec3_set(sphere, (min[0] + max[0]) * .5f, (min[1] + max[1]) * .5f, (min[2] + max[2]) * .5f);
+      sphere[3] = .5f * sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+    }
   }
 
-  model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
-  model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
-  lovrModelResetPose(model);
-  return model;
+  if (batch) {
+    createStaticBatches(resources);
+  }
+
+  return resources;
 }
 
-void lovrModelDestroy(void* ref) {
-  Model* model = ref;
+static uint64_t hashResources(ModelData* data, bool batched) {
+  uintptr_t key[2] = { (uintptr_t) data, batched };
+  return hash64(key, sizeof(key));
+}
+
+static void lovrModelResourcesDestroy(void* ref) {
+  ModelResources* resources = ref;
+  if (sharedResourcesInitialized) {
+    map_remove(&sharedResources, hashResources(resources->data, resources->batched));
+  }
+
+  if (resources->buffers) {
+    for (uint32_t i = 0; i < resources->data->bufferCount; i++) {
+      lovrRelease(Buffer, resources->buffers[i]);
+    }
+    free(resources->buffers);
+  }
+
+  if (resources->meshes) {
+    for (uint32_t i = 0; i < resources->data->primitiveCount; i++) {
+      lovrRelease(Mesh, resources->meshes[i]);
+    }
+    free(resources->meshes);
+  }
 
-  if (model->buffers) {
-    for (uint32_t i = 0; i < model->data->bufferCount; i++) {
-      lovrRelease(Buffer, model->buffers[i]);
+  if (resources->textures) {
+    for (uint32_t i = 0; i < resources->data->textureCount; i++) {
+      lovrRelease(Texture, resources->textures[i]);
     }
-    free(model->buffers);
+    free(resources->textures);
   }
 
-  if (model->meshes) {
-    for (uint32_t i = 0; i < model->data->primitiveCount; i++) {
-      lovrRelease(Mesh, model->meshes[i]);
+  if (resources->materials) {
+    for (uint32_t i = 0; i < resources->data->materialCount; i++) {
+      lovrRelease(Material, resources->materials[i]);
     }
-    free(model->meshes);
+    free(resources->materials);
   }
 
-  if (model->textures) {
-    for (uint32_t i = 0; i < model->data->textureCount; i++) {
-      lovrRelease(Texture, model->textures[i]);
+  for (uint32_t i = 0; i < resources->staticBatchCount; i++) {
+    lovrRelease(Mesh, resources->staticBatches[i].mesh);
+  }
+
+  if (resources->lodMeshes) {
+    for (uint32_t i = 0; i < resources->data->primitiveCount * (MAX_LODS - 1); i++) {
+      lovrRelease(Mesh, resources->lodMeshes[i]);
     }
-    free(model->textures);
+    free(resources->lodMeshes);
   }
 
+  lovrRelease(Buffer, resources->lodBuffer);
+  free(resources->nodeBounds);
+  free(resources->nodeOrder);
+  free(resources->nodeParents);
+  free(resources->poseOffsets);
+  free(resources->instanceOffsets);
+  lovrRelease(Texture, resources->instanceTransforms);
+  free(resources->staticNodes);
+  free(resources->staticBatches);
+  free(resources->staticRanges);
+  lovrRelease(ModelData, resources->data);
+}
+
+// GPU resources are shared by every Model created from the same ModelData (with the same batching).
+// The textures are optional, any that are NULL get created.
+Model* lovrModelCreate(ModelData* data, bool batch, Texture** textures) {
+  if (!sharedResourcesInitialized) {
+    map_init(&sharedResources, 0);
+    sharedResourcesInitialized = true;
+  }
+
+  uint64_t hash = hashResources(data, batch);
+  uint64_t entry = map_get(&sharedResources, hash);
+  ModelResources* resources;
+
+  if (entry == MAP_NIL) {
+    resources = lovrModelResourcesCreate(data, batch, textures);
+    map_set(&sharedResources, hash, (uint64_t) (uintptr_t) resources);
+  } else {
+    resources = (ModelResources*) (uintptr_t) entry;
+    lovrRetain(resources);
+  }
+
+  Model* model = lovrAlloc(Model);
+  model->data = data;
+  model->resources = resources;
+  lovrRetain(data);
+  model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
+  model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
+  model->keyframeCursors = calloc(data->channelCount, sizeof(uint32_t));
+  model->dirtyNodes = calloc(data->nodeCount, sizeof(bool));
+  model->poses = malloc(resources->poseCount * 16 * sizeof(float));
+  lovrModelResetPose(model);
+  return model;
+}
+
+// Models that are still alive keep their resources, they just aren't shared anymore
+void lovrModelDestroyShared() {
+  if (sharedResourcesInitialized) {
+    map_free(&sharedResources);
+    sharedResourcesInitialized = false;
+  }
+}
+
+void lovrModelDestroy(void* ref) {
+  Model* model = ref;
+
   if (model->materials) {
     for (uint32_t i = 0; i < model->data->materialCount; i++) {
       lovrRelease(Material, model->materials[i]);
@@ -221,9 +975,15 @@ void lovrModelDestroy(void* ref) {
     free(model->materials);
   }
 
+  _lovrRelease(model->resources, lovrModelResourcesDestroy);
   lovrRelease(ModelData, model->data);
   free(model->globalTransforms);
   free(model->localTransforms);
+  free(model->keyframeCursors);
+  free(model->dirtyNodes);
+  free(model->poses);
+  lovrRelease(Texture, model->instancePoses);
+  lovrRelease(TextureData, model->instancePoseData);
 }
 
 ModelData* lovrModelGetModelData(Model* model) {
@@ -231,23 +991,105 @@ ModelData* lovrModelGetModelData(Model* model) {
 }
 
 void lovrModelDraw(Model* model, mat4 transform, uint32_t instances) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
+  updateTransforms(model);
+
+  if (model->instancePosesDirty) {
+    TextureData* data = model->instancePoseData;
+    if (!model->instancePoses || lovrTextureGetHeight(model->instancePoses, 0) != data->height) {
+      lovrRelease(Texture, model->instancePoses);
+      model->instancePoses = lovrTextureCreate(TEXTURE_2D, &data, 1, false, false, 0);
+      lovrTextureSetFilter(model->instancePoses, (TextureFilter) { .mode = FILTER_NEAREST });
+    } else {
+      lovrTextureReplacePixels(model->instancePoses, data, 0, 0, 0, 0);
+    }
+    model->instancePosesDirty = false;
   }
 
   lovrGraphicsPush();
   lovrGraphicsMatrixTransform(transform);
-  renderNode(model, model->data->rootNode, instances);
+
+  LodContext context;
+  const Camera* camera = lovrGraphicsGetCamera();
+  float modelTransform[16];
+  lovrGraphicsGetTransform(modelTransform);
+  mat4_multiply(mat4_init(context.view, (float*) camera->viewMatrix[0]), modelTransform);
+  context.scale = camera->projection[0][5] * exp2f(-lovrGraphicsGetLodBias());
+  context.orthographic = camera->projection[0][15] == 1.f;
+
+  renderNode(model, model->data->rootNode, instances, &context);
+
+  for (uint32_t i = 0; i < model->resources->staticBatchCount; i++) {
+    StaticBatch* batch = &model->resources->staticBatches[i];
+    Material* override = model->materials && batch->material != ~0u ? model->materials[batch->material] : NULL;
+    lovrGraphicsDrawMesh(batch->mesh, override, NULL, instances, ~0u, NULL, 0);
+  }
+
   lovrGraphicsPop();
 }
 
+// Copies the current skinning palettes into one row of the instance pose texture. Instanced draws
+// pick their row using lovrInstanceID, the default shaders switch to a variant with the
+// animatedInstances flag for them, custom shaders need to set the flag themselves.  Each row has to fit
+// in a single texture row, so the bone count is limited to a quarter of the max texture size.
+static void reserveInstancePose(Model* model, uint32_t instance) {
+  ModelResources* resources = model->resources;
+  uint32_t maxSize = (uint32_t) lovrGraphicsGetLimits()->textureSize;
+  lovrAssert(resources->poseCount > 0, "Model has no skinned meshes");
+  lovrAssert(resources->poseCount <= maxSize / 4, "Model has too many bones (%d) for instance poses, the limit is %d", resources->poseCount, maxSize / 4);
+  lovrAssert(instance < maxSize, "Instance pose index %d is too big, the limit is %d", instance + 1, maxSize);
+
+  TextureData* data = model->instancePoseData;
+  uint32_t width = 4 * resources->poseCount;
+  if (!data || instance >= data->height) {
+    uint32_t height = data ? data->height : 1;
+    while (height <= instance) {
+      height *= 2;
+    }
+    height = MIN(height, maxSize);
+
+    TextureData* resized = lovrTextureDataCreate(width, height, NULL, 0x0, FORMAT_RGBA32F);
+    if (data) {
+      memcpy(resized->blob->data, data->blob->data, data->blob->size);
+      lovrRelease(TextureData, data);
+    }
+
+    model->instancePoseData = data = resized;
+  }
+}
+
+static void writeInstancePose(Model* model, uint32_t instance) {
+  ModelResources* resources = model->resources;
+  updateTransforms(model);
+  float* row = (float*) model->instancePoseData->blob->data + (size_t) instance * 4 * resources->poseCount * 4;
+  memcpy(row, model->poses, resources->poseCount * 16 * sizeof(float));
+  model->instancePosesDirty = true;
+}
+
+void lovrModelSetInstancePose(Model* model, uint32_t instance) {
+  reserveInstancePose(model, instance);
+  writeInstancePose(model, instance);
+}
+
+void lovrModelClearInstancePoses(Model* model) {
+  lovrRelease(Texture, model->instancePoses);
+  lovrRelease(TextureData, model->instancePoseData);
+  model->instancePoses = NULL;
+  model->instancePoseData = NULL;
+  model->instancePosesDirty = false;
+}
+
+static void sampleAnimation(Model* model, uint32_t animationIndex, float time, float alpha);
+
 void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha) {
   if (alpha <= 0.f) {
     return;
   }
 
   lovrAssert(animationIndex < model->data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", animationIndex, model->data->animationCount);
+  sampleAnimation(model, animationIndex, time, alpha);
+}
+
+static void sampleAnimation(Model* model, uint32_t animationIndex, float time, float alpha) {
   ModelAnimation* animation = &model->data->animations[animationIndex];
   time = fmodf(time, animation->duration);
 
@@ -255,61 +1097,15 @@ void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float a
     ModelAnimationChannel* channel = &animation->channels[i];
     uint32_t nodeIndex = channel->nodeIndex;
     NodeTransform* transform = &model->localTransforms[nodeIndex];
+    model->dirtyNodes[nodeIndex] = true;
 
-    uint32_t keyframe = 0;
-    while (keyframe < channel->keyframeCount && channel->times[keyframe] < time) {
-      keyframe++;
-    }
+    uint32_t* cursor = &model->keyframeCursors[channel - model->data->channels];
 
     float property[4];
     bool rotate = channel->property == PROP_ROTATION;
     size_t n = 3 + rotate;
     float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
-
-    if (keyframe == 0 || keyframe >= channel->keyframeCount) {
-      size_t index = CLAMP(keyframe, 0, channel->keyframeCount - 1);
-
-      // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
-      if (channel->smoothing == SMOOTH_CUBIC) {
-        index = 3 * index + 1;
-      }
-
-      memcpy(property, channel->data + index * n, n * sizeof(float));
-    } else {
-      float t1 = channel->times[keyframe - 1];
-      float t2 = channel->times[keyframe];
-      float z = (time - t1) / (t2 - t1);
-
-      switch (channel->smoothing) {
-        case SMOOTH_STEP:
-          memcpy(property, channel->data + (z >= .5f ? keyframe : keyframe - 1) * n, n * sizeof(float));
-          break;
-        case SMOOTH_LINEAR:
-          memcpy(property, channel->data + (keyframe - 1) * n, n * sizeof(float));
-          lerp(property, channel->data + keyframe * n, z);
-          break;
-        case SMOOTH_CUBIC: {
-          size_t stride = 3 * n;
-          float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
-          float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
-          float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
-          float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
-          float dt = t2 - t1;
-          float z2 = z * z;
-          float z3 = z2 * z;
-          float a = 2.f * z3 - 3.f * z2 + 1.f;
-          float b = 2.f * z3 - 3.f * z2 + 1.f;
-          float c = (-2.f * z3 + 3.f * z2);
-          float d = (z3 * -z2) * dt;
-          for (size_t j = 0; j < n; j++) {
-            property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
-          }
-          break;
-        }
-        default:
-          break;
-      }
-    }
+    lovrModelDataSampleChannel(channel, time, cursor, property);
 
     if (alpha >= 1.f) {
       memcpy(transform->properties[channel->property], property, n * sizeof(float));
@@ -321,16 +1117,109 @@ void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float a
   model->transformsDirty = true;
 }
 
+typedef struct {
+  ModelAnimationRequest* requests;
+  uint32_t* order;
+  uint32_t* groups;
+  uint32_t groupCount;
+} AnimationJob;
+
+// Each Model is handled start to finish by a single thread, applying its requests in order, so the
+// results are identical to calling lovrModelAnimate serially.  Requests with an instance index copy
+// the pose into that instance's row once the last of a run of requests for the same row is applied.
+static void animateGroup(void* context, uint32_t group) {
+  AnimationJob* job = context;
+  Model* model = NULL;
+  uint32_t end = job->groups[group + 1];
+  for (uint32_t i = job->groups[group]; i < end; i++) {
+    ModelAnimationRequest* request = &job->requests[job->order[i]];
+    model = request->model;
+    if (request->alpha > 0.f) {
+      sampleAnimation(model, request->animation, request->time, request->alpha);
+    }
+
+    if (request->instance != ~0u && (i + 1 == end || job->requests[job->order[i + 1]].instance != request->instance)) {
+      writeInstancePose(model, request->instance);
+    }
+  }
+
+  updateTransforms(model);
+}
+
+void lovrModelAnimateBatch(ModelAnimationRequest* requests, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    Model* model = requests[i].model;
+    uint32_t animation = requests[i].animation;
+    lovrAssert(animation < model->data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", animation, model->data->animationCount);
+    if (requests[i].instance != ~0u) {
+      reserveInstancePose(model, requests[i].instance);
+    }
+  }
+
+  // Group the requests by Model, keeping their original order within each group
+  map_t groupMap;
+  map_init(&groupMap, count);
+  uint32_t* groupOf = malloc(count * sizeof(uint32_t));
+  uint32_t* groups = calloc(count + 1, sizeof(uint32_t));
+  uint32_t* order = malloc(count * sizeof(uint32_t));
+  lovrAssert(groupOf && groups && order, "Out of memory");
+
+  uint32_t groupCount = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t hash = hash64(&requests[i].model, sizeof(Model*));
+    uint64_t group = map_get(&groupMap, hash);
+    if (group == MAP_NIL) {
+      group = groupCount++;
+      map_set(&groupMap, hash, group);
+    }
+    groupOf[i] = (uint32_t) group;
+    groups[group + 1]++;
+  }
+
+  for (uint32_t i = 0; i < groupCount; i++) {
+    groups[i + 1] += groups[i];
+  }
+
+  uint32_t* cursors = malloc(groupCount * sizeof(uint32_t));
+  lovrAssert(cursors, "Out of memory");
+  memcpy(cursors, groups, groupCount * sizeof(uint32_t));
+  for (uint32_t i = 0; i < count; i++) {
+    order[cursors[groupOf[i]]++] = i;
+  }
+
+  AnimationJob job = {
+    .requests = requests,
+    .order = order,
+    .groups = groups,
+    .groupCount = groupCount
+  };
+
+#ifdef LOVR_ENABLE_THREAD
+  lovrTaskParallel(animateGroup, &job, groupCount);
+#else
+  for (uint32_t i = 0; i < groupCount; i++) {
+    animateGroup(&job, i);
+  }
+#endif
+
+  map_free(&groupMap);
+  free(cursors);
+  free(groupOf);
+  free(groups);
+  free(order);
+}
+
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space) {
   lovrAssert(nodeIndex < model->data->nodeCount, "Invalid node index '%d' (Model only has %d nodes)", nodeIndex, model->data->nodeCount);
   if (space == SPACE_LOCAL) {
     vec3_init(position, model->localTransforms[nodeIndex].properties[PROP_TRANSLATION]);
     quat_init(rotation, model->localTransforms[nodeIndex].properties[PROP_ROTATION]);
   } else {
-    if (model->transformsDirty) {
-      updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-      model->transformsDirty = false;
-    }
+    updateTransforms(model);
 
     mat4_getPosition(model->globalTransforms + 16 * nodeIndex, position);
     mat4_getOrientation(model->globalTransforms + 16 * nodeIndex, rotation);
@@ -351,6 +1240,7 @@ void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float ro
     vec3_lerp(transform->properties[PROP_TRANSLATION], position, alpha);
     quat_slerp(transform->properties[PROP_ROTATION], rotation, alpha);
   }
+  model->dirtyNodes[nodeIndex] = true;
   model->transformsDirty = true;
 }
 
@@ -367,49 +1257,80 @@ void lovrModelResetPose(Model* model) {
     }
   }
 
+  memset(model->dirtyNodes, 1, model->data->nodeCount * sizeof(bool));
   model->transformsDirty = true;
 }
 
+// Materials are shared until they're accessed, then the Model gets its own copy to modify
 Material* lovrModelGetMaterial(Model* model, uint32_t material) {
   lovrAssert(material < model->data->materialCount, "Invalid material index '%d' (Model only has %d material%s)", material + 1, model->data->materialCount, model->data->materialCount == 1 ? "" : "s");
+
+  if (!model->materials) {
+    model->materials = calloc(model->data->materialCount, sizeof(Material*));
+    lovrAssert(model->materials, "Out of memory");
+  }
+
+  if (!model->materials[material]) {
+    Material* shared = model->resources->materials[material];
+    Material* copy = lovrMaterialCreate();
+    memcpy(copy->scalars, shared->scalars, sizeof(copy->scalars));
+    memcpy(copy->colors, shared->colors, sizeof(copy->colors));
+    memcpy(copy->transform, shared->transform, sizeof(copy->transform));
+    for (uint32_t i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
+      lovrMaterialSetTexture(copy, i, shared->textures[i]);
+    }
+    model->materials[material] = copy;
+  }
+
   return model->materials[material];
 }
 
+static void applyBounds(ModelAttribute* position, mat4 m, float aabb[6]) {
+  float xa[3] = { position->min[0] * m[0], position->min[0] * m[1], position->min[0] * m[2] };
+  float xb[3] = { position->max[0] * m[0], position->max[0] * m[1], position->max[0] * m[2] };
+
+  float ya[3] = { position->min[1] * m[4], position->min[1] * m[5], position->min[1] * m[6] };
+  float yb[3] = { position->max[1] * m[4], position->max[1] * m[5], position->max[1] * m[6] };
+
+  float za[3] = { position->min[2] * m[8], position->min[2] * m[9], position->min[2] * m[10] };
+  float zb[3] = { position->max[2] * m[8], position->max[2] * m[9], position->max[2] * m[10] };
+
+  float min[3] = {
+    MIN(xa[0], xb[0]) + MIN(ya[0], yb[0]) + MIN(za[0], zb[0]) + m[12],
+    MIN(xa[1], xb[1]) + MIN(ya[1], yb[1]) + MIN(za[1], zb[1]) + m[13],
+    MIN(xa[2], xb[2]) + MIN(ya[2], yb[2]) + MIN(za[2], zb[2]) + m[14]
+  };
+
+  float max[3] = {
+    MAX(xa[0], xb[0]) + MAX(ya[0], yb[0]) + MAX(za[0], zb[0]) + m[12],
+    MAX(xa[1], xb[1]) + MAX(ya[1], yb[1]) + MAX(za[1], zb[1]) + m[13],
+    MAX(xa[2], xb[2]) + MAX(ya[2], yb[2]) + MAX(za[2], zb[2]) + m[14]
+  };
+
+  aabb[0] = MIN(aabb[0], min[0]);
+  aabb[1] = MAX(aabb[1], max[0]);
+  aabb[2] = MIN(aabb[2], min[1]);
+  aabb[3] = MAX(aabb[3], max[1]);
+  aabb[4] = MIN(aabb[4], min[2]);
+  aabb[5] = MAX(aabb[5], max[2]);
+}
+
 static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
   ModelNode* node = &model->data->nodes[nodeIndex];
+  mat4 global = model->globalTransforms + 16 * nodeIndex;
 
   for (uint32_t i = 0; i < node->primitiveCount; i++) {
     ModelAttribute* position = model->data->primitives[node->primitiveIndex + i].attributes[ATTR_POSITION];
     if (position && position->hasMin && position->hasMax) {
-      mat4 m = model->globalTransforms + 16 * nodeIndex;
-
-      float xa[3] = { position->min[0] * m[0], position->min[0] * m[1], position->min[0] * m[2] };
-      float xb[3] = { position->max[0] * m[0], position->max[0] * m[1], position->max[0] * m[2] };
-
-      float ya[3] = { position->min[1] * m[4], position->min[1] * m[5], position->min[1] * m[6] };
-      float yb[3] = { position->max[1] * m[4], position->max[1] * m[5], position->max[1] * m[6] };
-
-      float za[3] = { position->min[2] * m[8], position->min[2] * m[9], position->min[2] * m[10] };
-      float zb[3] = { position->max[2] * m[8], position->max[2] * m[9], position->max[2] * m[10] };
-
-      float min[3] = {
-        MIN(xa[0], xb[0]) + MIN(ya[0], yb[0]) + MIN(za[0], zb[0]) + m[12],
-        MIN(xa[1], xb[1]) + MIN(ya[1], yb[1]) + MIN(za[1], zb[1]) + m[13],
-        MIN(xa[2], xb[2]) + MIN(ya[2], yb[2]) + MIN(za[2], zb[2]) + m[14]
-      };
-
-      float max[3] = {
-        MAX(xa[0], xb[0]) + MAX(ya[0], yb[0]) + MAX(za[0], zb[0]) + m[12],
-        MAX(xa[1], xb[1]) + MAX(ya[1], yb[1]) + MAX(za[1], zb[1]) + m[13],
-        MAX(xa[2], xb[2]) + MAX(ya[2], yb[2]) + MAX(za[2], zb[2]) + m[14]
-      };
+      if (node->instanceCount == 0) {
+        applyBounds(position, global, aabb);
+      }
 
-      aabb[0] = MIN(aabb[0], min[0]);
-      aabb[1] = MAX(aabb[1], max[0]);
-      aabb[2] = MIN(aabb[2], min[1]);
-      aabb[3] = MAX(aabb[3], max[1]);
-      aabb[4] = MIN(aabb[4], min[2]);
-      aabb[5] = MAX(aabb[5], max[2]);
+      for (uint32_t j = 0; j < node->instanceCount; j++) {
+        float m[16];
+        mat4_multiply(mat4_init(m, global), node->instances + 16 * j);
+        applyBounds(position, m, aabb);
+      }
     }
   }
 
@@ -419,10 +1340,7 @@ static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
 }
 
 void lovrModelGetAABB(Model* model, float aabb[6]) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
+  updateTransforms(model);
 
   aabb[0] = aabb[2] = aabb[4] = FLT_MAX;
   aabb[1] = aabb[3] = aabb[5] = -FLT_MAX;
@@ -5,6 +5,7 @@
 
 struct Material;
 struct ModelData;
+struct Texture;
 
 typedef enum {
   SPACE_LOCAL,
@@ -12,13 +13,27 @@ typedef enum {
 } CoordinateSpace;
 
 typedef struct Model Model;
-Model* lovrModelCreate(struct ModelData* data);
+
+typedef struct {
+  Model* model;
+  uint32_t animation;
+  float time;
+  float alpha;
+  uint32_t instance;
+} ModelAnimationRequest;
+
+Model* lovrModelCreate(struct ModelData* data, bool batch, struct Texture** textures);
+struct Texture* lovrModelCreateTexture(struct ModelData* data, uint32_t index);
 void lovrModelDestroy(void* ref);
+void lovrModelDestroyShared(void);
 struct ModelData* lovrModelGetModelData(Model* model);
 void lovrModelDraw(Model* model, float* transform, uint32_t instances);
 void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha);
+void lovrModelAnimateBatch(ModelAnimationRequest* requests, uint32_t count);
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space);
 void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], float alpha);
 void lovrModelResetPose(Model* model);
+void lovrModelSetInstancePose(Model* model, uint32_t instance);
+void lovrModelClearInstancePoses(Model* model);
 struct Material* lovrModelGetMaterial(Model* model, uint32_t material);
 void lovrModelGetAABB(Model* model, float aabb[6]);
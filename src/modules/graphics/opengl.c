@@ -6,8 +6,13 @@
 #include "graphics/shader.h"
 #include "graphics/texture.h"
 #include "resources/shaders.h"
+#include "data/blob.h"
 #include "data/modelData.h"
 #include "math/math.h"
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/task.h"
+#endif
+#include "core/cache.h"
 #include "core/hash.h"
 #include "core/ref.h"
 #include <math.h>
@@ -30,6 +35,9 @@
 #define MAX_TEXTURES 16
 #define MAX_IMAGES 8
 #define MAX_BLOCK_BUFFERS 8
+#define MAX_TEXTURE_RESTORES 4
+#define MIN_STREAMED_MIPMAP_SIZE 64
+#define DEFAULT_TEXTURE_IDLE_FRAMES 300
 
 #define LOVR_SHADER_POSITION 0
 #define LOVR_SHADER_NORMAL 1
@@ -72,6 +80,13 @@ struct Texture {
   bool allocated;
   bool native;
   uint8_t incoherent;
+  TextureData* source;
+  char* sourcePath;
+  ModelDataIO* sourceIO;
+  bool sourceFlip;
+  uint32_t lastUsed;
+  uint32_t evictedMips;
+  struct TextureRestore* restore;
 };
 
 struct Canvas {
@@ -195,6 +210,10 @@ static struct {
   GpuFeatures features;
   GpuLimits limits;
   GpuStats stats;
+  arr_t(Texture*) streamedTextures;
+  uint64_t textureBudget;
+  uint32_t textureIdleFrames;
+  uint32_t frame;
 } state;
 
 // Helper functions
@@ -371,6 +390,18 @@ static bool isTextureFormatCompressed(TextureFormat format) {
   }
 }
 
+static bool isTextureFormatSupported(TextureFormat format) {
+  switch (format) {
+    case FORMAT_DXT1: case FORMAT_DXT3: case FORMAT_DXT5: return state.features.dxt;
+    default: return !isTextureFormatCompressed(format) || state.features.astc;
+  }
+}
+
+static bool isTextureStreamable(Texture* texture) {
+  bool blittable = texture->format == FORMAT_RGB || texture->format == FORMAT_RGBA;
+  return texture->type == TEXTURE_2D && texture->mipmaps && texture->allocated && blittable && !texture->msaa && !texture->native;
+}
+
 static bool isTextureFormatDepth(TextureFormat format) {
   switch (format) {
     case FORMAT_D16: case FORMAT_D32F: case FORMAT_D24S8: return true;
@@ -418,7 +449,9 @@ static uint64_t getTextureMemorySize(Texture* texture) {
     case FORMAT_ASTC_12x12: bitrate = 0.89f; break;
     default: lovrThrow("Unreachable");
   }
-  size = texture->width * texture->height * texture->depth * (bitrate / 8.f) * (texture->mipmaps ? 1.33f : 1.f);
+  uint32_t width = MAX(texture->width >> texture->evictedMips, 1);
+  uint32_t height = MAX(texture->height >> texture->evictedMips, 1);
+  size = width * height * texture->depth * (bitrate / 8.f) * (texture->mipmaps ? 1.33f : 1.f);
   size += texture->msaa > 1 ? (texture->width * texture->height * texture->msaa * (bitrate / 8.f)) : 0.f;
   return (uint64_t) (size + .5f);
 }
@@ -1152,6 +1185,9 @@ static void lovrGpuBindShader(Shader* shader) {
           lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
           lovrAssert(!texture || (uniform->shadow == (texture->compareMode != COMPARE_NONE)), "Uniform '%s' requires a Texture with%s a compare mode", uniform->name, uniform->shadow ? "" : "out");
           lovrGpuBindTexture(texture, uniform->baseSlot + j);
+          if (texture) {
+            texture->lastUsed = state.frame;
+          }
         }
         break;
     }
@@ -1192,6 +1228,414 @@ static void lovrGpuSetViewports(float* viewport, uint32_t count) {
 #endif
 }
 
+// Creates storage for the bound Texture's GL object, which can have fewer levels than the Texture
+static void lovrGpuAllocateTexture(Texture* texture, uint32_t width, uint32_t height, uint32_t depth, uint32_t levels) {
+  GLenum internalFormat = convertTextureFormatInternal(texture->format, texture->srgb);
+#ifdef LOVR_GL
+  if (GLAD_GL_ARB_texture_storage) {
+#endif
+  if (texture->type == TEXTURE_ARRAY || texture->type == TEXTURE_VOLUME) {
+    glTexStorage3D(texture->target, levels, internalFormat, width, height, depth);
+  } else {
+    glTexStorage2D(texture->target, levels, internalFormat, width, height);
+  }
+#ifdef LOVR_GL
+  } else {
+    GLenum glFormat = convertTextureFormat(texture->format);
+    for (uint32_t i = 0; i < levels; i++) {
+      switch (texture->type) {
+        case TEXTURE_2D:
+          glTexImage2D(texture->target, i, internalFormat, width, height, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
+          break;
+
+        case TEXTURE_CUBE:
+          for (uint32_t face = 0; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, i, internalFormat, width, height, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
+          }
+          break;
+
+        case TEXTURE_ARRAY:
+        case TEXTURE_VOLUME:
+          glTexImage3D(texture->target, i, internalFormat, width, height, depth, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
+          break;
+      }
+      width = MAX(width >> 1, 1);
+      height = MAX(height >> 1, 1);
+      depth = texture->type == TEXTURE_VOLUME ? MAX(depth >> 1, 1) : depth;
+    }
+  }
+#endif
+}
+
+static void lovrGpuUploadTexture(Texture* texture, TextureData* textureData, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
+  if (isTextureFormatCompressed(textureData->format) && !isTextureFormatCompressed(texture->format)) {
+    lovrAssert(mipmap == 0, "Unable to replace a specific mipmap of a compressed texture");
+    TextureData* decoded = lovrTextureDataCreateDecoded(textureData);
+    lovrGpuUploadTexture(texture, decoded, x, y, slice, mipmap);
+    lovrRelease(TextureData, decoded);
+    return;
+  }
+
+  uint32_t maxWidth = lovrTextureGetWidth(texture, mipmap);
+  uint32_t maxHeight = lovrTextureGetHeight(texture, mipmap);
+  uint32_t width = textureData->width;
+  uint32_t height = textureData->height;
+  bool overflow = (x + width > maxWidth) || (y + height > maxHeight);
+  lovrAssert(!overflow, "Trying to replace pixels outside the texture's bounds");
+  lovrAssert(mipmap < texture->mipmapCount, "Invalid mipmap level %d", mipmap);
+  GLenum glFormat = convertTextureFormat(textureData->format);
+  GLenum glInternalFormat = convertTextureFormatInternal(textureData->format, texture->srgb);
+  GLenum binding = (texture->type == TEXTURE_CUBE) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + slice : texture->target;
+
+  lovrGpuBindTexture(texture, 0);
+  if (isTextureFormatCompressed(textureData->format)) {
+    lovrAssert(width == maxWidth && height == maxHeight, "Compressed texture pixels must be fully replaced");
+    lovrAssert(mipmap == 0, "Unable to replace a specific mipmap of a compressed texture");
+    for (uint32_t i = 0; i < textureData->mipmapCount; i++) {
+      Mipmap* m = textureData->mipmaps + i;
+      switch (texture->type) {
+        case TEXTURE_2D:
+        case TEXTURE_CUBE:
+          glCompressedTexImage2D(binding, i, glInternalFormat, m->width, m->height, 0, (GLsizei) m->size, m->data);
+          break;
+        case TEXTURE_ARRAY:
+        case TEXTURE_VOLUME:
+          glCompressedTexSubImage3D(binding, i, x, y, slice, m->width, m->height, 1, glInternalFormat, (GLsizei) m->size, m->data);
+          break;
+      }
+    }
+  } else {
+    lovrAssert(textureData->blob->data, "Trying to replace Texture pixels with empty pixel data");
+    GLenum glType = convertTextureFormatType(textureData->format);
+
+    switch (texture->type) {
+      case TEXTURE_2D:
+      case TEXTURE_CUBE:
+        glTexSubImage2D(binding, mipmap, x, y, width, height, glFormat, glType, textureData->blob->data);
+        break;
+      case TEXTURE_ARRAY:
+      case TEXTURE_VOLUME:
+        glTexSubImage3D(binding, mipmap, x, y, slice, width, height, 1, glFormat, glType, textureData->blob->data);
+        break;
+    }
+
+    // Upload precomputed mipmaps when the TextureData has a full chain for the whole image
+    bool fullChain = textureData->mipmapCount >= texture->mipmapCount && mipmap == 0 && width == maxWidth && height == maxHeight;
+    fullChain &= texture->type != TEXTURE_VOLUME;
+    if (texture->mipmaps && fullChain) {
+      for (uint32_t i = 1; i < texture->mipmapCount; i++) {
+        Mipmap* m = textureData->mipmaps + i;
+        switch (texture->type) {
+          case TEXTURE_2D:
+          case TEXTURE_CUBE:
+            glTexSubImage2D(binding, i, 0, 0, m->width, m->height, glFormat, glType, m->data);
+            break;
+          case TEXTURE_ARRAY:
+          default:
+            glTexSubImage3D(binding, i, 0, 0, slice, m->width, m->height, 1, glFormat, glType, m->data);
+            break;
+        }
+      }
+    } else if (texture->mipmaps) {
+#if defined(__APPLE__) || defined(LOVR_WEBGL) // glGenerateMipmap doesn't work on big cubemap textures on macOS
+      if (texture->type != TEXTURE_CUBE || width < 2048) {
+        glGenerateMipmap(texture->target);
+      } else {
+        glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, 0);
+      }
+#else
+      glGenerateMipmap(texture->target);
+#endif
+    }
+  }
+}
+
+// Texture streaming
+
+static int compareTextureUsage(const void* a, const void* b) {
+  uint32_t x = (*(Texture**) a)->lastUsed;
+  uint32_t y = (*(Texture**) b)->lastUsed;
+  return (int32_t) (x - y);
+}
+
+// Points every slot the Texture is bound to at its current GL object, leaving it active in slot 0
+static void lovrGpuRebindTexture(Texture* texture) {
+  lovrGpuBindTexture(texture, 0);
+  for (int i = MAX_TEXTURES - 1; i >= 0; i--) {
+    if (state.textures[i] == texture) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(texture->target, texture->id);
+      state.activeTexture = i;
+    }
+  }
+}
+
+// Moves the Texture to a new GL object missing its top mipmaps, returning the old one
+static GLuint lovrGpuSwapTexture(Texture* texture, uint32_t evictedMips) {
+  GLuint id = texture->id;
+  state.stats.textureMemory -= getTextureMemorySize(texture);
+  texture->evictedMips = evictedMips;
+  glGenTextures(1, &texture->id);
+  lovrGpuRebindTexture(texture);
+  uint32_t width = lovrTextureGetWidth(texture, evictedMips);
+  uint32_t height = lovrTextureGetHeight(texture, evictedMips);
+  lovrGpuAllocateTexture(texture, width, height, 1, texture->mipmapCount - evictedMips);
+  lovrTextureSetFilter(texture, texture->filter);
+  lovrTextureSetWrap(texture, texture->wrap);
+  state.stats.textureMemory += getTextureMemorySize(texture);
+  return id;
+}
+
+static void lovrGpuBlitTexture(GLuint src, uint32_t level, GLint width, GLint height, GLuint dst, GLint dstWidth, GLint dstHeight) {
+  GLuint framebuffers[2];
+  glGenFramebuffers(2, framebuffers);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src, level);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+  glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst, 0);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT, width == dstWidth ? GL_NEAREST : GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+  glDeleteFramebuffers(2, framebuffers);
+}
+
+// Keeps the mipmaps up to MIN_STREAMED_MIPMAP_SIZE pixels, copied on the GPU so nothing is decoded
+static void lovrGpuEvictTexture(Texture* texture) {
+  uint32_t drop = 0;
+  while ((MAX(texture->width, texture->height) >> (drop + 1)) >= MIN_STREAMED_MIPMAP_SIZE) {
+    drop++;
+  }
+
+  if (drop == 0) {
+    return;
+  }
+
+  GLuint id = lovrGpuSwapTexture(texture, drop);
+  GLint width = lovrTextureGetWidth(texture, drop);
+  GLint height = lovrTextureGetHeight(texture, drop);
+  lovrGpuBlitTexture(id, drop, width, height, texture->id, width, height);
+  glGenerateMipmap(texture->target);
+  glDeleteTextures(1, &id);
+}
+
+static void lovrGpuReleaseTextureSource(Texture* texture) {
+  if (!texture->source && !texture->sourcePath) {
+    return;
+  }
+
+  for (size_t i = 0; i < state.streamedTextures.length; i++) {
+    if (state.streamedTextures.data[i] == texture) {
+      arr_splice(&state.streamedTextures, i, 1);
+      break;
+    }
+  }
+
+  lovrRelease(TextureData, texture->source);
+  free(texture->sourcePath);
+  texture->source = NULL;
+  texture->sourcePath = NULL;
+}
+
+// Gives the Texture its top mipmaps back.  Without pixels (the source is gone or doesn't match the
+// Texture anymore) the mipmaps that are left get scaled up on the GPU, blurry but the right size.
+static void lovrGpuUnevictTexture(Texture* texture, TextureData* pixels) {
+  uint32_t evictedMips = texture->evictedMips;
+  GLuint id = lovrGpuSwapTexture(texture, 0);
+  if (pixels) {
+    lovrGpuUploadTexture(texture, pixels, 0, 0, 0, 0);
+  } else {
+    GLint width = lovrTextureGetWidth(texture, evictedMips);
+    GLint height = lovrTextureGetHeight(texture, evictedMips);
+    lovrGpuBlitTexture(id, 0, width, height, texture->id, texture->width, texture->height);
+    glGenerateMipmap(texture->target);
+  }
+  glDeleteTextures(1, &id);
+
+  // The source was only kept for the budget, which has been turned off since the Texture was evicted
+  if (state.textureBudget == 0) {
+    lovrGpuReleaseTextureSource(texture);
+  }
+}
+
+// Reads and decodes a Texture's source.  Safe to call on other threads, it only looks at its
+// arguments.  Returns NULL if the file can't be read anymore.
+static TextureData* lovrGpuLoadTextureSource(TextureData* source, const char* path, ModelDataIO* io, bool flip, TextureFormat format) {
+  if (source) {
+    lovrRetain(source);
+  } else {
+    size_t size;
+    void* data = io(path, &size);
+    if (!data) {
+      return NULL;
+    }
+    Blob* blob = lovrBlobCreate(data, size, path);
+    source = lovrTextureDataCreateFromBlob(blob, flip);
+    lovrRelease(Blob, blob);
+  }
+
+  // Compressed images the GPU can't sample are decoded here, so it doesn't happen during the upload
+  if (isTextureFormatCompressed(source->format) && !isTextureFormatCompressed(format)) {
+    TextureData* decoded = lovrTextureDataCreateDecoded(source);
+    lovrRelease(TextureData, source);
+    source = decoded;
+  }
+
+  return source;
+}
+
+// A source that can't be read or was changed (e.g. the file was replaced by one with a different
+// size) can't restore the Texture, so it's dropped.  The Texture stays evicted.
+static bool lovrGpuCheckTextureSource(Texture* texture, TextureData* pixels) {
+  if (!pixels || pixels->width != texture->width || pixels->height != texture->height || pixels->format != texture->format) {
+    lovrGpuReleaseTextureSource(texture);
+    return false;
+  }
+  return true;
+}
+
+// Restores the Texture right away, for when it's about to be changed or read back
+static void lovrGpuRestoreTexture(Texture* texture) {
+  TextureData* pixels = NULL;
+  if (texture->source || texture->sourcePath) {
+    pixels = lovrGpuLoadTextureSource(texture->source, texture->sourcePath, texture->sourceIO, texture->sourceFlip, texture->format);
+    if (!lovrGpuCheckTextureSource(texture, pixels)) {
+      lovrRelease(TextureData, pixels);
+      pixels = NULL;
+    }
+  }
+  lovrGpuUnevictTexture(texture, pixels);
+  lovrRelease(TextureData, pixels);
+}
+
+// Once a Texture is written to or rendered to it no longer matches its source, so it stops streaming
+static void lovrGpuPinTexture(Texture* texture) {
+  if (!texture) {
+    return;
+  }
+
+  if (texture->evictedMips) {
+    lovrGpuRestoreTexture(texture);
+  }
+
+  lovrGpuReleaseTextureSource(texture);
+}
+
+#ifdef LOVR_ENABLE_THREAD
+// Restores decode their source on a task worker, then upload it on the main thread in a later frame
+// (finishing Tasks is spread over frames by lovrTaskUpdate).  The Texture is only touched on the main
+// thread, and it clears its pointer to the restore if it's destroyed first.
+typedef struct TextureRestore {
+  Texture* texture;
+  TextureData* source;
+  char* path;
+  ModelDataIO* io;
+  bool flip;
+  TextureFormat format;
+  TextureData* pixels;
+  bool finished;
+} TextureRestore;
+
+static bool decodeTextureSource(Task* task) {
+  TextureRestore* restore = task->context;
+  restore->pixels = lovrGpuLoadTextureSource(restore->source, restore->path, restore->io, restore->flip, restore->format);
+  return true;
+}
+
+// The Texture may have been restored or changed in the meantime, which drops its source
+static bool uploadTextureSource(Task* task) {
+  TextureRestore* restore = task->context;
+  Texture* texture = restore->texture;
+  restore->finished = true;
+  if (texture && texture->evictedMips && (texture->source || texture->sourcePath)) {
+    if (lovrGpuCheckTextureSource(texture, restore->pixels)) {
+      lovrGpuUnevictTexture(texture, restore->pixels);
+    }
+  }
+  return true;
+}
+
+// A restore that failed (e.g. the file couldn't be decoded) drops the source too
+static void freeTextureRestore(void* context) {
+  TextureRestore* restore = context;
+  if (restore->texture) {
+    restore->texture->restore = NULL;
+    if (!restore->finished && restore->texture->evictedMips) {
+      lovrGpuReleaseTextureSource(restore->texture);
+    }
+  }
+  lovrRelease(TextureData, restore->source);
+  lovrRelease(TextureData, restore->pixels);
+  free(restore->path);
+  free(restore);
+}
+#endif
+
+// Without the task pool (the thread module isn't loaded), the source is decoded right away
+static void lovrGpuRequestRestore(Texture* texture) {
+#ifdef LOVR_ENABLE_THREAD
+  if (lovrTaskPoolIsInitialized()) {
+    TextureRestore* restore = calloc(1, sizeof(TextureRestore));
+    lovrAssert(restore, "Out of memory");
+    restore->texture = texture;
+    restore->source = texture->source;
+    restore->io = texture->sourceIO;
+    restore->flip = texture->sourceFlip;
+    restore->format = texture->format;
+    lovrRetain(restore->source);
+    if (texture->sourcePath) {
+      size_t length = strlen(texture->sourcePath);
+      restore->path = malloc(length + 1);
+      lovrAssert(restore->path, "Out of memory");
+      memcpy(restore->path, texture->sourcePath, length + 1);
+    }
+    texture->restore = restore;
+    Task* task = lovrTaskCreate(decodeTextureSource, uploadTextureSource, restore, freeTextureRestore);
+    lovrTaskStart(task);
+    lovrRelease(Task, task);
+    return;
+  }
+#endif
+
+  TextureData* pixels = lovrGpuLoadTextureSource(texture->source, texture->sourcePath, texture->sourceIO, texture->sourceFlip, texture->format);
+  if (lovrGpuCheckTextureSource(texture, pixels)) {
+    lovrGpuUnevictTexture(texture, pixels);
+  }
+  lovrRelease(TextureData, pixels);
+}
+
+// Textures that were sampled while evicted get their mipmaps back, a few per frame.  Then, if the
+// budget is exceeded, textures that have been idle long enough are evicted, least recently used first.
+// Restores can drop a source (removing it from the list), so the list is walked backwards.
+static void lovrGpuStreamTextures() {
+  uint32_t restores = 0;
+  for (size_t i = state.streamedTextures.length; i-- > 0 && restores < MAX_TEXTURE_RESTORES;) {
+    Texture* texture = state.streamedTextures.data[i];
+    if (texture->evictedMips && texture->lastUsed == state.frame && !texture->restore) {
+      lovrGpuRequestRestore(texture);
+      restores++;
+    }
+  }
+
+  if (state.textureBudget == 0 || state.stats.textureMemory <= state.textureBudget) {
+    return;
+  }
+
+  size_t count = 0;
+  Texture** candidates = malloc(state.streamedTextures.length * sizeof(Texture*));
+  lovrAssert(candidates, "Out of memory");
+  for (size_t i = 0; i < state.streamedTextures.length; i++) {
+    Texture* texture = state.streamedTextures.data[i];
+    if (!texture->evictedMips && state.frame - texture->lastUsed >= state.textureIdleFrames) {
+      candidates[count++] = texture;
+    }
+  }
+
+  qsort(candidates, count, sizeof(Texture*), compareTextureUsage);
+  for (size_t i = 0; i < count && state.stats.textureMemory > state.textureBudget; i++) {
+    lovrGpuEvictTexture(candidates[i]);
+  }
+  free(candidates);
+}
+
 // GPU
 
 void lovrGpuInit(void* (*getProcAddress)(const char*)) {
@@ -1289,6 +1733,9 @@ void lovrGpuInit(void* (*getProcAddress)(const char*)) {
     arr_init(&state.incoherents[i]);
   }
 
+  arr_init(&state.streamedTextures);
+  state.textureIdleFrames = DEFAULT_TEXTURE_IDLE_FRAMES;
+
   TextureData* textureData = lovrTextureDataCreate(1, 1, NULL, 0xff, FORMAT_RGBA);
   state.defaultTexture = lovrTextureCreate(TEXTURE_2D, &textureData, 1, true, false, 0);
   lovrTextureSetFilter(state.defaultTexture, (TextureFilter) { .mode = FILTER_NEAREST });
@@ -1311,6 +1758,7 @@ void lovrGpuDestroy() {
   for (int i = 0; i < MAX_BARRIERS; i++) {
     arr_free(&state.incoherents[i]);
   }
+  arr_free(&state.streamedTextures);
   glDeleteQueries(state.queryPool.count, state.queryPool.queries);
   free(state.queryPool.queries);
   arr_free(&state.timers);
@@ -1425,9 +1873,11 @@ void lovrGpuDraw(DrawCommand* draw) {
 }
 
 void lovrGpuPresent() {
+  lovrGpuStreamTextures();
   state.stats.shaderSwitches = 0;
   state.stats.renderPasses = 0;
   state.stats.drawCalls = 0;
+  state.frame++;
 }
 
 void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata) {
@@ -1458,6 +1908,24 @@ void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback call
   state.stencilMode = ~0; // Dirty
 }
 
+void lovrGpuGetTextureBudget(uint64_t* budget, uint32_t* idleFrames) {
+  *budget = state.textureBudget;
+  *idleFrames = state.textureIdleFrames;
+}
+
+// Without a budget nothing gets evicted, so sources are only kept for textures that need restoring
+void lovrGpuSetTextureBudget(uint64_t budget, uint32_t idleFrames) {
+  state.textureBudget = budget;
+  state.textureIdleFrames = MAX(idleFrames, 1);
+  if (budget == 0) {
+    for (size_t i = state.streamedTextures.length; i-- > 0;) {
+      if (!state.streamedTextures.data[i]->evictedMips) {
+        lovrGpuReleaseTextureSource(state.streamedTextures.data[i]);
+      }
+    }
+  }
+}
+
 void lovrGpuDirtyTexture() {
   lovrRelease(Texture, state.textures[state.activeTexture]);
   state.textures[state.activeTexture] = NULL;
@@ -1631,6 +2099,13 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 
 void lovrTextureDestroy(void* ref) {
   Texture* texture = ref;
+  lovrCacheRemove(ref);
+#ifdef LOVR_ENABLE_THREAD
+  if (texture->restore) {
+    texture->restore->texture = NULL;
+  }
+#endif
+  lovrGpuReleaseTextureSource(texture);
   glDeleteTextures(1, &texture->id);
   glDeleteRenderbuffers(1, &texture->msaaId);
   lovrGpuDestroySyncResource(texture, texture->incoherent);
@@ -1648,6 +2123,12 @@ void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint
   lovrAssert(height < maxSize, "Texture height %d exceeds max of %d", height, maxSize);
   lovrAssert(!texture->msaa || texture->type == TEXTURE_2D, "Only 2D textures can be created with MSAA");
 
+  // DXT textures are decoded to RGBA when the GPU can't sample them
+  if (!isTextureFormatSupported(format)) {
+    lovrAssert(format >= FORMAT_DXT1 && format <= FORMAT_DXT5, "This GPU does not support ASTC textures");
+    format = FORMAT_RGBA;
+  }
+
   texture->allocated = true;
   texture->width = width;
   texture->height = height;
@@ -1665,43 +2146,10 @@ void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint
     return;
   }
 
-  GLenum internalFormat = convertTextureFormatInternal(format, texture->srgb);
-#ifdef LOVR_GL
-  if (GLAD_GL_ARB_texture_storage) {
-#endif
-  if (texture->type == TEXTURE_ARRAY || texture->type == TEXTURE_VOLUME) {
-    glTexStorage3D(texture->target, texture->mipmapCount, internalFormat, width, height, depth);
-  } else {
-    glTexStorage2D(texture->target, texture->mipmapCount, internalFormat, width, height);
-  }
-#ifdef LOVR_GL
-  } else {
-    GLenum glFormat = convertTextureFormat(format);
-    for (uint32_t i = 0; i < texture->mipmapCount; i++) {
-      switch (texture->type) {
-        case TEXTURE_2D:
-          glTexImage2D(texture->target, i, internalFormat, width, height, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
-          break;
-
-        case TEXTURE_CUBE:
-          for (uint32_t face = 0; face < 6; face++) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, i, internalFormat, width, height, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
-          }
-          break;
-
-        case TEXTURE_ARRAY:
-        case TEXTURE_VOLUME:
-          glTexImage3D(texture->target, i, internalFormat, width, height, depth, 0, glFormat, GL_UNSIGNED_BYTE, NULL);
-          break;
-      }
-      width = MAX(width >> 1, 1);
-      height = MAX(height >> 1, 1);
-      depth = texture->type == TEXTURE_VOLUME ? MAX(depth >> 1, 1) : depth;
-    }
-  }
-#endif
+  lovrGpuAllocateTexture(texture, width, height, depth, texture->mipmapCount);
 
   if (texture->msaaId) {
+    GLenum internalFormat = convertTextureFormatInternal(format, texture->srgb);
     glBindRenderbuffer(GL_RENDERBUFFER, texture->msaaId);
     glRenderbufferStorageMultisample(GL_RENDERBUFFER, texture->msaa, internalFormat, width, height);
   }
@@ -1709,9 +2157,12 @@ void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint
   state.stats.textureMemory += getTextureMemorySize(texture);
 }
 
+// Changing a Texture evicts it from the cache (if it's there), so later loads get the original
 void lovrTextureReplacePixels(Texture* texture, TextureData* textureData, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
   lovrGraphicsFlush();
   lovrAssert(texture->allocated, "Texture is not allocated");
+  lovrCacheRemove(texture);
+  lovrGpuPinTexture(texture);
 
 #ifndef LOVR_WEBGL
   if ((texture->incoherent >> BARRIER_TEXTURE) & 1) {
@@ -1719,61 +2170,28 @@ void lovrTextureReplacePixels(Texture* texture, TextureData* textureData, uint32
   }
 #endif
 
-  uint32_t maxWidth = lovrTextureGetWidth(texture, mipmap);
-  uint32_t maxHeight = lovrTextureGetHeight(texture, mipmap);
-  uint32_t width = textureData->width;
-  uint32_t height = textureData->height;
-  bool overflow = (x + width > maxWidth) || (y + height > maxHeight);
-  lovrAssert(!overflow, "Trying to replace pixels outside the texture's bounds");
-  lovrAssert(mipmap < texture->mipmapCount, "Invalid mipmap level %d", mipmap);
-  GLenum glFormat = convertTextureFormat(textureData->format);
-  GLenum glInternalFormat = convertTextureFormatInternal(textureData->format, texture->srgb);
-  GLenum binding = (texture->type == TEXTURE_CUBE) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + slice : texture->target;
-
-  lovrGpuBindTexture(texture, 0);
-  if (isTextureFormatCompressed(textureData->format)) {
-    lovrAssert(width == maxWidth && height == maxHeight, "Compressed texture pixels must be fully replaced");
-    lovrAssert(mipmap == 0, "Unable to replace a specific mipmap of a compressed texture");
-    for (uint32_t i = 0; i < textureData->mipmapCount; i++) {
-      Mipmap* m = textureData->mipmaps + i;
-      switch (texture->type) {
-        case TEXTURE_2D:
-        case TEXTURE_CUBE:
-          glCompressedTexImage2D(binding, i, glInternalFormat, m->width, m->height, 0, (GLsizei) m->size, m->data);
-          break;
-        case TEXTURE_ARRAY:
-        case TEXTURE_VOLUME:
-          glCompressedTexSubImage3D(binding, i, x, y, slice, m->width, m->height, 1, glInternalFormat, (GLsizei) m->size, m->data);
-          break;
-      }
-    }
-  } else {
-    lovrAssert(textureData->blob->data, "Trying to replace Texture pixels with empty pixel data");
-    GLenum glType = convertTextureFormatType(textureData->format);
-
-    switch (texture->type) {
-      case TEXTURE_2D:
-      case TEXTURE_CUBE:
-        glTexSubImage2D(binding, mipmap, x, y, width, height, glFormat, glType, textureData->blob->data);
-        break;
-      case TEXTURE_ARRAY:
-      case TEXTURE_VOLUME:
-        glTexSubImage3D(binding, mipmap, x, y, slice, width, height, 1, glFormat, glType, textureData->blob->data);
-        break;
-    }
+  lovrGpuUploadTexture(texture, textureData, x, y, slice, mipmap);
+}
 
-    if (texture->mipmaps) {
-#if defined(__APPLE__) || defined(LOVR_WEBGL) // glGenerateMipmap doesn't work on big cubemap textures on macOS
-      if (texture->type != TEXTURE_CUBE || width < 2048) {
-        glGenerateMipmap(texture->target);
-      } else {
-        glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, 0);
-      }
-#else
-      glGenerateMipmap(texture->target);
-#endif
-    }
-  }
+// Blits through temporary framebuffers, since glCopyImageSubData needs GL 4.3 / GLES 3.2
+void lovrTextureCopy(Texture* texture, Texture* destination, uint32_t width, uint32_t height) {
+  lovrGraphicsFlush();
+  lovrAssert(texture->type == TEXTURE_2D && destination->type == TEXTURE_2D, "Only 2D textures can be copied");
+  lovrAssert(width <= MIN(texture->width, destination->width) && height <= MIN(texture->height, destination->height), "Texture copy is out of bounds");
+  lovrCacheRemove(destination);
+  lovrGpuPinTexture(destination);
+  if (texture->evictedMips) {
+    lovrGpuRestoreTexture(texture);
+  }
+  GLuint framebuffers[2];
+  glGenFramebuffers(2, framebuffers);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->id, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+  glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, destination->id, 0);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+  glDeleteFramebuffers(2, framebuffers);
 }
 
 uint64_t lovrTextureGetId(Texture* texture) {
@@ -1800,6 +2218,10 @@ uint32_t lovrTextureGetMSAA(Texture* texture) {
   return texture->msaa;
 }
 
+uint64_t lovrTextureGetMemorySize(Texture* texture) {
+  return getTextureMemorySize(texture);
+}
+
 TextureType lovrTextureGetType(Texture* texture) {
   return texture->type;
 }
@@ -1820,9 +2242,37 @@ TextureWrap lovrTextureGetWrap(Texture* texture) {
   return texture->wrap;
 }
 
+// Streamed textures can have their top mipmaps evicted when they're idle and the memory budget is
+// exceeded, reloading them from the source when they're sampled again.  The source is only kept while
+// there's a budget, so only textures created while one is set can be streamed.
+void lovrTextureSetSource(Texture* texture, TextureData* source) {
+  lovrGpuReleaseTextureSource(texture);
+  if (state.textureBudget > 0 && isTextureStreamable(texture)) {
+    lovrRetain(source);
+    texture->source = source;
+    texture->lastUsed = state.frame;
+    arr_push(&state.streamedTextures, texture);
+  }
+}
+
+void lovrTextureSetSourceFile(Texture* texture, const char* path, bool flip, ModelDataIO* io) {
+  lovrGpuReleaseTextureSource(texture);
+  if (state.textureBudget > 0 && isTextureStreamable(texture)) {
+    size_t length = strlen(path);
+    texture->sourcePath = malloc(length + 1);
+    lovrAssert(texture->sourcePath, "Out of memory");
+    memcpy(texture->sourcePath, path, length + 1);
+    texture->sourceFlip = flip;
+    texture->sourceIO = io;
+    texture->lastUsed = state.frame;
+    arr_push(&state.streamedTextures, texture);
+  }
+}
+
 void lovrTextureSetCompareMode(Texture* texture, CompareMode compareMode) {
   if (texture->compareMode != compareMode) {
     lovrGraphicsFlush();
+    lovrCacheRemove(texture);
     lovrGpuBindTexture(texture, 0);
     texture->compareMode = compareMode;
     if (compareMode == COMPARE_NONE) {
@@ -1837,6 +2287,9 @@ void lovrTextureSetCompareMode(Texture* texture, CompareMode compareMode) {
 
 void lovrTextureSetFilter(Texture* texture, TextureFilter filter) {
   lovrGraphicsFlush();
+  if (memcmp(&texture->filter, &filter, sizeof(filter))) {
+    lovrCacheRemove(texture);
+  }
   lovrGpuBindTexture(texture, 0);
   texture->filter = filter;
 
@@ -1872,6 +2325,9 @@ void lovrTextureSetFilter(Texture* texture, TextureFilter filter) {
 
 void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
   lovrGraphicsFlush();
+  if (memcmp(&texture->wrap, &wrap, sizeof(wrap))) {
+    lovrCacheRemove(texture);
+  }
   texture->wrap = wrap;
   lovrGpuBindTexture(texture, 0);
   glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, convertWrapMode(wrap.s));
@@ -2039,6 +2495,11 @@ void lovrCanvasSetAttachments(Canvas* canvas, Attachment* attachments, uint32_t
 
   lovrGraphicsFlushCanvas(canvas);
 
+  // Rendering to a Texture changes it
+  for (uint32_t i = 0; i < count; i++) {
+    lovrCacheRemove(attachments[i].texture);
+  }
+
   for (uint32_t i = 0; i < count; i++) {
     Texture* texture = attachments[i].texture;
     uint32_t slice = attachments[i].slice;
@@ -2055,6 +2516,7 @@ void lovrCanvasSetAttachments(Canvas* canvas, Attachment* attachments, uint32_t
 #ifndef __ANDROID__ // On multiview canvases, the multisample settings can be different
     lovrAssert(lovrTextureGetMSAA(texture) == canvas->flags.msaa, "Texture MSAA does not match Canvas MSAA");
 #endif
+    lovrGpuPinTexture(texture);
     lovrRetain(texture);
   }
 
@@ -2698,6 +3160,9 @@ void lovrShaderSetTextures(Shader* shader, const char* name, Texture** data, int
 }
 
 void lovrShaderSetImages(Shader* shader, const char* name, Image* data, int start, int count) {
+  for (int i = 0; i < count; i++) {
+    lovrGpuPinTexture(data[i].texture);
+  }
   lovrShaderSetUniform(shader, name, UNIFORM_IMAGE, data, start, count, sizeof(Image), "image");
 }
 
@@ -20,12 +20,14 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 void lovrTextureDestroy(void* ref);
 void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint32_t depth, TextureFormat format);
 void lovrTextureReplacePixels(Texture* texture, struct TextureData* data, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap);
+void lovrTextureCopy(Texture* texture, Texture* destination, uint32_t width, uint32_t height);
 uint64_t lovrTextureGetId(Texture* texture);
 uint32_t lovrTextureGetWidth(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetHeight(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetDepth(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetMipmapCount(Texture* texture);
 uint32_t lovrTextureGetMSAA(Texture* texture);
+uint64_t lovrTextureGetMemorySize(Texture* texture);
 TextureType lovrTextureGetType(Texture* texture);
 TextureFormat lovrTextureGetFormat(Texture* texture);
 CompareMode lovrTextureGetCompareMode(Texture* texture);
@@ -34,3 +36,5 @@ TextureFilter lovrTextureGetFilter(Texture* texture);
 void lovrTextureSetFilter(Texture* texture, TextureFilter filter);
 TextureWrap lovrTextureGetWrap(Texture* texture);
 void lovrTextureSetWrap(Texture* texture, TextureWrap wrap);
+void lovrTextureSetSource(Texture* texture, struct TextureData* source);
+void lovrTextureSetSourceFile(Texture* texture, const char* path, bool flip, ModelDataIO* io);
@@ -8,6 +8,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 static struct {
   bool initialized;
@@ -48,6 +51,68 @@ float lovrMathLinearToGamma(float x) {
   }
 }
 
+#if defined(__SSE2__)
+// pow for positive x using log2/exp2 polynomials, within ~1e-6 relative error
+static __m128 pow_ps(__m128 x, float p) {
+  __m128i bits = _mm_castps_si128(x);
+  __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+  __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+  __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+  m = _mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(.5f))), _mm_andnot_ps(big, m));
+  e = _mm_sub_epi32(e, _mm_castps_si128(big));
+
+  __m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.f)), _mm_add_ps(m, _mm_set1_ps(1.f)));
+  __m128 t2 = _mm_mul_ps(t, t);
+  __m128 l = _mm_add_ps(_mm_set1_ps(.5770780164f), _mm_mul_ps(t2, _mm_set1_ps(.4121985831f)));
+  l = _mm_add_ps(_mm_set1_ps(.9617966939f), _mm_mul_ps(t2, l));
+  l = _mm_add_ps(_mm_set1_ps(2.8853900818f), _mm_mul_ps(t2, l));
+  l = _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(t, l));
+
+  __m128 y = _mm_min_ps(_mm_max_ps(_mm_mul_ps(l, _mm_set1_ps(p)), _mm_set1_ps(-126.f)), _mm_set1_ps(127.f));
+  __m128i n = _mm_cvtps_epi32(y);
+  __m128 r = _mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(n)), _mm_set1_ps(.6931471806f));
+  __m128 q = _mm_add_ps(_mm_set1_ps(1.f / 120.f), _mm_mul_ps(r, _mm_set1_ps(1.f / 720.f)));
+  q = _mm_add_ps(_mm_set1_ps(1.f / 24.f), _mm_mul_ps(r, q));
+  q = _mm_add_ps(_mm_set1_ps(1.f / 6.f), _mm_mul_ps(r, q));
+  q = _mm_add_ps(_mm_set1_ps(.5f), _mm_mul_ps(r, q));
+  q = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(r, q));
+  q = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(r, q));
+  return _mm_mul_ps(q, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+}
+#endif
+
+void lovrMathGammaToLinearBatch(float* values, uint32_t count) {
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(values + i);
+    __m128 low = _mm_cmple_ps(x, _mm_set1_ps(.04045f));
+    __m128 a = _mm_div_ps(x, _mm_set1_ps(12.92f));
+    __m128 b = pow_ps(_mm_div_ps(_mm_add_ps(x, _mm_set1_ps(.055f)), _mm_set1_ps(1.055f)), 2.4f);
+    _mm_storeu_ps(values + i, _mm_or_ps(_mm_and_ps(low, a), _mm_andnot_ps(low, b)));
+  }
+#endif
+  for (; i < count; i++) {
+    values[i] = lovrMathGammaToLinear(values[i]);
+  }
+}
+
+void lovrMathLinearToGammaBatch(float* values, uint32_t count) {
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(values + i);
+    __m128 low = _mm_cmple_ps(x, _mm_set1_ps(.0031308f));
+    __m128 a = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+    __m128 b = _mm_sub_ps(_mm_mul_ps(pow_ps(x, 1.f / 2.4f), _mm_set1_ps(1.055f)), _mm_set1_ps(.055f));
+    _mm_storeu_ps(values + i, _mm_or_ps(_mm_and_ps(low, a), _mm_andnot_ps(low, b)));
+  }
+#endif
+  for (; i < count; i++) {
+    values[i] = lovrMathLinearToGamma(values[i]);
+  }
+}
+
 float lovrMathNoise1(float x) {
   return noise1(x) * .5f + .5f;
 }
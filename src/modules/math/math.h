@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stdint.h>
 
 #pragma once
 
@@ -9,6 +10,8 @@ struct RandomGenerator* lovrMathGetRandomGenerator(void);
 void lovrMathOrientationToDirection(float angle, float ax, float ay, float az, float* v);
 float lovrMathGammaToLinear(float x);
 float lovrMathLinearToGamma(float x);
+void lovrMathGammaToLinearBatch(float* values, uint32_t count);
+void lovrMathLinearToGammaBatch(float* values, uint32_t count);
 float lovrMathNoise1(float x);
 float lovrMathNoise2(float x, float y);
 float lovrMathNoise3(float x, float y, float z);
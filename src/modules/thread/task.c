@@ -0,0 +1,399 @@
+#include "thread/task.h"
+#include "core/arr.h"
+#include "core/os.h"
+#include "core/ref.h"
+#include "core/util.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TASK_ERROR_LENGTH 256
+
+static struct {
+  bool initialized;
+  bool quit;
+  mtx_t lock;
+  cnd_t cond;
+  cnd_t done;
+  thrd_t owner;
+  thrd_t threads[MAX_TASK_WORKERS];
+  uint32_t threadCount;
+  arr_t(Task*) queue;
+  arr_t(Task*) active;
+  arr_t(struct ParallelJob*) jobs;
+  double budget;
+} state;
+
+typedef struct ParallelJob {
+  ParallelFn* fn;
+  void* context;
+  uint32_t count;
+  uint32_t next;
+  uint32_t helpers;
+  char* error;
+} ParallelJob;
+
+typedef struct {
+  char* error;
+  jmp_buf env;
+} Guard;
+
+static void onGuardError(void* context, const char* format, va_list args) {
+  Guard* guard = context;
+  if (!guard->error && (guard->error = malloc(MAX_TASK_ERROR_LENGTH)) != NULL) {
+    vsnprintf(guard->error, MAX_TASK_ERROR_LENGTH, format, args);
+  }
+  longjmp(guard->env, 1);
+}
+
+// Errors can't unwind across threads, so code running for a Task or a parallel loop has its errors
+// caught here instead.  Returns the error message, which the caller frees, or NULL.
+static char* guard(void (*fn)(void*), void* arg) {
+  errorFn* callback = lovrErrorCallback;
+  void* userdata = lovrErrorUserdata;
+  Guard guard = { .error = NULL };
+  lovrSetErrorCallback(onGuardError, &guard);
+  if (!setjmp(guard.env)) {
+    fn(arg);
+  }
+  lovrSetErrorCallback(callback, userdata);
+  return guard.error;
+}
+
+typedef struct {
+  Task* task;
+  TaskFn* fn;
+  bool done;
+} TaskCall;
+
+static void callTask(void* arg) {
+  TaskCall* call = arg;
+  call->done = call->fn(call->task);
+}
+
+// Calls one of the Task's functions.  An error fails the Task, which also counts as being finished.
+static bool call(Task* task, TaskFn* fn) {
+  TaskCall call = { .task = task, .fn = fn, .done = true };
+  char* error = guard(callTask, &call);
+  if (error) {
+    if (task->error) {
+      free(error);
+    } else {
+      task->error = error;
+    }
+    return true;
+  }
+  return call.done;
+}
+
+typedef struct {
+  ParallelJob* job;
+  uint32_t index;
+} ParallelCall;
+
+static void callParallel(void* arg) {
+  ParallelCall* call = arg;
+  call->job->fn(call->job->context, call->index);
+}
+
+// Stops handing out indices of a job, must hold the lock
+static void closeJob(ParallelJob* job) {
+  for (size_t i = 0; i < state.jobs.length; i++) {
+    if (state.jobs.data[i] == job) {
+      arr_splice(&state.jobs, i, 1);
+      break;
+    }
+  }
+}
+
+// Runs indices of a job until there are none left, must hold the lock (it's released while working)
+static void help(ParallelJob* job) {
+  job->helpers++;
+  while (job->next < job->count) {
+    ParallelCall call = { .job = job, .index = job->next++ };
+    if (job->next == job->count) {
+      closeJob(job);
+    }
+    mtx_unlock(&state.lock);
+    char* error = guard(callParallel, &call);
+    mtx_lock(&state.lock);
+    if (error) {
+      if (job->error) {
+        free(error);
+      } else {
+        job->error = error;
+      }
+      job->next = job->count;
+      closeJob(job);
+    }
+  }
+  if (--job->helpers == 0) {
+    cnd_broadcast(&state.done);
+  }
+}
+
+static int worker(void* arg);
+
+// Starts workers until there are enough for the given amount of parallel work, must hold the lock
+static void spawn(uint32_t count) {
+  while (state.threadCount < MIN(count, MAX_TASK_WORKERS)) {
+    if (thrd_create(&state.threads[state.threadCount], worker, NULL) != thrd_success) {
+      break;
+    }
+    state.threadCount++;
+  }
+}
+
+static void run(Task* task) {
+  call(task, task->run);
+  mtx_lock(&state.lock);
+  task->state = task->error ? TASK_FAILED : TASK_FINISHING;
+  cnd_broadcast(&state.done);
+  mtx_unlock(&state.lock);
+}
+
+static bool finish(Task* task) {
+  return task->state == TASK_FAILED || !task->finish || call(task, task->finish);
+}
+
+// Takes a Task out of the queue so it can run on the calling thread, must hold the lock
+static bool dequeue(Task* task) {
+  for (size_t i = 0; i < state.queue.length; i++) {
+    if (state.queue.data[i] == task) {
+      arr_splice(&state.queue, i, 1);
+      task->state = TASK_RUNNING;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void complete(Task* task) {
+  bool found = false;
+  mtx_lock(&state.lock);
+  for (size_t i = 0; i < state.active.length; i++) {
+    if (state.active.data[i] == task) {
+      arr_splice(&state.active, i, 1);
+      found = true;
+      break;
+    }
+  }
+  task->state = task->error ? TASK_FAILED : TASK_DONE;
+  mtx_unlock(&state.lock);
+
+  if (found) {
+    if (task->notify) {
+      lovrEventPush((Event) { .type = EVENT_TASK_DONE, .data.task.task = task });
+    }
+    lovrRelease(Task, task);
+  }
+}
+
+// Parallel loops come first, since something is blocked waiting on them
+static int worker(void* arg) {
+  mtx_lock(&state.lock);
+  for (;;) {
+    while (state.queue.length == 0 && state.jobs.length == 0 && !state.quit) {
+      cnd_wait(&state.cond, &state.lock);
+    }
+
+    if (state.quit) {
+      break;
+    }
+
+    if (state.jobs.length > 0) {
+      help(state.jobs.data[0]);
+      continue;
+    }
+
+    Task* task = state.queue.data[0];
+    arr_splice(&state.queue, 0, 1);
+    task->state = TASK_RUNNING;
+    mtx_unlock(&state.lock);
+    run(task);
+    mtx_lock(&state.lock);
+  }
+  mtx_unlock(&state.lock);
+  return 0;
+}
+
+bool lovrTaskPoolInit() {
+  if (state.initialized) return false;
+  mtx_init(&state.lock, mtx_plain);
+  cnd_init(&state.cond);
+  cnd_init(&state.done);
+  arr_init(&state.queue);
+  arr_init(&state.active);
+  arr_init(&state.jobs);
+  state.owner = thrd_current();
+  state.budget = DEFAULT_TASK_BUDGET;
+  return state.initialized = true;
+}
+
+// Tasks that haven't started yet are dropped, running ones are waited on
+void lovrTaskPoolDestroy() {
+  if (!state.initialized) return;
+  mtx_lock(&state.lock);
+  state.quit = true;
+  cnd_broadcast(&state.cond);
+  mtx_unlock(&state.lock);
+  for (uint32_t i = 0; i < state.threadCount; i++) {
+    thrd_join(state.threads[i], NULL);
+  }
+  for (size_t i = 0; i < state.active.length; i++) {
+    lovrRelease(Task, state.active.data[i]);
+  }
+  arr_free(&state.queue);
+  arr_free(&state.active);
+  arr_free(&state.jobs);
+  cnd_destroy(&state.done);
+  cnd_destroy(&state.cond);
+  mtx_destroy(&state.lock);
+  memset(&state, 0, sizeof(state));
+}
+
+bool lovrTaskPoolIsInitialized() {
+  return state.initialized;
+}
+
+// Finishes Tasks in the order they were started, until the budget for this frame is used up.  At
+// least one step is taken per update so a step longer than the budget can't stall everything.
+// Only the thread that initialized the pool finishes Tasks, since that's where GPU work can happen.
+void lovrTaskUpdate() {
+  if (!state.initialized || !thrd_equal(thrd_current(), state.owner)) {
+    return;
+  }
+
+  double start = lovrPlatformGetTime();
+  for (;;) {
+    Task* task = NULL;
+    bool queued = false;
+    mtx_lock(&state.lock);
+    for (size_t i = 0; i < state.active.length; i++) {
+      Task* t = state.active.data[i];
+      if (t->state == TASK_FINISHING || t->state == TASK_FAILED) {
+        task = t;
+        break;
+      } else if (t->state == TASK_QUEUED && state.threadCount == 0) {
+        queued = dequeue(task = t);
+        break;
+      }
+    }
+    mtx_unlock(&state.lock);
+
+    if (!task) {
+      break;
+    }
+
+    // Without workers (they couldn't be created), Tasks run here instead
+    if (queued) {
+      run(task);
+    } else if (finish(task)) {
+      complete(task);
+    }
+
+    if (lovrPlatformGetTime() - start >= state.budget) {
+      break;
+    }
+  }
+}
+
+double lovrTaskGetBudget() {
+  return state.budget;
+}
+
+void lovrTaskSetBudget(double budget) {
+  state.budget = budget;
+}
+
+// The calling thread works on the loop too, so it finishes even if every worker is busy with a
+// long Task.  Without the pool (the thread module isn't loaded) the loop just runs here.
+void lovrTaskParallel(ParallelFn* fn, void* context, uint32_t count) {
+  if (!state.initialized || count <= 1) {
+    for (uint32_t i = 0; i < count; i++) {
+      fn(context, i);
+    }
+    return;
+  }
+
+  ParallelJob job = { .fn = fn, .context = context, .count = count };
+  mtx_lock(&state.lock);
+  arr_push(&state.jobs, &job);
+  spawn(count - 1);
+  cnd_broadcast(&state.cond);
+  help(&job);
+  while (job.helpers > 0) {
+    cnd_wait(&state.done, &state.lock);
+  }
+  mtx_unlock(&state.lock);
+
+  if (job.error) {
+    char message[MAX_TASK_ERROR_LENGTH];
+    memcpy(message, job.error, MAX_TASK_ERROR_LENGTH);
+    free(job.error);
+    lovrThrow("%s", message);
+  }
+}
+
+Task* lovrTaskInit(Task* task, TaskFn* run, TaskFn* finish, void* context, void (*destructor)(void*)) {
+  task->run = run;
+  task->finish = finish;
+  task->context = context;
+  task->destructor = destructor;
+  task->state = TASK_QUEUED;
+  return task;
+}
+
+void lovrTaskDestroy(void* ref) {
+  Task* task = ref;
+  if (task->destructor) {
+    task->destructor(task->context);
+  }
+  lovrVariantDestroy(&task->result);
+  free(task->error);
+}
+
+void lovrTaskStart(Task* task) {
+  lovrAssert(state.initialized, "The thread module needs to be initialized to start a Task");
+  lovrRetain(task);
+  mtx_lock(&state.lock);
+  arr_push(&state.active, task);
+  arr_push(&state.queue, task);
+  spawn(state.threadCount + 1);
+  cnd_signal(&state.cond);
+  mtx_unlock(&state.lock);
+}
+
+// A Task that hasn't been picked up by a worker yet is run right away on the calling thread
+void lovrTaskWait(Task* task) {
+  mtx_lock(&state.lock);
+  bool queued = task->state == TASK_QUEUED && dequeue(task);
+  while (task->state == TASK_RUNNING && !queued) {
+    cnd_wait(&state.done, &state.lock);
+  }
+  mtx_unlock(&state.lock);
+
+  if (queued) {
+    run(task);
+  }
+
+  if (task->state == TASK_FINISHING || task->state == TASK_FAILED) {
+    while (!finish(task)) {
+      continue;
+    }
+    complete(task);
+  }
+}
+
+bool lovrTaskIsDone(Task* task) {
+  mtx_lock(&state.lock);
+  bool done = task->state == TASK_DONE || task->state == TASK_FAILED;
+  mtx_unlock(&state.lock);
+  return done;
+}
+
+const char* lovrTaskGetError(Task* task) {
+  return task->error;
+}
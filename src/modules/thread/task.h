@@ -0,0 +1,56 @@
+#include "event/event.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// A Task runs its run function on a pool of worker threads (file I/O and decoding), then its finish
+// function on the main thread (GPU uploads).  finish is called once per step until it returns true,
+// and lovrTaskUpdate spreads the steps of every pending Task over frames using a time budget.  The
+// result is an object Variant.  Errors thrown by either function fail the Task instead.
+//
+// lovrTaskParallel splits a loop across the same workers and the calling thread, returning once
+// every index is done.  An error stops the loop and is rethrown on the calling thread.
+
+#pragma once
+
+#define MAX_TASK_WORKERS 4
+#define DEFAULT_TASK_BUDGET .002
+
+struct Task;
+typedef bool TaskFn(struct Task* task);
+typedef void ParallelFn(void* context, uint32_t index);
+
+typedef enum {
+  TASK_QUEUED,
+  TASK_RUNNING,
+  TASK_FINISHING,
+  TASK_DONE,
+  TASK_FAILED
+} TaskState;
+
+// Tasks with notify set (the ones started from Lua) send a taskdone event when they're done
+typedef struct Task {
+  TaskFn* run;
+  TaskFn* finish;
+  void (*destructor)(void* context);
+  void* context;
+  Variant result;
+  char* error;
+  TaskState state;
+  bool notify;
+} Task;
+
+bool lovrTaskPoolInit(void);
+void lovrTaskPoolDestroy(void);
+bool lovrTaskPoolIsInitialized(void);
+void lovrTaskUpdate(void);
+double lovrTaskGetBudget(void);
+void lovrTaskSetBudget(double budget);
+void lovrTaskParallel(ParallelFn* fn, void* context, uint32_t count);
+
+Task* lovrTaskInit(Task* task, TaskFn* run, TaskFn* finish, void* context, void (*destructor)(void*));
+#define lovrTaskCreate(...) lovrTaskInit(lovrAlloc(Task), __VA_ARGS__)
+void lovrTaskDestroy(void* ref);
+void lovrTaskStart(Task* task);
+void lovrTaskWait(Task* task);
+bool lovrTaskIsDone(Task* task);
+const char* lovrTaskGetError(Task* task);
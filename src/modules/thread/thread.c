@@ -1,5 +1,6 @@
 #include "thread/thread.h"
 #include "thread/channel.h"
+#include "thread/task.h"
 #include "core/arr.h"
 #include "core/hash.h"
 #include "core/map.h"
@@ -23,11 +24,13 @@ bool lovrThreadModuleInit() {
   if (state.initialized) return false;
   mtx_init(&state.channelLock, mtx_plain);
   map_init(&state.channels, 0);
+  lovrTaskPoolInit();
   return state.initialized = true;
 }
 
 void lovrThreadModuleDestroy() {
   if (!state.initialized) return;
+  lovrTaskPoolDestroy();
   for (size_t i = 0; i < state.channels.size; i++) {
     if (state.channels.values[i] != MAP_NIL) {
       ChannelEntry entry = { state.channels.values[i] };
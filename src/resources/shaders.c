@@ -2,11 +2,15 @@
 
 const char* lovrShaderVertexPrefix = ""
 "#define VERTEX VERTEX \n"
-"#define MAX_BONES 48 \n"
+"#define MAX_BONES 256 \n"
 "#define MAX_DRAWS 256 \n"
 "#define lovrView lovrViews[lovrViewID] \n"
 "#define lovrProjection lovrProjections[lovrViewID] \n"
+"#ifdef FLAG_instanceTransforms \n"
+"#define lovrModel (lovrModels[lovrDrawID] * lovrGetInstanceTransform()) \n"
+"#else \n"
 "#define lovrModel lovrModels[lovrDrawID] \n"
+"#endif \n"
 "#define lovrTransform (lovrView * lovrModel) \n"
 "#ifdef FLAG_uniformScale \n"
 "#define lovrNormalMatrix mat3(lovrModel) \n"
@@ -14,13 +18,18 @@ const char* lovrShaderVertexPrefix = ""
 "#define lovrNormalMatrix mat3(transpose(inverse(lovrModel))) \n"
 "#endif \n"
 "#define lovrInstanceID (gl_InstanceID / lovrViewportCount) \n"
+"#ifdef FLAG_animatedInstances \n"
+"#define lovrBonePose(i) lovrGetInstancePose(lovrBones[i]) \n"
+"#else \n"
+"#define lovrBonePose(i) lovrPose[lovrBones[i]] \n"
+"#endif \n"
 "#define lovrPoseMatrix ("
-  "lovrPose[lovrBones[0]] * lovrBoneWeights[0] +"
-  "lovrPose[lovrBones[1]] * lovrBoneWeights[1] +"
-  "lovrPose[lovrBones[2]] * lovrBoneWeights[2] +"
-  "lovrPose[lovrBones[3]] * lovrBoneWeights[3]"
+  "lovrBonePose(0) * lovrBoneWeights[0] +"
+  "lovrBonePose(1) * lovrBoneWeights[1] +"
+  "lovrBonePose(2) * lovrBoneWeights[2] +"
+  "lovrBonePose(3) * lovrBoneWeights[3]"
   ") \n"
-"#ifdef FLAG_animated \n"
+"#if defined(FLAG_animated) || defined(FLAG_animatedInstances) \n"
 "#define lovrVertex (lovrPoseMatrix * vec4(lovrPosition, 1.)) \n"
 "#else \n"
 "#define lovrVertex vec4(lovrPosition, 1.) \n"
@@ -43,7 +52,7 @@ const char* lovrShaderVertexPrefix = ""
 "layout(std140) uniform lovrFrameBlock { mat4 lovrViews[2]; mat4 lovrProjections[2]; }; \n"
 "uniform mat3 lovrMaterialTransform; \n"
 "uniform float lovrPointSize; \n"
-"uniform mat4 lovrPose[MAX_BONES]; \n"
+"layout(std140) uniform lovrPoseBlock { mat4 lovrPose[MAX_BONES]; }; \n"
 "uniform lowp int lovrViewportCount; \n"
 "#if defined MULTIVIEW \n"
 "layout(num_views = 2) in; \n"
@@ -53,6 +62,35 @@ const char* lovrShaderVertexPrefix = ""
 "#else \n"
 "uniform lowp int lovrViewID; \n"
 "#endif \n"
+"#ifdef FLAG_animatedInstances \n"
+"uniform highp sampler2D lovrPoseTexture; \n"
+"uniform int lovrPoseOffset; \n"
+"mat4 lovrGetInstancePose(uint bone) { \n"
+"  int x = 4 * (lovrPoseOffset + int(bone)); \n"
+"  int y = lovrInstanceID; \n"
+"  return mat4( \n"
+"    texelFetch(lovrPoseTexture, ivec2(x + 0, y), 0), \n"
+"    texelFetch(lovrPoseTexture, ivec2(x + 1, y), 0), \n"
+"    texelFetch(lovrPoseTexture, ivec2(x + 2, y), 0), \n"
+"    texelFetch(lovrPoseTexture, ivec2(x + 3, y), 0) \n"
+"  ); \n"
+"} \n"
+"#endif \n"
+"#ifdef FLAG_instanceTransforms \n"
+"uniform highp sampler2D lovrInstanceTexture; \n"
+"uniform int lovrInstanceOffset; \n"
+"mat4 lovrGetInstanceTransform() { \n"
+"  int width = textureSize(lovrInstanceTexture, 0).x; \n"
+"  int texel = 4 * (lovrInstanceOffset + lovrInstanceID); \n"
+"  ivec2 uv = ivec2(texel % width, texel / width); \n"
+"  return mat4( \n"
+"    texelFetch(lovrInstanceTexture, uv + ivec2(0, 0), 0), \n"
+"    texelFetch(lovrInstanceTexture, uv + ivec2(1, 0), 0), \n"
+"    texelFetch(lovrInstanceTexture, uv + ivec2(2, 0), 0), \n"
+"    texelFetch(lovrInstanceTexture, uv + ivec2(3, 0), 0) \n"
+"  ); \n"
+"} \n"
+"#endif \n"
 "#line 0 \n";
 
 const char* lovrShaderVertexSuffix = ""